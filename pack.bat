@@ -7,10 +7,13 @@ if not exist %dir%\pack (
     rd /s /Q %dir%\pack
     md %dir%\pack
 )
-md %dir%\pack\resource
 set cp=%dir%\pack
-cd %dir%\resource\
-xcopy * %cp%\resource\ /y /e /i /q
+rem 增量烘焙资源, 产物位于resource\.cooked并随资源包一起发布
+%dir%\build\mgl-cook.exe %dir%\resource
+if errorlevel 1 exit /b 1
+rem 资源目录打包为单个资源包, 运行时只需映射这一个文件
+%dir%\build\mgl-pack.exe %dir%\resource %cp%\resource.mglpack resource
+if errorlevel 1 exit /b 1
 cd %dir%\build\
 copy *.exe %cp%
 copy *.dll %cp%
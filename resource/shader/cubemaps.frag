@@ -7,9 +7,48 @@ in vec3 Position;
 uniform vec3 cameraPos;
 uniform samplerCube skybox;
 
+// Precomputed image-based lighting, see EnvironmentLighting::bind
+uniform bool useEnvironmentLighting;
+uniform vec3 irradianceSH[9];
+uniform samplerCube specularMap;
+uniform sampler2D brdfLut;
+uniform float specularLevels;
+// Surface parameters used with environment lighting, albedo is linear
+uniform vec3 albedo;
+uniform float metallic;
+uniform float roughness;
+
+// Diffuse irradiance divided by pi, from L2 spherical harmonics
+vec3 irradiance(vec3 n)
+{
+    return irradianceSH[0] * 0.282095
+         + irradianceSH[1] * 0.488603 * n.y
+         + irradianceSH[2] * 0.488603 * n.z
+         + irradianceSH[3] * 0.488603 * n.x
+         + irradianceSH[4] * 1.092548 * n.x * n.y
+         + irradianceSH[5] * 1.092548 * n.y * n.z
+         + irradianceSH[6] * 0.315392 * (3.0 * n.z * n.z - 1.0)
+         + irradianceSH[7] * 1.092548 * n.x * n.z
+         + irradianceSH[8] * 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
 void main()
 {    
+    vec3 N = normalize(Normal);
     vec3 I = normalize(Position - cameraPos);
-    vec3 R = reflect(I, normalize(Normal));
-    FragColor = vec4(texture(skybox, R).rgb, 1.0);
-}
\ No newline at end of file
+    vec3 R = reflect(I, N);
+    if (!useEnvironmentLighting) {
+        FragColor = vec4(texture(skybox, R).rgb, 1.0);
+        return;
+    }
+    // Split-sum approximation: prefiltered radiance times the BRDF integral
+    float NdotV = max(dot(N, -I), 0.0);
+    vec3 F0 = mix(vec3(0.04), albedo, metallic);
+    vec2 brdf = texture(brdfLut, vec2(NdotV, roughness)).rg;
+    float lod = roughness * (specularLevels - 1.0);
+    vec3 specular = textureLod(specularMap, R, lod).rgb * (F0 * brdf.x + brdf.y);
+    vec3 kD = (1.0 - F0) * (1.0 - metallic);
+    vec3 diffuse = kD * albedo * max(irradiance(N), vec3(0.0));
+    // Lighting is computed in linear space; encode for the sRGB display
+    FragColor = vec4(pow(diffuse + specular, vec3(1.0 / 2.2)), 1.0);
+}
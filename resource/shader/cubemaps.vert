@@ -1,6 +1,6 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aNormal;
+layout (location = 1) in vec3 aNormal;
 
 out vec3 Normal;
 out vec3 Position;
@@ -8,10 +8,27 @@ out vec3 Position;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+// packed vertices store positions normalized to the mesh bounds and
+// the normal as octahedral snorm16x2, see PackedVertex
+uniform bool packedVertex;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main()
 {
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    Position = vec3(model * vec4(aPos, 1.0));
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 position = packedVertex ? aPos * positionScale + positionOffset
+                                 : aPos;
+    vec3 normal = packedVertex ? decodeOctahedral(aNormal.xy) : aNormal;
+    Normal = mat3(transpose(inverse(model))) * normal;
+    Position = vec3(model * vec4(position, 1.0));
+    gl_Position = projection * view * model * vec4(position, 1.0);
 }
\ No newline at end of file
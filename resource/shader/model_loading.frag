@@ -2,10 +2,34 @@
 out vec4 FragColor;
 
 in vec2 TexCoords;
+in vec3 Normal;
+in mat3 TBN;
 
 uniform sampler2D texture_diffuse1;
+// The specular map is packed into the alpha channel of the diffuse map
+uniform bool specularInAlpha;
+// Normal maps keep only xy (BC5 or RG8); z is rebuilt from the unit length
+uniform sampler2D texture_normal1;
+uniform bool normalMapped;
+// Optional directional light; the zero default leaves the diffuse unlit
+uniform vec3 lightDirection;
+
+vec3 sampleNormalMap(vec2 uv)
+{
+    vec2 xy = texture(texture_normal1, uv).rg * 2.0 - 1.0;
+    float z = sqrt(max(1.0 - dot(xy, xy), 0.0));
+    return vec3(xy, z);
+}
 
 void main()
 {    
-    FragColor = texture(texture_diffuse1, TexCoords);
-}
\ No newline at end of file
+    vec4 diffuse = texture(texture_diffuse1, TexCoords);
+    vec3 N = normalMapped ? normalize(TBN * sampleNormalMap(TexCoords))
+                          : normalize(Normal);
+    float light = 1.0;
+    if (dot(lightDirection, lightDirection) > 0.0) {
+        light = 0.2 + 0.8 * max(dot(N, -normalize(lightDirection)), 0.0);
+    }
+    // A packed alpha holds specular intensity, not coverage
+    FragColor = vec4(diffuse.rgb * light, specularInAlpha ? 1.0 : diffuse.a);
+}
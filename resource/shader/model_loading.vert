@@ -2,15 +2,59 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
 
 out vec2 TexCoords;
+out vec3 Normal;
+out mat3 TBN;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+// packed vertices store positions normalized to the mesh bounds;
+// float vertices use scale 1 and offset 0
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+// packed vertices store normal and tangent as octahedral snorm16x2 and
+// the bitangent sign as unorm in location 4 (0 is -1, 1 is +1),
+// see PackedVertex
+uniform bool packedVertex;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 decodeNormal()
+{
+    return packedVertex ? decodeOctahedral(aNormal.xy) : aNormal;
+}
+
+vec3 decodeTangent()
+{
+    return packedVertex ? decodeOctahedral(aTangent.xy) : aTangent;
+}
+
+vec3 decodeBitangent(vec3 normal, vec3 tangent)
+{
+    return packedVertex ? cross(normal, tangent) * (aBitangent.x * 2.0 - 1.0)
+                        : aBitangent;
+}
 
 void main()
 {
-    TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    TexCoords = aTexCoords;
+    vec3 position = aPos * positionScale + positionOffset;
+    mat3 normalMatrix = mat3(transpose(inverse(model)));
+    vec3 normal = decodeNormal();
+    vec3 tangent = decodeTangent();
+    vec3 bitangent = decodeBitangent(normal, tangent);
+    Normal = normalMatrix * normal;
+    TBN = mat3(mat3(model) * tangent, mat3(model) * bitangent, Normal);
+    gl_Position = projection * view * model * vec4(position, 1.0);
 }
\ No newline at end of file
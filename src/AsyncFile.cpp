@@ -0,0 +1,388 @@
+﻿#include "header/AsyncFile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "header/Config.h"
+#include "header/FileSystem.h"
+#include "header/ThreadPool.h"
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define MGL_IO_URING
+#endif
+#endif
+#endif
+
+namespace {
+using Buffer = std::vector<unsigned char>;
+
+// 存活的批次登记的文件, 键为规范路径
+struct Registry {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_future<mgl::FileData>> files;
+    // files的大小, 没有批次时ReadFile不必计算规范路径
+    std::atomic<size_t> count{0};
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+// 一个待读取的文件
+struct Request {
+    std::string path;
+    std::promise<mgl::FileData> promise;
+};
+
+using Requests = std::vector<Request>;
+
+// 阻塞地把整个文件读入自有的缓冲区, 与ReadFile一样空文件视为无法读取
+mgl::FileData readWhole(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return mgl::FileData();
+    std::streamoff size = in.tellg();
+    if (size <= 0) return mgl::FileData();
+    auto buffer = std::make_shared<Buffer>(static_cast<size_t>(size));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(buffer->data()), size)) {
+        std::printf("ERROR::ASYNC_FILE::READ %s\n", path.c_str());
+        return mgl::FileData();
+    }
+    return mgl::FileData(buffer, buffer->data(), buffer->size());
+}
+
+// 每个文件一个任务, 在ioPool上并行阻塞读取
+void readEach(const std::shared_ptr<Requests>& requests,
+              const std::vector<size_t>& indices) {
+    mgl::ThreadPool& pool = mgl::ioPool();
+    for (size_t i : indices) {
+        pool.submit([requests, i]() {
+            Request& request = (*requests)[i];
+            request.promise.set_value(readWhole(request.path));
+        });
+    }
+}
+
+#ifdef MGL_IO_URING
+// 内核不支持或禁用了io_uring后不再尝试
+std::atomic<bool> uringUnavailable{false};
+
+// 单次读请求的最大长度, 更大的文件分多次读取
+const size_t MAX_READ = size_t(1) << 30;
+
+// 不依赖liburing的最小io_uring封装, 只由一个线程使用
+class Ring {
+  private:
+    int fd = -1;
+    void* sqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    void* cqRing = MAP_FAILED;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+  public:
+    unsigned entries = 0;
+
+    Ring() = default;
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+    ~Ring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool init(unsigned count) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, count, &params));
+        if (fd < 0) return false;
+        entries = params.sq_entries;
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize =
+            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) return false;
+        if (single) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(
+            mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // 放入一个读请求, 提交队列已满时返回false
+    bool read(int file, void* data, size_t size, uint64_t offset,
+              uint64_t tag) {
+        unsigned tail = *sqTail;
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (tail - head >= entries) return false;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = file;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(size);
+        sqe->off = offset;
+        sqe->user_data = tag;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // 提交submit个请求并至少等待wait个完成, 返回提交的个数或-errno
+    int enter(unsigned submit, unsigned wait) {
+        int result = static_cast<int>(
+            syscall(__NR_io_uring_enter, fd, submit, wait,
+                    wait ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0));
+        return result < 0 ? -errno : result;
+    }
+
+    // 取出所有已完成的请求, 对每个调用f(tag, result)
+    template <typename F>
+    void reap(F&& f) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            f(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+};
+
+// 通过一个io_uring同时读取整批文件, 读取失败的文件退回阻塞读取
+void readWithUring(const std::shared_ptr<Requests>& requests) {
+    struct File {
+        int fd = -1;
+        size_t done = 0;
+        std::shared_ptr<Buffer> buffer;
+    };
+    Requests& batch = *requests;
+    std::vector<File> files(batch.size());
+    std::vector<size_t> queue;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        File& file = files[i];
+        file.fd = ::open(batch[i].path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (file.fd < 0 || fstat(file.fd, &info) != 0 || info.st_size <= 0) {
+            // 不存在或为空, 与ReadFile的结果一致
+            if (file.fd >= 0) ::close(file.fd);
+            file.fd = -1;
+            batch[i].promise.set_value(mgl::FileData());
+            continue;
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        file.buffer = std::make_shared<Buffer>(size);
+        queue.push_back(i);
+    }
+    // 读取失败的文件之后交给readEach
+    std::vector<size_t> fallback;
+    auto finish = [&](size_t i, bool ok) {
+        File& file = files[i];
+        ::close(file.fd);
+        file.fd = -1;
+        if (ok) {
+            batch[i].promise.set_value(mgl::FileData(
+                file.buffer, file.buffer->data(), file.buffer->size()));
+        } else {
+            fallback.push_back(i);
+        }
+        file.buffer.reset();
+    };
+
+    Ring ring;
+    unsigned count = static_cast<unsigned>(std::min<size_t>(queue.size(), 64));
+    if (count == 0) return;
+    if (!ring.init(count)) {
+        int error = errno;
+        if (error == ENOSYS || error == EPERM || error == EACCES) {
+            uringUnavailable = true;
+        }
+        for (size_t i : queue) finish(i, false);
+        readEach(requests, fallback);
+        return;
+    }
+    // 请求按队列顺序放入, 完成后短读的文件重新排到队尾
+    size_t next = 0;
+    unsigned queued = 0, inFlight = 0;
+    bool failed = false;
+    while (next < queue.size() || queued + inFlight > 0) {
+        while (next < queue.size() && queued + inFlight < ring.entries) {
+            size_t i = queue[next];
+            File& file = files[i];
+            size_t size = std::min(file.buffer->size() - file.done, MAX_READ);
+            if (!ring.read(file.fd, file.buffer->data() + file.done, size,
+                           file.done, i)) {
+                break;
+            }
+            ++next;
+            ++queued;
+        }
+        int submitted = ring.enter(queued, 1);
+        if (submitted < 0) {
+            if (submitted == -EINTR || submitted == -EAGAIN ||
+                submitted == -EBUSY) {
+                continue;
+            }
+            std::printf("ERROR::ASYNC_FILE::IO_URING %s\n",
+                        std::strerror(-submitted));
+            failed = true;
+            break;
+        }
+        queued -= static_cast<unsigned>(submitted);
+        inFlight += static_cast<unsigned>(submitted);
+        ring.reap([&](uint64_t tag, int result) {
+            --inFlight;
+            size_t i = static_cast<size_t>(tag);
+            File& file = files[i];
+            if (result < 0 && result != -EAGAIN && result != -EINTR) {
+                // 5.6之前的内核不支持IORING_OP_READ
+                if (result == -EINVAL) uringUnavailable = true;
+                finish(i, false);
+            } else if (result == 0 && file.done < file.buffer->size()) {
+                // 文件在读取期间变短
+                file.buffer->resize(file.done);
+                finish(i, file.done > 0);
+            } else {
+                file.done += static_cast<size_t>(std::max(result, 0));
+                if (file.done < file.buffer->size()) {
+                    queue.push_back(i);
+                } else {
+                    finish(i, true);
+                }
+            }
+        });
+    }
+    if (failed) {
+        // 已提交的请求仍会写入缓冲区, 全部完成后才能释放,
+        // 完成事件由内核直接写入完成队列, enter失败时轮询等待
+        while (inFlight > 0) {
+            int result = ring.enter(0, 1);
+            unsigned before = inFlight;
+            ring.reap([&](uint64_t, int) { --inFlight; });
+            if (result < 0 && inFlight == before) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (files[i].buffer) finish(i, false);
+        }
+    }
+    readEach(requests, fallback);
+}
+#endif
+}  // namespace
+
+_MGL ReadBatch::ReadBatch(const std::vector<std::string>& paths) {
+    if (!loadConfig().asyncFileReads) return;
+    // 包中的文件已经映射, 不必预读
+    std::vector<std::pair<std::string, std::string>> loose;
+    for (const std::string& path : paths) {
+        if (!InPack(path)) loose.emplace_back(CanonicalPath(path), path);
+    }
+    auto requests = std::make_shared<Requests>();
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& file : loose) {
+            if (r.files.count(file.first)) continue;
+            Request request;
+            request.path = file.second;
+            r.files.emplace(file.first, request.promise.get_future().share());
+            keys.push_back(file.first);
+            requests->push_back(std::move(request));
+        }
+        r.count = r.files.size();
+    }
+    if (requests->empty()) return;
+#ifdef MGL_IO_URING
+    if (!uringUnavailable) {
+        ioPool().submit([requests]() { readWithUring(requests); });
+        return;
+    }
+#endif
+    std::vector<size_t> all(requests->size());
+    for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+    readEach(requests, all);
+}
+
+_MGL ReadBatch::~ReadBatch() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const std::string& key : keys) r.files.erase(key);
+    r.count = r.files.size();
+}
+
+std::vector<_MGL FileData> _MGL ReadFiles(
+    const std::vector<std::string>& paths) {
+    ReadBatch batch(paths);
+    std::vector<FileData> files;
+    files.reserve(paths.size());
+    for (const std::string& path : paths) files.push_back(ReadFile(path));
+    return files;
+}
+
+bool _MGL FindBatched(const std::string& path, FileData& data) {
+    Registry& r = registry();
+    if (r.count == 0) return false;
+    std::shared_future<FileData> file;
+    {
+        std::string key = CanonicalPath(path);
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto it = r.files.find(key);
+        if (it == r.files.end()) return false;
+        file = it->second;
+    }
+    data = file.get();
+    return true;
+}
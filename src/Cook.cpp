@@ -0,0 +1,466 @@
+﻿#include "header/Cook.h"
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "header/Config.h"
+#include "header/FileSystem.h"
+#include "header/Hash.h"
+#include "header/Image.h"
+#include "header/MappedFile.h"
+#include "header/Model.h"
+#include "header/ModelCache.h"
+#include "header/ThreadPool.h"
+#include "header/VirtualFileSystem.h"
+
+namespace {
+// 清单文件名
+const char* const MANIFEST = "manifest";
+
+enum class CookKind { None, Model, Texture, Shader };
+
+// 小写的文件扩展名
+std::string extension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos) {
+        return std::string();
+    }
+    std::string ext = path.substr(dot + 1);
+    for (auto& c : ext) c = static_cast<char>(std::tolower((unsigned char)c));
+    return ext;
+}
+
+CookKind kindOf(const std::string& path) {
+    static const std::unordered_map<std::string, CookKind> KINDS = {
+        {"obj", CookKind::Model},     {"gltf", CookKind::Model},
+        {"glb", CookKind::Model},     {"fbx", CookKind::Model},
+        {"dae", CookKind::Model},     {"3ds", CookKind::Model},
+        {"png", CookKind::Texture},   {"jpg", CookKind::Texture},
+        {"jpeg", CookKind::Texture},  {"tga", CookKind::Texture},
+        {"bmp", CookKind::Texture},   {"vert", CookKind::Shader},
+        {"frag", CookKind::Shader},   {"geom", CookKind::Shader},
+        {"tesc", CookKind::Shader},   {"tese", CookKind::Shader},
+        {"comp", CookKind::Shader},
+    };
+    auto it = KINDS.find(extension(path));
+    return it == KINDS.end() ? CookKind::None : it->second;
+}
+
+// 清单中的一条记录
+struct ManifestEntry {
+    uint64_t sourceHash = 0;
+    uint64_t settings = 0;
+    // 计算sourceHash时源文件的大小与修改时间
+    mgl::FileStamp stamp;
+    // 产物文件名, 相对于烘焙目录
+    std::string object;
+    // 模型导入时读取的其他文件(.mtl, 外部.bin等)及其哈希
+    std::vector<mgl::ModelDependency> dependencies;
+    // 与dependencies一一对应的大小与修改时间
+    std::vector<mgl::FileStamp> dependencyStamps;
+};
+
+// 记录的大小与修改时间有效且与文件当前的相同, 可以沿用记录的哈希
+bool unchanged(const std::string& path, const mgl::FileStamp& recorded) {
+    mgl::FileStamp current;
+    return recorded.mtime != 0 && mgl::StatFile(path, current) &&
+           current == recorded;
+}
+
+// 解析清单, 每行为: 源文件哈希 设置哈希 大小 修改时间 产物 源文件相对路径;
+// 模型之后的每个依赖文件占一行: + 依赖文件哈希 大小 修改时间 依赖文件路径
+template <typename F>
+void parseManifest(const mgl::FileData& file, F&& f) {
+    const char* p = reinterpret_cast<const char*>(file.data());
+    const char* end = p + file.size();
+    std::string path;
+    ManifestEntry entry;
+    bool pending = false;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!eol) eol = end;
+        std::string line(p, eol);
+        p = eol + 1;
+        unsigned long long hash, settings, size;
+        long long mtime;
+        int consumed = 0;
+        if (line.compare(0, 2, "+ ") == 0) {
+            if (pending &&
+                std::sscanf(line.c_str() + 2, "%llx %llu %lld %n", &hash,
+                            &size, &mtime, &consumed) == 3 &&
+                consumed != 0) {
+                mgl::ModelDependency dependency;
+                dependency.hash = hash;
+                dependency.path = line.substr(2 + size_t(consumed));
+                entry.dependencies.push_back(dependency);
+                mgl::FileStamp stamp;
+                stamp.size = size;
+                stamp.mtime = mtime;
+                entry.dependencyStamps.push_back(stamp);
+            }
+            continue;
+        }
+        char object[64];
+        if (std::sscanf(line.c_str(), "%llx %llx %llu %lld %63s %n", &hash,
+                        &settings, &size, &mtime, object, &consumed) < 5 ||
+            consumed == 0) {
+            continue;
+        }
+        if (pending) f(path, entry);
+        entry = ManifestEntry();
+        entry.sourceHash = hash;
+        entry.settings = settings;
+        entry.stamp.size = size;
+        entry.stamp.mtime = mtime;
+        entry.object = object;
+        path = line.substr(static_cast<size_t>(consumed));
+        pending = true;
+    }
+    if (pending) f(path, entry);
+}
+
+// 运行时使用的清单, 第一次查找时读取
+struct CookedIndex {
+    std::mutex mutex;
+    bool loaded = false;
+    // 读取时的资源根目录与烘焙目录
+    std::string root;
+    std::string directory;
+    // 源文件的规范路径 -> 记录
+    std::unordered_map<std::string, ManifestEntry> entries;
+};
+
+CookedIndex& cookedIndex() {
+    static CookedIndex index;
+    return index;
+}
+
+void loadIndex(CookedIndex& index, const std::string& root) {
+    index.loaded = true;
+    index.root = root;
+    index.directory = root + '/' + _MGL COOKED_DIRECTORY + '/';
+    index.entries.clear();
+    _MGL FileData file = _MGL ReadFile(index.directory + MANIFEST);
+    if (!file.isOpen()) return;
+    parseManifest(file, [&](const std::string& path,
+                            const ManifestEntry& entry) {
+        index.entries[_MGL CanonicalPath(root + '/' + path)] = entry;
+    });
+}
+
+uint64_t settingsFor(CookKind kind, const std::string& path) {
+    switch (kind) {
+        case CookKind::Model:
+            return _MGL Model::importSettings(path);
+        case CookKind::Texture:
+            return _MGL CookedImageSettings(path);
+        case CookKind::Shader:
+            return _MGL ShaderCookSettings();
+        default:
+            return 0;
+    }
+}
+
+// 产物文件名由源文件哈希, 设置, 种类与依赖文件决定, 内容相同的文件
+// 共用产物; 着色器保留阶段扩展名以便按文件名判断类型
+std::string objectName(CookKind kind, const std::string& path,
+                       const ManifestEntry& entry) {
+    uint64_t key = _MGL HashCombine(entry.sourceHash, entry.settings);
+    key = _MGL HashCombine(key, static_cast<int>(kind));
+    for (auto& d : entry.dependencies) {
+        key = _MGL HashBytes(d.path.data(), d.path.size(), key);
+        key = _MGL HashCombine(key, d.hash);
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+    switch (kind) {
+        case CookKind::Model:
+            return name + std::string(".mglcache");
+        case CookKind::Texture:
+            return name + std::string(".mgli");
+        default:
+            return name + ('.' + extension(path));
+    }
+}
+
+bool cookTexture(const _MGL MappedFile& source, const std::string& path,
+                 const std::string& output) {
+    _MGL Image image = _MGL DecodeImageFromMemory(source.data(), source.size());
+    std::string tmp = _MGL TempPath(output);
+    if (!_MGL WriteCookedImage(image, _MGL GuessTextureRole(path), tmp)) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return _MGL ReplaceFileAtomic(tmp, output);
+}
+
+bool cookShader(const _MGL MappedFile& source, const std::string& output) {
+    std::string code = _MGL CookShaderSource(std::string(
+        reinterpret_cast<const char*>(source.data()), source.size()));
+    std::string tmp = _MGL TempPath(output);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(code.data(), code.size());
+        if (!out) {
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    return _MGL ReplaceFileAtomic(tmp, output);
+}
+
+bool endsWith(const std::string& s, const char* suffix) {
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+}  // namespace
+
+std::string _MGL FindCooked(const std::string& source, uint64_t settings,
+                            uint64_t* sourceHash) {
+    const std::string& root = loadConfig().cookedRoot;
+    if (root.empty()) return std::string();
+    ManifestEntry entry;
+    std::string directory;
+    {
+        CookedIndex& index = cookedIndex();
+        std::lock_guard<std::mutex> lock(index.mutex);
+        if (!index.loaded || index.root != root) loadIndex(index, root);
+        if (index.entries.empty()) return std::string();
+        auto it = index.entries.find(CanonicalPath(source));
+        if (it == index.entries.end() || it->second.settings != settings) {
+            return std::string();
+        }
+        entry = it->second;
+        directory = index.directory;
+    }
+    // 源文件或模型的依赖文件改变后产物失效; 大小与修改时间都与清单
+    // 相同的文件不再读取, 其余的重新计算哈希.
+    // 只发布了产物, 源文件不存在时直接使用
+    bool present = unchanged(source, entry.stamp);
+    uint64_t hash = 0;
+    if (!present && FileHash(source, hash)) {
+        if (hash != entry.sourceHash) return std::string();
+        present = true;
+    }
+    if (present) {
+        for (size_t i = 0; i < entry.dependencies.size(); ++i) {
+            const ModelDependency& d = entry.dependencies[i];
+            std::string path = ModelCache::dependencyPath(source, d);
+            if (i < entry.dependencyStamps.size() &&
+                unchanged(path, entry.dependencyStamps[i])) {
+                continue;
+            }
+            uint64_t current = 0;
+            if (!FileHash(path, current)) current = 0;
+            if (current != d.hash) return std::string();
+        }
+    }
+    if (sourceHash) *sourceHash = entry.sourceHash;
+    return directory + entry.object;
+}
+
+bool _MGL CookDirectory(const std::string& root, CookStats* stats) {
+    CookStats local;
+    CookStats& s = stats ? *stats : local;
+    std::string directory = root + '/' + COOKED_DIRECTORY;
+    if (!MakeDirectory(directory)) {
+        std::printf("ERROR::COOK::CREATE_DIRECTORY %s\n", directory.c_str());
+        return false;
+    }
+
+    // 需要烘焙的源文件, 跳过产物与运行时写入的网格缓存
+    struct Job {
+        std::string path;
+        CookKind kind;
+        ManifestEntry entry;
+        bool hashed = false;
+    };
+    std::vector<Job> jobs;
+    std::string prefix = std::string(COOKED_DIRECTORY) + '/';
+    for (auto& name : ListFiles(root)) {
+        if (name.compare(0, prefix.size(), prefix) == 0 ||
+            endsWith(name, ".tmp")) {
+            continue;
+        }
+        CookKind kind = kindOf(name);
+        if (kind == CookKind::None) continue;
+        Job job;
+        job.path = name;
+        job.kind = kind;
+        jobs.push_back(job);
+    }
+    // 上次清单记录的模型依赖文件, 导入前据此预测产物文件名.
+    // 读完即释放映射, 之后才能替换清单
+    std::unordered_map<std::string, std::vector<ModelDependency>> previous;
+    {
+        FileData manifest = ReadFile(directory + '/' + MANIFEST);
+        if (manifest.isOpen()) {
+            parseManifest(manifest, [&](const std::string& path,
+                                        const ManifestEntry& entry) {
+                previous[path] = entry.dependencies;
+            });
+        }
+    }
+    // 先并行计算所有源文件与已知依赖文件的哈希, 得到产物文件名
+    ParallelFor(jobs.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Job& job = jobs[i];
+            std::string source = root + '/' + job.path;
+            // 先取大小与修改时间再读取, 读取期间的修改只会导致多算一次哈希
+            StatFile(source, job.entry.stamp);
+            MappedFile file(source);
+            if (!file.isOpen()) continue;
+            job.entry.sourceHash = HashBytes(file.data(), file.size());
+            job.entry.settings = settingsFor(job.kind, source);
+            auto it = job.kind == CookKind::Model ? previous.find(job.path)
+                                                  : previous.end();
+            if (it != previous.end()) {
+                job.entry.dependencies = it->second;
+                ModelCache::rehashDependencies(source,
+                                               job.entry.dependencies);
+            }
+            job.entry.object = objectName(job.kind, job.path, job.entry);
+            job.hashed = true;
+        }
+    });
+    // 每个尚不存在的产物只烘焙一次. 模型的依赖文件导入后才能确定,
+    // 烘焙后按实际的依赖改名; 与之共用预测产物名的其他模型按各自目录下的
+    // 依赖文件重新命名, 对应的产物仍不存在时在下一轮单独烘焙
+    std::unordered_set<std::string> failedObjects;
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (jobs[i].hashed) pending.push_back(i);
+    }
+    while (!pending.empty()) {
+        std::unordered_map<std::string, size_t> missing;
+        std::vector<size_t> work;
+        std::vector<size_t> sharing;
+        for (size_t i : pending) {
+            const std::string& object = jobs[i].entry.object;
+            if (std::ifstream(directory + '/' + object)) {
+                ++s.upToDate;
+            } else if (missing.emplace(object, work.size()).second) {
+                work.push_back(i);
+            } else {
+                sharing.push_back(i);
+            }
+        }
+        std::vector<std::string> predicted(work.size());
+        std::vector<char> succeeded(work.size(), 0);
+        ParallelFor(work.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t w = begin; w < end; ++w) {
+                Job& job = jobs[work[w]];
+                std::string source = root + '/' + job.path;
+                std::string output = directory + '/' + job.entry.object;
+                predicted[w] = job.entry.object;
+                auto start = std::chrono::steady_clock::now();
+                bool ok = false;
+                if (job.kind == CookKind::Model) {
+                    std::vector<ModelDependency> dependencies;
+                    ok = Model::Cook(source, job.entry.sourceHash, output,
+                                     &dependencies);
+                    if (ok) {
+                        job.entry.dependencies.swap(dependencies);
+                        job.entry.object =
+                            objectName(job.kind, job.path, job.entry);
+                    }
+                } else {
+                    MappedFile file(source);
+                    ok = file.isOpen() &&
+                         (job.kind == CookKind::Texture
+                              ? cookTexture(file, job.path, output)
+                              : cookShader(file, output));
+                }
+                succeeded[w] = ok;
+                if (!ok) continue;
+                std::printf("COOK %s -> %s (%.1f ms)\n", job.path.c_str(),
+                            job.entry.object.c_str(),
+                            std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count());
+            }
+        });
+        for (size_t w = 0; w < work.size(); ++w) {
+            const Job& job = jobs[work[w]];
+            bool ok = succeeded[w] &&
+                      (job.entry.object == predicted[w] ||
+                       ReplaceFileAtomic(directory + '/' + predicted[w],
+                                         directory + '/' + job.entry.object));
+            if (ok) {
+                ++s.cooked;
+            } else {
+                failedObjects.insert(job.entry.object);
+            }
+        }
+        // 失败时共用产物的文件随之失败, 纹理与着色器的产物名不变
+        pending.clear();
+        for (size_t i : sharing) {
+            Job& job = jobs[i];
+            size_t w = missing[job.entry.object];
+            const Job& cooked = jobs[work[w]];
+            if (!succeeded[w] || job.kind != CookKind::Model) continue;
+            job.entry.dependencies = cooked.entry.dependencies;
+            ModelCache::rehashDependencies(root + '/' + job.path,
+                                           job.entry.dependencies);
+            job.entry.object = objectName(job.kind, job.path, job.entry);
+            if (job.entry.object != cooked.entry.object) pending.push_back(i);
+        }
+    }
+
+    // 写入新的清单, 删除不再被引用的产物
+    std::unordered_set<std::string> referenced;
+    std::string tmp = TempPath(directory + '/' + MANIFEST);
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    for (auto& job : jobs) {
+        if (!job.hashed || failedObjects.count(job.entry.object)) {
+            std::printf("ERROR::COOK::FAILED %s\n", job.path.c_str());
+            ++s.failed;
+            continue;
+        }
+        referenced.insert(job.entry.object);
+        char line[96];
+        std::snprintf(line, sizeof(line), "%016llx %016llx %llu %lld ",
+                      (unsigned long long)job.entry.sourceHash,
+                      (unsigned long long)job.entry.settings,
+                      (unsigned long long)job.entry.stamp.size,
+                      (long long)job.entry.stamp.mtime);
+        out << line << job.entry.object << ' ' << job.path << '\n';
+        // 依赖文件的哈希在导入时计算, 这里才取得大小与修改时间,
+        // 烘焙期间被修改的依赖文件需要再烘焙一次才会被发现
+        for (auto& d : job.entry.dependencies) {
+            FileStamp stamp;
+            StatFile(ModelCache::dependencyPath(root + '/' + job.path, d),
+                     stamp);
+            std::snprintf(line, sizeof(line), "+ %016llx %llu %lld ",
+                          (unsigned long long)d.hash,
+                          (unsigned long long)stamp.size,
+                          (long long)stamp.mtime);
+            out << line << d.path << '\n';
+        }
+    }
+    out.close();
+    bool written = false;
+    if (out) {
+        written = ReplaceFileAtomic(tmp, directory + '/' + MANIFEST);
+    } else {
+        std::remove(tmp.c_str());
+    }
+    for (auto& name : ListFiles(directory)) {
+        if (name == MANIFEST || referenced.count(name)) continue;
+        if (std::remove((directory + '/' + name).c_str()) == 0) ++s.removed;
+    }
+    // 进程内之后的查找读取新的清单
+    {
+        CookedIndex& index = cookedIndex();
+        std::lock_guard<std::mutex> lock(index.mutex);
+        index.loaded = false;
+    }
+    return written && s.failed == 0;
+}
@@ -0,0 +1,416 @@
+﻿#include "header/Cubemap.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include "header/AsyncFile.h"
+#include "header/Config.h"
+#include "header/FileSystem.h"
+#include "header/Hash.h"
+#include "header/ThreadPool.h"
+#include "header/VirtualFileSystem.h"
+
+namespace {
+const char CUBEMAP_MAGIC[4] = {'M', 'G', 'L', 'X'};
+// 缓存格式版本, 修改布局或生成方式时递增
+const uint32_t CUBEMAP_VERSION = 1;
+// 每层数据的对齐
+const uint64_t LEVEL_ALIGNMENT = 16;
+
+// 缓存文件头, 之后是6 * levels个LevelIndex, 按面依次存放各层
+struct CubemapHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t settings;
+    uint32_t size;
+    uint32_t format;
+    uint32_t levels;
+    uint32_t reserved;
+};
+
+struct LevelIndex {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// 点在给定面上的坐标sc, tc, 范围[-1, 1], 与GL的面朝向一致
+void project(int face, const glm::vec3& p, float& sc, float& tc) {
+    switch (face) {
+        case 0:
+            sc = -p.z, tc = -p.y;
+            break;
+        case 1:
+            sc = p.z, tc = -p.y;
+            break;
+        case 2:
+            sc = p.x, tc = p.z;
+            break;
+        case 3:
+            sc = p.x, tc = -p.z;
+            break;
+        case 4:
+            sc = p.x, tc = -p.y;
+            break;
+        default:
+            sc = -p.x, tc = -p.y;
+            break;
+    }
+}
+
+// 立方体表面上的点落在给定面上的像素
+void faceTexel(int face, const glm::vec3& p, int size, int& x, int& y) {
+    float sc, tc;
+    project(face, p, sc, tc);
+    x = std::min(size - 1, std::max(0, int((sc + 1.0f) * 0.5f * size)));
+    y = std::min(size - 1, std::max(0, int((tc + 1.0f) * 0.5f * size)));
+}
+
+// 分量为±1的轴对应的面
+inline int axisFace(const glm::vec3& p, int axis) {
+    return 2 * axis + (p[axis] < 0.0f ? 1 : 0);
+}
+
+uint64_t cubemapSettings() {
+    const mgl::LoadConfig& config = mgl::loadConfig();
+    uint64_t hash = mgl::HashCombine(mgl::FNV_OFFSET_BASIS, CUBEMAP_VERSION);
+    hash = mgl::HashCombine(hash, config.compressTextures);
+    return mgl::HashCombine(
+        hash,
+        config.textureFilters[static_cast<int>(mgl::TextureRole::Color)]);
+}
+
+// 采样得到的分量数
+int channelsOf(mgl::PixelFormat format) {
+    bool rgb =
+        format == mgl::PixelFormat::RGB8 || format == mgl::PixelFormat::BC1;
+    return rgb ? 3 : 4;
+}
+
+bool writeCache(const std::string& path, uint64_t sourceHash,
+                uint64_t settings, const mgl::Image faces[6]) {
+    CubemapHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CUBEMAP_MAGIC, sizeof(CUBEMAP_MAGIC));
+    header.version = CUBEMAP_VERSION;
+    header.sourceHash = sourceHash;
+    header.settings = settings;
+    header.size = static_cast<uint32_t>(faces[0].width);
+    header.format = static_cast<uint32_t>(faces[0].format);
+    header.levels = static_cast<uint32_t>(faces[0].levels.size());
+    std::vector<LevelIndex> index;
+    uint64_t offset = sizeof(header) + sizeof(LevelIndex) * 6 * header.levels;
+    for (int f = 0; f < 6; ++f) {
+        for (auto& level : faces[f].levels) {
+            offset = (offset + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT *
+                     LEVEL_ALIGNMENT;
+            index.push_back({offset, level.size});
+            offset += level.size;
+        }
+    }
+
+    // 先写临时文件再替换, 避免中断时留下损坏的缓存
+    std::string tmp = mgl::TempPath(path);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(index.data()),
+                  index.size() * sizeof(LevelIndex));
+        static const char zeros[LEVEL_ALIGNMENT] = {0};
+        size_t i = 0;
+        for (int f = 0; f < 6; ++f) {
+            for (auto& level : faces[f].levels) {
+                uint64_t pos = static_cast<uint64_t>(out.tellp());
+                out.write(zeros, static_cast<std::streamsize>(
+                                     index[i++].offset - pos));
+                out.write(reinterpret_cast<const char*>(level.data),
+                          level.size);
+            }
+        }
+        if (!out) {
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    return mgl::ReplaceFileAtomic(tmp, path);
+}
+
+// 读取缓存, 各层直接引用文件内容
+bool readCache(const std::string& path, uint64_t sourceHash,
+               uint64_t settings, mgl::Image faces[6]) {
+    mgl::FileData file = mgl::ReadFile(path);
+    if (!file.isOpen() || file.size() < sizeof(CubemapHeader)) return false;
+    CubemapHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, CUBEMAP_MAGIC, sizeof(CUBEMAP_MAGIC)) ||
+        header.version != CUBEMAP_VERSION ||
+        header.sourceHash != sourceHash || header.settings != settings ||
+        header.size == 0 || header.levels == 0 || header.levels > 32) {
+        return false;
+    }
+    mgl::PixelFormat format = static_cast<mgl::PixelFormat>(header.format);
+    uint64_t count = uint64_t(header.levels) * 6;
+    if (file.size() < sizeof(header) + count * sizeof(LevelIndex)) {
+        return false;
+    }
+    const unsigned char* table = file.data() + sizeof(header);
+    for (int f = 0; f < 6; ++f) {
+        mgl::Image& face = faces[f];
+        face.reset();
+        for (uint32_t l = 0; l < header.levels; ++l) {
+            LevelIndex entry;
+            std::memcpy(&entry,
+                        table + (f * header.levels + l) * sizeof(LevelIndex),
+                        sizeof(entry));
+            int size = std::max(1, int(header.size >> l));
+            if (entry.size != mgl::ImageLevelSize(format, size, size) ||
+                entry.offset > file.size() ||
+                entry.size > file.size() - entry.offset) {
+                return false;
+            }
+            face.levels.push_back(
+                {size, size, file.data() + entry.offset, entry.size});
+        }
+        face.width = face.height = int(header.size);
+        face.channels = channelsOf(format);
+        face.format = format;
+        face.data = const_cast<unsigned char*>(face.levels[0].data);
+        face.file = file;
+    }
+    return true;
+}
+}  // namespace
+
+glm::vec3 _MGL CubemapFacePoint(int face, float s, float t) {
+    float sc = 2.0f * s - 1.0f, tc = 2.0f * t - 1.0f;
+    switch (face) {
+        case 0:
+            return {1.0f, -tc, -sc};
+        case 1:
+            return {-1.0f, -tc, sc};
+        case 2:
+            return {sc, 1.0f, tc};
+        case 3:
+            return {sc, -1.0f, -tc};
+        case 4:
+            return {sc, -tc, 1.0f};
+        default:
+            return {-sc, -tc, -1.0f};
+    }
+}
+
+int _MGL CubemapFaceOf(const glm::vec3& direction, float& s, float& t) {
+    glm::vec3 a = glm::abs(direction);
+    int axis = a.x >= a.y && a.x >= a.z ? 0 : a.y >= a.z ? 1 : 2;
+    int face = 2 * axis + (direction[axis] < 0.0f ? 1 : 0);
+    float sc, tc;
+    project(face, direction / a[axis], sc, tc);
+    s = (sc + 1.0f) * 0.5f;
+    t = (tc + 1.0f) * 0.5f;
+    return face;
+}
+
+void _MGL FixCubemapSeams(MipLevel faces[6]) {
+    int size = faces[0].width;
+    auto texel = [&](int face, int x, int y) {
+        return &faces[face].pixels[(size_t(y) * size + x) * 4];
+    };
+    if (size == 1) {
+        // 1x1的层各方向都是同一个像素
+        for (int c = 0; c < 4; ++c) {
+            int sum = 0;
+            for (int f = 0; f < 6; ++f) sum += texel(f, 0, 0)[c];
+            for (int f = 0; f < 6; ++f) {
+                texel(f, 0, 0)[c] = static_cast<unsigned char>((sum + 3) / 6);
+            }
+        }
+        return;
+    }
+    for (int face = 0; face < 6; ++face) {
+        // 边上的像素与相邻面的对应像素取平均, 角另外处理;
+        // 边依次为s = 0, s = 1, t = 0, t = 1
+        for (int edge = 0; edge < 4; ++edge) {
+            for (int k = 1; k < size - 1; ++k) {
+                float along = (k + 0.5f) / size;
+                float s = edge == 0 ? 0.0f : edge == 1 ? 1.0f : along;
+                float t = edge < 2 ? along : edge == 2 ? 0.0f : 1.0f;
+                int x = edge < 2 ? (edge == 0 ? 0 : size - 1) : k;
+                int y = edge < 2 ? k : (edge == 2 ? 0 : size - 1);
+                glm::vec3 p = CubemapFacePoint(face, s, t);
+                // 边上的点在相邻面的轴上也是±1
+                int other = face;
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (axis != face / 2 && std::abs(p[axis]) == 1.0f) {
+                        other = axisFace(p, axis);
+                    }
+                }
+                int ox, oy;
+                faceTexel(other, p, size, ox, oy);
+                unsigned char* a = texel(face, x, y);
+                unsigned char* b = texel(other, ox, oy);
+                for (int c = 0; c < 4; ++c) {
+                    a[c] = b[c] = static_cast<unsigned char>(
+                        (a[c] + b[c] + 1) / 2);
+                }
+            }
+        }
+        // 角由三个面共享
+        for (int corner = 0; corner < 4; ++corner) {
+            glm::vec3 p = CubemapFacePoint(face, float(corner & 1),
+                                    float(corner >> 1));
+            unsigned char* px[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                int x, y;
+                faceTexel(axisFace(p, axis), p, size, x, y);
+                px[axis] = texel(axisFace(p, axis), x, y);
+            }
+            for (int c = 0; c < 4; ++c) {
+                int sum = px[0][c] + px[1][c] + px[2][c];
+                unsigned char value = static_cast<unsigned char>((sum + 1) / 3);
+                px[0][c] = px[1][c] = px[2][c] = value;
+            }
+        }
+    }
+}
+
+bool _MGL DecodeCubemapFaces(const std::vector<std::string>& paths,
+                             MipLevel levels[6]) {
+    if (paths.size() != 6) return false;
+    // 六个面一起读入, 再并行解码
+    ReadBatch batch(paths);
+    std::future<Image> decoded[6];
+    for (int f = 0; f < 6; ++f) {
+        std::string path = paths[f];
+        decoded[f] = texturePool().submit([path]() {
+            FileData file = ReadFile(path);
+            if (!file.isOpen()) return Image();
+            return DecodeImageFromMemory(file.data(), file.size());
+        });
+    }
+    bool ok = true;
+    for (int f = 0; f < 6; ++f) {
+        Image image = decoded[f].get();
+        if (!image.valid()) {
+            std::cout << "Cubemap texture failed to load at path: "
+                      << paths[f] << std::endl;
+            ok = false;
+            continue;
+        }
+        levels[f].width = image.width;
+        levels[f].height = image.height;
+        levels[f].pixels = ExpandRGBA(image);
+    }
+    if (!ok) return false;
+    for (int f = 0; f < 6; ++f) {
+        if (levels[f].width != levels[0].width ||
+            levels[f].height != levels[0].width) {
+            std::printf("CUBEMAP::SIZE_MISMATCH %s\n", paths[f].c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool _MGL BuildCubemap(const std::vector<std::string>& paths,
+                       Image faces[6]) {
+    MipLevel levels[6];
+    if (!DecodeCubemapFaces(paths, levels)) return false;
+    int size = levels[0].width;
+    bool opaque = true;
+    for (int f = 0; f < 6; ++f) {
+        const std::vector<unsigned char>& px = levels[f].pixels;
+        for (size_t i = 3; i < px.size() && opaque; i += 4) {
+            opaque = px[i] == 255;
+        }
+    }
+
+    const LoadConfig& config = loadConfig();
+    PixelFormat format;
+    if (opaque) {
+        format = config.compressTextures ? PixelFormat::BC1 : PixelFormat::RGB8;
+    } else {
+        format =
+            config.compressTextures ? PixelFormat::BC3 : PixelFormat::RGBA8;
+    }
+    MipFilter filter =
+        config.textureFilters[static_cast<int>(TextureRole::Color)];
+    std::vector<ImageLevel> chains[6];
+    for (int f = 0; f < 6; ++f) faces[f].reset();
+    while (true) {
+        // 每个面编码当前层并缩小得到下一层
+        ParallelFor(6, 1, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                size_t bytes = ImageLevelSize(format, size, size);
+                size_t offset = faces[f].pixels.size();
+                faces[f].pixels.resize(offset + bytes);
+                EncodeImageLevel(format, levels[f].pixels.data(), size, size,
+                                 faces[f].pixels.data() + offset);
+                chains[f].push_back({size, size, nullptr, bytes});
+                if (size > 1) {
+                    levels[f] = DownsampleHalf(levels[f].pixels.data(), size,
+                                               size, 4, filter, false);
+                }
+            }
+        });
+        if (size == 1) break;
+        size = levels[0].width;
+        // 各面独立缩小, 接缝两侧的像素需要重新对齐
+        FixCubemapSeams(levels);
+    }
+    for (int f = 0; f < 6; ++f) {
+        Image& face = faces[f];
+        size_t offset = 0;
+        for (auto& level : chains[f]) {
+            level.data = face.pixels.data() + offset;
+            offset += level.size;
+        }
+        face.levels = std::move(chains[f]);
+        face.width = face.height = face.levels[0].width;
+        face.channels = channelsOf(format);
+        face.format = format;
+        face.data = face.pixels.data();
+    }
+    return true;
+}
+
+bool _MGL CubemapSourceHash(const std::vector<std::string>& paths,
+                            uint64_t& hash) {
+    if (paths.size() != 6) return false;
+    hash = FNV_OFFSET_BASIS;
+    for (auto& path : paths) {
+        uint64_t face = 0;
+        if (!FileHash(path, face)) return false;
+        hash = HashCombine(hash, face);
+    }
+    return true;
+}
+
+std::string _MGL CubemapCachePath(const std::vector<std::string>& paths) {
+    return paths.empty() ? std::string() : paths[0] + ".mglcube";
+}
+
+unsigned int _MGL LoadCubemap(const std::vector<std::string>& paths) {
+    // 计算哈希与生成缓存共用同一次读取
+    ReadBatch batch(paths);
+    Image faces[6];
+    uint64_t sourceHash = 0;
+    bool hashed = CubemapSourceHash(paths, sourceHash);
+    uint64_t settings = cubemapSettings();
+    std::string cachePath = CubemapCachePath(paths);
+    if (!hashed || !readCache(cachePath, sourceHash, settings, faces)) {
+        if (hashed) std::printf("CUBEMAP::CACHE::MISS %s\n", cachePath.c_str());
+        if (BuildCubemap(paths, faces) && hashed &&
+            !writeCache(cachePath, sourceHash, settings, faces)) {
+            std::printf("WARNING::CUBEMAP::CACHE::WRITE_FAILED %s\n",
+                        cachePath.c_str());
+        }
+    }
+    for (auto& face : faces) LimitTextureSize(face, TextureRole::Color);
+    return UploadCubemap(faces);
+}
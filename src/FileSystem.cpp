@@ -0,0 +1,172 @@
+﻿#include "header/FileSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <vector>
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+#include <direct.h>
+#include <errno.h>
+#include <process.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define MGL_GETCWD _getcwd
+#define MGL_GETPID _getpid
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MGL_GETCWD getcwd
+#define MGL_GETPID getpid
+#endif
+
+namespace {
+// 把directory/relative下的文件追加到files, relative为空表示根目录
+void listInto(const std::string& directory, const std::string& relative,
+              std::vector<std::string>& files) {
+    std::string path =
+        relative.empty() ? directory : directory + '/' + relative;
+    std::string prefix = relative.empty() ? relative : relative + '/';
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    WIN32_FIND_DATAA found;
+    HANDLE handle = FindFirstFileA((path + "/*").c_str(), &found);
+    if (handle == INVALID_HANDLE_VALUE) return;
+    do {
+        std::string name = found.cFileName;
+        if (name == "." || name == "..") continue;
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            listInto(directory, prefix + name, files);
+        } else {
+            files.push_back(prefix + name);
+        }
+    } while (FindNextFileA(handle, &found));
+    FindClose(handle);
+#else
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        struct stat st;
+        if (stat((path + '/' + name).c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            listInto(directory, prefix + name, files);
+        } else if (S_ISREG(st.st_mode)) {
+            files.push_back(prefix + name);
+        }
+    }
+    closedir(dir);
+#endif
+}
+}  // namespace
+
+std::string _MGL CanonicalPath(const std::string& path) {
+    std::string p = path;
+    std::replace(p.begin(), p.end(), '\\', '/');
+    bool absolute = !p.empty() && p[0] == '/';
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    absolute = absolute || (p.size() > 1 && p[1] == ':');
+#endif
+    if (!absolute) {
+        char cwd[4096];
+        if (MGL_GETCWD(cwd, sizeof(cwd))) {
+            std::string base(cwd);
+            std::replace(base.begin(), base.end(), '\\', '/');
+            p = base + '/' + p;
+        }
+    }
+    // 逐段消去 . 与 ..
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= p.size()) {
+        size_t end = p.find('/', start);
+        if (end == std::string::npos) end = p.size();
+        std::string part = p.substr(start, end - start);
+        if (part == "..") {
+            if (!parts.empty() && !parts.back().empty()) parts.pop_back();
+        } else if (part != "." && !(part.empty() && !parts.empty())) {
+            parts.push_back(part);
+        }
+        start = end + 1;
+    }
+    std::string result;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        if (i) result += '/';
+        result += parts[i];
+    }
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    // Windows文件系统不区分大小写
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+#endif
+    return result;
+}
+
+std::vector<std::string> _MGL ListFiles(const std::string& directory) {
+    std::vector<std::string> files;
+    listInto(directory, std::string(), files);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+bool _MGL MakeDirectory(const std::string& directory) {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    int result = _mkdir(directory.c_str());
+#else
+    int result = mkdir(directory.c_str(), 0755);
+#endif
+    return result == 0 || errno == EEXIST;
+}
+
+bool _MGL StatFile(const std::string& path, FileStamp& stamp) {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data) ||
+        (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        return false;
+    }
+    stamp.size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    // 自1601年起的100纳秒数
+    stamp.mtime = int64_t((uint64_t(data.ftLastWriteTime.dwHighDateTime)
+                           << 32) |
+                          data.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    stamp.size = uint64_t(st.st_size);
+    // 纳秒
+#if defined(__APPLE__)
+    stamp.mtime = int64_t(st.st_mtimespec.tv_sec) * 1000000000 +
+                  st.st_mtimespec.tv_nsec;
+#else
+    stamp.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+#endif
+    return true;
+}
+
+std::string _MGL TempPath(const std::string& path) {
+    static std::atomic<unsigned long long> counter{0};
+    char suffix[64];
+    std::snprintf(suffix, sizeof(suffix), ".%d.%llu.tmp",
+                  static_cast<int>(MGL_GETPID()), counter++);
+    return path + suffix;
+}
+
+bool _MGL ReplaceFileAtomic(const std::string& from, const std::string& to) {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    // rename在Windows上不能覆盖已存在的文件
+    if (MoveFileExA(from.c_str(), to.c_str(),
+                    MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        return true;
+    }
+#else
+    if (std::rename(from.c_str(), to.c_str()) == 0) return true;
+#endif
+    std::remove(from.c_str());
+    return false;
+}
@@ -0,0 +1,598 @@
+﻿#include "header/GltfLoader.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "header/Json.h"
+#include "header/Memory.h"
+#include "header/MeshProcess.h"
+#include "header/ThreadPool.h"
+#include "header/VirtualFileSystem.h"
+
+namespace {
+const uint32_t GLB_MAGIC = 0x46546C67;       // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;  // "JSON"
+const uint32_t GLB_CHUNK_BIN = 0x004E4942;   // "BIN\0"
+
+// 访问器分量类型
+enum ComponentType {
+    BYTE = 5120,
+    UNSIGNED_BYTE = 5121,
+    SHORT = 5122,
+    UNSIGNED_SHORT = 5123,
+    UNSIGNED_INT = 5125,
+    FLOAT = 5126,
+};
+
+// 图元拓扑
+enum PrimitiveMode { TRIANGLES = 4, TRIANGLE_STRIP = 5, TRIANGLE_FAN = 6 };
+
+// 一段只读的缓冲区内存
+struct GltfBuffer {
+    const unsigned char* data;
+    size_t size;
+};
+
+// 已解析并校验过边界的访问器
+struct GltfAccessor {
+    // 首个元素地址, 没有bufferView时为空(全部为零)
+    const unsigned char* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    int componentType = 0;
+    int components = 0;
+    bool normalized = false;
+    bool valid = false;
+};
+
+// 打开的glTF文档及其缓冲区
+struct GltfDocument {
+    mgl::JsonValue json;
+    // .gltf或.glb文件
+    mgl::FileData file;
+    // 外部.bin文件
+    std::vector<mgl::FileData> files;
+    // data: URI解码出的缓冲区
+    std::vector<std::vector<unsigned char>> embedded;
+    std::vector<GltfBuffer> buffers;
+    std::string directory;
+};
+
+size_t componentSize(int type) {
+    switch (type) {
+        case BYTE:
+        case UNSIGNED_BYTE: return 1;
+        case SHORT:
+        case UNSIGNED_SHORT: return 2;
+        case UNSIGNED_INT:
+        case FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+int componentCount(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4" || type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    return 0;
+}
+
+inline uint32_t readU32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 解码URI中的 %xx
+std::string decodeUri(const std::string& uri) {
+    std::string out;
+    out.reserve(uri.size());
+    for (size_t i = 0; i < uri.size(); ++i) {
+        if (uri[i] == '%' && i + 2 < uri.size()) {
+            char hex[3] = {uri[i + 1], uri[i + 2], '\0'};
+            char* stop = nullptr;
+            long c = std::strtol(hex, &stop, 16);
+            if (stop == hex + 2) {
+                out += static_cast<char>(c);
+                i += 2;
+                continue;
+            }
+        }
+        out += uri[i];
+    }
+    return out;
+}
+
+// base64字符 -> 6位值, 非法字符为-1
+struct Base64Table {
+    signed char values[256];
+    Base64Table() {
+        const char* alphabet =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::memset(values, -1, sizeof(values));
+        for (int i = 0; i < 64; ++i) {
+            values[static_cast<unsigned char>(alphabet[i])] =
+                static_cast<signed char>(i);
+        }
+    }
+};
+
+bool decodeBase64(const char* p, const char* end,
+                  std::vector<unsigned char>& out) {
+    static const Base64Table table;
+    out.reserve(size_t(end - p) / 4 * 3);
+    uint32_t bits = 0;
+    int count = 0;
+    for (; p < end && *p != '='; ++p) {
+        signed char v = table.values[static_cast<unsigned char>(*p)];
+        if (v < 0) return false;
+        bits = (bits << 6) | uint32_t(v);
+        if (++count == 4) {
+            out.push_back(static_cast<unsigned char>(bits >> 16));
+            out.push_back(static_cast<unsigned char>(bits >> 8));
+            out.push_back(static_cast<unsigned char>(bits));
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 2) {
+        out.push_back(static_cast<unsigned char>(bits >> 4));
+    } else if (count == 3) {
+        out.push_back(static_cast<unsigned char>(bits >> 10));
+        out.push_back(static_cast<unsigned char>(bits >> 2));
+    }
+    return count != 1;
+}
+
+bool openDocument(const std::string& path, GltfDocument& doc,
+                  std::vector<std::string>* dependencies) {
+    doc.file = mgl::ReadFile(path);
+    if (!doc.file.isOpen()) {
+        std::printf("ERROR::GLTF::FILE_NOT_SUCCESFULLY_READ %s\n",
+                    path.c_str());
+        return false;
+    }
+    doc.directory = path.substr(0, path.find_last_of('/') + 1);
+    const unsigned char* base = doc.file.data();
+    size_t size = doc.file.size();
+
+    const char* jsonText = reinterpret_cast<const char*>(base);
+    size_t jsonSize = size;
+    GltfBuffer bin = {nullptr, 0};
+    if (size >= 12 && readU32(base) == GLB_MAGIC) {
+        // GLB: 文件头 | JSON块 | 可选的BIN块
+        size_t length = std::min<size_t>(readU32(base + 8), size);
+        jsonText = nullptr;
+        for (size_t offset = 12; offset + 8 <= length;) {
+            uint32_t chunkLength = readU32(base + offset);
+            uint32_t chunkType = readU32(base + offset + 4);
+            offset += 8;
+            if (chunkLength > length - offset) break;
+            if (chunkType == GLB_CHUNK_JSON && !jsonText) {
+                jsonText = reinterpret_cast<const char*>(base + offset);
+                jsonSize = chunkLength;
+            } else if (chunkType == GLB_CHUNK_BIN && !bin.data) {
+                bin.data = base + offset;
+                bin.size = chunkLength;
+            }
+            offset += (chunkLength + 3) & ~size_t(3);
+        }
+        if (!jsonText) {
+            std::printf("ERROR::GLTF::MISSING_JSON_CHUNK %s\n", path.c_str());
+            return false;
+        }
+    }
+    std::string error;
+    if (!mgl::ParseJson(jsonText, jsonSize, doc.json, &error)) {
+        std::printf("ERROR::GLTF::JSON %s: %s\n", path.c_str(),
+                    error.c_str());
+        return false;
+    }
+    if (doc.json["asset"]["version"].asString().compare(0, 1, "2") != 0) {
+        std::printf("ERROR::GLTF::UNSUPPORTED_VERSION %s\n", path.c_str());
+        return false;
+    }
+
+    const mgl::JsonValue& buffers = doc.json["buffers"];
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        const mgl::JsonValue& buffer = buffers[i];
+        size_t byteLength = size_t(buffer["byteLength"].asNumber());
+        GltfBuffer view = {nullptr, 0};
+        if (!buffer.has("uri")) {
+            view = bin;
+        } else {
+            const std::string& uri = buffer["uri"].asString();
+            if (uri.compare(0, 5, "data:") == 0) {
+                size_t comma = uri.find(',');
+                doc.embedded.emplace_back();
+                if (comma == std::string::npos ||
+                    uri.find(";base64") > comma ||
+                    !decodeBase64(uri.data() + comma + 1,
+                                  uri.data() + uri.size(),
+                                  doc.embedded.back())) {
+                    std::printf("ERROR::GLTF::INVALID_DATA_URI %s\n",
+                                path.c_str());
+                    return false;
+                }
+                view.data = doc.embedded.back().data();
+                view.size = doc.embedded.back().size();
+            } else {
+                std::string filename = doc.directory + decodeUri(uri);
+                if (dependencies) dependencies->push_back(filename);
+                doc.files.push_back(mgl::ReadFile(filename));
+                if (!doc.files.back().isOpen()) {
+                    std::printf("ERROR::GLTF::BUFFER_NOT_FOUND %s\n",
+                                filename.c_str());
+                    return false;
+                }
+                view.data = doc.files.back().data();
+                view.size = doc.files.back().size();
+            }
+        }
+        if (view.size < byteLength) {
+            std::printf("ERROR::GLTF::BUFFER_TOO_SHORT %s\n", path.c_str());
+            return false;
+        }
+        doc.buffers.push_back(view);
+    }
+    return true;
+}
+
+// 解析访问器并校验其范围落在缓冲区内
+GltfAccessor getAccessor(const GltfDocument& doc, int index) {
+    GltfAccessor result;
+    const mgl::JsonValue& accessor = doc.json["accessors"][size_t(index)];
+    if (index < 0 || !accessor.isObject()) return result;
+    result.count = size_t(accessor["count"].asNumber());
+    result.componentType = accessor["componentType"].asInt();
+    result.components = componentCount(accessor["type"].asString());
+    result.normalized = accessor["normalized"].asBool();
+    size_t elementSize =
+        componentSize(result.componentType) * size_t(result.components);
+    if (elementSize == 0) return result;
+    if (accessor.has("sparse")) {
+        std::printf("WARNING::GLTF::SPARSE_ACCESSOR_IGNORED %d\n", index);
+    }
+    result.stride = elementSize;
+    if (!accessor.has("bufferView")) {
+        result.valid = true;
+        return result;
+    }
+    const mgl::JsonValue& view =
+        doc.json["bufferViews"][size_t(accessor["bufferView"].asInt(-1))];
+    size_t buffer = size_t(view["buffer"].asInt(-1));
+    if (!view.isObject() || buffer >= doc.buffers.size()) return result;
+    if (view.has("byteStride")) {
+        result.stride = size_t(view["byteStride"].asInt());
+    }
+    size_t offset = size_t(view["byteOffset"].asNumber()) +
+                    size_t(accessor["byteOffset"].asNumber());
+    size_t viewEnd = size_t(view["byteOffset"].asNumber()) +
+                     size_t(view["byteLength"].asNumber());
+    size_t last = result.count == 0
+                      ? offset
+                      : offset + result.stride * (result.count - 1) +
+                            elementSize;
+    if (result.stride < elementSize || last > viewEnd ||
+        viewEnd > doc.buffers[buffer].size) {
+        return result;
+    }
+    result.data = doc.buffers[buffer].data + offset;
+    result.valid = true;
+    return result;
+}
+
+// 读取一个分量并按需归一化为浮点
+inline float readComponent(const unsigned char* p, int type, bool normalized) {
+    switch (type) {
+        case FLOAT: {
+            float v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+        case UNSIGNED_BYTE:
+            return normalized ? *p / 255.0f : float(*p);
+        case BYTE: {
+            float v = float(static_cast<signed char>(*p));
+            return normalized ? std::max(v / 127.0f, -1.0f) : v;
+        }
+        case UNSIGNED_SHORT: {
+            uint16_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return normalized ? v / 65535.0f : float(v);
+        }
+        case SHORT: {
+            int16_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return normalized ? std::max(v / 32767.0f, -1.0f) : float(v);
+        }
+        case UNSIGNED_INT: {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return float(v);
+        }
+        default: return 0.0f;
+    }
+}
+
+/**
+ * 将访问器的元素逐个写入交错的顶点数组中的某个字段.
+ * 浮点数据直接整块复制每个元素, 其他类型逐分量转换
+ */
+void readInto(const GltfAccessor& accessor, int components, void* first,
+              size_t outStride, size_t count) {
+    if (!accessor.data) return;
+    unsigned char* out = static_cast<unsigned char*>(first);
+    int n = std::min(components, accessor.components);
+    size_t size = componentSize(accessor.componentType);
+    if (accessor.componentType == FLOAT) {
+        for (size_t i = 0; i < count; ++i) {
+            std::memcpy(out + i * outStride,
+                        accessor.data + i * accessor.stride,
+                        n * sizeof(float));
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* src = accessor.data + i * accessor.stride;
+        float* dst = reinterpret_cast<float*>(out + i * outStride);
+        for (int c = 0; c < n; ++c) {
+            dst[c] = readComponent(src + c * size, accessor.componentType,
+                                   accessor.normalized);
+        }
+    }
+}
+
+bool readIndices(const GltfAccessor& accessor,
+                 std::vector<unsigned int>& indices) {
+    if (accessor.components != 1 || !accessor.data) return false;
+    indices.resize(accessor.count);
+    switch (accessor.componentType) {
+        case UNSIGNED_INT:
+            if (accessor.stride == sizeof(uint32_t)) {
+                // 紧密排列的32位索引与引擎格式一致, 整块复制
+                std::memcpy(indices.data(), accessor.data,
+                            accessor.count * sizeof(uint32_t));
+                return true;
+            }
+            for (size_t i = 0; i < accessor.count; ++i) {
+                indices[i] = readU32(accessor.data + i * accessor.stride);
+            }
+            return true;
+        case UNSIGNED_SHORT:
+            for (size_t i = 0; i < accessor.count; ++i) {
+                uint16_t v;
+                std::memcpy(&v, accessor.data + i * accessor.stride, 2);
+                indices[i] = v;
+            }
+            return true;
+        case UNSIGNED_BYTE:
+            for (size_t i = 0; i < accessor.count; ++i) {
+                indices[i] = accessor.data[i * accessor.stride];
+            }
+            return true;
+        default: return false;
+    }
+}
+
+// 将条带与扇形展开为三角形列表
+void toTriangleList(int mode, std::vector<unsigned int>& indices) {
+    if (mode == TRIANGLES || indices.size() < 3) return;
+    std::vector<unsigned int> list;
+    list.reserve((indices.size() - 2) * 3);
+    for (size_t i = 2; i < indices.size(); ++i) {
+        if (mode == TRIANGLE_FAN) {
+            list.push_back(indices[0]);
+            list.push_back(indices[i - 1]);
+            list.push_back(indices[i]);
+        } else if (i % 2 == 0) {
+            list.push_back(indices[i - 2]);
+            list.push_back(indices[i - 1]);
+            list.push_back(indices[i]);
+        } else {
+            list.push_back(indices[i - 1]);
+            list.push_back(indices[i - 2]);
+            list.push_back(indices[i]);
+        }
+    }
+    indices.swap(list);
+}
+
+// 获取纹理引用的图像路径, 内嵌图像返回空
+std::string texturePath(const GltfDocument& doc,
+                        const mgl::JsonValue& textureInfo) {
+    if (!textureInfo.isObject()) return std::string();
+    const mgl::JsonValue& texture =
+        doc.json["textures"][size_t(textureInfo["index"].asInt(-1))];
+    const mgl::JsonValue& image =
+        doc.json["images"][size_t(texture["source"].asInt(-1))];
+    const std::string& uri = image["uri"].asString();
+    if (uri.empty() || uri.compare(0, 5, "data:") == 0) {
+        std::printf("WARNING::GLTF::EMBEDDED_IMAGE_UNSUPPORTED %d\n",
+                    texture["source"].asInt(-1));
+        return std::string();
+    }
+    return decodeUri(uri);
+}
+
+void materialTextures(const GltfDocument& doc, int index,
+                      std::vector<mgl::Texture>& textures) {
+    const mgl::JsonValue& material = doc.json["materials"][size_t(index)];
+    if (index < 0 || !material.isObject()) return;
+    const mgl::JsonValue& specGloss =
+        material["extensions"]["KHR_materials_pbrSpecularGlossiness"];
+    // 与着色器中的纹理名称对应, 金属度/粗糙度贴图暂不使用
+    const struct {
+        const mgl::JsonValue& info;
+        const char* name;
+    } slots[] = {
+        {material["pbrMetallicRoughness"]["baseColorTexture"],
+         "texture_diffuse"},
+        {specGloss["diffuseTexture"], "texture_diffuse"},
+        {specGloss["specularGlossinessTexture"], "texture_specular"},
+        {material["normalTexture"], "texture_normal"},
+    };
+    for (auto& slot : slots) {
+        std::string path = texturePath(doc, slot.info);
+        if (path.empty()) continue;
+        mgl::Texture texture;
+        texture.id = 0;
+        texture.type = slot.name;
+        texture.path = path;
+        textures.push_back(texture);
+    }
+}
+
+bool buildPrimitive(const GltfDocument& doc,
+                    const mgl::JsonValue& primitive, mgl::MeshData& mesh) {
+    int mode = primitive["mode"].asInt(TRIANGLES);
+    if (mode != TRIANGLES && mode != TRIANGLE_STRIP && mode != TRIANGLE_FAN) {
+        std::printf("WARNING::GLTF::PRIMITIVE_MODE_UNSUPPORTED %d\n", mode);
+        return false;
+    }
+    const mgl::JsonValue& attributes = primitive["attributes"];
+    GltfAccessor position =
+        getAccessor(doc, attributes["POSITION"].asInt(-1));
+    if (!position.valid || position.components != 3) {
+        std::printf("WARNING::GLTF::PRIMITIVE_WITHOUT_POSITION\n");
+        return false;
+    }
+    size_t count = position.count;
+    auto optional = [&](const char* name, int components) {
+        GltfAccessor accessor = getAccessor(doc, attributes[name].asInt(-1));
+        if (accessor.valid && (accessor.count < count ||
+                               accessor.components < components)) {
+            std::printf("WARNING::GLTF::INVALID_ATTRIBUTE %s\n", name);
+            accessor.valid = false;
+        }
+        return accessor;
+    };
+    GltfAccessor normal = optional("NORMAL", 3);
+    GltfAccessor uv = optional("TEXCOORD_0", 2);
+    GltfAccessor tangent = optional("TANGENT", 4);
+    GltfAccessor joints = optional("JOINTS_0", 4);
+    GltfAccessor weights = optional("WEIGHTS_0", 4);
+
+    // 引擎使用单个交错顶点缓冲, 各属性由映射内存直接写入最终位置
+    mesh.vertices.assign(count, mgl::Vertex());
+    mgl::CountAllocation(count * sizeof(mgl::Vertex));
+    mgl::CountCopy(count * sizeof(mgl::Vertex));
+    mgl::Vertex* v = mesh.vertices.data();
+    const size_t stride = sizeof(mgl::Vertex);
+    readInto(position, 3, &v->Position, stride, count);
+    if (normal.valid) readInto(normal, 3, &v->Normal, stride, count);
+    if (uv.valid) readInto(uv, 2, &v->TexCoords, stride, count);
+    if (weights.valid) readInto(weights, 4, v->m_Weights, stride, count);
+    if (joints.valid && joints.data) {
+        size_t size = componentSize(joints.componentType);
+        for (size_t i = 0; i < count; ++i) {
+            const unsigned char* src = joints.data + i * joints.stride;
+            for (int c = 0; c < 4; ++c) {
+                v[i].m_BoneIDs[c] = static_cast<int>(readComponent(
+                    src + c * size, joints.componentType, false));
+            }
+        }
+    }
+
+    const mgl::JsonValue& indices = primitive["indices"];
+    if (indices.isNull()) {
+        mesh.indices.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            mesh.indices[i] = static_cast<unsigned int>(i);
+        }
+    } else if (!readIndices(getAccessor(doc, indices.asInt(-1)),
+                            mesh.indices)) {
+        std::printf("WARNING::GLTF::INVALID_INDICES\n");
+        return false;
+    }
+    for (auto index : mesh.indices) {
+        if (index >= count) {
+            std::printf("WARNING::GLTF::INDEX_OUT_OF_RANGE\n");
+            return false;
+        }
+    }
+    mgl::CountAllocation(mesh.indices.size() * sizeof(unsigned int));
+    mgl::CountCopy(mesh.indices.size() * sizeof(unsigned int));
+    toTriangleList(mode, mesh.indices);
+    mesh.indices.resize(mesh.indices.size() / 3 * 3);
+
+    bool normalsGenerated = !normal.valid || !mgl::HasValidNormals(mesh);
+    if (normalsGenerated) mgl::GenerateSmoothNormals(mesh);
+    bool tangentsRead = false;
+    if (tangent.valid && !normalsGenerated) {
+        mgl::ArenaScope scope(mgl::threadArena());
+        mgl::ArenaVector<glm::vec4> t(
+            count, glm::vec4(0.0f),
+            mgl::ArenaAllocator<glm::vec4>(mgl::threadArena()));
+        readInto(tangent, 4, t.data(), sizeof(glm::vec4), count);
+        for (size_t i = 0; i < count; ++i) {
+            v[i].Tangent = glm::vec3(t[i]);
+            // w为副切线方向
+            v[i].Bitangent = glm::cross(v[i].Normal, v[i].Tangent) * t[i].w;
+        }
+        tangentsRead = mgl::HasValidTangents(mesh);
+    }
+    if (!tangentsRead && uv.valid) mgl::GenerateTangents(mesh);
+    materialTextures(doc, primitive["material"].asInt(-1), mesh.textures);
+    return true;
+}
+
+// 按深度优先顺序收集节点引用的网格
+void collectNode(const GltfDocument& doc, int index, int depth,
+                 std::vector<int>& meshes) {
+    const mgl::JsonValue& node = doc.json["nodes"][size_t(index)];
+    // 合法的节点树深度有限, 防止循环引用
+    if (index < 0 || !node.isObject() || depth > 256) return;
+    if (node.has("mesh")) meshes.push_back(node["mesh"].asInt(-1));
+    const mgl::JsonValue& children = node["children"];
+    for (size_t i = 0; i < children.size(); ++i) {
+        collectNode(doc, children[i].asInt(-1), depth + 1, meshes);
+    }
+}
+}  // namespace
+
+bool _MGL LoadGltf(const std::string& path, std::vector<MeshData>& meshes,
+                   std::vector<std::string>* dependencies) {
+    GltfDocument doc;
+    if (!openDocument(path, doc, dependencies)) return false;
+
+    std::vector<int> meshIndices;
+    const JsonValue& scenes = doc.json["scenes"];
+    if (scenes.size() > 0) {
+        const JsonValue& scene = scenes[size_t(doc.json["scene"].asInt(0))];
+        const JsonValue& roots = scene["nodes"];
+        for (size_t i = 0; i < roots.size(); ++i) {
+            collectNode(doc, roots[i].asInt(-1), 0, meshIndices);
+        }
+    } else {
+        // 没有场景时输出全部网格
+        for (size_t i = 0; i < doc.json["meshes"].size(); ++i) {
+            meshIndices.push_back(static_cast<int>(i));
+        }
+    }
+
+    std::vector<const JsonValue*> primitives;
+    for (int index : meshIndices) {
+        const JsonValue& list =
+            doc.json["meshes"][size_t(index)]["primitives"];
+        for (size_t i = 0; i < list.size(); ++i) {
+            primitives.push_back(&list[i]);
+        }
+    }
+
+    std::vector<MeshData> built(primitives.size());
+    std::vector<char> ok(primitives.size(), 0);
+    ParallelFor(primitives.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            ok[i] = buildPrimitive(doc, *primitives[i], built[i]);
+        }
+    });
+    meshes.reserve(meshes.size() + built.size());
+    for (size_t i = 0; i < built.size(); ++i) {
+        if (ok[i]) meshes.push_back(std::move(built[i]));
+    }
+    return true;
+}
@@ -0,0 +1,581 @@
+﻿#include "header/Ibl.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include "header/AsyncFile.h"
+#include "header/Config.h"
+#include "header/FileSystem.h"
+#include "header/Cubemap.h"
+#include "header/Hash.h"
+#include "header/ThreadPool.h"
+#include "header/VirtualFileSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MGL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+const char IBL_MAGIC[4] = {'M', 'G', 'L', 'E'};
+// 缓存格式版本, 修改布局或计算方式时递增
+const uint32_t IBL_VERSION = 2;
+// BRDF查找表的边长与每个像素的采样数
+const int LUT_SIZE = 128;
+const unsigned int LUT_SAMPLES = 512;
+// 球谐只保留低频, 辐照度在不超过这个边长的层上积分
+const int SH_SOURCE_SIZE = 64;
+// 预过滤镜面反射的最小边长, 更小的层粗糙度已接近1
+const int MIN_SPECULAR_SIZE = 8;
+const float PI_F = 3.14159265358979f;
+
+// 缓存文件头, 之后是球谐系数, BRDF查找表, 以及按面依次存放的
+// 镜面反射各层, 各部分的大小都由文件头决定
+struct EnvironmentHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t settings;
+    uint32_t size;
+    uint32_t levels;
+    uint32_t lutSize;
+    uint32_t reserved;
+};
+
+// 四个float的颜色(RGB与权重), 累加使用SIMD
+#ifdef MGL_SSE2
+typedef __m128 Color4;
+inline Color4 zero4() { return _mm_setzero_ps(); }
+inline Color4 load4(const float* p) { return _mm_loadu_ps(p); }
+inline void store4(float* p, Color4 c) { _mm_storeu_ps(p, c); }
+inline Color4 madd4(Color4 acc, Color4 c, float w) {
+    return _mm_add_ps(acc, _mm_mul_ps(c, _mm_set1_ps(w)));
+}
+#else
+struct Color4 {
+    float v[4];
+};
+inline Color4 zero4() { return {{0.0f, 0.0f, 0.0f, 0.0f}}; }
+inline Color4 load4(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store4(float* p, Color4 c) { std::memcpy(p, c.v, sizeof(c.v)); }
+inline Color4 madd4(Color4 acc, Color4 c, float w) {
+    for (int i = 0; i < 4; ++i) acc.v[i] += c.v[i] * w;
+    return acc;
+}
+#endif
+
+// 立方体贴图一层的浮点像素, 六个面依次存放, 每像素RGBA
+struct CubeLevel {
+    int size = 0;
+    std::vector<float> texels;
+
+    inline const float* texel(int face, int x, int y) const {
+        return &texels[((size_t(face) * size + y) * size + x) * 4];
+    }
+    inline float* texel(int face, int x, int y) {
+        return &texels[((size_t(face) * size + y) * size + x) * 4];
+    }
+};
+
+// sRGB编码的8位值到线性值的查找表
+struct SrgbTable {
+    float linear[256];
+
+    SrgbTable() {
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            linear[i] = c <= 0.04045f
+                            ? c / 12.92f
+                            : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+    }
+};
+
+// 线性值编码为sRGB的8位值
+inline unsigned char linearToSrgb(float c) {
+    c = std::min(1.0f, std::max(0.0f, c));
+    float s = c <= 0.0031308f ? c * 12.92f
+                              : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    return static_cast<unsigned char>(s * 255.0f + 0.5f);
+}
+
+// 由RGBA8的六个面生成线性浮点的mip链, 每层为上一层2x2的平均.
+// 颜色按sRGB解码, 透明度本身是线性的
+std::vector<CubeLevel> buildSource(const mgl::MipLevel faces[6]) {
+    static const SrgbTable srgb;
+    std::vector<CubeLevel> chain(1);
+    CubeLevel& base = chain[0];
+    base.size = faces[0].width;
+    base.texels.resize(size_t(base.size) * base.size * 6 * 4);
+    for (int f = 0; f < 6; ++f) {
+        const std::vector<unsigned char>& px = faces[f].pixels;
+        float* out = base.texel(f, 0, 0);
+        for (size_t i = 0; i < px.size(); i += 4) {
+            out[i] = srgb.linear[px[i]];
+            out[i + 1] = srgb.linear[px[i + 1]];
+            out[i + 2] = srgb.linear[px[i + 2]];
+            out[i + 3] = px[i + 3] / 255.0f;
+        }
+    }
+    while (chain.back().size > 1) {
+        CubeLevel next;
+        next.size = chain.back().size / 2;
+        next.texels.resize(size_t(next.size) * next.size * 6 * 4);
+        const CubeLevel& prev = chain.back();
+        mgl::ParallelFor(6 * size_t(next.size), 16, [&](size_t b, size_t e) {
+            for (size_t row = b; row < e; ++row) {
+                int f = int(row / next.size), y = int(row % next.size);
+                for (int x = 0; x < next.size; ++x) {
+                    Color4 sum = zero4();
+                    sum = madd4(sum, load4(prev.texel(f, 2 * x, 2 * y)), 0.25f);
+                    sum = madd4(sum, load4(prev.texel(f, 2 * x + 1, 2 * y)),
+                                0.25f);
+                    sum = madd4(sum, load4(prev.texel(f, 2 * x, 2 * y + 1)),
+                                0.25f);
+                    sum = madd4(sum,
+                                load4(prev.texel(f, 2 * x + 1, 2 * y + 1)),
+                                0.25f);
+                    store4(next.texel(f, x, y), sum);
+                }
+            }
+        });
+        chain.push_back(std::move(next));
+    }
+    return chain;
+}
+
+// 面内双线性采样, 超出面的部分取边缘
+Color4 bilinear(const CubeLevel& level, int face, float s, float t) {
+    int size = level.size;
+    float x = s * size - 0.5f, y = t * size - 0.5f;
+    int x0 = int(std::floor(x)), y0 = int(std::floor(y));
+    float fx = x - x0, fy = y - y0;
+    int x1 = std::min(size - 1, x0 + 1), y1 = std::min(size - 1, y0 + 1);
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    Color4 c = zero4();
+    c = madd4(c, load4(level.texel(face, x0, y0)), (1 - fx) * (1 - fy));
+    c = madd4(c, load4(level.texel(face, x1, y0)), fx * (1 - fy));
+    c = madd4(c, load4(level.texel(face, x0, y1)), (1 - fx) * fy);
+    return madd4(c, load4(level.texel(face, x1, y1)), fx * fy);
+}
+
+// 沿方向在给定层级三线性采样
+Color4 sampleCube(const std::vector<CubeLevel>& chain,
+                  const glm::vec3& direction, float lod) {
+    float s, t;
+    int face = mgl::CubemapFaceOf(direction, s, t);
+    lod = std::min(std::max(lod, 0.0f), float(chain.size() - 1));
+    size_t l0 = size_t(lod);
+    float f = lod - float(l0);
+    Color4 a = bilinear(chain[l0], face, s, t);
+    if (f == 0.0f || l0 + 1 >= chain.size()) return a;
+    Color4 b = bilinear(chain[l0 + 1], face, s, t);
+    return madd4(madd4(zero4(), a, 1.0f - f), b, f);
+}
+
+// 面上像素中心的单位方向
+inline glm::vec3 texelDirection(int face, int x, int y, int size) {
+    return glm::normalize(mgl::CubemapFacePoint(face, (x + 0.5f) / size,
+                                                (y + 0.5f) / size));
+}
+
+// Hammersley低差异序列
+glm::vec2 hammersley(unsigned int i, unsigned int count) {
+    unsigned int bits = i;
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return {float(i) / float(count), float(bits) * 2.3283064365386963e-10f};
+}
+
+// 按GGX分布重要性采样的半程向量, 切线空间中法线为+z
+glm::vec3 sampleGgx(const glm::vec2& xi, float roughness) {
+    float a = roughness * roughness;
+    float phi = 2.0f * PI_F * xi.x;
+    float cosTheta =
+        std::sqrt((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+    float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+    return {std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta};
+}
+
+// GGX法线分布函数
+float distributionGgx(float NdotH, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float d = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+    return a2 / (PI_F * d * d);
+}
+
+// 切线空间中的一个预过滤采样
+struct SpecularSample {
+    glm::vec3 direction;
+    float weight;
+    float lod;
+};
+
+// 一层预过滤的采样方向. 假设视线与法线重合, 采样只取决于粗糙度,
+// 按采样的概率密度选择源层级以避免欠采样的噪点
+std::vector<SpecularSample> specularSamples(float roughness,
+                                            unsigned int count,
+                                            int sourceSize, int levelSize) {
+    float minLod = std::log2(float(sourceSize) / float(levelSize));
+    if (roughness == 0.0f || count == 0) {
+        return {{glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, minLod}};
+    }
+    float texelAngle = 4.0f * PI_F / (6.0f * sourceSize * sourceSize);
+    std::vector<SpecularSample> samples;
+    for (unsigned int i = 0; i < count; ++i) {
+        glm::vec3 h = sampleGgx(hammersley(i, count), roughness);
+        glm::vec3 l = 2.0f * h.z * h - glm::vec3(0.0f, 0.0f, 1.0f);
+        if (l.z <= 0.0f) continue;
+        // 视线与法线重合时VdotH = NdotH, 概率密度为D / 4
+        float pdf = distributionGgx(h.z, roughness) / 4.0f;
+        float sampleAngle = 1.0f / (count * pdf + 1e-4f);
+        float lod =
+            std::max(minLod, 0.5f * std::log2(sampleAngle / texelAngle));
+        samples.push_back({glm::normalize(l), l.z, lod});
+    }
+    return samples;
+}
+
+// 把辐照度投影到L2球谐, 已与余弦核卷积并除以π
+void projectIrradiance(const CubeLevel& level,
+                       glm::vec3 irradiance[mgl::SH_COEFFICIENTS]) {
+    int n = level.size;
+    float totals[mgl::SH_COEFFICIENTS][4] = {};
+    std::mutex mutex;
+    mgl::ParallelFor(6 * size_t(n), 8, [&](size_t b, size_t e) {
+        Color4 acc[mgl::SH_COEFFICIENTS];
+        for (auto& a : acc) a = zero4();
+        for (size_t row = b; row < e; ++row) {
+            int f = int(row / n), y = int(row % n);
+            for (int x = 0; x < n; ++x) {
+                // 像素在单位球上所张的立体角
+                float u = 2.0f * (x + 0.5f) / n - 1.0f;
+                float v = 2.0f * (y + 0.5f) / n - 1.0f;
+                float r2 = 1.0f + u * u + v * v;
+                float solidAngle = 4.0f / (n * n * r2 * std::sqrt(r2));
+                glm::vec3 d = texelDirection(f, x, y, n);
+                float basis[mgl::SH_COEFFICIENTS] = {
+                    0.282095f,
+                    0.488603f * d.y,
+                    0.488603f * d.z,
+                    0.488603f * d.x,
+                    1.092548f * d.x * d.y,
+                    1.092548f * d.y * d.z,
+                    0.315392f * (3.0f * d.z * d.z - 1.0f),
+                    1.092548f * d.x * d.z,
+                    0.546274f * (d.x * d.x - d.y * d.y)};
+                Color4 c = load4(level.texel(f, x, y));
+                for (int i = 0; i < mgl::SH_COEFFICIENTS; ++i) {
+                    acc[i] = madd4(acc[i], c, basis[i] * solidAngle);
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < mgl::SH_COEFFICIENTS; ++i) {
+            float partial[4];
+            store4(partial, acc[i]);
+            for (int c = 0; c < 4; ++c) totals[i][c] += partial[c];
+        }
+    });
+    // 余弦核在各阶的系数π, 2π/3, π/4, 再除以π
+    const float band[3] = {1.0f, 2.0f / 3.0f, 0.25f};
+    for (int i = 0; i < mgl::SH_COEFFICIENTS; ++i) {
+        float scale = band[i == 0 ? 0 : i < 4 ? 1 : 2];
+        irradiance[i] = glm::vec3(totals[i][0], totals[i][1], totals[i][2]) *
+                        scale;
+    }
+}
+
+// 按各层的粗糙度预过滤镜面反射, 结果为sRGB编码的RGB8
+void prefilterSpecular(const std::vector<CubeLevel>& chain, int levels,
+                       unsigned int sampleCount, mgl::Image faces[6]) {
+    int base = chain[0].size;
+    std::vector<mgl::ImageLevel> layout[6];
+    size_t total = 0;
+    for (int l = 0; l < levels; ++l) {
+        int size = std::max(1, base >> l);
+        total += size_t(size) * size * 3;
+    }
+    for (int f = 0; f < 6; ++f) {
+        faces[f].reset();
+        faces[f].pixels.resize(total);
+    }
+    size_t offset = 0;
+    for (int l = 0; l < levels; ++l) {
+        int size = std::max(1, base >> l);
+        float roughness = levels > 1 ? float(l) / float(levels - 1) : 0.0f;
+        std::vector<SpecularSample> samples =
+            specularSamples(roughness, sampleCount, base, size);
+        mgl::ParallelFor(6 * size_t(size), 4, [&](size_t b, size_t e) {
+            for (size_t row = b; row < e; ++row) {
+                int f = int(row / size), y = int(row % size);
+                unsigned char* out = faces[f].pixels.data() + offset +
+                                     size_t(y) * size * 3;
+                for (int x = 0; x < size; ++x, out += 3) {
+                    glm::vec3 n = texelDirection(f, x, y, size);
+                    glm::vec3 up = std::abs(n.z) < 0.999f
+                                       ? glm::vec3(0.0f, 0.0f, 1.0f)
+                                       : glm::vec3(1.0f, 0.0f, 0.0f);
+                    glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+                    glm::vec3 bitangent = glm::cross(n, tangent);
+                    Color4 acc = zero4();
+                    float weight = 0.0f;
+                    for (auto& s : samples) {
+                        glm::vec3 l = tangent * s.direction.x +
+                                      bitangent * s.direction.y +
+                                      n * s.direction.z;
+                        acc = madd4(acc, sampleCube(chain, l, s.lod), s.weight);
+                        weight += s.weight;
+                    }
+                    float color[4];
+                    store4(color, acc);
+                    for (int c = 0; c < 3; ++c) {
+                        out[c] = linearToSrgb(color[c] / weight);
+                    }
+                }
+            }
+        });
+        for (int f = 0; f < 6; ++f) {
+            size_t bytes = size_t(size) * size * 3;
+            layout[f].push_back(
+                {size, size, faces[f].pixels.data() + offset, bytes});
+        }
+        offset += size_t(size) * size * 3;
+    }
+    for (int f = 0; f < 6; ++f) {
+        faces[f].levels = std::move(layout[f]);
+        faces[f].width = faces[f].height = base;
+        faces[f].channels = 3;
+        faces[f].format = mgl::PixelFormat::RGB8;
+        faces[f].data = faces[f].pixels.data();
+    }
+}
+
+// 积分BRDF查找表: F0的缩放与偏移, 横轴为NdotV, 纵轴为粗糙度
+std::vector<float> integrateBrdf(int size) {
+    std::vector<float> lut(size_t(size) * size * 2);
+    mgl::ParallelFor(size_t(size), 4, [&](size_t b, size_t e) {
+        for (size_t y = b; y < e; ++y) {
+            float roughness = (y + 0.5f) / size;
+            // 基于图像的光照使用的几何遮蔽参数
+            float k = roughness * roughness / 2.0f;
+            for (int x = 0; x < size; ++x) {
+                float NdotV = (x + 0.5f) / size;
+                glm::vec3 v(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+                float scale = 0.0f, bias = 0.0f;
+                for (unsigned int i = 0; i < LUT_SAMPLES; ++i) {
+                    glm::vec3 h =
+                        sampleGgx(hammersley(i, LUT_SAMPLES), roughness);
+                    float VdotH = glm::dot(v, h);
+                    glm::vec3 l = 2.0f * VdotH * h - v;
+                    float NdotL = l.z;
+                    if (NdotL <= 0.0f) continue;
+                    float NdotH = std::max(h.z, 0.0f);
+                    VdotH = std::max(VdotH, 0.0f);
+                    float g = NdotV / (NdotV * (1.0f - k) + k) * NdotL /
+                              (NdotL * (1.0f - k) + k);
+                    float visibility = g * VdotH / (NdotH * NdotV);
+                    float fresnel = std::pow(1.0f - VdotH, 5.0f);
+                    scale += (1.0f - fresnel) * visibility;
+                    bias += fresnel * visibility;
+                }
+                float* out = &lut[(y * size + x) * 2];
+                out[0] = scale / LUT_SAMPLES;
+                out[1] = bias / LUT_SAMPLES;
+            }
+        }
+    });
+    return lut;
+}
+
+uint64_t environmentSettings() {
+    const mgl::LoadConfig& config = mgl::loadConfig();
+    uint64_t hash = mgl::HashCombine(mgl::FNV_OFFSET_BASIS, IBL_VERSION);
+    hash = mgl::HashCombine(hash, config.iblSpecularSize);
+    return mgl::HashCombine(hash, config.iblSampleCount);
+}
+
+bool writeCache(const std::string& path, uint64_t sourceHash,
+                uint64_t settings, const mgl::EnvironmentData& data) {
+    EnvironmentHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, IBL_MAGIC, sizeof(IBL_MAGIC));
+    header.version = IBL_VERSION;
+    header.sourceHash = sourceHash;
+    header.settings = settings;
+    header.size = static_cast<uint32_t>(data.specular[0].width);
+    header.levels = static_cast<uint32_t>(data.specular[0].levels.size());
+    header.lutSize = static_cast<uint32_t>(data.lutSize);
+
+    // 先写临时文件再替换, 避免中断时留下损坏的缓存
+    std::string tmp = mgl::TempPath(path);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(data.irradiance),
+                  sizeof(data.irradiance));
+        out.write(reinterpret_cast<const char*>(data.lut.data()),
+                  data.lut.size() * sizeof(float));
+        for (auto& face : data.specular) {
+            for (auto& level : face.levels) {
+                out.write(reinterpret_cast<const char*>(level.data),
+                          level.size);
+            }
+        }
+        if (!out) {
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    return mgl::ReplaceFileAtomic(tmp, path);
+}
+
+// 读取缓存, 镜面反射的各层直接引用文件内容
+bool readCache(const std::string& path, uint64_t sourceHash,
+               uint64_t settings, mgl::EnvironmentData& data) {
+    mgl::FileData file = mgl::ReadFile(path);
+    if (!file.isOpen() || file.size() < sizeof(EnvironmentHeader)) {
+        return false;
+    }
+    EnvironmentHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, IBL_MAGIC, sizeof(IBL_MAGIC)) ||
+        header.version != IBL_VERSION || header.sourceHash != sourceHash ||
+        header.settings != settings || header.size == 0 ||
+        header.levels == 0 || header.levels > 32 || header.lutSize == 0 ||
+        header.lutSize > 4096) {
+        return false;
+    }
+    size_t lutCount = size_t(header.lutSize) * header.lutSize * 2;
+    size_t faceBytes = 0;
+    for (uint32_t l = 0; l < header.levels; ++l) {
+        size_t size = std::max<size_t>(1, header.size >> l);
+        faceBytes += size * size * 3;
+    }
+    size_t expected = sizeof(header) + sizeof(data.irradiance) +
+                      lutCount * sizeof(float) + 6 * faceBytes;
+    if (file.size() != expected) return false;
+
+    const unsigned char* p = file.data() + sizeof(header);
+    std::memcpy(data.irradiance, p, sizeof(data.irradiance));
+    p += sizeof(data.irradiance);
+    data.lutSize = int(header.lutSize);
+    data.lut.resize(lutCount);
+    std::memcpy(data.lut.data(), p, lutCount * sizeof(float));
+    p += lutCount * sizeof(float);
+    for (auto& face : data.specular) {
+        face.reset();
+        for (uint32_t l = 0; l < header.levels; ++l) {
+            int size = std::max(1, int(header.size >> l));
+            size_t bytes = size_t(size) * size * 3;
+            face.levels.push_back({size, size, p, bytes});
+            p += bytes;
+        }
+        face.width = face.height = int(header.size);
+        face.channels = 3;
+        face.format = mgl::PixelFormat::RGB8;
+        face.data = const_cast<unsigned char*>(face.levels[0].data);
+        face.file = file;
+    }
+    return true;
+}
+
+unsigned int uploadLut(const std::vector<float>& lut, int size) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, size, size);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RG, GL_FLOAT,
+                    lut.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+}  // namespace
+
+void _MGL EnvironmentLighting::bind(Shader& shader, unsigned int unit) const {
+    for (int i = 0; i < SH_COEFFICIENTS; ++i) {
+        shader.setUniformV("irradianceSH[" + std::to_string(i) + "]",
+                           irradiance[i]);
+    }
+    shader.setUniform("specularLevels", float(specularLevels));
+    shader.setUniform("specularMap", int(unit));
+    shader.setUniform("brdfLut", int(unit + 1));
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, specular);
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    glBindTexture(GL_TEXTURE_2D, brdfLut);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool _MGL PrecomputeEnvironment(const std::vector<std::string>& paths,
+                                EnvironmentData& data) {
+    MipLevel faces[6];
+    if (!DecodeCubemapFaces(paths, faces)) return false;
+    const LoadConfig& config = loadConfig();
+    // 预过滤不需要比镜面反射第0层更精细的源, 先在RGBA8上缩小
+    int target = int(std::max(1u, config.iblSpecularSize));
+    while (faces[0].width > target) {
+        ParallelFor(6, 1, [&](size_t b, size_t e) {
+            for (size_t f = b; f < e; ++f) {
+                faces[f] = DownsampleHalf(faces[f].pixels.data(),
+                                          faces[f].width, faces[f].height, 4,
+                                          MipFilter::Box, false);
+            }
+        });
+    }
+    std::vector<CubeLevel> chain = buildSource(faces);
+
+    size_t shLevel = 0;
+    while (chain[shLevel].size > SH_SOURCE_SIZE) ++shLevel;
+    projectIrradiance(chain[shLevel], data.irradiance);
+
+    int levels = 1;
+    while ((chain[0].size >> levels) >= MIN_SPECULAR_SIZE) ++levels;
+    prefilterSpecular(chain, levels, config.iblSampleCount, data.specular);
+
+    data.lutSize = LUT_SIZE;
+    data.lut = integrateBrdf(LUT_SIZE);
+    return true;
+}
+
+_MGL EnvironmentLighting _MGL LoadEnvironmentLighting(
+    const std::vector<std::string>& paths) {
+    EnvironmentLighting lighting;
+    EnvironmentData data;
+    // 计算哈希与预计算共用同一次读取
+    ReadBatch batch(paths);
+    uint64_t sourceHash = 0;
+    bool hashed = CubemapSourceHash(paths, sourceHash);
+    uint64_t settings = environmentSettings();
+    std::string cachePath =
+        paths.empty() ? std::string() : paths[0] + ".mglibl";
+    if (!hashed || !readCache(cachePath, sourceHash, settings, data)) {
+        if (hashed) std::printf("IBL::CACHE::MISS %s\n", cachePath.c_str());
+        if (!PrecomputeEnvironment(paths, data)) return lighting;
+        if (hashed && !writeCache(cachePath, sourceHash, settings, data)) {
+            std::printf("WARNING::IBL::CACHE::WRITE_FAILED %s\n",
+                        cachePath.c_str());
+        }
+    }
+    std::copy(data.irradiance, data.irradiance + SH_COEFFICIENTS,
+              lighting.irradiance);
+    lighting.specular = UploadCubemap(data.specular, true);
+    lighting.specularLevels =
+        static_cast<unsigned int>(data.specular[0].levels.size());
+    lighting.brdfLut = uploadLut(data.lut, data.lutSize);
+    return lighting;
+}
@@ -0,0 +1,464 @@
+﻿#include "header/Image.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include "header/Config.h"
+#include "header/Cook.h"
+#include "header/Hash.h"
+#include "header/TextureCompress.h"
+#include "header/stb_image.h"
+
+// S3TC不属于核心标准, 桌面驱动普遍支持
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace {
+const char IMAGE_MAGIC[4] = {'M', 'G', 'L', 'I'};
+// 烘焙格式版本, 修改布局或编码方式时递增
+const uint32_t IMAGE_VERSION = 3;
+// 每层数据的对齐
+const uint64_t LEVEL_ALIGNMENT = 16;
+
+// 烘焙图像的文件头, 之后是levels个LevelIndex, 与KTX2的布局相同:
+// 第0层在前, 每层的数据按16字节对齐
+struct ImageHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t format;
+    uint32_t levels;
+    uint32_t role;
+};
+
+struct LevelIndex {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// 每个格式上传时使用的GL格式
+struct GLFormat {
+    GLenum internal;
+    GLenum format;
+};
+
+GLFormat glFormat(mgl::PixelFormat format) {
+    switch (format) {
+        case mgl::PixelFormat::R8:
+            return {GL_R8, GL_RED};
+        case mgl::PixelFormat::RG8:
+            return {GL_RG8, GL_RG};
+        case mgl::PixelFormat::RGB8:
+            return {GL_RGB8, GL_RGB};
+        case mgl::PixelFormat::RGBA8:
+            return {GL_RGBA8, GL_RGBA};
+        case mgl::PixelFormat::BC1:
+            return {GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 0};
+        case mgl::PixelFormat::BC3:
+            return {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0};
+        case mgl::PixelFormat::BC4:
+            return {GL_COMPRESSED_RED_RGTC1, 0};
+        case mgl::PixelFormat::BC5:
+            return {GL_COMPRESSED_RG_RGTC2, 0};
+        default:
+            return {GL_RGBA8, GL_RGBA};
+    }
+}
+
+mgl::PixelFormat formatOf(int channels) {
+    switch (channels) {
+        case 1:
+            return mgl::PixelFormat::R8;
+        case 2:
+            return mgl::PixelFormat::RG8;
+        case 3:
+            return mgl::PixelFormat::RGB8;
+        case 4:
+            return mgl::PixelFormat::RGBA8;
+        default:
+            return mgl::PixelFormat::None;
+    }
+}
+
+// 图像需要的存储层数, 没有mip链时为驱动生成的完整mip链
+GLsizei storageLevels(const mgl::Image& image) {
+    if (!image.levels.empty()) return GLsizei(image.levels.size());
+    GLsizei count = 1;
+    for (int size = std::max(image.width, image.height); size > 1;
+         size >>= 1) {
+        ++count;
+    }
+    return count;
+}
+
+// 把图像的各层上传到已分配存储的target, 没有mip链时只上传第0层
+void uploadLevels(GLenum target, const mgl::Image& image) {
+    GLFormat gl = glFormat(image.format);
+    if (image.levels.empty()) {
+        glTexSubImage2D(target, 0, 0, 0, image.width, image.height, gl.format,
+                        GL_UNSIGNED_BYTE, image.data);
+    }
+    for (GLint level = 0; level < GLint(image.levels.size()); ++level) {
+        const mgl::ImageLevel& l = image.levels[level];
+        if (image.compressed()) {
+            glCompressedTexSubImage2D(target, level, 0, 0, l.width, l.height,
+                                      gl.internal,
+                                      static_cast<GLsizei>(l.size), l.data);
+        } else {
+            glTexSubImage2D(target, level, 0, 0, l.width, l.height, gl.format,
+                            GL_UNSIGNED_BYTE, l.data);
+        }
+    }
+}
+
+// 按用途与像素内容选择烘焙格式
+mgl::PixelFormat chooseFormat(const std::vector<unsigned char>& rgba,
+                              mgl::TextureRole role, bool compress) {
+    bool opaque = true, gray = true;
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        opaque = opaque && rgba[i + 3] == 255;
+        gray = gray && rgba[i] == rgba[i + 1] && rgba[i] == rgba[i + 2];
+    }
+    using mgl::PixelFormat;
+    switch (role) {
+        case mgl::TextureRole::Normal:
+            return compress ? PixelFormat::BC5 : PixelFormat::RG8;
+        case mgl::TextureRole::Specular:
+            if (gray) return compress ? PixelFormat::BC4 : PixelFormat::R8;
+            return compress ? PixelFormat::BC1 : PixelFormat::RGB8;
+        default:
+            if (!opaque) {
+                return compress ? PixelFormat::BC3 : PixelFormat::RGBA8;
+            }
+            if (gray) return compress ? PixelFormat::BC4 : PixelFormat::R8;
+            return compress ? PixelFormat::BC1 : PixelFormat::RGB8;
+    }
+}
+
+// 采样得到的分量数
+int channelsOf(mgl::PixelFormat format) {
+    switch (format) {
+        case mgl::PixelFormat::R8:
+        case mgl::PixelFormat::BC4:
+            return 1;
+        case mgl::PixelFormat::RG8:
+        case mgl::PixelFormat::BC5:
+            return 2;
+        case mgl::PixelFormat::RGB8:
+        case mgl::PixelFormat::BC1:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+_MGL Image readCooked(const std::string& filename) {
+    std::string cooked = _MGL FindCooked(filename,
+                                         _MGL CookedImageSettings(filename));
+    if (cooked.empty()) return _MGL Image();
+    return _MGL ReadCookedImage(_MGL ReadFile(cooked));
+}
+}  // namespace
+
+_MGL Image _MGL DecodeImage(const std::string& filename) {
+    Image image = readCooked(filename);
+    if (image.valid() && !image.compressed()) return image;
+    FileData file = ReadFile(filename);
+    if (!file.isOpen()) return Image();
+    return DecodeImageFromMemory(file.data(), file.size());
+}
+
+_MGL Image _MGL LoadTextureImage(const std::string& filename) {
+    Image image = readCooked(filename);
+    if (!image.valid()) {
+        FileData file = ReadFile(filename);
+        if (!file.isOpen()) return Image();
+        image = DecodeImageFromMemory(file.data(), file.size());
+    }
+    LimitTextureSize(image, GuessTextureRole(filename));
+    return image;
+}
+
+void _MGL LimitTextureSize(Image& image, TextureRole role) {
+    const LoadConfig& config = loadConfig();
+    if (!image.valid()) return;
+    // 需要缩小一半的次数
+    unsigned int halvings = 0;
+    int width = image.width, height = image.height;
+    auto halve = [&]() {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        ++halvings;
+    };
+    while (config.maxTextureSize &&
+           unsigned(std::max(width, height)) > config.maxTextureSize) {
+        halve();
+    }
+    for (unsigned int i = 0; i < config.textureMipBias; ++i) {
+        if (width > 1 || height > 1) halve();
+    }
+    if (halvings == 0) return;
+
+    if (!image.levels.empty()) {
+        size_t skip = std::min<size_t>(halvings, image.levels.size() - 1);
+        image.levels.erase(image.levels.begin(), image.levels.begin() + skip);
+        image.width = image.levels[0].width;
+        image.height = image.levels[0].height;
+        image.data = const_cast<unsigned char*>(image.levels[0].data);
+        return;
+    }
+    if (image.compressed()) return;
+    MipFilter filter = config.textureFilters[static_cast<int>(role)];
+    bool normalMap = role == TextureRole::Normal;
+    MipLevel level = DownsampleHalf(image.data, image.width, image.height,
+                                    image.channels, filter, normalMap);
+    for (unsigned int i = 1; i < halvings; ++i) {
+        level = DownsampleHalf(level.pixels.data(), level.width, level.height,
+                               4, filter, normalMap);
+    }
+    // 按原来的通道数存放, 双通道为灰度与透明度
+    int channels = image.channels;
+    std::vector<unsigned char> packed(level.pixels.size() / 4 * channels);
+    for (size_t i = 0, n = packed.size() / channels; i < n; ++i) {
+        const unsigned char* px = &level.pixels[i * 4];
+        unsigned char* d = &packed[i * channels];
+        if (channels == 2) {
+            d[0] = px[0];
+            d[1] = px[3];
+        } else {
+            std::memcpy(d, px, channels);
+        }
+    }
+    image.reset();
+    image.pixels = std::move(packed);
+    image.data = image.pixels.data();
+    image.width = level.width;
+    image.height = level.height;
+    image.channels = channels;
+    image.format = formatOf(channels);
+}
+
+_MGL Image _MGL DecodeImageFromMemory(const unsigned char* bytes,
+                                     size_t size) {
+    Image image;
+    image.data = stbi_load_from_memory(bytes, static_cast<int>(size),
+                                       &image.width, &image.height,
+                                       &image.channels, 0);
+    image.format = formatOf(image.channels);
+    return image;
+}
+
+std::vector<unsigned char> _MGL ExpandRGBA(const Image& image) {
+    size_t count = size_t(image.width) * image.height;
+    std::vector<unsigned char> rgba(count * 4);
+    const unsigned char* src = image.data;
+    int n = image.channels;
+    for (size_t i = 0; i < count; ++i, src += n) {
+        unsigned char* d = &rgba[i * 4];
+        if (n <= 2) {
+            d[0] = d[1] = d[2] = src[0];
+            d[3] = n == 2 ? src[1] : 255;
+        } else {
+            d[0] = src[0];
+            d[1] = src[1];
+            d[2] = src[2];
+            d[3] = n == 4 ? src[3] : 255;
+        }
+    }
+    return rgba;
+}
+
+void _MGL UploadTextureLevels(const Image& image) {
+    glTexStorage2D(GL_TEXTURE_2D, storageLevels(image),
+                   glFormat(image.format).internal, image.width,
+                   image.height);
+    // 行宽不一定是4字节的倍数
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    uploadLevels(GL_TEXTURE_2D, image);
+    if (image.levels.empty()) glGenerateMipmap(GL_TEXTURE_2D);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // 单通道采样为灰度, 解码得到的双通道为灰度加透明度, 同理.
+    // 烘焙产物中的RG8只用于法线xy(见chooseFormat), 与BC5一样保持原样
+    bool grayAlpha =
+        image.format == PixelFormat::RG8 && image.levels.empty();
+    if (image.channels == 1 || grayAlpha) {
+        GLint swizzle[4] = {GL_RED, GL_RED, GL_RED,
+                            image.channels == 1 ? GL_ONE : GL_GREEN};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+}
+
+unsigned int _MGL UploadTexture2D(const Image& image) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    if (!image.valid()) return textureID;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    UploadTextureLevels(image);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+unsigned int _MGL UploadCubemap(const Image faces[6], bool srgb) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    for (int i = 0; i < 6; ++i) {
+        const Image& face = faces[i];
+        if (!face.valid() || face.width != face.height ||
+            face.width != faces[0].width || face.format != faces[0].format ||
+            face.levels.size() != faces[0].levels.size()) {
+            return textureID;
+        }
+    }
+
+    GLenum internal = glFormat(faces[0].format).internal;
+    if (srgb && faces[0].format == PixelFormat::RGB8) internal = GL_SRGB8;
+    if (srgb && faces[0].format == PixelFormat::RGBA8) {
+        internal = GL_SRGB8_ALPHA8;
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glTexStorage2D(GL_TEXTURE_CUBE_MAP, storageLevels(faces[0]), internal,
+                   faces[0].width, faces[0].height);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < 6; ++i) {
+        uploadLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i]);
+    }
+    if (faces[0].levels.empty()) glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return textureID;
+}
+
+_MGL TextureRole _MGL GuessTextureRole(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string name =
+        path.substr(slash == std::string::npos ? 0 : slash + 1);
+    for (auto& c : name) c = static_cast<char>(std::tolower((unsigned char)c));
+    for (const char* tag : {"normal", "nrm", "ddn"}) {
+        if (name.find(tag) != std::string::npos) return TextureRole::Normal;
+    }
+    if (name.find("spec") != std::string::npos) return TextureRole::Specular;
+    return TextureRole::Color;
+}
+
+uint64_t _MGL CookedImageSettings(const std::string& path) {
+    uint64_t hash = HashCombine(FNV_OFFSET_BASIS, IMAGE_VERSION);
+    hash = HashCombine(hash, loadConfig().compressTextures);
+    TextureRole role = GuessTextureRole(path);
+    hash = HashCombine(hash,
+                       loadConfig().textureFilters[static_cast<int>(role)]);
+    return HashCombine(hash, static_cast<int>(role));
+}
+
+bool _MGL WriteCookedImage(const Image& image, TextureRole role,
+                           const std::string& path) {
+    if (!image.valid() || image.compressed() || image.channels < 1 ||
+        image.channels > 4) {
+        return false;
+    }
+    std::vector<unsigned char> rgba = ExpandRGBA(image);
+    PixelFormat format =
+        chooseFormat(rgba, role, loadConfig().compressTextures);
+    std::vector<MipLevel> chain =
+        BuildMipChain(rgba.data(), image.width, image.height,
+                      loadConfig().textureFilters[static_cast<int>(role)],
+                      role == TextureRole::Normal);
+
+    ImageHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.width = static_cast<uint32_t>(image.width);
+    header.height = static_cast<uint32_t>(image.height);
+    header.channels = static_cast<uint32_t>(channelsOf(format));
+    header.format = static_cast<uint32_t>(format);
+    header.levels = static_cast<uint32_t>(chain.size());
+    header.role = static_cast<uint32_t>(role);
+    std::vector<LevelIndex> index(chain.size());
+    uint64_t offset = sizeof(header) + sizeof(LevelIndex) * index.size();
+    for (size_t i = 0; i < chain.size(); ++i) {
+        offset = (offset + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT *
+                 LEVEL_ALIGNMENT;
+        index[i].offset = offset;
+        index[i].size =
+            ImageLevelSize(format, chain[i].width, chain[i].height);
+        offset += index[i].size;
+    }
+    std::vector<unsigned char> bytes(static_cast<size_t>(offset), 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + sizeof(header), index.data(),
+                sizeof(LevelIndex) * index.size());
+    for (size_t i = 0; i < chain.size(); ++i) {
+        EncodeImageLevel(format, chain[i].pixels.data(), chain[i].width,
+                         chain[i].height, &bytes[index[i].offset]);
+    }
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return static_cast<bool>(out);
+}
+
+_MGL Image _MGL ReadCookedImage(FileData&& file) {
+    Image image;
+    ImageHeader header;
+    if (!file.isOpen() || file.size() < sizeof(header)) return image;
+    std::memcpy(&header, file.data(), sizeof(header));
+    PixelFormat format = static_cast<PixelFormat>(header.format);
+    if (std::memcmp(header.magic, IMAGE_MAGIC, 4) != 0 ||
+        header.version != IMAGE_VERSION || format == PixelFormat::None ||
+        format > PixelFormat::BC5 || header.levels == 0 ||
+        header.levels > 32 || header.width == 0 || header.height == 0 ||
+        header.width > 65536 || header.height > 65536 ||
+        sizeof(header) + sizeof(LevelIndex) * header.levels > file.size()) {
+        return image;
+    }
+    image.levels.resize(header.levels);
+    int width = static_cast<int>(header.width);
+    int height = static_cast<int>(header.height);
+    for (uint32_t i = 0; i < header.levels; ++i) {
+        LevelIndex index;
+        std::memcpy(&index,
+                    file.data() + sizeof(header) + sizeof(LevelIndex) * i,
+                    sizeof(index));
+        if (index.size != ImageLevelSize(format, width, height) ||
+            index.offset > file.size() ||
+            index.size > file.size() - index.offset) {
+            image.levels.clear();
+            return image;
+        }
+        ImageLevel& level = image.levels[i];
+        level.width = width;
+        level.height = height;
+        level.data = file.data() + index.offset;
+        level.size = static_cast<size_t>(index.size);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    image.width = static_cast<int>(header.width);
+    image.height = static_cast<int>(header.height);
+    image.channels = static_cast<int>(header.channels);
+    image.format = format;
+    // 各层只读, 与文件内容同生命周期
+    image.data = const_cast<unsigned char*>(image.levels[0].data);
+    image.file = std::move(file);
+    return image;
+}
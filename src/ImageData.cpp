@@ -0,0 +1,31 @@
+﻿#include "header/Image.h"
+#include <utility>
+#include "header/stb_image.h"
+
+_MGL Image::Image(Image&& rval) noexcept { *this = std::move(rval); }
+
+_MGL Image& _MGL Image::operator=(Image&& rval) noexcept {
+    if (this != &rval) {
+        reset();
+        width = rval.width;
+        height = rval.height;
+        channels = rval.channels;
+        format = rval.format;
+        data = rval.data;
+        file = std::move(rval.file);
+        levels = std::move(rval.levels);
+        pixels = std::move(rval.pixels);
+        rval.data = nullptr;
+        rval.levels.clear();
+        rval.pixels.clear();
+    }
+    return *this;
+}
+
+void _MGL Image::reset() noexcept {
+    if (data && !file.isOpen() && pixels.empty()) stbi_image_free(data);
+    data = nullptr;
+    file = FileData();
+    levels.clear();
+    std::vector<unsigned char>().swap(pixels);
+}
@@ -0,0 +1,257 @@
+﻿#include "header/Json.h"
+#include <cstdlib>
+#include <cstring>
+
+MGL_START
+/**
+ * @brief 递归下降的JSON解析器
+ * @class
+ */
+class JsonParser {
+  private:
+    const char* p;
+    const char* end;
+    // 最大嵌套深度, 防止恶意文件耗尽栈空间
+    static const int MaxDepth = 256;
+
+  public:
+    std::string error;
+
+    JsonParser(const char* data, size_t size) : p(data), end(data + size) {}
+
+    bool fail(const char* message) {
+        if (error.empty()) error = message;
+        return false;
+    }
+
+    void skipSpace() {
+        while (p < end &&
+               (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            ++p;
+        }
+    }
+
+    bool literal(const char* word) {
+        size_t n = std::strlen(word);
+        if (size_t(end - p) < n || std::strncmp(p, word, n) != 0) {
+            return fail("invalid literal");
+        }
+        p += n;
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned long code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool hex4(unsigned long& code) {
+        if (end - p < 4) return fail("truncated escape");
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = p[i];
+            int digit = c >= '0' && c <= '9'   ? c - '0'
+                        : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                        : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                               : -1;
+            if (digit < 0) return fail("invalid escape");
+            code = code << 4 | static_cast<unsigned long>(digit);
+        }
+        p += 4;
+        return true;
+    }
+
+    bool parseString(std::string& out) {
+        ++p;  // 跳过 "
+        for (;;) {
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\') ++p;
+            out.append(run, p);
+            if (p >= end) return fail("unterminated string");
+            if (*p++ == '"') return true;
+            if (p >= end) return fail("unterminated string");
+            char c = *p++;
+            switch (c) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned long code;
+                    if (!hex4(code)) return false;
+                    // 代理对
+                    if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 &&
+                        p[0] == '\\' && p[1] == 'u') {
+                        p += 2;
+                        unsigned long low;
+                        if (!hex4(low)) return false;
+                        if (low < 0xDC00 || low >= 0xE000) {
+                            return fail("invalid surrogate");
+                        }
+                        code = 0x10000 + ((code - 0xD800) << 10) +
+                               (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                case '"':
+                case '\\':
+                case '/': out += c; break;
+                default: return fail("invalid escape");
+            }
+        }
+    }
+
+    bool parseNumber(JsonValue& value) {
+        // 输入未必以'\0'结尾, 先复制到缓冲区再交给strtod
+        char buffer[64];
+        size_t n = 0;
+        while (p + n < end && n + 1 < sizeof(buffer) &&
+               p[n] != '\0' && std::strchr("+-.0123456789eE", p[n])) {
+            buffer[n] = p[n];
+            ++n;
+        }
+        buffer[n] = '\0';
+        char* stop = nullptr;
+        value.number = std::strtod(buffer, &stop);
+        if (stop == buffer) return fail("invalid number");
+        p += stop - buffer;
+        value.type = JsonValue::Number;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value, int depth) {
+        if (depth > MaxDepth) return fail("nesting too deep");
+        skipSpace();
+        if (p >= end) return fail("unexpected end");
+        switch (*p) {
+            case '{': {
+                ++p;
+                value.type = JsonValue::Object;
+                skipSpace();
+                if (p < end && *p == '}') {
+                    ++p;
+                    return true;
+                }
+                for (;;) {
+                    skipSpace();
+                    if (p >= end || *p != '"') return fail("expected key");
+                    value.members.emplace_back();
+                    auto& member = value.members.back();
+                    if (!parseString(member.first)) return false;
+                    skipSpace();
+                    if (p >= end || *p++ != ':') return fail("expected ':'");
+                    if (!parseValue(member.second, depth + 1)) return false;
+                    skipSpace();
+                    if (p < end && *p == ',') {
+                        ++p;
+                        continue;
+                    }
+                    if (p < end && *p == '}') {
+                        ++p;
+                        return true;
+                    }
+                    return fail("expected ',' or '}'");
+                }
+            }
+            case '[': {
+                ++p;
+                value.type = JsonValue::Array;
+                skipSpace();
+                if (p < end && *p == ']') {
+                    ++p;
+                    return true;
+                }
+                for (;;) {
+                    value.items.emplace_back();
+                    if (!parseValue(value.items.back(), depth + 1)) {
+                        return false;
+                    }
+                    skipSpace();
+                    if (p < end && *p == ',') {
+                        ++p;
+                        continue;
+                    }
+                    if (p < end && *p == ']') {
+                        ++p;
+                        return true;
+                    }
+                    return fail("expected ',' or ']'");
+                }
+            }
+            case '"':
+                value.type = JsonValue::String;
+                return parseString(value.text);
+            case 't':
+                value.type = JsonValue::Bool;
+                value.boolean = true;
+                return literal("true");
+            case 'f':
+                value.type = JsonValue::Bool;
+                value.boolean = false;
+                return literal("false");
+            case 'n':
+                value.type = JsonValue::Null;
+                return literal("null");
+            default:
+                return parseNumber(value);
+        }
+    }
+
+    bool parse(JsonValue& value) {
+        if (!parseValue(value, 0)) return false;
+        skipSpace();
+        return p == end || *p == '\0' ? true : fail("trailing characters");
+    }
+};
+MGL_END
+
+namespace {
+const _MGL JsonValue NULL_VALUE;
+}  // namespace
+
+const _MGL JsonValue& _MGL JsonValue::operator[](size_t index) const {
+    return index < items.size() ? items[index] : NULL_VALUE;
+}
+
+const _MGL JsonValue& _MGL JsonValue::operator[](const char* key) const {
+    for (auto& member : members) {
+        if (member.first == key) return member.second;
+    }
+    return NULL_VALUE;
+}
+
+bool _MGL JsonValue::has(const char* key) const {
+    for (auto& member : members) {
+        if (member.first == key) return true;
+    }
+    return false;
+}
+
+bool _MGL ParseJson(const char* data, size_t size, JsonValue& value,
+                    std::string* error) {
+    value = JsonValue();
+    // 跳过UTF-8 BOM
+    if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        data += 3;
+        size -= 3;
+    }
+    JsonParser parser(data, size);
+    bool ok = parser.parse(value);
+    if (!ok && error) *error = parser.error;
+    return ok;
+}
@@ -0,0 +1,48 @@
+﻿#include "header/LodSelect.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+// 模型矩阵的最大轴向缩放
+float maxScale(const glm::mat4& m) {
+    float x = glm::dot(glm::vec3(m[0]), glm::vec3(m[0]));
+    float y = glm::dot(glm::vec3(m[1]), glm::vec3(m[1]));
+    float z = glm::dot(glm::vec3(m[2]), glm::vec3(m[2]));
+    return std::sqrt(std::max(x, std::max(y, z)));
+}
+}  // namespace
+
+float _MGL ProjectedError(float error, const BoundingSphere& bounds,
+                          const glm::mat4& transform, const LodView& view) {
+    float scale = maxScale(transform);
+    glm::vec3 center(transform * glm::vec4(bounds.center, 1.0f));
+    float distance =
+        glm::length(center - view.position) - bounds.radius * scale;
+    if (distance <= 0.0f) return std::numeric_limits<float>::infinity();
+    return error * scale / distance * view.pixelsPerUnit;
+}
+
+unsigned int _MGL SelectLod(const MeshGeometry& geometry,
+                            const glm::mat4& transform, const LodView& view,
+                            unsigned int current) {
+    const std::vector<MeshLod>& lods = geometry.getLods();
+    unsigned int last = static_cast<unsigned int>(lods.size() - 1);
+    current = std::min(current, last);
+    const BoundingSphere& bounds = geometry.getBounds();
+    auto projected = [&](unsigned int level) {
+        return ProjectedError(lods[level].error, bounds, transform, view);
+    };
+    // 各层误差递增, 取误差不超过阈值的最粗一层
+    unsigned int target = 0;
+    while (target < last && projected(target + 1) <= view.pixelError) {
+        ++target;
+    }
+    if (target > current) {
+        float coarser = view.pixelError * (1.0f - view.hysteresis);
+        while (target > current && projected(target) > coarser) --target;
+    } else if (target < current) {
+        float finer = view.pixelError * (1.0f + view.hysteresis);
+        if (projected(current) <= finer) target = current;
+    }
+    return target;
+}
@@ -0,0 +1,163 @@
+﻿#include "header/Lz4.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+// 最短匹配长度
+const size_t MIN_MATCH = 4;
+// 块末尾必须是字面量的字节数
+const size_t LAST_LITERALS = 5;
+// 最后一个匹配必须在距末尾这么多字节之前开始
+const size_t MF_LIMIT = 12;
+// 最大匹配距离
+const size_t MAX_DISTANCE = 65535;
+// 哈希表大小(2的幂)
+const unsigned HASH_LOG = 16;
+
+inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash4(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// 带边界检查的输出
+struct Writer {
+    unsigned char* out;
+    unsigned char* end;
+
+    inline bool put(unsigned char byte) {
+        if (out == end) return false;
+        *out++ = byte;
+        return true;
+    }
+    // 长度的扩展部分: 若干个255后跟余数
+    inline bool putLength(size_t length) {
+        for (; length >= 255; length -= 255) {
+            if (!put(255)) return false;
+        }
+        return put(static_cast<unsigned char>(length));
+    }
+    inline bool copy(const unsigned char* src, size_t size) {
+        if (size == 0) return true;
+        if (size_t(end - out) < size) return false;
+        std::memcpy(out, src, size);
+        out += size;
+        return true;
+    }
+};
+
+// 输出一个序列: 字面量之后跟一个匹配, matchLength为0表示最后只有字面量
+bool emit(Writer& w, const unsigned char* literals, size_t literalLength,
+          size_t distance, size_t matchLength) {
+    size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+    unsigned char token = static_cast<unsigned char>(
+        (literalLength < 15 ? literalLength : 15) << 4 |
+        (matchCode < 15 ? matchCode : 15));
+    if (!w.put(token)) return false;
+    if (literalLength >= 15 && !w.putLength(literalLength - 15)) return false;
+    if (!w.copy(literals, literalLength)) return false;
+    if (matchLength == 0) return true;
+    if (!w.put(static_cast<unsigned char>(distance & 0xff)) ||
+        !w.put(static_cast<unsigned char>(distance >> 8))) {
+        return false;
+    }
+    return matchCode < 15 || w.putLength(matchCode - 15);
+}
+
+// 读取长度的扩展部分
+bool readLength(const unsigned char*& in, const unsigned char* end,
+                size_t& length) {
+    unsigned char byte;
+    do {
+        if (in == end) return false;
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+}  // namespace
+
+size_t _MGL Lz4Compress(const unsigned char* src, size_t size,
+                        unsigned char* dst, size_t capacity) {
+    Writer w = {dst, dst + capacity};
+    size_t anchor = 0;
+    if (size > MF_LIMIT) {
+        // 保存位置 + 1, 0表示空
+        std::vector<uint32_t> table(size_t(1) << HASH_LOG, 0);
+        size_t limit = size - MF_LIMIT;
+        size_t matchLimit = size - LAST_LITERALS;
+        size_t ip = 0;
+        while (ip < limit) {
+            uint32_t sequence = read32(src + ip);
+            uint32_t& slot = table[hash4(sequence)];
+            size_t stored = slot;
+            slot = static_cast<uint32_t>(ip + 1);
+            if (stored == 0 || ip + 1 - stored > MAX_DISTANCE ||
+                read32(src + stored - 1) != sequence) {
+                ++ip;
+                continue;
+            }
+            size_t ref = stored - 1;
+            // 向后扩展匹配, 再向前吞并尚未输出的字面量
+            size_t end = ip + MIN_MATCH;
+            while (end < matchLimit && src[end] == src[ref + end - ip]) ++end;
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                --ip;
+                --ref;
+            }
+            if (!emit(w, src + anchor, ip - anchor, ip - ref, end - ip)) {
+                return 0;
+            }
+            ip = anchor = end;
+        }
+    }
+    if (!emit(w, src + anchor, size - anchor, 0, 0)) return 0;
+    return static_cast<size_t>(w.out - dst);
+}
+
+bool _MGL Lz4Decompress(const unsigned char* src, size_t size,
+                        unsigned char* dst, size_t rawSize) {
+    const unsigned char* in = src;
+    const unsigned char* inEnd = src + size;
+    unsigned char* out = dst;
+    unsigned char* outEnd = dst + rawSize;
+    while (in < inEnd) {
+        unsigned char token = *in++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(in, inEnd, literalLength)) {
+            return false;
+        }
+        if (size_t(inEnd - in) < literalLength ||
+            size_t(outEnd - out) < literalLength) {
+            return false;
+        }
+        if (literalLength) std::memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        // 最后一个序列只有字面量
+        if (in == inEnd) break;
+
+        if (inEnd - in < 2) return false;
+        size_t distance = size_t(in[0]) | size_t(in[1]) << 8;
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(in, inEnd, matchLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (distance == 0 || size_t(out - dst) < distance ||
+            size_t(outEnd - out) < matchLength) {
+            return false;
+        }
+        // 匹配可能与输出重叠, 逐字节复制
+        const unsigned char* from = out - distance;
+        for (size_t i = 0; i < matchLength; ++i) out[i] = from[i];
+        out += matchLength;
+    }
+    return out == outEnd;
+}
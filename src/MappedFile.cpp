@@ -0,0 +1,107 @@
+﻿#include "header/MappedFile.h"
+#include <utility>
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+_MGL MappedFile::MappedFile()
+    : _data(nullptr), _size(0), _file(nullptr), _mapping(nullptr) {}
+#else
+_MGL MappedFile::MappedFile() : _data(nullptr), _size(0) {}
+#endif
+
+_MGL MappedFile::MappedFile(const std::string& path) : MappedFile() {
+    open(path);
+}
+
+_MGL MappedFile::MappedFile(MappedFile&& rval) noexcept : MappedFile() {
+    *this = std::move(rval);
+}
+
+_MGL MappedFile& _MGL MappedFile::operator=(MappedFile&& rval) noexcept {
+    if (this != &rval) {
+        close();
+        std::swap(_data, rval._data);
+        std::swap(_size, rval._size);
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+        std::swap(_file, rval._file);
+        std::swap(_mapping, rval._mapping);
+#endif
+    }
+    return *this;
+}
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+bool _MGL MappedFile::open(const std::string& path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    _file = file;
+    _mapping = mapping;
+    _data = static_cast<const unsigned char*>(view);
+    _size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void _MGL MappedFile::close() noexcept {
+    if (_data) UnmapViewOfFile(_data);
+    if (_mapping) CloseHandle(_mapping);
+    if (_file) CloseHandle(_file);
+    _data = nullptr;
+    _size = 0;
+    _file = nullptr;
+    _mapping = nullptr;
+}
+#else
+bool _MGL MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                      MAP_PRIVATE, fd, 0);
+    // 映射建立后即可关闭描述符
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+    _data = static_cast<const unsigned char*>(view);
+    _size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void _MGL MappedFile::close() noexcept {
+    if (_data) munmap(const_cast<unsigned char*>(_data), _size);
+    _data = nullptr;
+    _size = 0;
+}
+#endif
@@ -0,0 +1,150 @@
+﻿#include "header/MaterialPacker.h"
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace {
+// 图像的各层, 没有mip链时只有data一层
+std::vector<mgl::ImageLevel> levelsOf(const mgl::Image& image) {
+    if (!image.levels.empty()) return image.levels;
+    mgl::ImageLevel level;
+    level.width = image.width;
+    level.height = image.height;
+    level.data = image.data;
+    level.size = size_t(image.width) * image.height * image.channels;
+    return std::vector<mgl::ImageLevel>(1, level);
+}
+
+// 未压缩的图像是否不透明
+bool opaque(const mgl::Image& image) {
+    if (image.channels != 2 && image.channels != 4) return true;
+    for (const auto& level : levelsOf(image)) {
+        size_t count = size_t(level.width) * level.height;
+        for (size_t i = 0; i < count; ++i) {
+            if (level.data[i * image.channels + image.channels - 1] != 255) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 按各层在pixels中的位置设置levels与data
+void finish(mgl::Image& packed, std::vector<mgl::ImageLevel>& levels,
+            std::vector<unsigned char>&& pixels, bool keepLevels) {
+    packed.pixels = std::move(pixels);
+    size_t offset = 0;
+    for (auto& level : levels) {
+        level.data = packed.pixels.data() + offset;
+        offset += level.size;
+    }
+    packed.data = packed.pixels.data();
+    if (keepLevels) packed.levels = std::move(levels);
+}
+}  // namespace
+
+bool _MGL IsSingleChannel(const Image& image) {
+    if (!image.valid()) return false;
+    if (image.format == PixelFormat::R8 || image.format == PixelFormat::BC4) {
+        return true;
+    }
+    if (image.compressed() || image.channels < 3 || !opaque(image)) {
+        return false;
+    }
+    for (const auto& level : levelsOf(image)) {
+        size_t count = size_t(level.width) * level.height;
+        for (size_t i = 0; i < count; ++i) {
+            const unsigned char* px = level.data + i * image.channels;
+            if (px[0] != px[1] || px[0] != px[2]) return false;
+        }
+    }
+    return true;
+}
+
+bool _MGL ReduceToSingleChannel(Image& image) {
+    if (image.channels == 1) return image.valid();
+    if (!IsSingleChannel(image)) return false;
+    std::vector<ImageLevel> levels = levelsOf(image);
+    size_t total = 0;
+    for (auto& level : levels) {
+        level.size = size_t(level.width) * level.height;
+        total += level.size;
+    }
+    std::vector<unsigned char> pixels(total);
+    unsigned char* out = pixels.data();
+    for (const auto& level : levelsOf(image)) {
+        size_t count = size_t(level.width) * level.height;
+        for (size_t i = 0; i < count; ++i) {
+            *out++ = level.data[i * image.channels];
+        }
+    }
+    bool keepLevels = !image.levels.empty();
+    int width = image.width, height = image.height;
+    image.reset();
+    image.width = width;
+    image.height = height;
+    image.channels = 1;
+    image.format = PixelFormat::R8;
+    finish(image, levels, std::move(pixels), keepLevels);
+    return true;
+}
+
+bool _MGL PackSpecularIntoAlpha(const Image& diffuse, const Image& specular,
+                                Image& packed) {
+    if (!diffuse.valid() || !specular.valid() ||
+        diffuse.width != specular.width ||
+        diffuse.height != specular.height ||
+        diffuse.levels.size() != specular.levels.size()) {
+        return false;
+    }
+    std::vector<ImageLevel> color = levelsOf(diffuse);
+    std::vector<ImageLevel> alpha = levelsOf(specular);
+    std::vector<ImageLevel> levels = color;
+    std::vector<unsigned char> pixels;
+    PixelFormat format;
+    if (diffuse.format == PixelFormat::BC1 &&
+        specular.format == PixelFormat::BC4) {
+        // BC3的块由BC4格式的alpha块与四色模式的BC1颜色块组成,
+        // 烘焙的BC1总是四色模式, 两者可以直接拼接
+        format = PixelFormat::BC3;
+        size_t total = 0;
+        for (auto& level : levels) total += (level.size *= 2);
+        pixels.resize(total);
+        unsigned char* out = pixels.data();
+        for (size_t l = 0; l < levels.size(); ++l) {
+            if (color[l].size != alpha[l].size) return false;
+            for (size_t b = 0; b < color[l].size; b += 8) {
+                std::memcpy(out, alpha[l].data + b, 8);
+                std::memcpy(out + 8, color[l].data + b, 8);
+                out += 16;
+            }
+        }
+    } else if (!diffuse.compressed() && diffuse.channels >= 3 &&
+               specular.format == PixelFormat::R8 && opaque(diffuse)) {
+        format = PixelFormat::RGBA8;
+        size_t total = 0;
+        for (auto& level : levels) {
+            level.size = size_t(level.width) * level.height * 4;
+            total += level.size;
+        }
+        pixels.resize(total);
+        unsigned char* out = pixels.data();
+        int n = diffuse.channels;
+        for (size_t l = 0; l < levels.size(); ++l) {
+            size_t count = size_t(levels[l].width) * levels[l].height;
+            for (size_t i = 0; i < count; ++i, out += 4) {
+                std::memcpy(out, color[l].data + i * n, 3);
+                out[3] = alpha[l].data[i];
+            }
+        }
+    } else {
+        return false;
+    }
+    packed.reset();
+    packed.width = diffuse.width;
+    packed.height = diffuse.height;
+    packed.channels = 4;
+    packed.format = format;
+    finish(packed, levels, std::move(pixels), !diffuse.levels.empty());
+    return true;
+}
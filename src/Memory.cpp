@@ -0,0 +1,86 @@
+﻿#include "header/Memory.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+std::atomic<uint64_t> allocations(0);
+std::atomic<uint64_t> allocatedBytes(0);
+std::atomic<uint64_t> bytesCopied(0);
+std::atomic<uint64_t> bytesUploaded(0);
+}  // namespace
+
+_MGL Arena::Arena(size_t blockSize) : current(0), blockSize(blockSize) {}
+
+_MGL Arena::~Arena() {
+    for (auto& block : blocks) std::free(block.data);
+}
+
+void* _MGL Arena::allocate(size_t size, size_t alignment) {
+    for (;;) {
+        if (current < blocks.size()) {
+            Block& block = blocks[current];
+            size_t address = reinterpret_cast<size_t>(block.data) + block.used;
+            size_t padding = (alignment - address % alignment) % alignment;
+            if (padding + size <= block.size - block.used) {
+                void* p = block.data + block.used + padding;
+                block.used += padding + size;
+                return p;
+            }
+            // 当前块不够时依次尝试之后保留的块
+            if (current + 1 < blocks.size()) {
+                blocks[++current].used = 0;
+                continue;
+            }
+        }
+        // 新块至少与之前的所有块一样大, 块数量按对数增长
+        size_t bytes = blockSize;
+        for (auto& block : blocks) bytes = std::max(bytes, block.size * 2);
+        bytes = std::max(bytes, size + alignment);
+        Block block = {static_cast<unsigned char*>(std::malloc(bytes)), bytes,
+                       0};
+        if (!block.data) throw std::bad_alloc();
+        CountAllocation(bytes);
+        blocks.push_back(block);
+        current = blocks.size() - 1;
+    }
+}
+
+void _MGL Arena::rewind(Marker marker) {
+    if (blocks.empty()) return;
+    current = marker.block;
+    blocks[current].used = marker.used;
+}
+
+size_t _MGL Arena::capacity() const {
+    size_t bytes = 0;
+    for (auto& block : blocks) bytes += block.size;
+    return bytes;
+}
+
+_MGL Arena& _MGL threadArena() {
+    thread_local Arena arena;
+    return arena;
+}
+
+void _MGL CountAllocation(size_t bytes) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void _MGL CountCopy(size_t bytes) {
+    bytesCopied.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void _MGL CountUpload(size_t bytes) {
+    bytesUploaded.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+_MGL LoadCounters _MGL ReadLoadCounters() {
+    LoadCounters counters;
+    counters.allocations = allocations.load(std::memory_order_relaxed);
+    counters.allocatedBytes = allocatedBytes.load(std::memory_order_relaxed);
+    counters.bytesCopied = bytesCopied.load(std::memory_order_relaxed);
+    counters.bytesUploaded = bytesUploaded.load(std::memory_order_relaxed);
+    return counters;
+}
@@ -1,15 +1,251 @@
 ﻿#include "header/Mesh.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include "header/Config.h"
+#include "header/Hash.h"
+#include "header/Memory.h"
+#include "header/MeshProcess.h"
+#include "header/VertexLayout.h"
+
+namespace {
+// 设置当前绑定的VAO与VBO的顶点属性指针, 按格式分派到VertexLayout中
+// 编译期生成的设置. 各格式使用相同的位置:
+// 0位置, 1法线, 2纹理坐标, 3切线, 4副切线(压缩时为方向), 5骨骼索引, 6权重
+void setupVertexAttributes(mgl::VertexFormat format) {
+    switch (format) {
+        case mgl::VertexFormat::Skinned:
+            mgl::SkinnedLayout::setup();
+            break;
+        case mgl::VertexFormat::Static:
+            mgl::StaticLayout::setup();
+            break;
+        case mgl::VertexFormat::Position:
+            mgl::PositionLayout::setup();
+            break;
+        case mgl::VertexFormat::Packed:
+            mgl::PackedLayout::setup();
+            break;
+        case mgl::VertexFormat::PackedSkinned:
+            mgl::PackedSkinnedLayout::setup();
+            break;
+    }
+}
+
+// 内容哈希 -> 几何数据, 只保存弱引用, 最后一个Mesh销毁时几何数据随之释放
+std::mutex geometryMutex;
+std::unordered_map<uint64_t, std::weak_ptr<const mgl::MeshGeometry>>
+    geometries;
+
+/**
+ * 查找哈希相同且same确认内容相同的几何数据, 不存在时调用create创建并登记.
+ * 哈希碰撞时新的几何数据替换登记, 旧的仍由其使用者持有
+ */
+template <typename Same, typename Create>
+std::shared_ptr<const mgl::MeshGeometry> shareGeometry(uint64_t hash,
+                                                       Same same,
+                                                       Create create) {
+    std::lock_guard<std::mutex> lock(geometryMutex);
+    auto it = geometries.find(hash);
+    if (it != geometries.end()) {
+        auto existing = it->second.lock();
+        if (existing && same(*existing)) return existing;
+    }
+    std::shared_ptr<const mgl::MeshGeometry> geometry = create();
+    geometries[hash] = geometry;
+    return geometry;
+}
+
+// 转换为上传格式的顶点与索引, 数据位于调用者的Arena中
+struct UploadData {
+    mgl::VertexFormat format;
+    mgl::PositionDecode decode;
+    const void* vertices;
+    size_t vertexBytes;
+    const void* indices;
+    size_t indexBytes;
+    bool shortIndices;
+};
+
+UploadData convertForUpload(const mgl::Vertex* vertexData,
+                            size_t vertexCount, const unsigned int* indexData,
+                            size_t count, mgl::Arena& arena) {
+    UploadData data;
+    data.shortIndices = vertexCount <= mgl::MeshGeometry::MaxShortIndexVertices;
+    data.indexBytes =
+        count * (data.shortIndices ? sizeof(uint16_t) : sizeof(unsigned int));
+    data.format = mgl::ChooseVertexFormat(vertexData, vertexCount,
+                                          mgl::loadConfig().packVertices);
+    data.vertexBytes = vertexCount * mgl::VertexFormatSize(data.format);
+    data.vertices = vertexData;
+    if (data.format != mgl::VertexFormat::Skinned) {
+        void* converted =
+            arena.allocate(data.vertexBytes, alignof(mgl::Vertex));
+        data.decode = mgl::ConvertVertices(vertexData, vertexCount,
+                                           data.format, converted);
+        data.vertices = converted;
+    }
+    data.indices = indexData;
+    if (data.shortIndices) {
+        // 缩窄到16位, 索引带宽与显存减半
+        uint16_t* narrow = arena.allocateArray<uint16_t>(count);
+        for (size_t i = 0; i < count; ++i) {
+            narrow[i] = static_cast<uint16_t>(indexData[i]);
+        }
+        mgl::CountCopy(data.indexBytes);
+        data.indices = narrow;
+    }
+    return data;
+}
+}  // namespace
+
+_MGL MeshGeometry::MeshGeometry(const Vertex* vertexData, size_t vertexCount,
+                                const unsigned int* indexData, size_t count,
+                                std::vector<MeshLod> lods, uint64_t hash,
+                                uint64_t check, bool progressive)
+    : lods(std::move(lods)), contentHash(hash), contentCheck(check) {
+    setupMesh(vertexData, vertexCount, indexData, count, progressive);
+}
+
+_MGL MeshGeometry::~MeshGeometry() {
+    {
+        std::lock_guard<std::mutex> lock(geometryMutex);
+        auto it = geometries.find(contentHash);
+        if (it != geometries.end() && it->second.expired()) {
+            geometries.erase(it);
+        }
+    }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    if (meshletBuffer != 0) glDeleteBuffers(1, &meshletBuffer);
+    if (commandBuffer != 0) glDeleteBuffers(1, &commandBuffer);
+}
+
+uint64_t _MGL MeshGeometry::hashContent(const Vertex* vertexData,
+                                        size_t vertexCount,
+                                        const unsigned int* indexData,
+                                        size_t count, uint64_t seed) {
+    uint64_t hash = HashCombine(seed, uint64_t(vertexCount));
+    hash = HashCombine(hash, uint64_t(count));
+    hash = HashBytes(vertexData, vertexCount * sizeof(Vertex), hash);
+    return HashBytes(indexData, count * sizeof(unsigned int), hash);
+}
+
+bool _MGL MeshGeometry::sameContent(size_t vertexCount, size_t count,
+                                    const std::vector<MeshLod>& lods,
+                                    uint64_t check) const {
+    if (vertexCount != this->vertexCount || count != totalIndexCount ||
+        check != contentCheck) {
+        return false;
+    }
+    std::vector<MeshLod> expected = lods;
+    if (expected.empty()) {
+        expected.push_back({0, static_cast<uint32_t>(count), 0.0f,
+                            static_cast<uint32_t>(vertexCount)});
+    }
+    return expected.size() == this->lods.size() &&
+           std::memcmp(expected.data(), this->lods.data(),
+                       expected.size() * sizeof(MeshLod)) == 0;
+}
+
+size_t _MGL MeshGeometry::liveCount() {
+    std::lock_guard<std::mutex> lock(geometryMutex);
+    size_t count = 0;
+    for (auto& g : geometries) count += g.second.expired() ? 0 : 1;
+    return count;
+}
+
+void _MGL MeshGeometry::setDecodeUniforms(Shader& shader) const {
+    bool packed = format == VertexFormat::Packed ||
+                  format == VertexFormat::PackedSkinned;
+    shader.setUniform("packedVertex", packed);
+    shader.setUniformV("positionScale", positionDecode.scale);
+    shader.setUniformV("positionOffset", positionDecode.offset);
+}
+
+void _MGL MeshGeometry::Draw(unsigned int lod) const {
+    lod = std::max(lod, residentLod);
+    const MeshLod& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, level.indexCount, indexType,
+                   (void*)(level.indexOffset * getIndexSize()));
+    glBindVertexArray(0);
+}
+
+void _MGL MeshGeometry::Draw(const MeshletDrawList& list) const {
+    if (list.counts.empty()) return;
+    glBindVertexArray(VAO);
+    glMultiDrawElements(GL_TRIANGLES, list.counts.data(), indexType,
+                        list.offsets.data(),
+                        static_cast<GLsizei>(list.counts.size()));
+    glBindVertexArray(0);
+}
+
+void _MGL MeshGeometry::DrawIndirect() const {
+    if (commandBuffer == 0) return;
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, nullptr,
+                                static_cast<GLsizei>(meshlets.size()), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
 
 _MGL Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices,
-           std::vector<Texture> textures) {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+                std::vector<Texture> textures, std::vector<MeshLod> lods)
+    : Mesh(vertices.data(), vertices.size(), indices.data(), indices.size(),
+           std::move(textures), std::move(lods)) {}
 
-    setupMesh();
+_MGL Mesh::Mesh(const Vertex* vertexData, size_t vertexCount,
+                const unsigned int* indexData, size_t count,
+                std::vector<Texture> textures, std::vector<MeshLod> lods)
+    : textures(std::move(textures)) {
+    uint64_t hash =
+        MeshGeometry::hashContent(vertexData, vertexCount, indexData, count);
+    uint64_t check =
+        MeshGeometry::hashContent(vertexData, vertexCount, indexData, count,
+                                  MeshGeometry::ContentCheckSeed);
+    auto same = [&](const MeshGeometry& existing) {
+        return existing.sameContent(vertexCount, count, lods, check);
+    };
+    geometry = shareGeometry(hash, same, [&]() {
+        return std::make_shared<const MeshGeometry>(
+            vertexData, vertexCount, indexData, count, std::move(lods), hash,
+            check);
+    });
 }
 
-void _MGL Mesh::setupMesh() {
+_MGL Mesh::Mesh(std::shared_ptr<const MeshGeometry> geometry,
+                std::vector<Texture> textures)
+    : geometry(std::move(geometry)), textures(std::move(textures)) {}
+
+void _MGL MeshGeometry::setupMesh(const Vertex* vertexData,
+                                  size_t vertexCount,
+                                  const unsigned int* indexData,
+                                  size_t count, bool progressive) {
+    if (lods.empty()) {
+        lods.push_back({0, static_cast<uint32_t>(count), 0.0f,
+                        static_cast<uint32_t>(vertexCount)});
+    }
+    indexCount = lods[0].indexCount;
+    this->vertexCount = vertexCount;
+    totalIndexCount = count;
+    bounds = ComputeBounds(vertexData, vertexCount);
+
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    UploadData data =
+        convertForUpload(vertexData, vertexCount, indexData, count, arena);
+    format = data.format;
+    positionDecode = data.decode;
+    indexType = data.shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    const void* vertexSource = data.vertices;
+    const void* indexSource = data.indices;
+    size_t vertexBytes = data.vertexBytes;
+    size_t indexBytes = data.indexBytes;
+
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
@@ -17,47 +253,122 @@ void _MGL Mesh::setupMesh() {
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                 &vertices[0], GL_STATIC_DRAW);
-
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                 &indices[0], GL_STATIC_DRAW);
-
-    // 顶点位置
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // 顶点法线
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void*)offsetof(Vertex, Normal));
-    // 顶点纹理
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void*)offsetof(Vertex, TexCoords));
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void*)offsetof(Vertex, Tangent));
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (void*)offsetof(Vertex, Bitangent));
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, MAX_BONE_INFLUENCE, GL_INT, sizeof(Vertex),
-                           (void*)offsetof(Vertex, m_BoneIDs));
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, MAX_BONE_INFLUENCE, GL_FLOAT, GL_FALSE,
-                          sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+    if (progressive && lods.size() > 1) {
+        // 先分配完整的缓冲区, 只上传最粗的一层
+        auto v = static_cast<const unsigned char*>(vertexSource);
+        auto i = static_cast<const unsigned char*>(indexSource);
+        stagedVertices.assign(v, v + vertexBytes);
+        stagedIndices.assign(i, i + indexBytes);
+        CountCopy(vertexBytes + indexBytes);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr,
+                     GL_STATIC_DRAW);
+        residentLod = static_cast<unsigned int>(lods.size());
+    } else {
+        CountUpload(vertexBytes + indexBytes);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexSource,
+                     GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexSource,
+                     GL_STATIC_DRAW);
+    }
 
+    setupVertexAttributes(format);
+
+    glBindVertexArray(0);
+
+    if (residentLod > 0) uploadLevel(residentLod - 1);
+
+    if (loadConfig().buildMeshlets) {
+        setupMeshlets(vertexData, vertexCount, indexData);
+    }
+}
+
+size_t _MGL MeshGeometry::uploadLevel(unsigned int level) {
+    const MeshLod& lod = lods[level];
+    size_t stride = VertexFormatSize(format);
+    size_t indexSize = getIndexSize();
+    // 更粗的各层已经上传了前面的顶点
+    size_t firstVertex =
+        residentLod < lods.size() ? lods[residentLod].vertexCount : 0;
+    size_t vertexBytes = lod.vertexCount > firstVertex
+                             ? (lod.vertexCount - firstVertex) * stride
+                             : 0;
+    size_t indexBytes = lod.indexCount * indexSize;
+
+    glBindVertexArray(VAO);
+    if (vertexBytes > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, firstVertex * stride, vertexBytes,
+                        stagedVertices.data() + firstVertex * stride);
+    }
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, lod.indexOffset * indexSize,
+                    indexBytes,
+                    stagedIndices.data() + lod.indexOffset * indexSize);
     glBindVertexArray(0);
+    CountUpload(vertexBytes + indexBytes);
+
+    residentLod = level;
+    if (level == 0) {
+        std::vector<unsigned char>().swap(stagedVertices);
+        std::vector<unsigned char>().swap(stagedIndices);
+    }
+    return vertexBytes + indexBytes;
+}
+
+size_t _MGL MeshGeometry::refine() {
+    if (residentLod == 0) return 0;
+    return uploadLevel(residentLod - 1);
 }
 
-void _MGL Mesh::Draw(Shader& shader) {
+void _MGL MeshGeometry::setupMeshlets(const Vertex* vertexData,
+                                      size_t vertexCount,
+                                      const unsigned int* indexData) {
+    // 只切分原始网格, 簇是lods[0]中连续的索引范围
+    BuildMeshlets(vertexData, vertexCount, indexData + lods[0].indexOffset,
+                  lods[0].indexCount, meshlets);
+    for (auto& meshlet : meshlets) meshlet.indexOffset += lods[0].indexOffset;
+    meshletBounds = MakeMeshletBounds(meshlets);
+    if (!GLAD_GL_VERSION_4_3 || meshlets.empty()) return;
+
+    glGenBuffers(1, &meshletBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshletBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, meshlets.size() * sizeof(Meshlet),
+                 meshlets.data(), GL_STATIC_DRAW);
+    // 每个簇一条DrawElementsIndirectCommand, 由计算着色器每帧重写
+    glGenBuffers(1, &commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 meshlets.size() * 5 * sizeof(unsigned int), nullptr,
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    CountUpload(meshlets.size() * sizeof(Meshlet));
+}
+
+void _MGL Mesh::bindTextures(Shader& shader) const {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
     unsigned int heightNr = 1;
+    unsigned int firstDiffuse = 0;
+    bool specularInAlpha = false;
+    // 合并了高光的漫反射与高光是同一张纹理, 只绑定一次
+    std::vector<unsigned int> units(textures.size());
+    unsigned int bound = 0;
     for (unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);  // 在绑定之前激活相应的纹理单元
+        units[i] = bound;
+        for (unsigned int j = 0; j < i; ++j) {
+            if (textures[j].id == textures[i].id) {
+                units[i] = units[j];
+                break;
+            }
+        }
+        if (units[i] == bound) {
+            // 在绑定之前激活相应的纹理单元
+            glActiveTexture(GL_TEXTURE0 + bound);
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            ++bound;
+        }
         // 获取纹理序号（diffuse_textureN 中的 N）
         std::string number;
         std::string name = textures[i].type;
@@ -71,15 +382,34 @@ void _MGL Mesh::Draw(Shader& shader) {
         else if (name == "texture_height")
             number = std::to_string(heightNr++);
 
-        shader.setUniform((name + number).c_str(), (int)i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        shader.setUniform((name + number).c_str(), (int)units[i]);
+        if (name == "texture_specular" && specularNr == 2) {
+            specularInAlpha = diffuseNr > 1 && units[i] == units[firstDiffuse];
+        } else if (name == "texture_diffuse" && diffuseNr == 2) {
+            firstDiffuse = i;
+        }
     }
+    shader.setUniform("specularInAlpha", specularInAlpha);
+    shader.setUniform("normalMapped", normalNr > 1);
+
+    geometry->setDecodeUniforms(shader);
+}
 
+void _MGL Mesh::Draw(Shader& shader, unsigned int lod) const {
+    bindTextures(shader);
     // 绘制网格
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()),
-                   GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    geometry->Draw(lod);
+    glActiveTexture(GL_TEXTURE0);
+}
 
+void _MGL Mesh::Draw(Shader& shader, const MeshletDrawList& list) const {
+    bindTextures(shader);
+    geometry->Draw(list);
     glActiveTexture(GL_TEXTURE0);
-}
\ No newline at end of file
+}
+
+void _MGL Mesh::DrawIndirect(Shader& shader) const {
+    bindTextures(shader);
+    geometry->DrawIndirect();
+    glActiveTexture(GL_TEXTURE0);
+}
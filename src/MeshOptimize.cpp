@@ -0,0 +1,403 @@
+﻿#include "header/MeshOptimize.h"
+#include <algorithm>
+#include <cstring>
+#include "header/Memory.h"
+#include "header/MeshProcess.h"
+
+namespace {
+const uint32_t NONE = 0xFFFFFFFFu;
+
+/**
+ * 顶点 -> 三角形的邻接表, CSR格式:
+ * 第v个顶点所在的三角形为 triangles[offsets[v], offsets[v + 1])
+ */
+struct Adjacency {
+    uint32_t* offsets;
+    uint32_t* triangles;
+};
+
+Adjacency buildAdjacency(const unsigned int* indices, size_t count,
+                         size_t vertexCount, mgl::Arena& arena) {
+    Adjacency adjacency;
+    adjacency.offsets = arena.allocateArray<uint32_t>(vertexCount + 1);
+    adjacency.triangles = arena.allocateArray<uint32_t>(count);
+    uint32_t* offsets = adjacency.offsets;
+    std::fill(offsets, offsets + vertexCount + 1, 0u);
+    for (size_t i = 0; i < count; ++i) ++offsets[indices[i] + 1];
+    for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
+    uint32_t* cursor = arena.allocateArray<uint32_t>(vertexCount);
+    std::copy(offsets, offsets + vertexCount, cursor);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t triangle = static_cast<uint32_t>(i / 3);
+        adjacency.triangles[cursor[indices[i]]++] = triangle;
+    }
+    return adjacency;
+}
+
+/**
+ * FIFO缓存: 顶点在time - stamp[v] <= size时仍在缓存中.
+ * 把time推进size + 1即可清空缓存
+ */
+struct FifoCache {
+    uint32_t* stamp;
+    uint32_t time;
+    uint32_t size;
+
+    FifoCache(size_t vertexCount, unsigned int size, mgl::Arena& arena)
+        : stamp(arena.allocateArray<uint32_t>(vertexCount)),
+          time(size + 1),
+          size(size) {
+        std::fill(stamp, stamp + vertexCount, 0u);
+    }
+    // 访问顶点, 未命中时返回1
+    inline unsigned int access(uint32_t v) {
+        if (time - stamp[v] <= size) return 0;
+        stamp[v] = time++;
+        return 1;
+    }
+    inline unsigned int triangle(const unsigned int* t) {
+        return access(t[0]) + access(t[1]) + access(t[2]);
+    }
+    inline void clear() { time += size + 1; }
+};
+
+/**
+ * Tipsify (Sander et al. 2007): 围绕扇心顶点输出其剩余三角形,
+ * 下一个扇心优先选择在缓存中停留最久且输出后仍在缓存中的相邻顶点,
+ * 没有时从死端栈或输入顺序中取
+ */
+void tipsify(const unsigned int* indices, size_t count, size_t vertexCount,
+             unsigned int cacheSize, unsigned int* out, mgl::Arena& arena) {
+    Adjacency adjacency = buildAdjacency(indices, count, vertexCount, arena);
+    // 每个顶点尚未输出的三角形数
+    uint32_t* live = arena.allocateArray<uint32_t>(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+    unsigned char* emitted = arena.allocateArray<unsigned char>(count / 3);
+    std::memset(emitted, 0, count / 3);
+    uint32_t* deadEnd = arena.allocateArray<uint32_t>(count);
+    size_t deadEndTop = 0;
+    mgl::ArenaVector<uint32_t> candidates{mgl::ArenaAllocator<uint32_t>(arena)};
+    FifoCache cache(vertexCount, cacheSize, arena);
+
+    size_t written = 0;
+    size_t cursor = 0;
+    uint32_t fan = NONE;
+    while (cursor < vertexCount && live[cursor] == 0) ++cursor;
+    if (cursor < vertexCount) fan = static_cast<uint32_t>(cursor);
+    while (fan != NONE) {
+        candidates.clear();
+        for (uint32_t k = adjacency.offsets[fan];
+             k < adjacency.offsets[fan + 1]; ++k) {
+            uint32_t t = adjacency.triangles[k];
+            if (emitted[t]) continue;
+            emitted[t] = 1;
+            for (int j = 0; j < 3; ++j) {
+                uint32_t v = indices[3 * t + j];
+                out[written++] = v;
+                deadEnd[deadEndTop++] = v;
+                candidates.push_back(v);
+                --live[v];
+                cache.access(v);
+            }
+        }
+        // 选择输出全部剩余三角形后仍留在缓存中, 且停留最久的顶点
+        fan = NONE;
+        int64_t best = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) continue;
+            int64_t age = cache.time - cache.stamp[v];
+            bool stays = age + 2 * int64_t(live[v]) <= int64_t(cacheSize);
+            int64_t priority = stays ? age : 0;
+            if (priority > best) {
+                best = priority;
+                fan = v;
+            }
+        }
+        while (fan == NONE && deadEndTop > 0) {
+            uint32_t v = deadEnd[--deadEndTop];
+            if (live[v] > 0) fan = v;
+        }
+        while (fan == NONE && cursor < vertexCount) {
+            if (live[cursor] > 0) fan = static_cast<uint32_t>(cursor);
+            ++cursor;
+        }
+    }
+}
+
+/**
+ * 硬边界: 三个顶点都未命中缓存的三角形, 通常是与之前不相连的新区域,
+ * 在此切分不会增加缓存未命中
+ */
+void hardBoundaries(const unsigned int* indices, size_t vertexCount,
+                    size_t triangleCount, unsigned int cacheSize,
+                    mgl::ArenaVector<uint32_t>& hard, mgl::Arena& arena) {
+    FifoCache cache(vertexCount, cacheSize, arena);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (cache.triangle(indices + 3 * t) == 3 || t == 0) {
+            hard.push_back(static_cast<uint32_t>(t));
+        }
+    }
+}
+
+/**
+ * 在每个硬边界簇内寻找软边界: 从簇起点开始清空缓存模拟,
+ * 累计ACMR不高于整簇ACMR的threshold倍时即可在此切分
+ */
+void softBoundaries(const unsigned int* indices, size_t vertexCount,
+                    size_t triangleCount, unsigned int cacheSize,
+                    float threshold,
+                    const mgl::ArenaVector<uint32_t>& hard,
+                    mgl::ArenaVector<uint32_t>& soft, mgl::Arena& arena) {
+    FifoCache cache(vertexCount, cacheSize, arena);
+    for (size_t c = 0; c < hard.size(); ++c) {
+        size_t begin = hard[c];
+        size_t end = c + 1 < hard.size() ? hard[c + 1] : triangleCount;
+        size_t misses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            misses += cache.triangle(indices + 3 * t);
+        }
+        double limit = threshold * double(misses) / double(end - begin);
+
+        soft.push_back(static_cast<uint32_t>(begin));
+        cache.clear();
+        misses = 0;
+        size_t start = begin;
+        for (size_t t = begin; t + 1 < end; ++t) {
+            misses += cache.triangle(indices + 3 * t);
+            if (double(misses) <= limit * double(t + 1 - start)) {
+                start = t + 1;
+                soft.push_back(static_cast<uint32_t>(start));
+                cache.clear();
+                misses = 0;
+            }
+        }
+    }
+}
+
+/**
+ * 按簇的朝外程度排序: 簇的面积加权中心相对网格中心的偏移在簇平均法线上的投影.
+ * 投影越大越可能遮挡其他簇, 越先绘制
+ */
+void sortClusters(unsigned int* indices, size_t triangleCount,
+                  const mgl::Vertex* vertices, size_t vertexCount,
+                  const mgl::ArenaVector<uint32_t>& clusters,
+                  mgl::Arena& arena) {
+    glm::vec3 center(0.0f);
+    for (size_t v = 0; v < vertexCount; ++v) center += vertices[v].Position;
+    center /= float(vertexCount > 0 ? vertexCount : 1);
+
+    const size_t clusterCount = clusters.size();
+    float* keys = arena.allocateArray<float>(clusterCount);
+    uint32_t* order = arena.allocateArray<uint32_t>(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        size_t end = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < end; ++t) {
+            const glm::vec3& p0 = vertices[indices[3 * t]].Position;
+            const glm::vec3& p1 = vertices[indices[3 * t + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[3 * t + 2]].Position;
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float a = glm::length(n);
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+        float len = glm::length(normal);
+        keys[c] = area > 0.0f && len > 0.0f
+                      ? glm::dot(centroid / area - center, normal / len)
+                      : 0.0f;
+        order[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(order, order + clusterCount,
+                     [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    unsigned int* sorted = arena.allocateArray<unsigned int>(triangleCount * 3);
+    size_t written = 0;
+    for (size_t i = 0; i < clusterCount; ++i) {
+        uint32_t c = order[i];
+        size_t end = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+        size_t n = (end - clusters[c]) * 3;
+        std::memcpy(sorted + written, indices + 3 * size_t(clusters[c]),
+                    n * sizeof(unsigned int));
+        written += n;
+    }
+    std::memcpy(indices, sorted, written * sizeof(unsigned int));
+}
+}  // namespace
+
+_MGL VertexCacheStats _MGL AnalyzeVertexCache(const unsigned int* indices,
+                                              size_t count,
+                                              size_t vertexCount,
+                                              unsigned int cacheSize) {
+    VertexCacheStats stats;
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    FifoCache cache(vertexCount, cacheSize, arena);
+    unsigned char* used = arena.allocateArray<unsigned char>(vertexCount);
+    std::memset(used, 0, vertexCount);
+    stats.triangles = count / 3;
+    for (size_t i = 0; i < count; ++i) {
+        stats.misses += cache.access(indices[i]);
+        stats.vertices += used[indices[i]] ? 0 : 1;
+        used[indices[i]] = 1;
+    }
+    return stats;
+}
+
+void _MGL OptimizeVertexCache(unsigned int* indices, size_t count,
+                              size_t vertexCount, unsigned int cacheSize) {
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    unsigned int* out = arena.allocateArray<unsigned int>(count);
+    tipsify(indices, count, vertexCount, cacheSize, out, arena);
+    std::memcpy(indices, out, count * sizeof(unsigned int));
+}
+
+size_t _MGL WeldVertices(MeshData& mesh) {
+    const size_t vertexCount = mesh.vertices.size();
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    uint32_t* group = arena.allocateArray<uint32_t>(vertexCount);
+    size_t groups = GroupVertices(mesh.vertices, sizeof(Vertex), group, arena);
+    if (groups == vertexCount) return 0;
+    // 组号按首次出现的顺序分配, 不大于顶点序号, 可以原地前移
+    for (size_t v = 0; v < vertexCount; ++v) {
+        mesh.vertices[group[v]] = mesh.vertices[v];
+    }
+    mesh.vertices.resize(groups);
+    for (auto& index : mesh.indices) index = group[index];
+    CountCopy(groups * sizeof(Vertex));
+    return vertexCount - groups;
+}
+
+void _MGL OptimizeVertexFetch(MeshData& mesh) {
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    const size_t vertexCount = mesh.vertices.size();
+    uint32_t* remap = arena.allocateArray<uint32_t>(vertexCount);
+    std::fill(remap, remap + vertexCount, NONE);
+    uint32_t next = 0;
+    for (auto& index : mesh.indices) {
+        if (remap[index] == NONE) remap[index] = next++;
+        index = remap[index];
+    }
+    std::vector<Vertex> vertices(next);
+    CountAllocation(next * sizeof(Vertex));
+    CountCopy(next * sizeof(Vertex));
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (remap[v] != NONE) vertices[remap[v]] = mesh.vertices[v];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+_MGL MeshOptimizeStats _MGL OptimizeMesh(MeshData& mesh, float threshold) {
+    MeshOptimizeStats stats;
+    const size_t count = mesh.indices.size();
+    stats.before =
+        AnalyzeVertexCache(mesh.indices.data(), count, mesh.vertices.size());
+    if (count == 0 || count % 3 != 0) {
+        stats.after = stats.before;
+        return stats;
+    }
+    WeldVertices(mesh);
+    const size_t vertexCount = mesh.vertices.size();
+    {
+        Arena& arena = threadArena();
+        ArenaScope scope(arena);
+        unsigned int* indices = mesh.indices.data();
+        unsigned int* out = arena.allocateArray<unsigned int>(count);
+        tipsify(indices, count, vertexCount, VERTEX_CACHE_SIZE, out, arena);
+        std::memcpy(indices, out, count * sizeof(unsigned int));
+
+        ArenaVector<uint32_t> hard{ArenaAllocator<uint32_t>(arena)};
+        hardBoundaries(indices, vertexCount, count / 3, VERTEX_CACHE_SIZE,
+                       hard, arena);
+        ArenaVector<uint32_t> soft{ArenaAllocator<uint32_t>(arena)};
+        softBoundaries(indices, vertexCount, count / 3, VERTEX_CACHE_SIZE,
+                       threshold, hard, soft, arena);
+        sortClusters(indices, count / 3, mesh.vertices.data(), vertexCount,
+                     soft, arena);
+    }
+    OptimizeVertexFetch(mesh);
+    stats.after = AnalyzeVertexCache(mesh.indices.data(), count,
+                                     mesh.vertices.size());
+    return stats;
+}
+
+bool _MGL SplitForShortIndices(const MeshData& mesh,
+                               std::vector<MeshData>& parts) {
+    const size_t limit = MeshGeometry::MaxShortIndexVertices;
+    const size_t count = mesh.indices.size();
+    const size_t vertexCount = mesh.vertices.size();
+    if (vertexCount <= limit || count == 0 || count % 3 != 0) return false;
+
+    // 按三角形顺序贪心切分, 保持缓存优化后的局部性;
+    // remap记录顶点在当前部分中的序号, part记录其所属部分
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    uint32_t* remap = arena.allocateArray<uint32_t>(vertexCount);
+    uint32_t* part = arena.allocateArray<uint32_t>(vertexCount);
+    std::fill(part, part + vertexCount, NONE);
+    // 每个部分的起始三角形
+    ArenaVector<uint32_t> starts{ArenaAllocator<uint32_t>(arena)};
+    uint32_t current = 0;
+    size_t used = 0;
+    size_t total = 0;
+    starts.push_back(0);
+    for (size_t t = 0; t < count / 3; ++t) {
+        const unsigned int* tri = mesh.indices.data() + 3 * t;
+        size_t fresh = 0;
+        for (int k = 0; k < 3; ++k) {
+            bool seen = false;
+            for (int j = 0; j < k; ++j) seen = seen || tri[j] == tri[k];
+            fresh += part[tri[k]] != current && !seen ? 1 : 0;
+        }
+        if (used + fresh > limit) {
+            ++current;
+            total += used;
+            used = 0;
+            starts.push_back(static_cast<uint32_t>(t));
+        }
+        for (int k = 0; k < 3; ++k) {
+            if (part[tri[k]] != current) {
+                part[tri[k]] = current;
+                remap[tri[k]] = static_cast<uint32_t>(used++);
+            }
+        }
+    }
+    total += used;
+    // 重复的边界顶点比节省的索引字节更多时不切分
+    size_t duplicated = total > vertexCount ? total - vertexCount : 0;
+    if (duplicated * sizeof(Vertex) >=
+        count * (sizeof(unsigned int) - sizeof(uint16_t))) {
+        return false;
+    }
+
+    std::fill(part, part + vertexCount, NONE);
+    for (size_t p = 0; p < starts.size(); ++p) {
+        size_t begin = size_t(starts[p]) * 3;
+        size_t end = p + 1 < starts.size() ? size_t(starts[p + 1]) * 3 : count;
+        MeshData out;
+        out.textures = mesh.textures;
+        out.indices.resize(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            unsigned int v = mesh.indices[i];
+            if (part[v] != p) {
+                part[v] = static_cast<uint32_t>(p);
+                remap[v] = static_cast<uint32_t>(out.vertices.size());
+                out.vertices.push_back(mesh.vertices[v]);
+            }
+            out.indices[i - begin] = remap[v];
+        }
+        CountAllocation(out.vertices.size() * sizeof(Vertex) +
+                        out.indices.size() * sizeof(unsigned int));
+        CountCopy(out.vertices.size() * sizeof(Vertex) +
+                  out.indices.size() * sizeof(unsigned int));
+        parts.push_back(std::move(out));
+    }
+    return true;
+}
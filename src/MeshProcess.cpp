@@ -0,0 +1,536 @@
+﻿#include "header/MeshProcess.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "header/Hash.h"
+#include "header/Memory.h"
+#include "header/ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MGL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+// 交错写入依赖的顶点布局
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float) &&
+                  sizeof(glm::vec2) == 2 * sizeof(float),
+              "glm vectors must be tightly packed");
+static_assert(offsetof(mgl::Vertex, Normal) == 12 &&
+                  offsetof(mgl::Vertex, TexCoords) == 24 &&
+                  offsetof(mgl::Vertex, Tangent) == 32 &&
+                  offsetof(mgl::Vertex, Bitangent) == 44 &&
+                  offsetof(mgl::Vertex, m_BoneIDs) == 56,
+              "unexpected Vertex layout");
+
+inline void copy3(float* dst, const float* src, size_t i) {
+    if (src) {
+        std::memcpy(dst, src + 3 * i, 3 * sizeof(float));
+    } else {
+        dst[0] = dst[1] = dst[2] = 0.0f;
+    }
+}
+
+// 标量路径, 也用于最后一个元素以避免越界读取
+void interleaveScalar(const mgl::VertexStreams& s, size_t i, float* d) {
+    copy3(d + 0, s.positions, i);
+    copy3(d + 3, s.normals, i);
+    if (s.texCoords) {
+        d[6] = s.texCoords[s.texCoordStride * i];
+        d[7] = s.texCoords[s.texCoordStride * i + 1];
+    } else {
+        d[6] = d[7] = 0.0f;
+    }
+    copy3(d + 8, s.tangents, i);
+    copy3(d + 11, s.bitangents, i);
+}
+
+#ifdef MGL_SSE2
+// 读取16字节, 第4个分量属于下一个元素, 会被后续写入覆盖
+inline __m128 load4(const float* src, size_t offset) {
+    return src ? _mm_loadu_ps(src + offset) : _mm_setzero_ps();
+}
+#endif
+
+// 每个并行块处理的三角形或顶点数量
+const size_t GRAIN = 8 * 1024;
+const uint32_t EMPTY = 0xFFFFFFFFu;
+
+// 顶点前部字节的长度: 位置
+const size_t POSITION_KEY = offsetof(mgl::Vertex, Normal);
+// 与Assimp的CalcTangentSpace相同的平滑条件: 位置距离小于包围盒对角线的
+// POSITION_EPSILON倍, 法线点积不小于NORMAL_LIMIT,
+// 切线与副切线都与首个角相差不超过45度
+const float POSITION_EPSILON = 1e-4f;
+const float NORMAL_LIMIT = 0.9999f;
+const float SMOOTH_LIMIT = 0.70710678f;
+
+/**
+ * 组 -> 三角形角(索引数组下标)的邻接表, CSR格式:
+ * 第g组的角为 corners[offsets[g], offsets[g + 1])
+ */
+void buildAdjacency(const std::vector<unsigned int>& indices,
+                    const uint32_t* group, size_t groups, mgl::Arena& arena,
+                    uint32_t*& offsets, uint32_t*& corners) {
+    size_t count = indices.size() / 3 * 3;
+    offsets = arena.allocateArray<uint32_t>(groups + 1);
+    corners = arena.allocateArray<uint32_t>(count);
+    std::fill(offsets, offsets + groups + 1, 0u);
+    for (size_t c = 0; c < count; ++c) ++offsets[group[indices[c]] + 1];
+    for (size_t g = 0; g < groups; ++g) offsets[g + 1] += offsets[g];
+    uint32_t* cursor = arena.allocateArray<uint32_t>(groups);
+    std::copy(offsets, offsets + groups, cursor);
+    for (size_t c = 0; c < count; ++c) {
+        corners[cursor[group[indices[c]]]++] = static_cast<uint32_t>(c);
+    }
+}
+
+// 与n正交的任意单位向量
+glm::vec3 anyOrthogonal(const glm::vec3& n) {
+    glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                           : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 t = axis - n * glm::dot(n, axis);
+    float len = glm::length(t);
+    return len > 0.0f ? t / len : glm::vec3(1.0f, 0.0f, 0.0f);
+}
+
+inline bool finiteUnit(const glm::vec3& v) {
+    float len = glm::dot(v, v);
+    // NaN与无穷在比较中均为false
+    return len > 1e-12f && len < 1e12f;
+}
+
+inline glm::vec3 normalizeSafe(const glm::vec3& v) {
+    float len = glm::length(v);
+    return len > 0.0f ? v / len : glm::vec3(0.0f);
+}
+
+inline bool isSpecial(const glm::vec3& v) {
+    return !std::isfinite(v.x) || !std::isfinite(v.y) || !std::isfinite(v.z);
+}
+
+// 网格坐标, 用于按位置查找相近的顶点
+struct Cell {
+    int64_t x, y, z;
+    uint32_t index;
+};
+
+inline bool cellLess(const Cell& a, const Cell& b) {
+    return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+}
+
+/**
+ * 找出距离小于epsilon的全部位置对, 每对只出现一次且不含自身.
+ * 按epsilon大小的网格划分, 每个位置只与相邻27个格子中的位置比较
+ */
+std::vector<std::pair<uint32_t, uint32_t>> nearPairs(
+    const glm::vec3* positions, size_t count, float epsilon) {
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    if (epsilon <= 0.0f) return pairs;
+    std::vector<Cell> cells(count);
+    double scale = 1.0 / epsilon;
+    for (size_t i = 0; i < count; ++i) {
+        const glm::vec3& p = positions[i];
+        cells[i] = {int64_t(std::floor(p.x * scale)),
+                    int64_t(std::floor(p.y * scale)),
+                    int64_t(std::floor(p.z * scale)), uint32_t(i)};
+    }
+    std::sort(cells.begin(), cells.end(), cellLess);
+    float epsilon2 = epsilon * epsilon;
+    for (const Cell& cell : cells) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dz = -1; dz <= 1; ++dz) {
+                    Cell key = {cell.x + dx, cell.y + dy, cell.z + dz, 0};
+                    auto range = std::equal_range(cells.begin(), cells.end(),
+                                                  key, cellLess);
+                    for (auto it = range.first; it != range.second; ++it) {
+                        if (it->index <= cell.index) continue;
+                        glm::vec3 d =
+                            positions[it->index] - positions[cell.index];
+                        if (glm::dot(d, d) < epsilon2) {
+                            pairs.emplace_back(cell.index, it->index);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return pairs;
+}
+
+/**
+ * 由相近的位置对建立邻接表(CSR格式, 含自身): 第g个位置的邻居为
+ * neighbours[offsets[g], offsets[g + 1]). 同时按连通性划分分量,
+ * 返回分量数量, 分量编号按首次出现的顺序分配
+ */
+size_t connectPositions(const std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+                        size_t count, mgl::Arena& arena, uint32_t*& offsets,
+                        uint32_t*& neighbours, uint32_t* component) {
+    offsets = arena.allocateArray<uint32_t>(count + 1);
+    neighbours = arena.allocateArray<uint32_t>(count + 2 * pairs.size());
+    std::fill(offsets, offsets + count + 1, 1u);
+    offsets[0] = 0;
+    for (auto& pair : pairs) {
+        ++offsets[pair.first + 1];
+        ++offsets[pair.second + 1];
+    }
+    for (size_t g = 0; g < count; ++g) offsets[g + 1] += offsets[g];
+    uint32_t* cursor = arena.allocateArray<uint32_t>(count);
+    for (size_t g = 0; g < count; ++g) {
+        neighbours[offsets[g]] = static_cast<uint32_t>(g);
+        cursor[g] = offsets[g] + 1;
+    }
+    // 并查集
+    uint32_t* parent = arena.allocateArray<uint32_t>(count);
+    for (size_t g = 0; g < count; ++g) parent[g] = static_cast<uint32_t>(g);
+    auto find = [parent](uint32_t x) {
+        while (parent[x] != x) x = parent[x] = parent[parent[x]];
+        return x;
+    };
+    for (auto& pair : pairs) {
+        neighbours[cursor[pair.first]++] = pair.second;
+        neighbours[cursor[pair.second]++] = pair.first;
+        uint32_t a = find(pair.first);
+        uint32_t b = find(pair.second);
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+    }
+    // 根总是分量中最小的位置, 先于其余成员出现
+    size_t components = 0;
+    for (size_t g = 0; g < count; ++g) {
+        uint32_t root = find(static_cast<uint32_t>(g));
+        component[g] = root == g ? static_cast<uint32_t>(components++)
+                                 : component[root];
+    }
+    return components;
+}
+}  // namespace
+
+void _MGL InterleaveVertices(const VertexStreams& streams, size_t first,
+                             size_t count, Vertex* out) {
+    CountCopy(count * sizeof(Vertex));
+    size_t i = 0;
+#ifdef MGL_SSE2
+    // 按字段顺序写入, 每次多写的一个float被下一字段覆盖;
+    // 副切线之后是骨骼数据, 分两次写入避免越界
+    for (; count > 0 && i < count - 1; ++i) {
+        size_t e = first + i;
+        float* d = reinterpret_cast<float*>(out + i);
+        _mm_storeu_ps(d + 0, load4(streams.positions, 3 * e));
+        _mm_storeu_ps(d + 3, load4(streams.normals, 3 * e));
+        _mm_storeu_ps(d + 6,
+                      load4(streams.texCoords, streams.texCoordStride * e));
+        _mm_storeu_ps(d + 8, load4(streams.tangents, 3 * e));
+        __m128 b = load4(streams.bitangents, 3 * e);
+        _mm_storel_pi(reinterpret_cast<__m64*>(d + 11), b);
+        _mm_store_ss(d + 13, _mm_movehl_ps(b, b));
+        std::memset(out[i].m_BoneIDs, 0,
+                    sizeof(Vertex) - offsetof(Vertex, m_BoneIDs));
+    }
+#endif
+    for (; i < count; ++i) {
+        interleaveScalar(streams, first + i, reinterpret_cast<float*>(out + i));
+        std::memset(out[i].m_BoneIDs, 0,
+                    sizeof(Vertex) - offsetof(Vertex, m_BoneIDs));
+    }
+}
+
+size_t _MGL GroupVertices(const std::vector<Vertex>& vertices,
+                          size_t keyBytes, uint32_t* group, Arena& arena) {
+    size_t capacity = 16;
+    while (capacity < vertices.size() * 2) capacity <<= 1;
+    uint32_t* table = arena.allocateArray<uint32_t>(capacity);
+    uint32_t* representative = arena.allocateArray<uint32_t>(vertices.size());
+    std::fill(table, table + capacity, EMPTY);
+    size_t mask = capacity - 1;
+    size_t groups = 0;
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        const void* key = &vertices[v];
+        size_t slot = size_t(HashBytes(key, keyBytes)) & mask;
+        for (;; slot = (slot + 1) & mask) {
+            uint32_t g = table[slot];
+            if (g == EMPTY) {
+                table[slot] = static_cast<uint32_t>(groups);
+                representative[groups] = static_cast<uint32_t>(v);
+                group[v] = static_cast<uint32_t>(groups++);
+                break;
+            }
+            if (std::memcmp(&vertices[representative[g]], key, keyBytes) ==
+                0) {
+                group[v] = g;
+                break;
+            }
+        }
+    }
+    return groups;
+}
+
+_MGL BoundingSphere _MGL ComputeBounds(const Vertex* vertices,
+                                       size_t count) {
+    BoundingSphere bounds;
+    if (count == 0) return bounds;
+    glm::vec3 min = vertices[0].Position;
+    glm::vec3 max = min;
+    for (size_t i = 1; i < count; ++i) {
+        min = glm::min(min, vertices[i].Position);
+        max = glm::max(max, vertices[i].Position);
+    }
+    bounds.center = (min + max) * 0.5f;
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 d = vertices[i].Position - bounds.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    bounds.radius = std::sqrt(radius2);
+    return bounds;
+}
+
+bool _MGL HasValidNormals(const MeshData& mesh) {
+    for (auto& v : mesh.vertices) {
+        if (!finiteUnit(v.Normal)) return false;
+    }
+    return true;
+}
+
+bool _MGL HasValidTangents(const MeshData& mesh) {
+    for (auto& v : mesh.vertices) {
+        if (!finiteUnit(v.Tangent) || !finiteUnit(v.Bitangent)) return false;
+    }
+    return true;
+}
+
+void _MGL GenerateSmoothNormals(MeshData& mesh) {
+    const size_t vertexCount = mesh.vertices.size();
+    const size_t triangles = mesh.indices.size() / 3;
+    if (vertexCount == 0) return;
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    Vertex* vertices = mesh.vertices.data();
+    const unsigned int* indices = mesh.indices.data();
+
+    uint32_t* group = arena.allocateArray<uint32_t>(vertexCount);
+    size_t groups = GroupVertices(mesh.vertices, POSITION_KEY, group, arena);
+    uint32_t* offsets;
+    uint32_t* corners;
+    buildAdjacency(mesh.indices, group, groups, arena, offsets, corners);
+
+    // 面法线, 叉积的长度为面积的两倍, 累加即按面积加权
+    glm::vec3* faces = arena.allocateArray<glm::vec3>(triangles);
+    ParallelFor(triangles, GRAIN, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            const unsigned int* i = indices + 3 * t;
+            faces[t] =
+                glm::cross(vertices[i[1]].Position - vertices[i[0]].Position,
+                           vertices[i[2]].Position - vertices[i[0]].Position);
+        }
+    });
+    // 每组按固定顺序累加相邻面, 结果与线程数无关
+    glm::vec3* normals = arena.allocateArray<glm::vec3>(groups);
+    ParallelFor(groups, GRAIN, [&](size_t first, size_t last) {
+        for (size_t g = first; g < last; ++g) {
+            glm::vec3 n(0.0f);
+            for (uint32_t c = offsets[g]; c < offsets[g + 1]; ++c) {
+                n += faces[corners[c] / 3];
+            }
+            float len = glm::length(n);
+            normals[g] = len > 0.0f ? n / len : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    });
+    ParallelFor(vertexCount, GRAIN, [&](size_t first, size_t last) {
+        for (size_t v = first; v < last; ++v) {
+            vertices[v].Normal = normals[group[v]];
+        }
+    });
+}
+
+void _MGL GenerateTangents(MeshData& mesh) {
+    const size_t vertexCount = mesh.vertices.size();
+    const size_t triangles = mesh.indices.size() / 3;
+    if (vertexCount == 0) return;
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    Vertex* vertices = mesh.vertices.data();
+    const unsigned int* indices = mesh.indices.data();
+
+    // 每个角的面切线空间投影到该角法线所在平面后归一化,
+    // 相当于Assimp对未合并顶点逐面计算的结果
+    glm::vec3* cornerTangents = arena.allocateArray<glm::vec3>(triangles * 3);
+    glm::vec3* cornerBitangents = arena.allocateArray<glm::vec3>(triangles * 3);
+    ParallelFor(triangles, GRAIN, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            const unsigned int* i = indices + 3 * t;
+            const Vertex* v[3] = {&vertices[i[0]], &vertices[i[1]],
+                                  &vertices[i[2]]};
+            glm::vec3 e1 = v[1]->Position - v[0]->Position;
+            glm::vec3 e2 = v[2]->Position - v[0]->Position;
+            float s1 = v[1]->TexCoords.x - v[0]->TexCoords.x;
+            float t1 = v[1]->TexCoords.y - v[0]->TexCoords.y;
+            float s2 = v[2]->TexCoords.x - v[0]->TexCoords.x;
+            float t2 = v[2]->TexCoords.y - v[0]->TexCoords.y;
+            // Assimp在翻转V之前计算, 翻转后的det与其方向修正同号
+            float sign = s1 * t2 - s2 * t1 < 0.0f ? -1.0f : 1.0f;
+            if (s1 * t2 == t1 * s2) {
+                // 纹理坐标退化时使用默认方向(翻转前为 U=(0,1), V=(1,0))
+                s1 = 0.0f;
+                t1 = -1.0f;
+                s2 = 1.0f;
+                t2 = 0.0f;
+            }
+            glm::vec3 tangent = (e1 * t2 - e2 * t1) * sign;
+            glm::vec3 bitangent = (e2 * s1 - e1 * s2) * sign;
+            for (int k = 0; k < 3; ++k) {
+                const glm::vec3& n = v[k]->Normal;
+                glm::vec3 lt = tangent - n * glm::dot(n, tangent);
+                glm::vec3 lb = bitangent - n * glm::dot(n, bitangent) -
+                               lt * glm::dot(lt, bitangent);
+                lt = normalizeSafe(lt);
+                lb = normalizeSafe(lb);
+                // 只有一个无效时由法线与另一个重建
+                bool badTangent = isSpecial(lt);
+                if (badTangent != isSpecial(lb)) {
+                    if (badTangent) {
+                        lt = normalizeSafe(glm::cross(n, lb));
+                    } else {
+                        lb = normalizeSafe(glm::cross(lt, n));
+                    }
+                }
+                cornerTangents[3 * t + k] = lt;
+                cornerBitangents[3 * t + k] = lb;
+            }
+        }
+    });
+
+    // 位置相近的角才可能合并. 按位置的连通分量划分后各分量互不影响,
+    // 分量内按角的顺序贪心合并, 与Assimp按顶点顺序处理的结果相同
+    uint32_t* group = arena.allocateArray<uint32_t>(vertexCount);
+    size_t groups = GroupVertices(mesh.vertices, POSITION_KEY, group, arena);
+    glm::vec3* positions = arena.allocateArray<glm::vec3>(groups);
+    glm::vec3 min = vertices[0].Position;
+    glm::vec3 max = min;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        positions[group[v]] = vertices[v].Position;
+        min = glm::min(min, vertices[v].Position);
+        max = glm::max(max, vertices[v].Position);
+    }
+    float epsilon = glm::length(max - min) * POSITION_EPSILON;
+    uint32_t* nearOffsets;
+    uint32_t* nearby;
+    uint32_t* component = arena.allocateArray<uint32_t>(groups);
+    size_t components =
+        connectPositions(nearPairs(positions, groups, epsilon), groups, arena,
+                         nearOffsets, nearby, component);
+    uint32_t* groupOffsets;
+    uint32_t* groupCorners;
+    buildAdjacency(mesh.indices, group, groups, arena, groupOffsets,
+                   groupCorners);
+    uint32_t* vertexComponent = arena.allocateArray<uint32_t>(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vertexComponent[v] = component[group[v]];
+    }
+    uint32_t* offsets;
+    uint32_t* corners;
+    buildAdjacency(mesh.indices, vertexComponent, components, arena, offsets,
+                   corners);
+
+    // 每个角所属的合并组以首个角标记, 未合并时为EMPTY
+    uint32_t* cluster = arena.allocateArray<uint32_t>(triangles * 3);
+    std::fill(cluster, cluster + triangles * 3, EMPTY);
+    ParallelFor(components, GRAIN, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c) {
+            for (uint32_t i = offsets[c]; i < offsets[c + 1]; ++i) {
+                uint32_t a = corners[i];
+                if (cluster[a] != EMPTY) continue;
+                uint32_t g = group[indices[a]];
+                const glm::vec3& n = vertices[indices[a]].Normal;
+                const glm::vec3 t0 = cornerTangents[a];
+                const glm::vec3 b0 = cornerBitangents[a];
+                // 与Assimp一样, 首个角在候选中会再计入一次
+                glm::vec3 t = t0;
+                glm::vec3 b = b0;
+                for (uint32_t j = nearOffsets[g]; j < nearOffsets[g + 1]; ++j) {
+                    uint32_t h = nearby[j];
+                    for (uint32_t k = groupOffsets[h]; k < groupOffsets[h + 1];
+                         ++k) {
+                        uint32_t x = groupCorners[k];
+                        if (cluster[x] != EMPTY) continue;
+                        if (glm::dot(vertices[indices[x]].Normal, n) <
+                                NORMAL_LIMIT ||
+                            glm::dot(cornerTangents[x], t0) < SMOOTH_LIMIT ||
+                            glm::dot(cornerBitangents[x], b0) < SMOOTH_LIMIT) {
+                            continue;
+                        }
+                        t += cornerTangents[x];
+                        b += cornerBitangents[x];
+                        cluster[x] = a;
+                    }
+                }
+                cluster[a] = a;
+                t = normalizeSafe(t);
+                if (t == glm::vec3(0.0f)) t = anyOrthogonal(n);
+                b = normalizeSafe(b);
+                if (b == glm::vec3(0.0f)) b = glm::cross(n, t);
+                for (uint32_t j = nearOffsets[g]; j < nearOffsets[g + 1]; ++j) {
+                    uint32_t h = nearby[j];
+                    for (uint32_t k = groupOffsets[h]; k < groupOffsets[h + 1];
+                         ++k) {
+                        uint32_t x = groupCorners[k];
+                        if (cluster[x] != a) continue;
+                        cornerTangents[x] = t;
+                        cornerBitangents[x] = b;
+                    }
+                }
+            }
+        }
+    });
+    // 被多个角共用的顶点取第一个角的结果; 其余角合并到不同组时
+    // 复制顶点, 与Assimp对未合并顶点的结果一致
+    uint32_t* firstCorner = arena.allocateArray<uint32_t>(vertexCount);
+    std::fill(firstCorner, firstCorner + vertexCount, EMPTY);
+    for (size_t c = triangles * 3; c-- > 0;) {
+        firstCorner[indices[c]] = static_cast<uint32_t>(c);
+    }
+    ParallelFor(vertexCount, GRAIN, [&](size_t first, size_t last) {
+        for (size_t v = first; v < last; ++v) {
+            uint32_t c = firstCorner[v];
+            if (c == EMPTY) {
+                vertices[v].Tangent = anyOrthogonal(vertices[v].Normal);
+                vertices[v].Bitangent =
+                    glm::cross(vertices[v].Normal, vertices[v].Tangent);
+            } else {
+                vertices[v].Tangent = cornerTangents[c];
+                vertices[v].Bitangent = cornerBitangents[c];
+            }
+        }
+    });
+    // 每个顶点的副本组成链表, 记录副本所属的合并组
+    uint32_t* copies = arena.allocateArray<uint32_t>(vertexCount);
+    std::fill(copies, copies + vertexCount, EMPTY);
+    std::vector<uint32_t> next;
+    std::vector<uint32_t> copyCluster;
+    std::vector<Vertex> added;
+    for (size_t c = 0; c < triangles * 3; ++c) {
+        unsigned int v = mesh.indices[c];
+        if (cluster[c] == cluster[firstCorner[v]]) continue;
+        uint32_t copy = copies[v];
+        while (copy != EMPTY && copyCluster[copy] != cluster[c]) {
+            copy = next[copy];
+        }
+        if (copy == EMPTY) {
+            copy = static_cast<uint32_t>(added.size());
+            Vertex vertex = vertices[v];
+            vertex.Tangent = cornerTangents[c];
+            vertex.Bitangent = cornerBitangents[c];
+            added.push_back(vertex);
+            copyCluster.push_back(cluster[c]);
+            next.push_back(copies[v]);
+            copies[v] = copy;
+        }
+        mesh.indices[c] = static_cast<unsigned int>(vertexCount + copy);
+    }
+    mesh.vertices.insert(mesh.vertices.end(), added.begin(), added.end());
+}
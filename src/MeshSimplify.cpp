@@ -0,0 +1,459 @@
+﻿#include "header/MeshSimplify.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "header/Memory.h"
+#include "header/MeshOptimize.h"
+#include "header/MeshProcess.h"
+
+namespace {
+const uint32_t NONE = 0xFFFFFFFFu;
+
+/**
+ * 对称4x4矩阵表示的平面距离平方和, 按三角形面积加权.
+ * eval返回加权平均的距离平方
+ */
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0, a33 = 0;
+    double weight = 0;
+
+    void addTriangle(const glm::vec3& p0, const glm::vec3& p1,
+                     const glm::vec3& p2) {
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        double length = std::sqrt(double(n.x) * n.x + double(n.y) * n.y +
+                                  double(n.z) * n.z);
+        if (length == 0.0) return;
+        double x = n.x / length;
+        double y = n.y / length;
+        double z = n.z / length;
+        double d = -(x * p0.x + y * p0.y + z * p0.z);
+        double w = length * 0.5;
+        a00 += w * x * x;
+        a01 += w * x * y;
+        a02 += w * x * z;
+        a03 += w * x * d;
+        a11 += w * y * y;
+        a12 += w * y * z;
+        a13 += w * y * d;
+        a22 += w * z * z;
+        a23 += w * z * d;
+        a33 += w * d * d;
+        weight += w;
+    }
+
+    Quadric& operator+=(const Quadric& q) {
+        a00 += q.a00;
+        a01 += q.a01;
+        a02 += q.a02;
+        a03 += q.a03;
+        a11 += q.a11;
+        a12 += q.a12;
+        a13 += q.a13;
+        a22 += q.a22;
+        a23 += q.a23;
+        a33 += q.a33;
+        weight += q.weight;
+        return *this;
+    }
+
+    double eval(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double r = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z +
+                   2 * a03 * x + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y +
+                   a22 * z * z + 2 * a23 * z + a33;
+        return weight > 0 ? std::fabs(r) / weight : 0.0;
+    }
+};
+
+// 一次候选折叠: 把from组的顶点移到to组的位置
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+inline uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return (uint64_t(a) << 32) | b;
+}
+
+/**
+ * 边折叠简化器. 位置相同的顶点组成一组, 折叠以组为单位进行;
+ * 每轮收集所有边的最小代价折叠, 按代价从小到大执行,
+ * 同一轮内一个组最多参与一次折叠. 状态在多次run之间保留, 用于生成LOD链
+ */
+class Simplifier {
+  public:
+    Simplifier(const std::vector<mgl::Vertex>& vertices,
+               const unsigned int* indices, size_t count, mgl::Arena& arena)
+        : vertices(vertices),
+          current(indices, indices + count),
+          arena(arena),
+          maxCost(0.0) {
+        size_t vertexCount = vertices.size();
+        group = arena.allocateArray<uint32_t>(vertexCount);
+        groupCount = mgl::GroupVertices(vertices, sizeof(glm::vec3), group,
+                                        arena);
+        // 组 -> 组内顶点, CSR格式
+        wedgeOffsets = arena.allocateArray<uint32_t>(groupCount + 1);
+        wedges = arena.allocateArray<uint32_t>(vertexCount);
+        std::fill(wedgeOffsets, wedgeOffsets + groupCount + 1, 0u);
+        for (size_t v = 0; v < vertexCount; ++v) ++wedgeOffsets[group[v] + 1];
+        for (size_t g = 0; g < groupCount; ++g) {
+            wedgeOffsets[g + 1] += wedgeOffsets[g];
+        }
+        uint32_t* cursor = arena.allocateArray<uint32_t>(groupCount);
+        std::copy(wedgeOffsets, wedgeOffsets + groupCount, cursor);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            wedges[cursor[group[v]]++] = static_cast<uint32_t>(v);
+        }
+
+        remap = arena.allocateArray<uint32_t>(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            remap[v] = static_cast<uint32_t>(v);
+        }
+        quadrics = arena.allocateArray<Quadric>(groupCount);
+        std::fill(quadrics, quadrics + groupCount, Quadric());
+        for (size_t i = 0; i + 2 < count; i += 3) {
+            Quadric q;
+            q.addTriangle(vertices[indices[i]].Position,
+                          vertices[indices[i + 1]].Position,
+                          vertices[indices[i + 2]].Position);
+            for (int k = 0; k < 3; ++k) quadrics[group[indices[i + k]]] += q;
+        }
+        locked = arena.allocateArray<unsigned char>(groupCount);
+        std::memset(locked, 0, groupCount);
+        lockBoundaries();
+        removeDegenerate();
+    }
+
+    /// 简化到不超过targetCount个索引, 或下一次折叠的误差超过maxError
+    void run(size_t targetCount, float maxError) {
+        double limit = double(maxError) * maxError;
+        while (current.size() > targetCount) {
+            mgl::ArenaScope scope(arena);
+            if (pass(targetCount, limit) == 0) break;
+        }
+    }
+
+    inline const std::vector<unsigned int>& indices() const { return current; }
+    inline float error() const { return float(std::sqrt(maxCost)); }
+
+  private:
+    const std::vector<mgl::Vertex>& vertices;
+    std::vector<unsigned int> current;
+    mgl::Arena& arena;
+    size_t groupCount;
+    // 顶点 -> 位置组
+    uint32_t* group;
+    // 组 -> 组内顶点
+    uint32_t* wedgeOffsets;
+    uint32_t* wedges;
+    // 顶点 -> 折叠后的顶点
+    uint32_t* remap;
+    Quadric* quadrics;
+    // 不能移动的组: 开放边界与非流形边的端点
+    unsigned char* locked;
+    // 已执行折叠的最大代价(距离平方)
+    double maxCost;
+
+    // 本轮使用的组 -> 三角形邻接表与折叠目标
+    uint32_t* adjacencyOffsets;
+    uint32_t* adjacencyTriangles;
+    uint32_t* collapsedTo;
+
+    inline const glm::vec3& position(uint32_t g) const {
+        return vertices[wedges[wedgeOffsets[g]]].Position;
+    }
+    inline uint32_t resolve(unsigned int vertex) const {
+        return collapsedTo[group[vertex]];
+    }
+
+    // 只有一侧三角形的边为开放边界, 同向出现多次的边为非流形边
+    void lockBoundaries() {
+        mgl::ArenaScope scope(arena);
+        size_t count = current.size();
+        uint64_t* edges = arena.allocateArray<uint64_t>(count);
+        size_t edgeCount = 0;
+        for (size_t i = 0; i < count; i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = group[current[i + k]];
+                uint32_t b = group[current[i + (k + 1) % 3]];
+                if (a != b) edges[edgeCount++] = edgeKey(a, b);
+            }
+        }
+        std::sort(edges, edges + edgeCount);
+        for (size_t i = 0; i < edgeCount; ++i) {
+            uint32_t a = uint32_t(edges[i] >> 32);
+            uint32_t b = uint32_t(edges[i]);
+            bool repeated = (i > 0 && edges[i - 1] == edges[i]) ||
+                            (i + 1 < edgeCount && edges[i + 1] == edges[i]);
+            bool open = !std::binary_search(edges, edges + edgeCount,
+                                            edgeKey(b, a));
+            if (repeated || open) locked[a] = locked[b] = 1;
+        }
+    }
+
+    // 移除有两个角位于同一组的三角形
+    size_t removeDegenerate() {
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < current.size(); i += 3) {
+            unsigned int a = current[i];
+            unsigned int b = current[i + 1];
+            unsigned int c = current[i + 2];
+            uint32_t ga = group[a];
+            uint32_t gb = group[b];
+            uint32_t gc = group[c];
+            if (ga == gb || gb == gc || ga == gc) continue;
+            current[write++] = a;
+            current[write++] = b;
+            current[write++] = c;
+        }
+        size_t removed = current.size() - write;
+        current.resize(write);
+        return removed;
+    }
+
+    void buildAdjacency() {
+        size_t count = current.size();
+        adjacencyOffsets = arena.allocateArray<uint32_t>(groupCount + 1);
+        adjacencyTriangles = arena.allocateArray<uint32_t>(count);
+        std::fill(adjacencyOffsets, adjacencyOffsets + groupCount + 1, 0u);
+        for (size_t i = 0; i < count; ++i) {
+            ++adjacencyOffsets[group[current[i]] + 1];
+        }
+        for (size_t g = 0; g < groupCount; ++g) {
+            adjacencyOffsets[g + 1] += adjacencyOffsets[g];
+        }
+        uint32_t* cursor = arena.allocateArray<uint32_t>(groupCount);
+        std::copy(adjacencyOffsets, adjacencyOffsets + groupCount, cursor);
+        for (size_t i = 0; i < count; ++i) {
+            adjacencyTriangles[cursor[group[current[i]]]++] =
+                static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    /**
+     * from组的每个顶点都要找到to组中与它共边的顶点, 折叠后沿用其属性.
+     * 被引用却找不到对应顶点时(如跨过纹理接缝)不能折叠
+     */
+    bool mapWedges(uint32_t from, uint32_t to, uint32_t* mapped) const {
+        for (uint32_t w = wedgeOffsets[from]; w < wedgeOffsets[from + 1];
+             ++w) {
+            uint32_t v = wedges[w];
+            uint32_t target = NONE;
+            bool referenced = false;
+            for (uint32_t a = adjacencyOffsets[from];
+                 a < adjacencyOffsets[from + 1] && target == NONE; ++a) {
+                const unsigned int* t = &current[adjacencyTriangles[a] * 3];
+                if (t[0] != v && t[1] != v && t[2] != v) continue;
+                referenced = true;
+                for (int k = 0; k < 3; ++k) {
+                    if (group[t[k]] == to) target = t[k];
+                }
+            }
+            if (target == NONE) {
+                if (referenced) return false;
+                target = wedges[wedgeOffsets[to]];
+            }
+            mapped[w - wedgeOffsets[from]] = target;
+        }
+        return true;
+    }
+
+    // 折叠后from周围是否有三角形翻转
+    bool flips(uint32_t from, uint32_t to) const {
+        const glm::vec3& target = position(to);
+        for (uint32_t a = adjacencyOffsets[from];
+             a < adjacencyOffsets[from + 1]; ++a) {
+            const unsigned int* t = &current[adjacencyTriangles[a] * 3];
+            uint32_t g[3] = {resolve(t[0]), resolve(t[1]), resolve(t[2])};
+            if (g[0] == g[1] || g[1] == g[2] || g[0] == g[2]) continue;
+            if (g[0] == to || g[1] == to || g[2] == to) continue;
+            glm::vec3 p[3] = {position(g[0]), position(g[1]), position(g[2])};
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            for (int k = 0; k < 3; ++k) {
+                if (g[k] == from) p[k] = target;
+            }
+            glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+            if (glm::dot(before, after) <= 0.0f) return true;
+        }
+        return false;
+    }
+
+    // 执行一轮折叠, 返回执行的次数
+    size_t pass(size_t targetCount, double limit) {
+        buildAdjacency();
+        collapsedTo = arena.allocateArray<uint32_t>(groupCount);
+        for (size_t g = 0; g < groupCount; ++g) {
+            collapsedTo[g] = static_cast<uint32_t>(g);
+        }
+        size_t maxWedges = 0;
+        for (size_t g = 0; g < groupCount; ++g) {
+            maxWedges = std::max<size_t>(maxWedges,
+                                         wedgeOffsets[g + 1] - wedgeOffsets[g]);
+        }
+        uint32_t* mapped = arena.allocateArray<uint32_t>(maxWedges);
+
+        // 收集不重复的边
+        size_t count = current.size();
+        uint64_t* edges = arena.allocateArray<uint64_t>(count);
+        for (size_t i = 0; i < count; i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = group[current[i + k]];
+                uint32_t b = group[current[i + (k + 1) % 3]];
+                edges[i + k] = edgeKey(std::min(a, b), std::max(a, b));
+            }
+        }
+        std::sort(edges, edges + count);
+        size_t edgeCount = std::unique(edges, edges + count) - edges;
+
+        Collapse* collapses = arena.allocateArray<Collapse>(edgeCount);
+        size_t collapseCount = 0;
+        for (size_t i = 0; i < edgeCount; ++i) {
+            uint32_t ends[2] = {uint32_t(edges[i] >> 32), uint32_t(edges[i])};
+            Collapse best = {NONE, NONE, 0.0};
+            for (int k = 0; k < 2; ++k) {
+                uint32_t from = ends[k];
+                uint32_t to = ends[1 - k];
+                if (locked[from]) continue;
+                Quadric q = quadrics[from];
+                q += quadrics[to];
+                double cost = q.eval(position(to));
+                if (best.from != NONE && cost >= best.cost) continue;
+                if (!mapWedges(from, to, mapped)) continue;
+                best = {from, to, cost};
+            }
+            if (best.from != NONE && best.cost <= limit) {
+                collapses[collapseCount++] = best;
+            }
+        }
+        std::sort(collapses, collapses + collapseCount,
+                  [](const Collapse& a, const Collapse& b) {
+                      return a.cost < b.cost;
+                  });
+
+        unsigned char* touched = arena.allocateArray<unsigned char>(groupCount);
+        std::memset(touched, 0, groupCount);
+        size_t triangles = count / 3;
+        size_t goal = triangles - targetCount / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+        for (size_t i = 0; i < collapseCount && removed < goal; ++i) {
+            const Collapse& c = collapses[i];
+            if (touched[c.from] || touched[c.to]) continue;
+            if (flips(c.from, c.to)) continue;
+            if (!mapWedges(c.from, c.to, mapped)) continue;
+            for (uint32_t w = wedgeOffsets[c.from];
+                 w < wedgeOffsets[c.from + 1]; ++w) {
+                remap[wedges[w]] = mapped[w - wedgeOffsets[c.from]];
+            }
+            // 同时包含两端的三角形会退化
+            for (uint32_t a = adjacencyOffsets[c.from];
+                 a < adjacencyOffsets[c.from + 1]; ++a) {
+                const unsigned int* t = &current[adjacencyTriangles[a] * 3];
+                uint32_t g[3] = {resolve(t[0]), resolve(t[1]), resolve(t[2])};
+                bool degenerate = g[0] == g[1] || g[1] == g[2] || g[0] == g[2];
+                if (!degenerate && (g[0] == c.to || g[1] == c.to ||
+                                    g[2] == c.to)) {
+                    ++removed;
+                }
+            }
+            collapsedTo[c.from] = c.to;
+            quadrics[c.to] += quadrics[c.from];
+            touched[c.from] = touched[c.to] = 1;
+            maxCost = std::max(maxCost, c.cost);
+            ++applied;
+        }
+        for (auto& index : current) index = remap[index];
+        removeDegenerate();
+        return applied;
+    }
+};
+}  // namespace
+
+std::vector<unsigned int> _MGL SimplifyMesh(
+    const std::vector<Vertex>& vertices,
+    const std::vector<unsigned int>& indices, size_t targetCount,
+    float maxError, float* error) {
+    if (indices.size() % 3 != 0 || indices.size() <= targetCount) {
+        if (error) *error = 0.0f;
+        return indices;
+    }
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    Simplifier simplifier(vertices, indices.data(), indices.size(), arena);
+    simplifier.run(targetCount, maxError);
+    if (error) *error = simplifier.error();
+    return simplifier.indices();
+}
+
+size_t _MGL GenerateLods(MeshData& mesh, unsigned int maxLevels,
+                         float maxError) {
+    mesh.lods.clear();
+    size_t count = mesh.indices.size();
+    if (maxLevels == 0 || count == 0 || count % 3 != 0) return 0;
+    BoundingSphere bounds =
+        ComputeBounds(mesh.vertices.data(), mesh.vertices.size());
+    float limit = maxError * bounds.radius;
+
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    Simplifier simplifier(mesh.vertices, mesh.indices.data(), count, arena);
+    std::vector<unsigned int> chain(mesh.indices);
+    std::vector<MeshLod> lods;
+    lods.push_back({0, static_cast<uint32_t>(count), 0.0f, 0});
+    size_t previous = count;
+    for (unsigned int level = 1; level <= maxLevels; ++level) {
+        size_t target = size_t(previous / 3 * LOD_REDUCTION) * 3;
+        simplifier.run(target, limit);
+        const std::vector<unsigned int>& lod = simplifier.indices();
+        // 简化不再有效时多一层也省不了多少三角形
+        if (lod.empty() || lod.size() > previous * LOD_MIN_GAIN) break;
+        size_t offset = chain.size();
+        chain.insert(chain.end(), lod.begin(), lod.end());
+        mgl::OptimizeVertexCache(chain.data() + offset, lod.size(),
+                                 mesh.vertices.size());
+        lods.push_back({static_cast<uint32_t>(offset),
+                        static_cast<uint32_t>(lod.size()),
+                        simplifier.error(), 0});
+        previous = lod.size();
+    }
+    if (lods.size() == 1) return 0;
+    mesh.indices.swap(chain);
+    mesh.lods.swap(lods);
+    OrderVerticesByLod(mesh);
+    return mesh.lods.size() - 1;
+}
+
+void _MGL OrderVerticesByLod(MeshData& mesh) {
+    size_t vertexCount = mesh.vertices.size();
+    if (mesh.lods.empty()) return;
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    uint32_t* remap = arena.allocateArray<uint32_t>(vertexCount);
+    std::fill(remap, remap + vertexCount, NONE);
+    // 由粗到精按首次使用编号, 每层内保持索引中的访问顺序
+    uint32_t next = 0;
+    for (size_t level = mesh.lods.size(); level-- > 0;) {
+        MeshLod& lod = mesh.lods[level];
+        unsigned int* index = mesh.indices.data() + lod.indexOffset;
+        for (uint32_t i = 0; i < lod.indexCount; ++i) {
+            if (remap[index[i]] == NONE) remap[index[i]] = next++;
+        }
+        lod.vertexCount = next;
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (remap[v] == NONE) remap[v] = next++;
+    }
+    mesh.lods[0].vertexCount = static_cast<uint32_t>(vertexCount);
+
+    std::vector<Vertex> ordered(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        ordered[remap[v]] = mesh.vertices[v];
+    }
+    CountCopy(vertexCount * sizeof(Vertex));
+    mesh.vertices.swap(ordered);
+    for (auto& index : mesh.indices) index = remap[index];
+}
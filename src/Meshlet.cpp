@@ -0,0 +1,322 @@
+﻿#include "header/Meshlet.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include "header/Memory.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MGL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+const uint32_t NONE = 0xFFFFFFFFu;
+// 法线锥与轴的最小夹角余弦低于此值时不做锥剔除
+const float MIN_CONE_DOT = 0.1f;
+
+static_assert(sizeof(mgl::Meshlet) == 48,
+              "Meshlet must match the std430 layout of the cull shader");
+
+// 计算一个簇的包围球与法线锥
+void finishMeshlet(const mgl::Vertex* vertices, const unsigned int* indices,
+                   mgl::Meshlet& meshlet) {
+    const unsigned int* first = indices + meshlet.indexOffset;
+    glm::vec3 min = vertices[first[0]].Position;
+    glm::vec3 max = min;
+    for (uint32_t i = 1; i < meshlet.indexCount; ++i) {
+        min = glm::min(min, vertices[first[i]].Position);
+        max = glm::max(max, vertices[first[i]].Position);
+    }
+    meshlet.center = (min + max) * 0.5f;
+    float radius2 = 0.0f;
+    for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+        glm::vec3 d = vertices[first[i]].Position - meshlet.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    meshlet.radius = std::sqrt(radius2);
+
+    // 轴为面法线的平均方向, cutoff为锥半角的正弦
+    glm::vec3 sum(0.0f);
+    for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+        const glm::vec3& p0 = vertices[first[i]].Position;
+        glm::vec3 n = glm::cross(vertices[first[i + 1]].Position - p0,
+                                 vertices[first[i + 2]].Position - p0);
+        float length = glm::length(n);
+        if (length > 0.0f) sum += n / length;
+    }
+    float length = glm::length(sum);
+    meshlet.coneAxis = glm::vec3(0.0f);
+    meshlet.coneCutoff = 1.0f;
+    if (length == 0.0f) return;
+    glm::vec3 axis = sum / length;
+    float minDot = 1.0f;
+    for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+        const glm::vec3& p0 = vertices[first[i]].Position;
+        glm::vec3 n = glm::cross(vertices[first[i + 1]].Position - p0,
+                                 vertices[first[i + 2]].Position - p0);
+        float l = glm::length(n);
+        if (l > 0.0f) minDot = std::min(minDot, glm::dot(axis, n) / l);
+    }
+    if (minDot < MIN_CONE_DOT) return;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+// 把第index个簇加入绘制范围, 与上一个范围相邻时合并
+inline void appendRange(const mgl::Meshlet& meshlet, size_t indexSize,
+                        uint32_t& runEnd, mgl::MeshletDrawList& out) {
+    out.visibleMeshlets += 1;
+    out.triangles += meshlet.indexCount / 3;
+    if (!out.counts.empty() && runEnd == meshlet.indexOffset) {
+        out.counts.back() += static_cast<int>(meshlet.indexCount);
+    } else {
+        out.counts.push_back(static_cast<int>(meshlet.indexCount));
+        out.offsets.push_back(
+            reinterpret_cast<const void*>(meshlet.indexOffset * indexSize));
+    }
+    runEnd = meshlet.indexOffset + meshlet.indexCount;
+}
+
+#ifndef MGL_SSE2
+// 4个簇的可见性位掩码
+unsigned int cullScalar(const mgl::MeshletBounds& bounds, size_t first,
+                        const mgl::CullView& view) {
+    unsigned int mask = 0;
+    for (size_t k = 0; k < 4; ++k) {
+        size_t i = first + k;
+        glm::vec3 c(bounds.stream(0)[i], bounds.stream(1)[i],
+                    bounds.stream(2)[i]);
+        float r = bounds.stream(3)[i];
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; ++p) {
+            const glm::vec4& plane = view.planes[p];
+            visible = glm::dot(glm::vec3(plane), c) + plane.w > -r;
+        }
+        if (visible && view.coneCulling) {
+            glm::vec3 axis(bounds.stream(4)[i], bounds.stream(5)[i],
+                           bounds.stream(6)[i]);
+            glm::vec3 v = c - view.position;
+            visible = glm::dot(v, axis) <
+                      bounds.stream(7)[i] * glm::length(v) + r;
+        }
+        if (visible) mask |= 1u << k;
+    }
+    return mask;
+}
+#endif
+}  // namespace
+
+void _MGL BuildMeshlets(const Vertex* vertices, size_t vertexCount,
+                        const unsigned int* indices, size_t count,
+                        std::vector<Meshlet>& meshlets) {
+    meshlets.clear();
+    if (count < 3) return;
+    Arena& arena = threadArena();
+    ArenaScope scope(arena);
+    // 顶点最后一次加入的簇
+    uint32_t* stamp = arena.allocateArray<uint32_t>(vertexCount);
+    std::fill(stamp, stamp + vertexCount, NONE);
+
+    Meshlet meshlet = {};
+    size_t meshletVertices = 0;
+    uint32_t id = 0;
+    for (size_t i = 0; i + 2 < count; i += 3) {
+        const unsigned int* t = indices + i;
+        auto fresh = [&]() {
+            size_t n = 0;
+            for (int k = 0; k < 3; ++k) {
+                bool repeated = (k > 0 && t[k] == t[0]) ||
+                                (k > 1 && t[k] == t[1]);
+                if (stamp[t[k]] != id && !repeated) ++n;
+            }
+            return n;
+        };
+        size_t added = fresh();
+        if (meshletVertices + added > MESHLET_MAX_VERTICES ||
+            meshlet.indexCount / 3 + 1 > MESHLET_MAX_TRIANGLES) {
+            finishMeshlet(vertices, indices, meshlet);
+            meshlets.push_back(meshlet);
+            meshlet = {};
+            meshlet.indexOffset = static_cast<uint32_t>(i);
+            meshletVertices = 0;
+            ++id;
+            added = fresh();
+        }
+        for (int k = 0; k < 3; ++k) stamp[t[k]] = id;
+        meshletVertices += added;
+        meshlet.indexCount += 3;
+    }
+    finishMeshlet(vertices, indices, meshlet);
+    meshlets.push_back(meshlet);
+}
+
+_MGL MeshletBounds _MGL MakeMeshletBounds(
+    const std::vector<Meshlet>& meshlets) {
+    MeshletBounds bounds;
+    bounds.count = meshlets.size();
+    bounds.padded = (bounds.count + 3) & ~size_t(3);
+    bounds.data.assign(bounds.padded * 8, 0.0f);
+    // 补齐的元素半径为负无穷, 总在视锥外
+    std::fill(bounds.data.begin() + 3 * bounds.padded,
+              bounds.data.begin() + 4 * bounds.padded,
+              -std::numeric_limits<float>::infinity());
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+        const Meshlet& m = meshlets[i];
+        float values[8] = {m.center.x,   m.center.y,   m.center.z,
+                           m.radius,     m.coneAxis.x, m.coneAxis.y,
+                           m.coneAxis.z, m.coneCutoff};
+        for (size_t k = 0; k < 8; ++k) {
+            bounds.data[k * bounds.padded + i] = values[k];
+        }
+    }
+    return bounds;
+}
+
+_MGL CullView _MGL MakeCullView(const glm::mat4& viewProjection,
+                                const glm::vec3& position) {
+    // Gribb-Hartmann: 平面由投影矩阵的行组合得到
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                            viewProjection[2][i], viewProjection[3][i]);
+    }
+    CullView view;
+    for (int i = 0; i < 3; ++i) {
+        view.planes[2 * i] = rows[3] + rows[i];
+        view.planes[2 * i + 1] = rows[3] - rows[i];
+    }
+    for (auto& plane : view.planes) {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) plane = plane * (1.0f / length);
+    }
+    view.position = position;
+    return view;
+}
+
+_MGL CullView _MGL ToModelSpace(const CullView& view,
+                                const glm::mat4& transform) {
+    CullView local;
+    // 世界空间的平面q对应模型空间的 transpose(M) * q
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4& q = view.planes[p];
+        glm::vec4 plane(glm::dot(transform[0], q), glm::dot(transform[1], q),
+                        glm::dot(transform[2], q), glm::dot(transform[3], q));
+        float length = glm::length(glm::vec3(plane));
+        local.planes[p] = length > 0.0f ? plane * (1.0f / length) : plane;
+    }
+    local.position =
+        glm::vec3(glm::inverse(transform) * glm::vec4(view.position, 1.0f));
+    // 法线锥只在旋转与均匀缩放下保持角度, 镜像会翻转朝向
+    glm::vec3 x(transform[0]), y(transform[1]), z(transform[2]);
+    float lx = glm::length(x), ly = glm::length(y), lz = glm::length(z);
+    float longest = std::max(lx, std::max(ly, lz));
+    float shortest = std::min(lx, std::min(ly, lz));
+    bool uniform = longest - shortest <= longest * 1e-3f;
+    bool mirrored = glm::dot(x, glm::cross(y, z)) < 0.0f;
+    local.coneCulling = view.coneCulling && uniform && !mirrored;
+    return local;
+}
+
+bool _MGL SphereVisible(const CullView& view, const glm::vec3& center,
+                        float radius) {
+    for (const auto& plane : view.planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w <= -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void _MGL CullMeshlets(const std::vector<Meshlet>& meshlets,
+                       const MeshletBounds& bounds, const CullView& view,
+                       size_t indexSize, MeshletDrawList& out) {
+    uint32_t runEnd = NONE;
+#ifdef MGL_SSE2
+    __m128 planes[6][4];
+    for (int p = 0; p < 6; ++p) {
+        for (int k = 0; k < 4; ++k) {
+            planes[p][k] = _mm_set1_ps(view.planes[p][k]);
+        }
+    }
+    __m128 camera[3] = {_mm_set1_ps(view.position.x),
+                        _mm_set1_ps(view.position.y),
+                        _mm_set1_ps(view.position.z)};
+    __m128 zero = _mm_setzero_ps();
+#endif
+    for (size_t i = 0; i < bounds.count; i += 4) {
+#ifdef MGL_SSE2
+        __m128 cx = _mm_loadu_ps(bounds.stream(0) + i);
+        __m128 cy = _mm_loadu_ps(bounds.stream(1) + i);
+        __m128 cz = _mm_loadu_ps(bounds.stream(2) + i);
+        __m128 r = _mm_loadu_ps(bounds.stream(3) + i);
+        __m128 negative = _mm_sub_ps(zero, r);
+        __m128 visible = _mm_cmpeq_ps(zero, zero);
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(planes[p][0], cx),
+                           _mm_mul_ps(planes[p][1], cy)),
+                _mm_add_ps(_mm_mul_ps(planes[p][2], cz), planes[p][3]));
+            visible = _mm_and_ps(visible, _mm_cmpgt_ps(d, negative));
+        }
+        if (view.coneCulling) {
+            // 整簇背向相机: dot(c - camera, axis) >= cutoff * |c - camera| + r
+            __m128 vx = _mm_sub_ps(cx, camera[0]);
+            __m128 vy = _mm_sub_ps(cy, camera[1]);
+            __m128 vz = _mm_sub_ps(cz, camera[2]);
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(bounds.stream(4) + i)),
+                           _mm_mul_ps(vy, _mm_loadu_ps(bounds.stream(5) + i))),
+                _mm_mul_ps(vz, _mm_loadu_ps(bounds.stream(6) + i)));
+            __m128 length = _mm_sqrt_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+                           _mm_mul_ps(vz, vz)));
+            __m128 limit = _mm_add_ps(
+                _mm_mul_ps(_mm_loadu_ps(bounds.stream(7) + i), length), r);
+            visible = _mm_andnot_ps(_mm_cmpge_ps(d, limit), visible);
+        }
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(visible));
+#else
+        unsigned int mask = cullScalar(bounds, i, view);
+#endif
+        size_t end = std::min(i + 4, bounds.count);
+        for (size_t k = i; k < end; ++k) {
+            if (mask & (1u << (k - i))) {
+                appendRange(meshlets[k], indexSize, runEnd, out);
+            }
+        }
+    }
+}
+
+_MGL GpuMeshletCuller::GpuMeshletCuller(const std::string& path) {
+    if (!GLAD_GL_VERSION_4_3) return;
+    try {
+        std::unique_ptr<Shader> shader(new Shader(path));
+        shader->Compile();
+        program = std::move(shader);
+    } catch (const shader_exception& e) {
+        std::printf("WARNING::MESHLET::COMPUTE_UNAVAILABLE %s\n", e.what());
+    }
+}
+
+void _MGL GpuMeshletCuller::dispatch(unsigned int meshletBuffer,
+                                     unsigned int commandBuffer,
+                                     size_t meshletCount,
+                                     const CullView& view) {
+    if (!program || meshletCount == 0) return;
+    program->use();
+    for (int p = 0; p < 6; ++p) {
+        program->setUniformV("planes[" + std::to_string(p) + "]",
+                             view.planes[p]);
+    }
+    program->setUniformV("cameraPosition", view.position);
+    program->setUniform("coneCulling", view.coneCulling);
+    program->setUniform("meshletCount", static_cast<int>(meshletCount));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meshletBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+    glDispatchCompute(static_cast<GLuint>((meshletCount + 63) / 64), 1, 1);
+    // 命令缓冲区随后作为间接绘制参数读取
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
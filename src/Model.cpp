@@ -1,135 +1,1204 @@
 ﻿#include "header/Model.h"
+#include "header/ModelCache.h"
+#include "header/AsyncFile.h"
+#include "header/Config.h"
+#include "header/Cook.h"
+#include "header/FileSystem.h"
+#include "header/GltfLoader.h"
+#include "header/Hash.h"
+#include "header/Image.h"
+#include "header/MaterialPacker.h"
+#include "header/Memory.h"
+#include "header/MeshOptimize.h"
+#include "header/MeshProcess.h"
+#include "header/MeshSimplify.h"
+#include "header/ObjLoader.h"
+#include "header/TextureCache.h"
+#include "header/ThreadPool.h"
+#include "header/VirtualFileSystem.h"
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <cctype>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <unordered_set>
 
-void _MGL Model::Draw(Shader& shader) {
+namespace {
+// 模型使用的材质纹理类型及其在着色器中的名称前缀
+struct MaterialSlot {
+    aiTextureType type;
+    const char* name;
+};
+const MaterialSlot MATERIAL_SLOTS[] = {
+    {aiTextureType_DIFFUSE, "texture_diffuse"},
+    {aiTextureType_SPECULAR, "texture_specular"},
+    {aiTextureType_HEIGHT, "texture_normal"},
+    {aiTextureType_AMBIENT, "texture_height"},
+};
+
+// 后台线程的纹理解码结果
+struct DecodedTexture {
+    mgl::Image image;
+    // 文件内容哈希
+    uint64_t contentHash = 0;
+    bool hashed = false;
+    // 注册表中已有相同内容, 跳过了解码
+    bool duplicate = false;
+    // 成对解码时的高光图像, 合并后为空
+    mgl::Image specular;
+    // image是否为合并了高光的漫反射
+    bool packed = false;
+};
+
+// 材质中的纹理类型对应的用途, 高度图与高光一样是标量
+mgl::TextureRole roleOf(const std::string& type) {
+    if (type == "texture_normal") return mgl::TextureRole::Normal;
+    if (type == "texture_specular" || type == "texture_height") {
+        return mgl::TextureRole::Specular;
+    }
+    return mgl::TextureRole::Color;
+}
+
+// 标量纹理实际只有一个通道时存为R8
+void limitTexture(mgl::Image& image, mgl::TextureRole role) {
+    mgl::LimitTextureSize(image, role);
+    if (role == mgl::TextureRole::Specular) mgl::ReduceToSingleChannel(image);
+}
+
+// 解码并按设置缩小纹理, 缩小在解码线程上进行
+DecodedTexture decodeTexture(const std::string& filename,
+                             mgl::TextureRole role, bool dedupe) {
+    DecodedTexture result;
+    // 烘焙过的纹理不需要解码, 内容哈希直接取自清单
+    uint64_t sourceHash = 0;
+    std::string cooked = mgl::FindCooked(
+        filename, mgl::CookedImageSettings(filename), &sourceHash);
+    if (!cooked.empty()) {
+        if (dedupe) {
+            result.contentHash = sourceHash;
+            result.hashed = true;
+            result.duplicate =
+                mgl::TextureCache::instance().hasContent(sourceHash);
+            if (result.duplicate) return result;
+        }
+        result.image = mgl::ReadCookedImage(mgl::ReadFile(cooked));
+        if (result.image.valid()) {
+            limitTexture(result.image, role);
+            return result;
+        }
+    }
+    mgl::FileData file = mgl::ReadFile(filename);
+    if (!file.isOpen()) return result;
+    if (dedupe) {
+        result.contentHash = mgl::HashBytes(file.data(), file.size());
+        result.hashed = true;
+        result.duplicate =
+            mgl::TextureCache::instance().hasContent(result.contentHash);
+        if (result.duplicate) return result;
+    }
+    result.image = mgl::DecodeImageFromMemory(file.data(), file.size());
+    limitTexture(result.image, role);
+    return result;
+}
+
+// 解码一对漫反射与高光, 格式与尺寸允许时合并为一张纹理.
+// 成对的纹理不按内容去重
+DecodedTexture decodePair(const std::string& diffuse,
+                          const std::string& specular) {
+    DecodedTexture result =
+        decodeTexture(diffuse, mgl::TextureRole::Color, false);
+    result.specular = std::move(
+        decodeTexture(specular, mgl::TextureRole::Specular, false).image);
+    mgl::Image packed;
+    if (mgl::PackSpecularIntoAlpha(result.image, result.specular, packed)) {
+        result.image = std::move(packed);
+        result.specular.reset();
+        result.packed = true;
+    }
+    return result;
+}
+
+// 上传图像并以key登记, 其他模型已上传同一key时直接共享
+unsigned int uploadImage(const std::string& key, const std::string& path,
+                         const mgl::Image& image) {
+    mgl::TextureCache& cache = mgl::TextureCache::instance();
+    unsigned int id = 0;
+    if (cache.acquire(key, id)) return id;
+    if (!image.valid()) {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    }
+    id = mgl::UploadTexture2D(image);
+    cache.insert(key, id, 0, false);
+    return id;
+}
+
+// 查找可以合并的漫反射与高光: 网格恰有一张漫反射和一张高光,
+// 并且两者在整个模型中总是这样成对出现
+class MaterialPairs {
+public:
+    void add(const std::vector<mgl::Texture>& textures) {
+        const mgl::Texture* diffuse = nullptr;
+        const mgl::Texture* specular = nullptr;
+        int diffuseCount = 0, specularCount = 0;
+        for (auto& t : textures) {
+            if (t.type == "texture_diffuse") {
+                diffuse = &t;
+                ++diffuseCount;
+            } else if (t.type == "texture_specular") {
+                specular = &t;
+                ++specularCount;
+            }
+        }
+        if (diffuseCount == 1 && specularCount == 1 &&
+            diffuse->path != specular->path) {
+            auto it = pairs.emplace(diffuse->path, specular->path).first;
+            if (it->second != specular->path) rejected.insert(diffuse->path);
+            return;
+        }
+        for (auto& t : textures) {
+            if (t.type == "texture_diffuse" || t.type == "texture_specular") {
+                rejected.insert(t.path);
+            }
+        }
+    }
+
+    std::unordered_map<std::string, std::string> result() {
+        // 同一高光对应多张漫反射, 或路径两种用途都有时不合并
+        std::unordered_map<std::string, std::string> bySpecular;
+        for (auto& p : pairs) {
+            if (!bySpecular.emplace(p.second, p.first).second) {
+                rejected.insert(p.second);
+            }
+        }
+        std::unordered_map<std::string, std::string> found;
+        for (auto& p : pairs) {
+            if (rejected.count(p.first) || rejected.count(p.second) ||
+                pairs.count(p.second) || bySpecular.count(p.first)) {
+                continue;
+            }
+            found.insert(p);
+        }
+        return found;
+    }
+
+private:
+    std::unordered_map<std::string, std::string> pairs;
+    std::unordered_set<std::string> rejected;
+};
+
+// 上传解码结果并登记到纹理注册表, 注册表中已有相同内容时直接共享
+unsigned int uploadDecoded(const mgl::Texture& texture,
+                           const std::string& filename, const std::string& key,
+                           DecodedTexture& result) {
+    mgl::TextureCache& cache = mgl::TextureCache::instance();
+    unsigned int id = 0;
+    if (result.hashed && cache.acquireContent(key, result.contentHash, id)) {
+        return id;
+    }
+    if (result.duplicate) {
+        result = decodeTexture(filename, roleOf(texture.type), false);
+    }
+    if (!result.image.valid()) {
+        std::cout << "Texture failed to load at path: " << texture.path
+                  << std::endl;
+    }
+    id = mgl::UploadTexture2D(result.image);
+    cache.insert(key, id, result.contentHash, result.hashed);
+    return id;
+}
+
+// 逐步加载时纹理就绪之前使用的1x1纹理, 按类型取中性的值
+unsigned int placeholderTexture(const std::string& type) {
+    static std::unordered_map<std::string, unsigned int> textures;
+    auto it = textures.find(type);
+    if (it != textures.end()) return it->second;
+    // 漫反射为灰色, 法线朝向+z, 其余为0
+    unsigned char pixel[4] = {0, 0, 0, 255};
+    if (type == "texture_diffuse") {
+        pixel[0] = pixel[1] = pixel[2] = 128;
+    } else if (type == "texture_normal") {
+        pixel[0] = pixel[1] = 128;
+        pixel[2] = 255;
+    }
+    unsigned int id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, pixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    textures[type] = id;
+    return id;
+}
+
+// processMesh中每个并行块的顶点数
+const size_t VERTEX_GRAIN = 16 * 1024;
+
+// 从start开始经过的毫秒数
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// 自start以来的计数
+mgl::LoadCounters countersSince(const mgl::LoadCounters& start) {
+    mgl::LoadCounters now = mgl::ReadLoadCounters();
+    now.allocations -= start.allocations;
+    now.allocatedBytes -= start.allocatedBytes;
+    now.bytesCopied -= start.bytesCopied;
+    now.bytesUploaded -= start.bytesUploaded;
+    return now;
+}
+
+void printCounters(const std::string& path, const mgl::LoadCounters& c) {
+    std::printf(
+        "MODEL::MEMORY %s (allocations: %llu, allocated: %llu KB, "
+        "copied: %llu KB, uploaded: %llu KB)\n",
+        path.c_str(), (unsigned long long)c.allocations,
+        (unsigned long long)c.allocatedBytes / 1024,
+        (unsigned long long)c.bytesCopied / 1024,
+        (unsigned long long)c.bytesUploaded / 1024);
+}
+
+// 小写的文件扩展名
+std::string extension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos) {
+        return std::string();
+    }
+    std::string ext = path.substr(dot + 1);
+    for (auto& c : ext) c = static_cast<char>(std::tolower((unsigned char)c));
+    return ext;
+}
+
+// Assimp读取的文件, 内容来自ReadFile
+class FileStream : public Assimp::IOStream {
+  private:
+    mgl::FileData file;
+    size_t position = 0;
+
+  public:
+    explicit FileStream(mgl::FileData&& file) : file(std::move(file)) {}
+    size_t Read(void* buffer, size_t size, size_t count) override {
+        if (size == 0) return 0;
+        count = std::min(count, (file.size() - position) / size);
+        std::memcpy(buffer, file.data() + position, size * count);
+        position += size * count;
+        return count;
+    }
+    size_t Write(const void*, size_t, size_t) override { return 0; }
+    aiReturn Seek(size_t offset, aiOrigin origin) override {
+        size_t base = 0;
+        if (origin == aiOrigin_CUR) {
+            base = position;
+        } else if (origin == aiOrigin_END) {
+            base = file.size();
+        }
+        if (offset > file.size() - base) return aiReturn_FAILURE;
+        position = base + offset;
+        return aiReturn_SUCCESS;
+    }
+    size_t Tell() const override { return position; }
+    size_t FileSize() const override { return file.size(); }
+    void Flush() override {}
+};
+
+// 让Assimp通过虚拟文件系统读取模型及其引用的文件(.mtl等), 只读
+class VirtualIOSystem : public Assimp::IOSystem {
+  public:
+    // 不为空时记录打开过的文件, 作为网格缓存的依赖
+    std::vector<std::string>* opened = nullptr;
+
+    bool Exists(const char* path) const override {
+        return mgl::FileExists(path);
+    }
+    char getOsSeparator() const override { return '/'; }
+    Assimp::IOStream* Open(const char* path, const char* mode) override {
+        if (std::strchr(mode, 'w') || std::strchr(mode, 'a')) return nullptr;
+        if (opened) opened->push_back(path);
+        mgl::FileData file = mgl::ReadFile(path);
+        return file.isOpen() ? new FileStream(std::move(file)) : nullptr;
+    }
+    void Close(Assimp::IOStream* stream) override { delete stream; }
+};
+
+// 当前线程的导入器, 批量加载时各线程互不影响
+Assimp::Importer& threadImporter() {
+    static thread_local Assimp::Importer importer;
+    static thread_local bool installed = false;
+    if (!installed) {
+        // 导入器接管IOSystem的所有权
+        importer.SetIOHandler(new VirtualIOSystem());
+        installed = true;
+    }
+    return importer;
+}
+
+// 内置导入器
+typedef bool (*NativeImporter)(const std::string&,
+                               std::vector<mgl::MeshData>&,
+                               std::vector<std::string>*);
+
+// 获取处理该格式的内置导入器, 没有或已禁用时返回空
+NativeImporter nativeImporter(const std::string& path) {
+    const mgl::LoadConfig& config = mgl::loadConfig();
+    std::string ext = extension(path);
+    if (ext == "obj" && config.nativeObjLoader) return &mgl::LoadObj;
+    if ((ext == "gltf" || ext == "glb") && config.nativeGltfLoader) {
+        return &mgl::LoadGltf;
+    }
+    return nullptr;
+}
+}  // namespace
+
+struct _MGL Model::PendingTexture {
+    Texture texture;
+    // 文件路径与规范化的注册键
+    std::string filename;
+    std::string key;
+    std::future<DecodedTexture> decoded;
+    // 与texture成对解码的高光, path为空时不成对
+    Texture specular;
+    std::string specularKey;
+    // 合并后的纹理的注册键
+    std::string packedKey;
+};
+
+struct _MGL Model::ImportResult {
+    bool imported = false;
+    std::vector<MeshData> data;
+    // 导入时读取的其他文件
+    std::vector<std::string> files;
+    LoadStats stats;
+};
+
+struct _MGL Model::PendingLoad {
+    std::string path;
+    LoadMode mode = LoadMode::Blocking;
+    // 开始加载的时间与计数
+    std::chrono::steady_clock::time_point start;
+    LoadCounters counters;
+    std::string cachePath;
+    // 导入失败时为true, 不再上传
+    bool failed = false;
+    // 缓存命中时映射的缓存文件, meshes指向其中的数据
+    ModelCache cache;
+    // 缓存未命中时导入的网格数据
+    std::vector<MeshData> data;
+    // 网格视图, 缓存命中或逐步加载时使用
+    std::vector<CachedMesh> meshes;
+    // 已提交解码的纹理
+    std::vector<PendingTexture> textures;
+    // 逐步加载未命中缓存时在importPool中进行的导入
+    std::future<ImportResult> importing;
+    // 写入网格缓存所需的校验项, hashed为false时不写入
+    bool hashed = false;
+    uint64_t sourceHash = 0;
+    uint64_t settings = 0;
+};
+
+struct _MGL Model::StreamState {
+    // 模型路径, 用于输出
+    std::string path;
+    // 开始加载的时间与计数
+    std::chrono::steady_clock::time_point start;
+    LoadCounters counters;
+    // 尚未完全上传的几何数据, 与meshes中的几何数据相同
+    std::vector<std::shared_ptr<MeshGeometry>> geometries;
+    // 正在解码的纹理
+    std::vector<PendingTexture> textures;
+    // 网格仍在后台导入时不为空, 导入完成后由update开始上传
+    std::unique_ptr<PendingLoad> importing;
+};
+
+_MGL Model::Model(const std::string& path, bool gamma, LoadMode mode)
+    : gammaCorrection(gamma) {
+    loadModel(path, mode);
+}
+
+_MGL Model::Model(const char* path, bool gamma, LoadMode mode)
+    : gammaCorrection(gamma) {
+    loadModel(path, mode);
+}
+
+_MGL Model::Model(Deferred, bool gamma) : gammaCorrection(gamma) {}
+
+_MGL Model::Model(Model&& rval) = default;
+
+_MGL Model& _MGL Model::operator=(Model&& rval) {
+    if (this != &rval) {
+        releaseTextures();
+        meshes = std::move(rval.meshes);
+        directory = std::move(rval.directory);
+        textures_loaded = std::move(rval.textures_loaded);
+        textureIndex = std::move(rval.textureIndex);
+        gammaCorrection = rval.gammaCorrection;
+        stats = rval.stats;
+        stream = std::move(rval.stream);
+        pendingLoad = std::move(rval.pendingLoad);
+        rval.textures_loaded.clear();
+        rval.textureIndex.clear();
+    }
+    return *this;
+}
+
+_MGL Model::~Model() { releaseTextures(); }
+
+void _MGL Model::releaseTextures() {
+    TextureCache& cache = TextureCache::instance();
+    for (auto& t : textures_loaded) cache.release(t.id);
+    textures_loaded.clear();
+    textureIndex.clear();
+}
+
+void _MGL Model::Draw(Shader& shader) const {
     for (unsigned int i = 0; i < meshes.size(); ++i) {
         meshes[i].Draw(shader);
     }
 }
 
-void _MGL Model::loadModel(const std::string& path) {
-    Assimp::Importer import;
-    const aiScene* scene = import.ReadFile(
-        path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
-                  aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+size_t _MGL Model::Draw(Shader& shader, const glm::mat4& transform,
+                        const LodView& view, LodState& state) const {
+    state.levels.resize(meshes.size(), 0);
+    size_t triangles = 0;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const MeshGeometry& geometry = *meshes[i].getGeometry();
+        unsigned int lod =
+            SelectLod(geometry, transform, view, state.levels[i]);
+        state.levels[i] = static_cast<unsigned char>(lod);
+        meshes[i].Draw(shader, lod);
+        // 逐步加载时尚未上传的层由已上传的最精细一层代替
+        lod = std::max(lod, geometry.getResidentLod());
+        triangles += geometry.getLods()[lod].indexCount / 3;
+    }
+    return triangles;
+}
+
+_MGL ClusterCullStats _MGL Model::DrawClusters(Shader& shader,
+                                               const glm::mat4& transform,
+                                               const CullView& view,
+                                               ClusterState& state,
+                                               GpuMeshletCuller* gpu) const {
+    ClusterCullStats result;
+    CullView local = ToModelSpace(view, transform);
+    bool useGpu = gpu != nullptr && gpu->available();
+    state.lists.resize(meshes.size());
+    auto culled = [&](const MeshGeometry& geometry) {
+        const BoundingSphere& bounds = geometry.getBounds();
+        return !SphereVisible(local, bounds.center, bounds.radius);
+    };
+    // 簇只覆盖原始网格, 逐步加载尚未完成时整体绘制
+    auto clustered = [](const MeshGeometry& geometry) {
+        return !geometry.getMeshlets().empty() &&
+               geometry.getResidentLod() == 0;
+    };
+    ParallelFor(meshes.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const MeshGeometry& geometry = *meshes[i].getGeometry();
+            MeshletDrawList& list = state.lists[i];
+            list.clear();
+            bool indirect = useGpu && geometry.getCommandBuffer() != 0;
+            if (!clustered(geometry) || indirect) continue;
+            if (culled(geometry)) continue;
+            CullMeshlets(geometry.getMeshlets(), geometry.getMeshletBounds(),
+                         local, geometry.getIndexSize(), list);
+        }
+    });
+
+    // 计算着色器先剔除所有网格, 再切回绘制用的着色器
+    std::vector<bool> dispatched(meshes.size(), false);
+    if (useGpu) {
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            const MeshGeometry& geometry = *meshes[i].getGeometry();
+            if (!clustered(geometry) || geometry.getCommandBuffer() == 0 ||
+                culled(geometry)) {
+                continue;
+            }
+            gpu->dispatch(geometry.getMeshletBuffer(),
+                          geometry.getCommandBuffer(),
+                          geometry.getMeshlets().size(), local);
+            dispatched[i] = true;
+        }
+        shader.use();
+    }
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const MeshGeometry& geometry = *meshes[i].getGeometry();
+        if (!clustered(geometry)) {
+            meshes[i].Draw(shader);
+            unsigned int lod = geometry.getResidentLod();
+            result.triangles += geometry.getLods()[lod].indexCount / 3;
+            continue;
+        }
+        result.meshlets += geometry.getMeshlets().size();
+        if (dispatched[i]) {
+            meshes[i].DrawIndirect(shader);
+        } else if (!state.lists[i].counts.empty()) {
+            meshes[i].Draw(shader, state.lists[i]);
+            result.visible += state.lists[i].visibleMeshlets;
+            result.triangles += state.lists[i].triangles;
+        }
+    }
+    return result;
+}
+
+void _MGL Model::loadModel(const std::string& path, LoadMode mode) {
+    importModel(path, mode);
+    uploadModel();
+}
+
+void _MGL Model::importModel(const std::string& path, LoadMode mode) {
+    pendingLoad.reset(new PendingLoad());
+    PendingLoad& load = *pendingLoad;
+    load.path = path;
+    load.mode = mode;
+    load.start = std::chrono::steady_clock::now();
+    load.counters = ReadLoadCounters();
+    directory = path.substr(0, path.find_last_of('/'));
+
+    load.cachePath = ModelCache::cachePath(path);
+    uint64_t settings = importSettings(path);
+    uint64_t sourceHash = 0;
+    // 烘焙产物与运行时写入的网格缓存格式相同, 优先使用
+    std::string cooked = FindCooked(path, settings, &sourceHash);
+    bool hashed = !cooked.empty() || ModelCache::hashSource(path, sourceHash);
+    bool hit = false;
+    if (!cooked.empty() &&
+        load.cache.open(cooked, path, sourceHash, settings)) {
+        load.cachePath = cooked;
+        hit = true;
+    } else {
+        hit = hashed &&
+              load.cache.open(load.cachePath, path, sourceHash, settings);
+    }
+    std::vector<Texture> wanted;
+    MaterialPairs pairs;
+    bool pack = loadConfig().packMaterialTextures;
+    if (hit) {
+        stats.cacheHit = true;
+        for (size_t i = 0; i < load.cache.meshCount(); ++i) {
+            load.meshes.push_back(load.cache.mesh(i));
+            const std::vector<Texture>& textures = load.meshes.back().textures;
+            wanted.insert(wanted.end(), textures.begin(), textures.end());
+            if (pack) pairs.add(textures);
+        }
+        stats.importMs = elapsedMs(load.start);
+        requestTextures(wanted, load.textures, pairs.result());
+        return;
+    }
+    std::printf("MODEL::CACHE::MISS %s\n", load.cachePath.c_str());
+    if (mode == LoadMode::Progressive) {
+        // 导入与写入缓存都不阻塞调用线程, 完成后由update上传最粗的一层.
+        // 任务不引用this, 模型在导入期间可以移动或销毁
+        load.hashed = hashed;
+        load.sourceHash = sourceHash;
+        load.settings = settings;
+        load.importing = importPool().submit([path]() {
+            ImportResult result;
+            Model importer(Deferred(), false);
+            auto start = std::chrono::steady_clock::now();
+            result.imported =
+                importer.importMeshes(path, result.data, &result.files);
+            result.stats = importer.stats;
+            result.stats.importMs = elapsedMs(start);
+            return result;
+        });
+        return;
+    }
+
+    std::vector<MeshData>& data = load.data;
+    std::vector<std::string> files;
+    if (!importMeshes(path, data, &files)) {
+        load.failed = true;
+        return;
+    }
+    stats.importMs = elapsedMs(load.start);
+
+    std::vector<ModelDependency> dependencies =
+        ModelCache::hashDependencies(path, files);
+    if (hashed && !ModelCache::write(load.cachePath, sourceHash, settings,
+                                     data, dependencies)) {
+        std::printf("WARNING::MODEL::CACHE::WRITE_FAILED %s\n",
+                    load.cachePath.c_str());
+    }
+    for (auto& d : data) {
+        wanted.insert(wanted.end(), d.textures.begin(), d.textures.end());
+        if (pack) pairs.add(d.textures);
+    }
+    requestTextures(wanted, load.textures, pairs.result());
+}
+
+void _MGL Model::uploadModel() {
+    std::unique_ptr<PendingLoad> load = std::move(pendingLoad);
+    if (!load || load->failed) return;
+    const std::string& path = load->path;
+    // 逐步加载在update中完成后输出统计
+    if (load->mode == LoadMode::Progressive) {
+        stream.reset(new StreamState());
+        stream->path = path;
+        stream->start = load->start;
+        stream->counters = load->counters;
+        if (load->importing.valid()) {
+            // 网格仍在后台导入, 此前没有可绘制的网格
+            stream->importing = std::move(load);
+            return;
+        }
+        if (stats.cacheHit) {
+            std::printf("MODEL::CACHE::HIT %s\n", load->cachePath.c_str());
+        }
+        streamMeshes(load->meshes, std::move(load->textures));
+        stats.firstDrawMs = elapsedMs(load->start);
+        std::printf("MODEL::STREAM::BASE %s (%.1f ms)\n", path.c_str(),
+                    stats.firstDrawMs);
+        return;
+    }
+    // 解码已在导入时开始, 这里按提交顺序上传
+    for (auto& p : load->textures) finishTexture(p);
+    if (!stats.cacheHit) {
+        buildMeshes(std::move(load->data));
+        stats.totalMs = elapsedMs(load->start);
+        stats.counters = countersSince(load->counters);
+        std::printf(
+            "MODEL::LOAD %s (%s: %.1f ms, convert: %.1f ms, total: %.1f ms)\n",
+            path.c_str(), stats.nativeImport ? "native" : "assimp",
+            stats.importMs, stats.convertMs, stats.totalMs);
+        printCounters(path, stats.counters);
+        return;
+    }
+    meshes.reserve(load->meshes.size());
+    for (auto& cached : load->meshes) {
+        std::vector<Texture> textures;
+        for (auto& t : cached.textures) {
+            textures.push_back(findOrLoadTexture(t.path, t.type));
+        }
+        // 顶点与索引直接从映射内存上传, 不经过导入器
+        meshes.emplace_back(
+            cached.vertices, cached.vertexCount, cached.indices,
+            cached.indexCount, std::move(textures),
+            std::vector<MeshLod>(cached.lods, cached.lods + cached.lodCount));
+    }
+    stats.totalMs = elapsedMs(load->start);
+    stats.counters = countersSince(load->counters);
+    std::printf("MODEL::CACHE::HIT %s (%.1f ms)\n", load->cachePath.c_str(),
+                stats.totalMs);
+    printCounters(path, stats.counters);
+}
+
+bool _MGL Model::Cook(const std::string& path, uint64_t sourceHash,
+                      const std::string& output,
+                      std::vector<ModelDependency>* dependencies) {
+    Model model(Deferred(), false);
+    std::vector<MeshData> data;
+    std::vector<std::string> files;
+    if (!model.importMeshes(path, data, &files)) return false;
+    std::vector<ModelDependency> hashed =
+        ModelCache::hashDependencies(path, files);
+    if (!ModelCache::write(output, sourceHash, importSettings(path), data,
+                           hashed)) {
+        return false;
+    }
+    if (dependencies) dependencies->swap(hashed);
+    return true;
+}
+
+bool _MGL Model::Import(const std::string& path, std::vector<MeshData>& data,
+                        LoadStats* stats) {
+    Model model(Deferred(), false);
+    auto start = std::chrono::steady_clock::now();
+    bool imported = model.importMeshes(path, data);
+    model.stats.importMs = elapsedMs(start);
+    if (stats) *stats = model.stats;
+    return imported;
+}
+
+bool _MGL Model::importMeshes(const std::string& path,
+                              std::vector<MeshData>& data,
+                              std::vector<std::string>* dependencies) {
+    NativeImporter importer = nativeImporter(path);
+    stats.nativeImport = importer != nullptr;
+    bool imported = importer ? importer(path, data, dependencies)
+                             : importAssimp(path, data, dependencies);
+    if (!imported) return false;
+    if (loadConfig().optimizeMeshes) optimizeMeshes(path, data);
+    if (loadConfig().lodLevels > 0) generateLods(path, data);
+    return true;
+}
+
+// importSettings以引用传给HashCombine, 需要类外定义
+const unsigned int _MGL Model::ImportFlags;
+
+uint64_t _MGL Model::importSettings(const std::string& path) {
+    uint64_t settings = HashCombine(FNV_OFFSET_BASIS, ImportFlags);
+    // 内置导入器与Assimp的顶点顺序不同, 不能共用缓存
+    settings = HashCombine(settings, nativeImporter(path) != nullptr);
+    settings = HashCombine(settings, loadConfig().optimizeMeshes);
+    settings = HashCombine(settings, loadConfig().lodLevels);
+    return HashCombine(settings, loadConfig().lodMaxError);
+}
+
+void _MGL Model::optimizeMeshes(const std::string& path,
+                                std::vector<MeshData>& data) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<MeshOptimizeStats> results(data.size());
+    // 顶点过多的网格切分后可以使用16位索引
+    std::vector<std::vector<MeshData>> parts(data.size());
+    ParallelFor(data.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            results[i] = OptimizeMesh(data[i]);
+            SplitForShortIndices(data[i], parts[i]);
+        }
+    });
+    size_t splits = 0;
+    std::vector<MeshData> optimized;
+    optimized.reserve(data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        stats.cacheBefore += results[i].before;
+        stats.cacheAfter += results[i].after;
+        if (parts[i].empty()) {
+            optimized.push_back(std::move(data[i]));
+            continue;
+        }
+        ++splits;
+        for (auto& p : parts[i]) optimized.push_back(std::move(p));
+    }
+    data.swap(optimized);
+    stats.optimizeMs = elapsedMs(start);
+    std::printf(
+        "MODEL::OPTIMIZE %s (acmr: %.3f -> %.3f, atvr: %.3f -> %.3f, "
+        "vertices: %llu -> %llu, split: %zu, %.1f ms)\n",
+        path.c_str(), stats.cacheBefore.acmr(), stats.cacheAfter.acmr(),
+        stats.cacheBefore.atvr(), stats.cacheAfter.atvr(),
+        (unsigned long long)stats.cacheBefore.vertices,
+        (unsigned long long)stats.cacheAfter.vertices, splits,
+        stats.optimizeMs);
+}
+
+void _MGL Model::generateLods(const std::string& path,
+                              std::vector<MeshData>& data) {
+    auto start = std::chrono::steady_clock::now();
+    const LoadConfig& config = loadConfig();
+    ParallelFor(data.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            GenerateLods(data[i], config.lodLevels, config.lodMaxError);
+        }
+    });
+    // 每层的三角形总数, 没有该层的网格计入其最粗的一层
+    std::vector<size_t> triangles(config.lodLevels + 1, 0);
+    for (auto& d : data) {
+        for (size_t l = 0; l < triangles.size(); ++l) {
+            if (d.lods.empty()) {
+                triangles[l] += d.indices.size() / 3;
+            } else {
+                size_t level = std::min(l, d.lods.size() - 1);
+                triangles[l] += d.lods[level].indexCount / 3;
+            }
+        }
+    }
+    stats.lodMs = elapsedMs(start);
+    std::string counts;
+    for (size_t l = 0; l < triangles.size(); ++l) {
+        counts += (l ? " -> " : "") + std::to_string(triangles[l]);
+    }
+    std::printf("MODEL::LOD %s (triangles: %s, %.1f ms)\n", path.c_str(),
+                counts.c_str(), stats.lodMs);
+}
+
+bool _MGL Model::importAssimp(const std::string& path,
+                              std::vector<MeshData>& data,
+                              std::vector<std::string>* dependencies) {
+    Assimp::Importer& import = threadImporter();
+    auto* io = static_cast<VirtualIOSystem*>(import.GetIOHandler());
+    io->opened = dependencies;
+    const aiScene* scene = import.ReadFile(path, ImportFlags);
+    io->opened = nullptr;
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
         !scene->mRootNode) {
         std::printf("ERROR::ASSIMP::%s\n", import.GetErrorString());
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<aiMesh*> found;
+    processNode(scene->mRootNode, scene, found);
+    // 各网格互相独立, 并行转换
+    size_t first = data.size();
+    data.resize(first + found.size());
+    ParallelFor(found.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            data[first + i] = processMesh(found[i], scene);
+        }
+    });
+    stats.convertMs = elapsedMs(start);
+    import.FreeScene();
+    return true;
+}
+
+void _MGL Model::streamMeshes(const std::vector<CachedMesh>& source,
+                              std::vector<PendingTexture>&& decoding) {
+    stream->textures = std::move(decoding);
+    meshes.reserve(meshes.size() + source.size());
+    for (auto& m : source) {
+        std::vector<Texture> textures = m.textures;
+        for (auto& t : textures) t.id = placeholderTexture(t.type);
+        // 正在细化的几何数据不参与按内容共享
+        auto geometry = std::make_shared<MeshGeometry>(
+            m.vertices, m.vertexCount, m.indices, m.indexCount,
+            std::vector<MeshLod>(m.lods, m.lods + m.lodCount), 0, 0, true);
+        if (geometry->getResidentLod() > 0) {
+            stream->geometries.push_back(geometry);
+        }
+        meshes.emplace_back(std::move(geometry), std::move(textures));
+    }
+    // 其他模型已载入的纹理立即可用
+    for (auto& t : textures_loaded) applyTexture(t);
+}
+
+void _MGL Model::applyTexture(const Texture& texture) {
+    for (auto& mesh : meshes) {
+        for (auto& t : mesh.getTextures()) {
+            if (t.path == texture.path) t.id = texture.id;
+        }
+    }
+}
+
+void _MGL Model::finishImport() {
+    std::unique_ptr<PendingLoad> load = std::move(stream->importing);
+    ImportResult result = load->importing.get();
+    if (!result.imported) {
+        std::printf("MODEL::STREAM::IMPORT_FAILED %s\n", load->path.c_str());
+        stream.reset();
         return;
     }
-    directory = path.substr(0, path.find_last_of('/'));
+    stats = result.stats;
+    std::vector<Texture> wanted;
+    MaterialPairs pairs;
+    bool pack = loadConfig().packMaterialTextures;
+    std::vector<CachedMesh> views;
+    views.reserve(result.data.size());
+    for (auto& d : result.data) {
+        wanted.insert(wanted.end(), d.textures.begin(), d.textures.end());
+        if (pack) pairs.add(d.textures);
+        views.push_back({d.vertices.data(),
+                         static_cast<uint32_t>(d.vertices.size()),
+                         d.indices.data(),
+                         static_cast<uint32_t>(d.indices.size()),
+                         d.lods.data(), static_cast<uint32_t>(d.lods.size()),
+                         d.textures});
+    }
+    std::vector<PendingTexture> decoding;
+    requestTextures(wanted, decoding, pairs.result());
+    streamMeshes(views, std::move(decoding));
+    stats.firstDrawMs = elapsedMs(stream->start);
+    std::printf("MODEL::STREAM::BASE %s (%.1f ms)\n", stream->path.c_str(),
+                stats.firstDrawMs);
+    if (!load->hashed) return;
+    // streamMeshes已暂存数据, 缓存在后台写入, 不推迟第一次绘制
+    auto data = std::make_shared<std::vector<MeshData>>(std::move(result.data));
+    auto files = std::make_shared<std::vector<std::string>>(
+        std::move(result.files));
+    std::string path = load->path;
+    std::string cachePath = load->cachePath;
+    uint64_t sourceHash = load->sourceHash;
+    uint64_t settings = load->settings;
+    ioPool().submit([=]() {
+        if (!ModelCache::write(cachePath, sourceHash, settings, *data,
+                               ModelCache::hashDependencies(path, *files))) {
+            std::printf("WARNING::MODEL::CACHE::WRITE_FAILED %s\n",
+                        cachePath.c_str());
+        }
+    });
+}
 
-    processNode(scene->mRootNode, scene);
+bool _MGL Model::update(double budgetMs) {
+    if (!stream) return false;
+    if (stream->importing) {
+        auto status =
+            stream->importing->importing.wait_for(std::chrono::seconds(0));
+        if (status != std::future_status::ready) return true;
+        finishImport();
+        // 上传最粗的一层已用去本帧, 其余留到下一次
+        return stream != nullptr;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool progressed = false;
+    auto withinBudget = [&]() {
+        return !progressed || elapsedMs(start) < budgetMs;
+    };
+    // 纹理解码已在后台进行, 这里只上传完成的
+    auto& textures = stream->textures;
+    for (size_t i = 0; i < textures.size() && withinBudget();) {
+        auto status = textures[i].decoded.wait_for(std::chrono::seconds(0));
+        if (status != std::future_status::ready) {
+            ++i;
+            continue;
+        }
+        // 成对的纹理一次记入两张
+        size_t loaded = textures_loaded.size();
+        finishTexture(textures[i]);
+        for (size_t j = loaded; j < textures_loaded.size(); ++j) {
+            applyTexture(textures_loaded[j]);
+        }
+        textures.erase(textures.begin() + i);
+        progressed = true;
+    }
+    // 所有网格细化到同一层之后再细化下一层
+    auto& geometries = stream->geometries;
+    while (!geometries.empty() && withinBudget()) {
+        auto coarsest = std::max_element(
+            geometries.begin(), geometries.end(),
+            [](const std::shared_ptr<MeshGeometry>& a,
+               const std::shared_ptr<MeshGeometry>& b) {
+                return a->getResidentLod() < b->getResidentLod();
+            });
+        (*coarsest)->refine();
+        if ((*coarsest)->getResidentLod() == 0) geometries.erase(coarsest);
+        progressed = true;
+    }
+    if (!textures.empty() || !geometries.empty()) return true;
+
+    stats.totalMs = elapsedMs(stream->start);
+    stats.counters = countersSince(stream->counters);
+    std::printf(
+        "MODEL::STREAM::DONE %s (first draw: %.1f ms, total: %.1f ms)\n",
+        stream->path.c_str(), stats.firstDrawMs, stats.totalMs);
+    printCounters(stream->path, stats.counters);
+    stream.reset();
+    return false;
+}
+
+void _MGL Model::buildMeshes(std::vector<MeshData>&& data) {
+    // 几何数据移动给Mesh, 上传后随即释放, 只在上传时读取一次
+    meshes.reserve(meshes.size() + data.size());
+    for (auto& d : data) {
+        for (auto& t : d.textures) {
+            t.id = findOrLoadTexture(t.path, t.type).id;
+        }
+        meshes.emplace_back(std::move(d.vertices), std::move(d.indices),
+                            std::move(d.textures), std::move(d.lods));
+    }
+    data.clear();
 }
 
-void _MGL Model::processNode(aiNode* node, const aiScene* scene) {
+void _MGL Model::processNode(aiNode* node, const aiScene* scene,
+                             std::vector<aiMesh*>& found) {
     // 处理节点所有网格
     for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        found.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
     // 递归处理子节点
     for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-        processNode(node->mChildren[i], scene);
-    }
-}
-
-_MGL Mesh _MGL Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
-
-    for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
-        Vertex vertex;
-        // 处理顶点位置，法线，纹理坐标
-        glm::vec3 vector;
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.Position = vector;
-        // 法线
-        if (mesh->HasNormals()) {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
-        }
-        // 纹理
-        if (mesh->mTextureCoords[0]) {
-            glm::vec2 vec;
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.TexCoords = vec;
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
-        } else {
-            vertex.TexCoords = glm::vec2(0.0f);
-        }
-        vertices.push_back(vertex);
+        processNode(node->mChildren[i], scene, found);
+    }
+}
+
+_MGL MeshData _MGL Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+    MeshData data;
+    std::vector<Vertex>& vertices = data.vertices;
+    std::vector<unsigned int>& indices = data.indices;
+    std::vector<Texture>& textures = data.textures;
+
+    // 处理顶点位置，法线，纹理坐标: aiVector3D与glm::vec3布局相同,
+    // 各属性按块交错写入一次分配好的数组, 大网格再分块并行
+    static_assert(sizeof(aiVector3D) == 3 * sizeof(float),
+                  "aiVector3D must be three packed floats");
+    VertexStreams streams;
+    streams.positions = &mesh->mVertices[0].x;
+    if (mesh->HasNormals()) streams.normals = &mesh->mNormals[0].x;
+    if (mesh->mTextureCoords[0]) {
+        streams.texCoords = &mesh->mTextureCoords[0][0].x;
+        streams.texCoordStride = 3;
+        if (mesh->mTangents) streams.tangents = &mesh->mTangents[0].x;
+        if (mesh->mBitangents) streams.bitangents = &mesh->mBitangents[0].x;
     }
+    vertices.resize(mesh->mNumVertices);
+    CountAllocation(vertices.size() * sizeof(Vertex));
+    Vertex* out = vertices.data();
+    ParallelFor(vertices.size(), VERTEX_GRAIN, [&](size_t first, size_t last) {
+        InterleaveVertices(streams, first, last - first, out + first);
+    });
     // 处理索引
+    size_t indexCount = 0;
     for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; ++j) {
-            indices.push_back(face.mIndices[j]);
+        indexCount += mesh->mFaces[i].mNumIndices;
+    }
+    indices.resize(indexCount);
+    CountAllocation(indexCount * sizeof(unsigned int));
+    CountCopy(indexCount * sizeof(unsigned int));
+    unsigned int* index = indices.data();
+    for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+        const aiFace& face = mesh->mFaces[i];
+        std::memcpy(index, face.mIndices, face.mNumIndices * sizeof(*index));
+        index += face.mNumIndices;
+    }
+    // 法线与切线空间由引擎并行生成, 源数据有效时直接使用;
+    // 含点或线图元的网格与Assimp一样不生成
+    if (indexCount == size_t(mesh->mNumFaces) * 3) {
+        bool normalsGenerated = !mesh->HasNormals() || !HasValidNormals(data);
+        if (normalsGenerated) GenerateSmoothNormals(data);
+        if (mesh->mTextureCoords[0] &&
+            (normalsGenerated || !mesh->mTangents || !HasValidTangents(data))) {
+            GenerateTangents(data);
         }
     }
     // 处理材质
     if (mesh->mMaterialIndex >= 0) {
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // diffuse
-        std::vector<Texture> diffuseMaps = loadMaterialTextures(
-            material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // specular
-        std::vector<Texture> specularMaps = loadMaterialTextures(
-            material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(),
-                        specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(
-            material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(
-            material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-    }
-    return Mesh(vertices, indices, textures);
-}
-
-std::vector<_MGL Texture> _MGL Model::loadMaterialTextures(aiMaterial* mat,
-                                                 aiTextureType type,
-                                                 std::string typeName) {
-    std::vector<Texture> textures;
+        for (auto& slot : MATERIAL_SLOTS) {
+            loadMaterialTextures(material, slot.type, slot.name, textures);
+        }
+    }
+    return data;
+}
+
+void _MGL Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type,
+                                      const char* typeName,
+                                      std::vector<Texture>& textures) {
     for (unsigned int i = 0; i < mat->GetTextureCount(type); ++i) {
         aiString str;
         mat->GetTexture(type, i, &str);
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-                textures.push_back(textures_loaded[j]);
-                skip = true;
-                break;
-            }
+        textures.emplace_back();
+        Texture& texture = textures.back();
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = str.C_Str();
+    }
+}
+
+_MGL Texture _MGL Model::findOrLoadTexture(const std::string& path,
+                                           const std::string& typeName) {
+    auto it = textureIndex.find(path);
+    if (it == textureIndex.end()) {
+        Texture wanted;
+        wanted.id = 0;
+        wanted.type = typeName;
+        wanted.path = path;
+        std::vector<PendingTexture> requested;
+        requestTextures(std::vector<Texture>(1, wanted), requested);
+        for (auto& p : requested) finishTexture(p);
+        it = textureIndex.find(path);
+    }
+    Texture texture = textures_loaded[it->second];
+    texture.type = typeName;
+    return texture;
+}
+
+void _MGL Model::requestTextures(
+    const std::vector<Texture>& wanted, std::vector<PendingTexture>& pending,
+    const std::unordered_map<std::string, std::string>& pairs) {
+    TextureCache& cache = TextureCache::instance();
+    bool dedupe = loadConfig().dedupeTextureContent;
+    std::unordered_set<std::string> seen;
+    // 先收集整组纹理, 读取一起提交后再开始解码
+    size_t first = pending.size();
+    std::vector<std::string> files;
+    std::vector<std::function<DecodedTexture()>> jobs;
+    for (auto& pair : pairs) {
+        if (textureIndex.count(pair.first) || textureIndex.count(pair.second)) {
+            continue;
+        }
+        PendingTexture p;
+        p.texture = {0, "texture_diffuse", pair.first};
+        p.specular = {0, "texture_specular", pair.second};
+        p.filename = directory + '/' + pair.first;
+        std::string specular = directory + '/' + pair.second;
+        p.key = CanonicalPath(p.filename);
+        p.specularKey = CanonicalPath(specular);
+        p.packedKey = p.key + '|' + p.specularKey;
+        if (cache.acquire(p.packedKey, p.texture.id)) {
+            // 其他模型已合并同一对纹理
+            cache.acquire(p.packedKey, p.specular.id);
+            textureIndex[pair.first] = textures_loaded.size();
+            textures_loaded.push_back(p.texture);
+            textureIndex[pair.second] = textures_loaded.size();
+            textures_loaded.push_back(p.specular);
+            continue;
+        }
+        // 已经分别载入的纹理不再合并, 按单张处理
+        if (cache.contains(p.key) || cache.contains(p.specularKey)) continue;
+        seen.insert(pair.first);
+        seen.insert(pair.second);
+        std::string filename = p.filename;
+        files.push_back(filename);
+        files.push_back(specular);
+        jobs.push_back([filename, specular]() {
+            return decodePair(filename, specular);
+        });
+        pending.push_back(std::move(p));
+    }
+    for (auto& t : wanted) {
+        if (textureIndex.count(t.path) || !seen.insert(t.path).second) {
+            continue;
         }
-        if (!skip) {
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
+        std::string filename = directory + '/' + t.path;
+        std::string key = CanonicalPath(filename);
+        Texture texture = t;
+        if (cache.acquire(key, texture.id)) {
+            // 其他模型已载入同一文件
+            textureIndex[texture.path] = textures_loaded.size();
             textures_loaded.push_back(texture);
+            continue;
         }
+        PendingTexture p;
+        p.texture = texture;
+        p.filename = filename;
+        p.key = key;
+        TextureRole role = roleOf(texture.type);
+        files.push_back(filename);
+        jobs.push_back([filename, role, dedupe]() {
+            return decodeTexture(filename, role, dedupe);
+        });
+        pending.push_back(std::move(p));
+    }
+    if (jobs.empty()) return;
+    // 解码任务经ReadFile取得批次读入的内容, 批次随最后一个任务释放
+    auto batch = std::make_shared<ReadBatch>(files);
+    ThreadPool& pool = texturePool();
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        std::function<DecodedTexture()> job = std::move(jobs[i]);
+        pending[first + i].decoded =
+            pool.submit([batch, job]() { return job(); });
     }
+}
 
-    return textures;
+_MGL Texture _MGL Model::finishTexture(PendingTexture& pending) {
+    Texture texture = pending.texture;
+    if (!pending.specular.path.empty()) {
+        TextureCache& cache = TextureCache::instance();
+        Texture specular = pending.specular;
+        bool packed = cache.acquire(pending.packedKey, texture.id);
+        if (!packed) {
+            DecodedTexture result = pending.decoded.get();
+            packed = result.packed;
+            if (packed) {
+                texture.id =
+                    uploadImage(pending.packedKey, texture.path, result.image);
+            } else {
+                texture.id = uploadImage(pending.key, texture.path,
+                                         result.image);
+                specular.id = uploadImage(pending.specularKey, specular.path,
+                                          result.specular);
+            }
+        }
+        // 合并后两者共享一张纹理, 各持有一次引用
+        if (packed) cache.acquire(pending.packedKey, specular.id);
+        textureIndex[texture.path] = textures_loaded.size();
+        textures_loaded.push_back(texture);
+        textureIndex[specular.path] = textures_loaded.size();
+        textures_loaded.push_back(specular);
+        return texture;
+    }
+    // 同时加载的其他模型可能已上传同一文件, 解码结果直接丢弃
+    if (!TextureCache::instance().acquire(pending.key, texture.id)) {
+        DecodedTexture result = pending.decoded.get();
+        texture.id =
+            uploadDecoded(texture, pending.filename, pending.key, result);
+    }
+    textureIndex[texture.path] = textures_loaded.size();
+    textures_loaded.push_back(texture);
+    return texture;
 }
 
 unsigned int _MGL TextureFromFile(const char* path, const std::string& directory,
@@ -137,37 +1206,9 @@ unsigned int _MGL TextureFromFile(const char* path, const std::string& directory
     std::string filename = std::string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data =
-        stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                     GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                        GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
+    Image image = LoadTextureImage(filename);
+    if (!image.valid()) {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
-
-    return textureID;
+    return UploadTexture2D(image);
 }
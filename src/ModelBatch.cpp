@@ -0,0 +1,112 @@
+﻿#include "header/ModelBatch.h"
+#include "header/FileSystem.h"
+#include "header/ModelRegistry.h"
+#include "header/ThreadPool.h"
+#include <cstdio>
+#include <unordered_map>
+
+_MGL ModelBatch::ModelBatch(const std::vector<std::string>& paths, bool gamma,
+                            LoadMode mode)
+    : models(paths.size()),
+      groupOf(paths.size()),
+      gamma(gamma),
+      mode(mode),
+      start(std::chrono::steady_clock::now()) {
+    // 相同路径只导入一次, 组内的模型共享导入的结果
+    std::unordered_map<std::string, size_t> byPath;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        auto found = byPath.emplace(CanonicalPath(paths[i]), groups.size());
+        if (found.second) {
+            groups.emplace_back();
+            groups.back().path = paths[i];
+            groups.back().model.reset(new Model(Model::Deferred(), gamma));
+        }
+        groupOf[i] = found.first->second;
+        groups[groupOf[i]].members.push_back(i);
+    }
+    remaining = groups.size();
+    ThreadPool& pool = importPool();
+    for (auto& group : groups) {
+        Model* model = group.model.get();
+        std::string path = group.path;
+        group.imported = pool.submit(
+            [model, path, mode]() { model->importModel(path, mode); });
+    }
+}
+
+_MGL ModelBatch::~ModelBatch() {
+    // 导入任务持有模型的指针
+    for (auto& group : groups) {
+        if (group.imported.valid()) group.imported.wait();
+    }
+}
+
+void _MGL ModelBatch::upload(Group& group) {
+    if (group.uploaded) return;
+    group.uploaded = true;
+    try {
+        group.imported.get();
+        group.model->uploadModel();
+        // 一次载入的模型登记到注册表, 之后按路径加载时直接共享
+        if (mode == LoadMode::Blocking) {
+            ModelRegistry::instance().insert(group.path, gamma, group.model);
+        }
+        for (size_t i : group.members) models[i] = group.model;
+    } catch (...) {
+        // 由take或wait重新抛出, 其余组照常上传
+        group.error = std::current_exception();
+    }
+    group.model.reset();
+    if (--remaining == 0) {
+        std::printf("MODEL::BATCH %zu models (%.1f ms)\n", models.size(),
+                    std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+    }
+}
+
+size_t _MGL ModelBatch::poll() {
+    size_t count = 0;
+    for (auto& group : groups) {
+        if (group.uploaded) {
+            count += group.members.size();
+            continue;
+        }
+        auto status = group.imported.wait_for(std::chrono::seconds(0));
+        if (status != std::future_status::ready) continue;
+        upload(group);
+        count += group.members.size();
+    }
+    return count;
+}
+
+bool _MGL ModelBatch::ready(size_t index) const {
+    return groups[groupOf[index]].uploaded;
+}
+
+std::shared_ptr<_MGL Model> _MGL ModelBatch::take(size_t index) {
+    Group& group = groups[groupOf[index]];
+    upload(group);
+    if (group.error) std::rethrow_exception(group.error);
+    return std::move(models[index]);
+}
+
+std::vector<std::shared_ptr<_MGL Model>> _MGL ModelBatch::wait() {
+    // 先导入完成的先上传, 上传与其余模型的导入重叠
+    while (poll() < models.size()) {
+        for (auto& group : groups) {
+            if (group.uploaded) continue;
+            group.imported.wait_for(std::chrono::milliseconds(1));
+            break;
+        }
+    }
+    for (auto& group : groups) {
+        if (group.error) std::rethrow_exception(group.error);
+    }
+    return std::move(models);
+}
+
+std::vector<std::shared_ptr<_MGL Model>> _MGL LoadModels(
+    const std::vector<std::string>& paths, bool gamma, LoadMode mode) {
+    return ModelBatch(paths, gamma, mode).wait();
+}
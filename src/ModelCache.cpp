@@ -0,0 +1,353 @@
+﻿#include "header/ModelCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <unordered_set>
+#include "header/FileSystem.h"
+
+namespace {
+const char CACHE_MAGIC[4] = {'M', 'G', 'L', 'C'};
+
+// 缓存文件头
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t settings;
+    uint32_t meshCount;
+    uint32_t vertexSize;
+    // 依赖文件表的偏移与条目数, 每条为哈希, 路径长度与路径
+    uint64_t dependencyOffset;
+    uint32_t dependencyCount;
+    uint32_t reserved;
+};
+
+// 单个网格记录, 偏移量相对于文件开头
+struct CacheMeshRecord {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t textureOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+};
+
+static_assert(std::is_trivially_copyable<_MGL Vertex>::value,
+              "Vertex must be trivially copyable to be cached");
+static_assert(std::is_trivially_copyable<_MGL MeshLod>::value &&
+                  sizeof(_MGL MeshLod) == 16,
+              "MeshLod must be tightly packed to be cached");
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// 索引均小于limit时返回true, 损坏的缓存会让绘制越界读取顶点缓冲
+bool indicesBelow(const unsigned int* indices, uint64_t count,
+                  uint32_t limit) {
+    unsigned int largest = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        largest = indices[i] > largest ? indices[i] : largest;
+    }
+    return count == 0 || largest < limit;
+}
+
+// 按偏移量写入, 中间空隙补零
+void writeAt(std::ofstream& out, uint64_t offset, const void* data,
+             size_t size) {
+    uint64_t pos = static_cast<uint64_t>(out.tellp());
+    static const char zeros[16] = {0};
+    while (pos < offset) {
+        size_t n = static_cast<size_t>(
+            offset - pos < sizeof(zeros) ? offset - pos : sizeof(zeros));
+        out.write(zeros, n);
+        pos += n;
+    }
+    out.write(static_cast<const char*>(data), size);
+}
+
+CacheMeshRecord readRecord(const unsigned char* base, size_t index) {
+    CacheMeshRecord r;
+    std::memcpy(&r,
+                base + sizeof(CacheHeader) + index * sizeof(CacheMeshRecord),
+                sizeof(r));
+    return r;
+}
+
+size_t textureBlockSize(const std::vector<_MGL Texture>& textures) {
+    size_t size = 0;
+    for (auto& t : textures) {
+        size += 2 * sizeof(uint32_t) + t.type.size() + t.path.size();
+    }
+    return size;
+}
+
+// 模型所在目录, 含末尾的'/'
+std::string directoryOf(const std::string& source) {
+    return source.substr(0, source.find_last_of("/\\") + 1);
+}
+
+bool isAbsolute(const std::string& path) {
+    return (!path.empty() && (path[0] == '/' || path[0] == '\\')) ||
+           (path.size() > 1 && path[1] == ':');
+}
+
+// 依赖文件的哈希, 不存在的文件记为0, 之后出现时缓存同样失效
+uint64_t dependencyHash(const std::string& path) {
+    uint64_t hash = 0;
+    return _MGL FileHash(path, hash) ? hash : 0;
+}
+
+// 依赖文件表中的路径 -> 可读取的路径
+std::string resolveDependency(const std::string& directory,
+                              const std::string& path) {
+    return isAbsolute(path) ? path : directory + path;
+}
+}  // namespace
+
+std::string _MGL ModelCache::cachePath(const std::string& source) {
+    return source + ".mglcache";
+}
+
+bool _MGL ModelCache::hashSource(const std::string& source, uint64_t& hash) {
+    // 资源包中的文件使用构建时记录的哈希, 无需读取
+    return FileHash(source, hash);
+}
+
+std::vector<_MGL ModelDependency> _MGL ModelCache::hashDependencies(
+    const std::string& source, const std::vector<std::string>& files) {
+    std::string directory = directoryOf(source);
+    std::string self = CanonicalPath(source);
+    std::unordered_set<std::string> seen;
+    std::vector<ModelDependency> dependencies;
+    for (const std::string& file : files) {
+        std::string key = CanonicalPath(file);
+        if (key == self || !seen.insert(key).second) continue;
+        ModelDependency dependency;
+        dependency.path = file;
+        if (!directory.empty() &&
+            file.compare(0, directory.size(), directory) == 0) {
+            dependency.path = file.substr(directory.size());
+        }
+        dependency.hash = dependencyHash(file);
+        dependencies.push_back(dependency);
+    }
+    return dependencies;
+}
+
+std::string _MGL ModelCache::dependencyPath(
+    const std::string& source, const ModelDependency& dependency) {
+    return resolveDependency(directoryOf(source), dependency.path);
+}
+
+void _MGL ModelCache::rehashDependencies(
+    const std::string& source, std::vector<ModelDependency>& dependencies) {
+    std::string directory = directoryOf(source);
+    for (auto& d : dependencies) {
+        d.hash = dependencyHash(resolveDependency(directory, d.path));
+    }
+}
+
+bool _MGL ModelCache::write(const std::string& path, uint64_t sourceHash,
+                            uint64_t settings,
+                            const std::vector<MeshData>& meshes,
+                            const std::vector<ModelDependency>& dependencies) {
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = Version;
+    header.sourceHash = sourceHash;
+    header.settings = settings;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.vertexSize = sizeof(Vertex);
+
+    // 先计算布局, 顶点按16字节对齐以便直接映射使用
+    std::vector<CacheMeshRecord> records(meshes.size());
+    uint64_t offset =
+        sizeof(CacheHeader) + records.size() * sizeof(CacheMeshRecord);
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const MeshData& mesh = meshes[i];
+        CacheMeshRecord& r = records[i];
+        r.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        r.indexCount = static_cast<uint32_t>(mesh.indices.size());
+        r.textureCount = static_cast<uint32_t>(mesh.textures.size());
+        r.lodCount = static_cast<uint32_t>(mesh.lods.size());
+        r.vertexOffset = offset = alignUp(offset, 16);
+        offset += uint64_t(r.vertexCount) * sizeof(Vertex);
+        r.indexOffset = offset = alignUp(offset, 4);
+        offset += uint64_t(r.indexCount) * sizeof(unsigned int);
+        // LOD表紧跟在索引之后
+        offset += uint64_t(r.lodCount) * sizeof(MeshLod);
+        r.textureOffset = offset;
+        offset += textureBlockSize(mesh.textures);
+    }
+    header.dependencyOffset = offset = alignUp(offset, 8);
+    header.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    header.reserved = 0;
+
+    // 先写临时文件再替换, 避免中断时留下损坏的缓存
+    std::string tmp = TempPath(path);
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()),
+                  records.size() * sizeof(CacheMeshRecord));
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            const MeshData& mesh = meshes[i];
+            const CacheMeshRecord& r = records[i];
+            writeAt(out, r.vertexOffset, mesh.vertices.data(),
+                    r.vertexCount * sizeof(Vertex));
+            writeAt(out, r.indexOffset, mesh.indices.data(),
+                    r.indexCount * sizeof(unsigned int));
+            out.write(reinterpret_cast<const char*>(mesh.lods.data()),
+                      r.lodCount * sizeof(MeshLod));
+            for (auto& t : mesh.textures) {
+                uint32_t len[2] = {static_cast<uint32_t>(t.type.size()),
+                                   static_cast<uint32_t>(t.path.size())};
+                out.write(reinterpret_cast<const char*>(len), sizeof(len));
+                out.write(t.type.data(), t.type.size());
+                out.write(t.path.data(), t.path.size());
+            }
+        }
+        for (size_t i = 0; i < dependencies.size(); ++i) {
+            const ModelDependency& d = dependencies[i];
+            uint32_t len = static_cast<uint32_t>(d.path.size());
+            if (i == 0) {
+                writeAt(out, header.dependencyOffset, &d.hash, sizeof(d.hash));
+            } else {
+                out.write(reinterpret_cast<const char*>(&d.hash),
+                          sizeof(d.hash));
+            }
+            out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+            out.write(d.path.data(), d.path.size());
+        }
+        if (!out) {
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    return ReplaceFileAtomic(tmp, path);
+}
+
+bool _MGL ModelCache::open(const std::string& path, const std::string& source,
+                           uint64_t sourceHash, uint64_t settings) {
+    dependencies.clear();
+    file = ReadFile(path);
+    if (!file.isOpen()) return false;
+    const unsigned char* base = file.data();
+    size_t size = file.size();
+
+    CacheHeader header;
+    bool valid = size >= sizeof(CacheHeader);
+    if (valid) {
+        std::memcpy(&header, base, sizeof(header));
+        uint64_t tableEnd =
+            sizeof(CacheHeader) +
+            uint64_t(header.meshCount) * sizeof(CacheMeshRecord);
+        valid = std::memcmp(header.magic, CACHE_MAGIC, 4) == 0 &&
+                header.version == Version && header.sourceHash == sourceHash &&
+                header.settings == settings &&
+                header.vertexSize == sizeof(Vertex) && tableEnd <= size;
+    }
+    // 校验每条记录均落在文件范围内, 索引均指向有效顶点
+    for (uint32_t i = 0; valid && i < header.meshCount; ++i) {
+        CacheMeshRecord r = readRecord(base, i);
+        uint64_t vertexEnd =
+            r.vertexOffset + uint64_t(r.vertexCount) * sizeof(Vertex);
+        uint64_t indexEnd =
+            r.indexOffset + uint64_t(r.indexCount) * sizeof(unsigned int);
+        uint64_t lodEnd = indexEnd + uint64_t(r.lodCount) * sizeof(MeshLod);
+        valid = r.vertexOffset % 16 == 0 && r.indexOffset % 4 == 0 &&
+                vertexEnd <= size && lodEnd <= size &&
+                r.textureOffset <= size;
+        // 索引不能超出顶点数
+        const unsigned int* indices =
+            reinterpret_cast<const unsigned int*>(base + r.indexOffset);
+        valid = valid && indicesBelow(indices, r.indexCount, r.vertexCount);
+        // 每层LOD的索引范围与顶点前缀都不能越界
+        for (uint32_t l = 0; valid && l < r.lodCount; ++l) {
+            MeshLod lod;
+            std::memcpy(&lod, base + indexEnd + l * sizeof(MeshLod),
+                        sizeof(lod));
+            uint64_t end = uint64_t(lod.indexOffset) + lod.indexCount;
+            valid = end <= r.indexCount && lod.vertexCount <= r.vertexCount &&
+                    indicesBelow(indices + lod.indexOffset, lod.indexCount,
+                                 lod.vertexCount);
+        }
+        uint64_t offset = r.textureOffset;
+        for (uint32_t t = 0; valid && t < r.textureCount; ++t) {
+            uint32_t len[2];
+            valid = offset + sizeof(len) <= size;
+            if (!valid) break;
+            std::memcpy(len, base + offset, sizeof(len));
+            offset += sizeof(len) + uint64_t(len[0]) + len[1];
+            valid = offset <= size;
+        }
+    }
+    // 读出依赖文件表, 任一文件的内容与记录不同时缓存失效
+    uint64_t offset = valid ? header.dependencyOffset : 0;
+    std::string directory = directoryOf(source);
+    for (uint32_t i = 0; valid && i < header.dependencyCount; ++i) {
+        ModelDependency d;
+        uint32_t len = 0;
+        valid = offset + sizeof(d.hash) + sizeof(len) <= size;
+        if (!valid) break;
+        std::memcpy(&d.hash, base + offset, sizeof(d.hash));
+        std::memcpy(&len, base + offset + sizeof(d.hash), sizeof(len));
+        offset += sizeof(d.hash) + sizeof(len);
+        valid = offset + len <= size;
+        if (!valid) break;
+        d.path.assign(reinterpret_cast<const char*>(base + offset), len);
+        offset += len;
+        std::string resolved = resolveDependency(directory, d.path);
+        valid = dependencyHash(resolved) == d.hash;
+        if (!valid) {
+            std::printf("MODEL::CACHE::DEPENDENCY_CHANGED %s\n",
+                        resolved.c_str());
+        }
+        dependencies.push_back(d);
+    }
+    if (!valid) {
+        file = FileData();
+        dependencies.clear();
+    }
+    return valid;
+}
+
+size_t _MGL ModelCache::meshCount() const {
+    if (!file.isOpen()) return 0;
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    return header.meshCount;
+}
+
+_MGL CachedMesh _MGL ModelCache::mesh(size_t index) const {
+    const unsigned char* base = file.data();
+    CacheMeshRecord r = readRecord(base, index);
+
+    CachedMesh mesh;
+    mesh.vertices = reinterpret_cast<const Vertex*>(base + r.vertexOffset);
+    mesh.vertexCount = r.vertexCount;
+    mesh.indices = reinterpret_cast<const unsigned int*>(base + r.indexOffset);
+    mesh.indexCount = r.indexCount;
+    mesh.lods = reinterpret_cast<const MeshLod*>(
+        base + r.indexOffset + uint64_t(r.indexCount) * sizeof(unsigned int));
+    mesh.lodCount = r.lodCount;
+    const unsigned char* p = base + r.textureOffset;
+    for (uint32_t t = 0; t < r.textureCount; ++t) {
+        uint32_t len[2];
+        std::memcpy(len, p, sizeof(len));
+        p += sizeof(len);
+        Texture texture;
+        texture.id = 0;
+        texture.type.assign(reinterpret_cast<const char*>(p), len[0]);
+        p += len[0];
+        texture.path.assign(reinterpret_cast<const char*>(p), len[1]);
+        p += len[1];
+        mesh.textures.push_back(texture);
+    }
+    return mesh;
+}
@@ -0,0 +1,60 @@
+﻿#include "header/ModelRegistry.h"
+#include "header/FileSystem.h"
+
+namespace {
+std::string registryKey(const std::string& path, bool gamma) {
+    return mgl::CanonicalPath(path) + (gamma ? "|gamma" : "");
+}
+}  // namespace
+
+_MGL ModelRegistry& _MGL ModelRegistry::instance() {
+    static ModelRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<const _MGL Model> _MGL ModelRegistry::load(
+    const std::string& path, bool gamma) {
+    std::string key = registryKey(path, gamma);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = models.find(key);
+    if (it != models.end()) {
+        if (auto existing = it->second.lock()) return existing;
+    }
+    std::shared_ptr<const Model> model = std::make_shared<Model>(path, gamma);
+    models[key] = model;
+    return model;
+}
+
+void _MGL ModelRegistry::insert(const std::string& path, bool gamma,
+                                std::shared_ptr<const Model> model) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::weak_ptr<const Model>& slot = models[registryKey(path, gamma)];
+    if (slot.expired()) slot = model;
+}
+
+size_t _MGL ModelRegistry::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (auto it = models.begin(); it != models.end();) {
+        if (it->second.expired()) {
+            it = models.erase(it);
+        } else {
+            ++count;
+            ++it;
+        }
+    }
+    return count;
+}
+
+_MGL ModelInstance::ModelInstance(const std::string& path, bool gamma)
+    : model(ModelRegistry::instance().load(path, gamma)),
+      transform(1.0f) {}
+
+_MGL ModelInstance::ModelInstance(std::shared_ptr<const Model> model,
+                                  const glm::mat4& transform)
+    : model(std::move(model)), transform(transform) {}
+
+void _MGL ModelInstance::Draw(Shader& shader) const {
+    shader.setUniformM("model", transform);
+    model->Draw(shader);
+}
@@ -0,0 +1,546 @@
+﻿#include "header/ObjLoader.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include "header/Memory.h"
+#include "header/MeshProcess.h"
+#include "header/ThreadPool.h"
+#include "header/VirtualFileSystem.h"
+
+namespace {
+// 每个解析块的最小字节数
+const size_t MIN_CHUNK_BYTES = 64 * 1024;
+
+// 10的整数次幂表, 用于快速浮点解析
+const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+inline bool isDigit(char c) { return static_cast<unsigned>(c - '0') < 10u; }
+
+inline const char* skipSpace(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+inline const char* skipLine(const char* p, const char* end) {
+    const char* nl =
+        static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+    return nl ? nl + 1 : end;
+}
+
+/**
+ * 解析十进制浮点数. 尾数以整数累加, 最后乘一次10的幂,
+ * 没有逐字符的浮点运算与locale查询. 特殊格式(nan, inf, 超长尾数)回退到strtod
+ */
+const char* parseFloat(const char* p, const char* end, float& out) {
+    p = skipSpace(p, end);
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    while (p < end && isDigit(*p)) {
+        mantissa = mantissa * 10 + uint64_t(*p++ - '0');
+        ++digits;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && isDigit(*p)) {
+            mantissa = mantissa * 10 + uint64_t(*p++ - '0');
+            ++digits;
+            --exponent;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negExp = false;
+        if (p < end && (*p == '-' || *p == '+')) negExp = *p++ == '-';
+        int e = 0;
+        while (p < end && isDigit(*p)) e = e * 10 + (*p++ - '0');
+        exponent += negExp ? -e : e;
+    }
+    if (digits == 0 || digits > 18 || exponent < -22 || exponent > 22) {
+        // 罕见情况交给标准库
+        char buffer[64];
+        size_t n = 0;
+        for (const char* q = start; q < end && !isSpace(*q) && *q != '\n' &&
+                                    n + 1 < sizeof(buffer);
+             ++q) {
+            buffer[n++] = *q;
+        }
+        buffer[n] = '\0';
+        char* stop = nullptr;
+        out = static_cast<float>(std::strtod(buffer, &stop));
+        return start + (stop - buffer);
+    }
+    double value = double(mantissa);
+    value = exponent < 0 ? value / POW10[-exponent] : value * POW10[exponent];
+    out = static_cast<float>(negative ? -value : value);
+    return p;
+}
+
+inline const char* parseInt(const char* p, const char* end, int& out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    int value = 0;
+    while (p < end && isDigit(*p)) value = value * 10 + (*p++ - '0');
+    out = negative ? -value : value;
+    return p;
+}
+
+// 读取行内剩余内容并去掉首尾空白
+std::string restOfLine(const char* p, const char* end) {
+    p = skipSpace(p, end);
+    const char* e = p;
+    while (e < end && *e != '\n') ++e;
+    while (e > p && isSpace(e[-1])) --e;
+    return std::string(p, e);
+}
+
+// 面的一个角, 保存文件中的原始索引, 0表示缺省
+struct ObjCorner {
+    int v, vt, vn;
+};
+
+// 顶点去重的键: 解析后的 (v, vt, vn), 缺省的vt, vn为-1.
+// 三个字段完整保存并逐一比较, 索引再大也不会混淆
+struct CornerKey {
+    long v, vt, vn;
+    bool operator==(const CornerKey& other) const {
+        return v == other.v && vt == other.vt && vn == other.vn;
+    }
+};
+
+struct CornerKeyHash {
+    size_t operator()(const CornerKey& key) const {
+        // 各字段乘以不同的奇数常量后混合, 再折叠高位
+        uint64_t h = uint64_t(key.v) * 0x9E3779B97F4A7C15ull;
+        h ^= uint64_t(key.vt + 1) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+        h ^= uint64_t(key.vn + 1) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+};
+
+// 面, 记录解析到该面时块内已有的属性数量, 用于解析负数(相对)索引
+struct ObjFace {
+    uint32_t first;
+    uint32_t count;
+    uint32_t vBase, vtBase, vnBase;
+};
+
+// 切分网格的事件: o, g, usemtl
+struct ObjEvent {
+    enum Kind { Object, Group, Material };
+    // 事件发生前块内已有的面数
+    size_t face;
+    Kind kind;
+    std::string name;
+};
+
+// 一个解析块的结果
+struct ObjChunk {
+    std::vector<float> positions;
+    std::vector<float> uvs;
+    std::vector<float> normals;
+    std::vector<ObjCorner> corners;
+    std::vector<ObjFace> faces;
+    std::vector<ObjEvent> events;
+    std::vector<std::string> mtllibs;
+};
+
+void parseChunk(const char* p, const char* end, ObjChunk& chunk) {
+    // 按平均行长预估容量, 减少重新分配
+    size_t estimate = size_t(end - p) / 32;
+    chunk.positions.reserve(estimate);
+    chunk.corners.reserve(estimate);
+    _MGL CountAllocation(estimate * (sizeof(float) + sizeof(ObjCorner)));
+    while (p < end) {
+        p = skipSpace(p, end);
+        if (p >= end) break;
+        char c = *p;
+        if (c == 'v' && p + 1 < end) {
+            char k = p[1];
+            if (isSpace(k)) {
+                float x, y, z;
+                p = parseFloat(p + 1, end, x);
+                p = parseFloat(p, end, y);
+                p = parseFloat(p, end, z);
+                chunk.positions.push_back(x);
+                chunk.positions.push_back(y);
+                chunk.positions.push_back(z);
+            } else if (k == 't') {
+                float u, v = 0.0f;
+                p = parseFloat(p + 2, end, u);
+                const char* q = skipSpace(p, end);
+                if (q < end && *q != '\n') p = parseFloat(q, end, v);
+                chunk.uvs.push_back(u);
+                chunk.uvs.push_back(v);
+            } else if (k == 'n') {
+                float x, y, z;
+                p = parseFloat(p + 2, end, x);
+                p = parseFloat(p, end, y);
+                p = parseFloat(p, end, z);
+                chunk.normals.push_back(x);
+                chunk.normals.push_back(y);
+                chunk.normals.push_back(z);
+            }
+        } else if (c == 'f' && p + 1 < end && isSpace(p[1])) {
+            ObjFace face;
+            face.first = static_cast<uint32_t>(chunk.corners.size());
+            face.vBase = static_cast<uint32_t>(chunk.positions.size() / 3);
+            face.vtBase = static_cast<uint32_t>(chunk.uvs.size() / 2);
+            face.vnBase = static_cast<uint32_t>(chunk.normals.size() / 3);
+            ++p;
+            for (;;) {
+                p = skipSpace(p, end);
+                if (p >= end || *p == '\n' || *p == '#') break;
+                ObjCorner corner = {0, 0, 0};
+                p = parseInt(p, end, corner.v);
+                if (p < end && *p == '/') {
+                    ++p;
+                    if (p < end && *p != '/') p = parseInt(p, end, corner.vt);
+                    if (p < end && *p == '/') {
+                        p = parseInt(p + 1, end, corner.vn);
+                    }
+                }
+                if (corner.v == 0) break;
+                chunk.corners.push_back(corner);
+            }
+            face.count =
+                static_cast<uint32_t>(chunk.corners.size()) - face.first;
+            if (face.count >= 3) {
+                chunk.faces.push_back(face);
+            } else {
+                chunk.corners.resize(face.first);
+            }
+        } else if ((c == 'o' || c == 'g') && p + 1 < end && isSpace(p[1])) {
+            ObjEvent event;
+            event.face = chunk.faces.size();
+            event.kind = c == 'o' ? ObjEvent::Object : ObjEvent::Group;
+            event.name = restOfLine(p + 1, end);
+            chunk.events.push_back(event);
+        } else if (c == 'u' && size_t(end - p) > 7 &&
+                   std::strncmp(p, "usemtl", 6) == 0 && isSpace(p[6])) {
+            ObjEvent event;
+            event.face = chunk.faces.size();
+            event.kind = ObjEvent::Material;
+            event.name = restOfLine(p + 6, end);
+            chunk.events.push_back(event);
+        } else if (c == 'm' && size_t(end - p) > 7 &&
+                   std::strncmp(p, "mtllib", 6) == 0 && isSpace(p[6])) {
+            chunk.mtllibs.push_back(restOfLine(p + 6, end));
+        }
+        p = skipLine(p, end);
+    }
+}
+
+// MTL材质中模型使用的贴图
+struct ObjMaterial {
+    std::vector<_MGL Texture> textures;
+};
+
+// 取贴图语句中的文件名, 跳过 -bm 0.5 之类的选项
+std::string mapFile(const std::string& args) {
+    size_t pos = args.find_last_of(" \t");
+    return pos == std::string::npos ? args : args.substr(pos + 1);
+}
+
+void parseMtl(const std::string& path,
+              std::unordered_map<std::string, ObjMaterial>& materials) {
+    _MGL FileData file = _MGL ReadFile(path);
+    if (!file.isOpen()) {
+        std::printf("WARNING::OBJ::MTL_NOT_FOUND %s\n", path.c_str());
+        return;
+    }
+    // 与Assimp的映射保持一致: map_Bump -> HEIGHT -> texture_normal,
+    // map_Ka -> AMBIENT -> texture_height
+    static const struct {
+        const char* keyword;
+        int slot;
+    } MAPS[] = {{"map_Kd", 0},   {"map_Ks", 1}, {"map_Bump", 2},
+                {"map_bump", 2}, {"bump", 2},   {"map_Ka", 3}};
+    static const char* SLOT_NAMES[] = {"texture_diffuse", "texture_specular",
+                                       "texture_normal", "texture_height"};
+
+    const char* p = reinterpret_cast<const char*>(file.data());
+    const char* end = p + file.size();
+    ObjMaterial* current = nullptr;
+    std::vector<std::string> slots[4];
+    auto flush = [&]() {
+        if (!current) return;
+        for (int s = 0; s < 4; ++s) {
+            for (auto& f : slots[s]) {
+                _MGL Texture texture;
+                texture.id = 0;
+                texture.type = SLOT_NAMES[s];
+                texture.path = f;
+                current->textures.push_back(texture);
+            }
+            slots[s].clear();
+        }
+    };
+    while (p < end) {
+        p = skipSpace(p, end);
+        const char* word = p;
+        while (p < end && !isSpace(*p) && *p != '\n') ++p;
+        std::string keyword(word, p);
+        if (keyword == "newmtl") {
+            flush();
+            current = &materials[restOfLine(p, end)];
+        } else if (current) {
+            for (auto& m : MAPS) {
+                if (keyword == m.keyword) {
+                    slots[m.slot].push_back(mapFile(restOfLine(p, end)));
+                    break;
+                }
+            }
+        }
+        p = skipLine(p, end);
+    }
+    flush();
+}
+
+// 一个输出网格对应的面范围
+struct ObjRange {
+    size_t chunk;
+    size_t firstFace;
+    size_t endFace;
+};
+
+struct ObjMeshPlan {
+    std::string material;
+    std::vector<ObjRange> ranges;
+};
+
+// 全部块合并后的属性
+struct ObjAttributes {
+    std::vector<float> positions;
+    std::vector<float> uvs;
+    std::vector<float> normals;
+};
+
+inline long resolveIndex(int raw, size_t prefix, uint32_t base) {
+    if (raw > 0) return long(raw) - 1;
+    if (raw < 0) return long(prefix) + long(base) + raw;
+    return -1;
+}
+
+inline glm::vec3 vec3At(const std::vector<float>& a, long i) {
+    return glm::vec3(a[3 * i], a[3 * i + 1], a[3 * i + 2]);
+}
+
+void buildMesh(const std::vector<ObjChunk>& chunks,
+               const std::vector<size_t>& vPrefix,
+               const std::vector<size_t>& vtPrefix,
+               const std::vector<size_t>& vnPrefix,
+               const ObjAttributes& attributes, const ObjMeshPlan& plan,
+               _MGL MeshData& mesh) {
+    size_t cornerCount = 0;
+    size_t triangleCount = 0;
+    for (auto& r : plan.ranges) {
+        for (size_t f = r.firstFace; f < r.endFace; ++f) {
+            cornerCount += chunks[r.chunk].faces[f].count;
+            triangleCount += chunks[r.chunk].faces[f].count - 2;
+        }
+    }
+    mesh.vertices.reserve(cornerCount);
+    mesh.indices.reserve(triangleCount * 3);
+    _MGL CountAllocation(cornerCount * sizeof(_MGL Vertex));
+    _MGL CountAllocation(triangleCount * 3 * sizeof(unsigned int));
+
+    const long positionCount = long(attributes.positions.size() / 3);
+    const long uvCount = long(attributes.uvs.size() / 2);
+    const long normalCount = long(attributes.normals.size() / 3);
+    bool hasNormals = true;
+    bool hasUVs = true;
+    // 临时数据来自线程的分配器, 网格组装完成后整体回退
+    typedef std::pair<const CornerKey, unsigned int> Entry;
+    _MGL Arena& arena = _MGL threadArena();
+    _MGL ArenaScope scope(arena);
+    // (v, vt, vn) -> 输出顶点序号
+    std::unordered_map<CornerKey, unsigned int, CornerKeyHash,
+                       std::equal_to<CornerKey>, _MGL ArenaAllocator<Entry>>
+        lookup(cornerCount, CornerKeyHash(), std::equal_to<CornerKey>(),
+               _MGL ArenaAllocator<Entry>(arena));
+    _MGL ArenaVector<unsigned int> polygon(
+        (_MGL ArenaAllocator<unsigned int>(arena)));
+    polygon.reserve(64);
+    for (auto& r : plan.ranges) {
+        const ObjChunk& chunk = chunks[r.chunk];
+        for (size_t f = r.firstFace; f < r.endFace; ++f) {
+            const ObjFace& face = chunk.faces[f];
+            polygon.clear();
+            for (uint32_t c = 0; c < face.count; ++c) {
+                const ObjCorner& corner = chunk.corners[face.first + c];
+                long v = resolveIndex(corner.v, vPrefix[r.chunk], face.vBase);
+                long vt =
+                    resolveIndex(corner.vt, vtPrefix[r.chunk], face.vtBase);
+                long vn =
+                    resolveIndex(corner.vn, vnPrefix[r.chunk], face.vnBase);
+                if (v < 0 || v >= positionCount) v = 0;
+                if (vt >= uvCount) vt = -1;
+                if (vn >= normalCount) vn = -1;
+                CornerKey key = {v, vt, vn};
+                auto it = lookup.find(key);
+                if (it != lookup.end()) {
+                    polygon.push_back(it->second);
+                    continue;
+                }
+                _MGL Vertex vertex = _MGL Vertex();
+                vertex.Position = vec3At(attributes.positions, v);
+                if (vn >= 0) {
+                    vertex.Normal = vec3At(attributes.normals, vn);
+                } else {
+                    hasNormals = false;
+                }
+                if (vt >= 0) {
+                    // 与aiProcess_FlipUVs一致
+                    vertex.TexCoords =
+                        glm::vec2(attributes.uvs[2 * vt],
+                                  1.0f - attributes.uvs[2 * vt + 1]);
+                } else {
+                    hasUVs = false;
+                }
+                unsigned int index =
+                    static_cast<unsigned int>(mesh.vertices.size());
+                mesh.vertices.push_back(vertex);
+                lookup.emplace(key, index);
+                polygon.push_back(index);
+            }
+            // 扇形三角化
+            for (size_t k = 1; k + 1 < polygon.size(); ++k) {
+                mesh.indices.push_back(polygon[0]);
+                mesh.indices.push_back(polygon[k]);
+                mesh.indices.push_back(polygon[k + 1]);
+            }
+        }
+    }
+    _MGL CountCopy(mesh.vertices.size() * sizeof(_MGL Vertex));
+    if (!hasNormals || !HasValidNormals(mesh)) GenerateSmoothNormals(mesh);
+    // 只在有纹理坐标时计算切线空间
+    if (hasUVs) GenerateTangents(mesh);
+}
+}  // namespace
+
+bool _MGL LoadObj(const std::string& path, std::vector<MeshData>& meshes,
+                  std::vector<std::string>* dependencies) {
+    FileData file = ReadFile(path);
+    if (!file.isOpen()) {
+        std::printf("ERROR::OBJ::FILE_NOT_SUCCESFULLY_READ %s\n",
+                    path.c_str());
+        return false;
+    }
+    const char* begin = reinterpret_cast<const char*>(file.data());
+    const char* end = begin + file.size();
+
+    // 在行边界处切块
+    ThreadPool& pool = workerPool();
+    size_t chunkCount = std::max<size_t>(
+        1, std::min<size_t>(pool.size() * 4, file.size() / MIN_CHUNK_BYTES));
+    std::vector<const char*> bounds(1, begin);
+    for (size_t i = 1; i < chunkCount; ++i) {
+        const char* p = begin + file.size() * i / chunkCount;
+        if (p <= bounds.back()) continue;
+        p = skipLine(p, end);
+        if (p < end && p > bounds.back()) bounds.push_back(p);
+    }
+    bounds.push_back(end);
+    chunkCount = bounds.size() - 1;
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    ParallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            parseChunk(bounds[i], bounds[i + 1], chunks[i]);
+        }
+    }, pool);
+
+    // 各块属性的全局偏移, 并合并属性数组
+    std::vector<size_t> vPrefix(chunkCount), vtPrefix(chunkCount),
+        vnPrefix(chunkCount);
+    ObjAttributes attributes;
+    size_t nv = 0, nvt = 0, nvn = 0;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        vPrefix[i] = nv;
+        vtPrefix[i] = nvt;
+        vnPrefix[i] = nvn;
+        nv += chunks[i].positions.size() / 3;
+        nvt += chunks[i].uvs.size() / 2;
+        nvn += chunks[i].normals.size() / 3;
+    }
+    attributes.positions.reserve(nv * 3);
+    attributes.uvs.reserve(nvt * 2);
+    attributes.normals.reserve(nvn * 3);
+    CountAllocation(nv * 3 * sizeof(float));
+    CountAllocation(nvt * 2 * sizeof(float));
+    CountAllocation(nvn * 3 * sizeof(float));
+    CountCopy((nv * 3 + nvt * 2 + nvn * 3) * sizeof(float));
+    for (auto& chunk : chunks) {
+        attributes.positions.insert(attributes.positions.end(),
+                                    chunk.positions.begin(),
+                                    chunk.positions.end());
+        attributes.uvs.insert(attributes.uvs.end(), chunk.uvs.begin(),
+                              chunk.uvs.end());
+        attributes.normals.insert(attributes.normals.end(),
+                                  chunk.normals.begin(), chunk.normals.end());
+        std::vector<float>().swap(chunk.positions);
+        std::vector<float>().swap(chunk.uvs);
+        std::vector<float>().swap(chunk.normals);
+    }
+    if (nv == 0) {
+        std::printf("ERROR::OBJ::NO_VERTICES %s\n", path.c_str());
+        return false;
+    }
+
+    // 按 o/g/usemtl 切分网格, 与Assimp一样每个对象的每种材质一个网格
+    std::vector<ObjMeshPlan> plans(1);
+    std::string material;
+    auto split = [&]() {
+        if (!plans.back().ranges.empty()) plans.emplace_back();
+        plans.back().material = material;
+    };
+    for (size_t c = 0; c < chunkCount; ++c) {
+        const ObjChunk& chunk = chunks[c];
+        size_t face = 0;
+        auto addRange = [&](size_t endFace) {
+            if (endFace > face) {
+                plans.back().ranges.push_back({c, face, endFace});
+                face = endFace;
+            }
+        };
+        for (auto& event : chunk.events) {
+            addRange(event.face);
+            if (event.kind == ObjEvent::Material) material = event.name;
+            split();
+        }
+        addRange(chunk.faces.size());
+    }
+    if (plans.back().ranges.empty()) plans.pop_back();
+
+    std::unordered_map<std::string, ObjMaterial> materials;
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    for (auto& chunk : chunks) {
+        for (auto& lib : chunk.mtllibs) {
+            parseMtl(directory + lib, materials);
+            if (dependencies) dependencies->push_back(directory + lib);
+        }
+    }
+
+    // 各网格互相独立, 并行组装
+    size_t first = meshes.size();
+    meshes.resize(first + plans.size());
+    ParallelFor(plans.size(), 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) {
+            buildMesh(chunks, vPrefix, vtPrefix, vnPrefix, attributes,
+                      plans[i], meshes[first + i]);
+            auto it = materials.find(plans[i].material);
+            if (it != materials.end()) {
+                meshes[first + i].textures = it->second.textures;
+            }
+        }
+    }, pool);
+    return true;
+}
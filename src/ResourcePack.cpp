@@ -0,0 +1,237 @@
+﻿#include "header/ResourcePack.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "header/FileSystem.h"
+#include "header/Hash.h"
+#include "header/Lz4.h"
+
+namespace {
+const char PACK_MAGIC[4] = {'M', 'G', 'L', 'P'};
+
+// 包文件头
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t tocOffset;
+    uint64_t tocSize;
+};
+
+// 目录表中的一条记录, 其后紧跟pathLength字节的路径
+struct PackRecord {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t rawSize;
+    uint64_t contentHash;
+    uint32_t compression;
+    uint32_t pathLength;
+};
+
+// 这些文件在运行时被直接映射使用, 不压缩
+const char* const MAPPED_EXTENSIONS[] = {".mglcache", ".mgli", ".mglcube",
+                                         ".mglibl"};
+
+inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool endsWith(const std::string& s, const char* suffix) {
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// 查找用的键, 与CanonicalPath一致, Windows下不区分大小写
+std::string lookupKey(const std::string& path) {
+    std::string key = path;
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    std::transform(key.begin(), key.end(), key.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+#endif
+    return key;
+}
+
+// 按偏移量写入, 中间空隙补零
+void writeAt(std::ofstream& out, uint64_t offset, const void* data,
+             size_t size) {
+    uint64_t pos = static_cast<uint64_t>(out.tellp());
+    static const char zeros[16] = {0};
+    while (pos < offset) {
+        size_t n = static_cast<size_t>(
+            offset - pos < sizeof(zeros) ? offset - pos : sizeof(zeros));
+        out.write(zeros, n);
+        pos += n;
+    }
+    out.write(static_cast<const char*>(data), size);
+}
+}  // namespace
+
+bool _MGL ResourcePack::open(const std::string& path) {
+    entries.clear();
+    index.clear();
+    if (!file.open(path)) return false;
+    const unsigned char* base = file.data();
+    uint64_t size = file.size();
+
+    PackHeader header = {};
+    bool valid = size >= sizeof(PackHeader);
+    if (valid) {
+        std::memcpy(&header, base, sizeof(header));
+        valid = std::memcmp(header.magic, PACK_MAGIC, 4) == 0 &&
+                header.version == Version && header.tocOffset <= size &&
+                header.tocSize <= size - header.tocOffset;
+    }
+    // 逐条读取目录表, 校验每个条目均落在数据区内
+    uint64_t offset = header.tocOffset;
+    uint64_t tocEnd = header.tocOffset + header.tocSize;
+    for (uint32_t i = 0; valid && i < header.entryCount; ++i) {
+        PackRecord r;
+        valid = offset + sizeof(r) <= tocEnd;
+        if (!valid) break;
+        std::memcpy(&r, base + offset, sizeof(r));
+        offset += sizeof(r);
+        valid = r.pathLength <= tocEnd - offset &&
+                r.offset <= header.tocOffset &&
+                r.size <= header.tocOffset - r.offset &&
+                (r.compression == Lz4 ||
+                 (r.compression == Stored && r.size == r.rawSize));
+        if (!valid) break;
+        PackEntry entry;
+        entry.path.assign(reinterpret_cast<const char*>(base + offset),
+                          r.pathLength);
+        offset += r.pathLength;
+        entry.offset = r.offset;
+        entry.size = r.size;
+        entry.rawSize = r.rawSize;
+        entry.contentHash = r.contentHash;
+        entry.compression = r.compression;
+        index[lookupKey(entry.path)] = entries.size();
+        entries.push_back(std::move(entry));
+    }
+    if (!valid) {
+        entries.clear();
+        index.clear();
+        file.close();
+    }
+    return valid;
+}
+
+const _MGL PackEntry* _MGL ResourcePack::find(const std::string& path) const {
+    auto it = index.find(lookupKey(path));
+    return it == index.end() ? nullptr : &entries[it->second];
+}
+
+const unsigned char* _MGL ResourcePack::view(const PackEntry& entry) const {
+    if (entry.compression != Stored) return nullptr;
+    return file.data() + entry.offset;
+}
+
+bool _MGL ResourcePack::read(const PackEntry& entry,
+                             std::vector<unsigned char>& out) const {
+    const unsigned char* data = file.data() + entry.offset;
+    size_t size = static_cast<size_t>(entry.size);
+    if (entry.compression == Stored) {
+        out.assign(data, data + size);
+        return true;
+    }
+    out.resize(static_cast<size_t>(entry.rawSize));
+    if (!Lz4Decompress(data, size, out.data(), out.size())) {
+        out.clear();
+        return false;
+    }
+    return true;
+}
+
+bool _MGL BuildResourcePack(const std::string& directory,
+                            const std::string& prefix,
+                            const std::string& output,
+                            PackBuildStats* stats) {
+    PackBuildStats local;
+    PackBuildStats& s = stats ? *stats : local;
+    std::string outputKey = CanonicalPath(output);
+    std::vector<std::string> files = ListFiles(directory);
+
+    std::string tmp = TempPath(output);
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    PackHeader header;
+    std::memset(&header, 0, sizeof(header));
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<std::string> paths;
+    std::vector<PackRecord> records;
+    uint64_t offset = sizeof(PackHeader);
+    std::vector<unsigned char> packed;
+    for (auto& name : files) {
+        std::string filename = directory + '/' + name;
+        // 跳过未完成的临时文件与输出文件本身
+        if (endsWith(name, ".tmp") || CanonicalPath(filename) == outputKey) {
+            continue;
+        }
+        std::ifstream in(filename, std::ios::binary);
+        if (!in) {
+            std::printf("ERROR::PACK::READ %s\n", filename.c_str());
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+        std::vector<unsigned char> raw((std::istreambuf_iterator<char>(in)),
+                                       std::istreambuf_iterator<char>());
+        PackRecord r;
+        r.rawSize = raw.size();
+        r.contentHash = HashBytes(raw.data(), raw.size());
+        r.compression = ResourcePack::Stored;
+        const unsigned char* data = raw.data();
+        size_t size = raw.size();
+
+        bool mapped = false;
+        for (const char* ext : MAPPED_EXTENSIONS) mapped |= endsWith(name, ext);
+        if (!mapped && !raw.empty()) {
+            packed.resize(Lz4CompressBound(raw.size()));
+            size_t n = Lz4Compress(raw.data(), raw.size(), packed.data(),
+                                   packed.size());
+            if (n != 0 && n < raw.size() - raw.size() / 8) {
+                r.compression = ResourcePack::Lz4;
+                data = packed.data();
+                size = n;
+                ++s.compressed;
+            }
+        }
+        r.offset = offset = alignUp(offset, ResourcePack::Alignment);
+        r.size = size;
+        writeAt(out, r.offset, data, size);
+        offset += size;
+
+        paths.push_back(prefix.empty() ? name : prefix + '/' + name);
+        r.pathLength = static_cast<uint32_t>(paths.back().size());
+        records.push_back(r);
+        ++s.files;
+        s.rawBytes += r.rawSize;
+    }
+
+    header.tocOffset = offset = alignUp(offset, ResourcePack::Alignment);
+    for (size_t i = 0; i < records.size(); ++i) {
+        writeAt(out, offset, &records[i], sizeof(PackRecord));
+        offset += sizeof(PackRecord);
+        out.write(paths[i].data(), paths[i].size());
+        offset += paths[i].size();
+    }
+    std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = ResourcePack::Version;
+    header.entryCount = static_cast<uint32_t>(records.size());
+    header.tocSize = offset - header.tocOffset;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    s.packedBytes = offset;
+    if (!out) {
+        out.close();
+        std::remove(tmp.c_str());
+        return false;
+    }
+    out.close();
+    return ReplaceFileAtomic(tmp, output);
+}
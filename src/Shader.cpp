@@ -1,4 +1,7 @@
-#include "header/Shader.h"
+﻿#include "header/Shader.h"
+#include "header/AsyncFile.h"
+#include "header/Cook.h"
+#include "header/VirtualFileSystem.h"
 using namespace std;
 
 const char* _MGL ShaderFileType::Vert = ".vert";
@@ -8,31 +11,41 @@ const char* _MGL ShaderFileType::Tese = ".tese";
 const char* _MGL ShaderFileType::Geom = ".geom";
 const char* _MGL ShaderFileType::Comp = ".comp";
 
+namespace {
+// 优先读取烘焙后的源码, 资源包挂载时从包中读取
+string sourceFile(const string& path) {
+    string cooked = _MGL FindCooked(path, _MGL ShaderCookSettings());
+    return cooked.empty() ? path : cooked;
+}
+}  // namespace
+
 _MGL Shader::Shader(initializer_list<string> list) {
+    // 各阶段实际读取的文件一起读入
+    vector<string> files;
+    for (auto& path : list) files.push_back(sourceFile(path));
+    ReadBatch batch(files);
+    size_t i = 0;
     for (auto a = list.begin(); a != list.end(); ++a) {
-        readShader(*a);
+        readShader(*a, files[i++]);
     }
 }
 
 void _MGL Shader::readShader(const string& path) {
+    readShader(path, sourceFile(path));
+}
+
+void _MGL Shader::readShader(const string& path, const string& source) {
     auto type = getShaderType(path);
     if (type == ShaderType::Unknown) {
         throw shader_exception(
             FileError, "Shader file is error, The file type cannot be judged");
     }
-    string code;
-    ifstream shaderFile;
-    shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        shaderFile.open(path);
-        stringstream shaderStream;
-        shaderStream << shaderFile.rdbuf();
-        shaderFile.close();
-        code = shaderStream.str();
-    } catch (ifstream::failure e) {
+    FileData file = ReadFile(source);
+    if (!file.isOpen()) {
         throw shader_exception(FileError,
                                "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ");
     }
+    string code(reinterpret_cast<const char*>(file.data()), file.size());
     shaderList.push_back(make_pair(path, code));
 }
 
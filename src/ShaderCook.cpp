@@ -0,0 +1,53 @@
+﻿#include "header/Cook.h"
+#include <algorithm>
+#include "header/Hash.h"
+
+namespace {
+// 着色器烘焙版本, 修改处理方式时递增
+const uint32_t SHADER_COOK_VERSION = 1;
+}  // namespace
+
+uint64_t _MGL ShaderCookSettings() {
+    return HashCombine(FNV_OFFSET_BASIS, SHADER_COOK_VERSION);
+}
+
+std::string _MGL CookShaderSource(const std::string& source) {
+    std::string out;
+    out.reserve(source.size());
+    // 去掉当前行末尾的空白
+    auto trim = [&]() {
+        while (!out.empty() && (out.back() == ' ' || out.back() == '\t')) {
+            out.pop_back();
+        }
+    };
+    size_t n = source.size();
+    for (size_t i = 0; i < n;) {
+        char c = source[i];
+        char next = i + 1 < n ? source[i + 1] : '\0';
+        if (c == '/' && next == '/') {
+            while (i < n && source[i] != '\n') ++i;
+        } else if (c == '/' && next == '*') {
+            // 块注释中的换行保留, 注释本身替换为一个空格以免记号相连
+            for (i += 2; i < n; ++i) {
+                if (source[i] == '*' && i + 1 < n && source[i + 1] == '/') {
+                    break;
+                }
+                if (source[i] == '\n') {
+                    trim();
+                    out += '\n';
+                }
+            }
+            i = std::min(n, i + 2);
+            out += ' ';
+        } else if (c == '\n') {
+            trim();
+            out += '\n';
+            ++i;
+        } else {
+            if (c != '\r') out += c;
+            ++i;
+        }
+    }
+    trim();
+    return out;
+}
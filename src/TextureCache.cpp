@@ -0,0 +1,98 @@
+﻿#include "header/TextureCache.h"
+#include <glad/glad.h>
+#include <cstring>
+#include "header/VirtualFileSystem.h"
+
+namespace {
+// 两个文件的内容是否逐字节相同
+bool sameFileContent(const std::string& a, const std::string& b) {
+    if (a == b) return true;
+    _MGL FileData first = _MGL ReadFile(a);
+    _MGL FileData second = _MGL ReadFile(b);
+    return first.isOpen() && second.isOpen() &&
+           first.size() == second.size() &&
+           std::memcmp(first.data(), second.data(), first.size()) == 0;
+}
+}  // namespace
+
+_MGL TextureCache& _MGL TextureCache::instance() {
+    static TextureCache cache;
+    return cache;
+}
+
+bool _MGL TextureCache::acquire(const std::string& key, unsigned int& id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = byPath.find(key);
+    if (it == byPath.end()) return false;
+    id = it->second;
+    ++entries[id].refs;
+    return true;
+}
+
+bool _MGL TextureCache::acquireContent(const std::string& key,
+                                       uint64_t contentHash,
+                                       unsigned int& id) {
+    unsigned int candidate = 0;
+    std::string source;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = byContent.find(contentHash);
+        if (it == byContent.end()) return false;
+        candidate = it->second;
+        source = entries[candidate].keys.front();
+    }
+    // 哈希不能排除碰撞, 读取两个文件逐字节比较, 期间不持有锁
+    if (!sameFileContent(source, key)) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = byContent.find(contentHash);
+    if (it == byContent.end() || it->second != candidate) return false;
+    id = candidate;
+    Entry& entry = entries[id];
+    ++entry.refs;
+    if (byPath.emplace(key, id).second) entry.keys.push_back(key);
+    return true;
+}
+
+bool _MGL TextureCache::hasContent(uint64_t contentHash) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return byContent.count(contentHash) != 0;
+}
+
+bool _MGL TextureCache::contains(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return byPath.count(key) != 0;
+}
+
+void _MGL TextureCache::insert(const std::string& key, unsigned int id,
+                               uint64_t contentHash, bool hashed) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = entries[id];
+    entry.id = id;
+    entry.refs = 1;
+    entry.contentHash = contentHash;
+    entry.hashed = hashed;
+    entry.keys.assign(1, key);
+    byPath[key] = id;
+    if (hashed) byContent.emplace(contentHash, id);
+}
+
+void _MGL TextureCache::release(unsigned int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(id);
+    if (it == entries.end() || --it->second.refs != 0) return;
+    for (auto& key : it->second.keys) {
+        auto p = byPath.find(key);
+        if (p != byPath.end() && p->second == id) byPath.erase(p);
+    }
+    if (it->second.hashed) {
+        auto c = byContent.find(it->second.contentHash);
+        if (c != byContent.end() && c->second == id) byContent.erase(c);
+    }
+    entries.erase(it);
+    glDeleteTextures(1, &id);
+}
+
+size_t _MGL TextureCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
@@ -0,0 +1,408 @@
+﻿#include "header/TextureCompress.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MGL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+// Kaiser窗口的形状参数
+const double KAISER_BETA = 4.0;
+const double PI = 3.14159265358979323846;
+
+// 一个4x4块的RGBA像素
+struct Block {
+    unsigned char px[16][4];
+};
+
+// 取出(x, y)处的块, 越界的像素重复边缘
+void loadBlock(const unsigned char* rgba, int width, int height, int x, int y,
+               Block& block) {
+    for (int j = 0; j < 4; ++j) {
+        int sy = std::min(y + j, height - 1);
+        for (int i = 0; i < 4; ++i) {
+            int sx = std::min(x + i, width - 1);
+            std::memcpy(block.px[j * 4 + i],
+                        rgba + (size_t(sy) * width + sx) * 4, 4);
+        }
+    }
+}
+
+uint16_t to565(int r, int g, int b) {
+    return static_cast<uint16_t>(((r * 31 + 127) / 255) << 11 |
+                                 ((g * 63 + 127) / 255) << 5 |
+                                 ((b * 31 + 127) / 255));
+}
+
+void from565(uint16_t c, int rgb[3]) {
+    int r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// BC1颜色块, 始终使用四色模式(c0 > c1), 也用作BC3的颜色部分.
+// 端点取包围盒沿主要相关方向的对角线, 向内收缩1/16以减小量化误差
+void encodeColor(const Block& block, unsigned char* out) {
+    int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (auto& p : block.px) {
+        for (int c = 0; c < 3; ++c) {
+            lo[c] = std::min(lo[c], int(p[c]));
+            hi[c] = std::max(hi[c], int(p[c]));
+            mean[c] += p[c] / 16.0f;
+        }
+    }
+    // 以范围最大的通道为主轴, 与之负相关的通道交换端点
+    int axis = 0;
+    for (int c = 1; c < 3; ++c) {
+        if (hi[c] - lo[c] > hi[axis] - lo[axis]) axis = c;
+    }
+    for (int c = 0; c < 3; ++c) {
+        if (c == axis) continue;
+        float cov = 0.0f;
+        for (auto& p : block.px) {
+            cov += (p[axis] - mean[axis]) * (p[c] - mean[c]);
+        }
+        if (cov < 0.0f) std::swap(lo[c], hi[c]);
+    }
+    int e0[3], e1[3];
+    for (int c = 0; c < 3; ++c) {
+        int inset = (hi[c] - lo[c]) / 16;
+        e0[c] = hi[c] - inset;
+        e1[c] = lo[c] + inset;
+    }
+    uint16_t c0 = to565(e0[0], e0[1], e0[2]);
+    uint16_t c1 = to565(e1[0], e1[1], e1[2]);
+    if (c0 < c1) std::swap(c0, c1);
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int palette[4][3];
+        from565(c0, palette[0]);
+        from565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestError = 1 << 30;
+            for (int k = 0; k < 4; ++k) {
+                int error = 0;
+                for (int c = 0; c < 3; ++c) {
+                    int d = block.px[i][c] - palette[k][c];
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    best = k;
+                    bestError = error;
+                }
+            }
+            indices |= uint32_t(best) << (2 * i);
+        }
+    }
+    out[0] = static_cast<unsigned char>(c0 & 0xff);
+    out[1] = static_cast<unsigned char>(c0 >> 8);
+    out[2] = static_cast<unsigned char>(c1 & 0xff);
+    out[3] = static_cast<unsigned char>(c1 >> 8);
+    for (int i = 0; i < 4; ++i) {
+        out[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+}
+
+// BC4单通道块, 也用作BC3的alpha部分与BC5的两个通道.
+// 使用八值模式(a0 > a1), 端点为块内的最大与最小值
+void encodeChannel(const Block& block, int channel, unsigned char* out) {
+    int lo = 255, hi = 0;
+    for (auto& p : block.px) {
+        lo = std::min(lo, int(p[channel]));
+        hi = std::max(hi, int(p[channel]));
+    }
+    out[0] = static_cast<unsigned char>(hi);
+    out[1] = static_cast<unsigned char>(lo);
+    uint64_t indices = 0;
+    if (hi > lo) {
+        int range = hi - lo;
+        for (int i = 0; i < 16; ++i) {
+            // 0..7对应从a0到a1的插值位置, 编码为0, 2..7, 1
+            int t = ((hi - block.px[i][channel]) * 7 + range / 2) / range;
+            int code = t == 0 ? 0 : t == 7 ? 1 : t + 1;
+            indices |= uint64_t(code) << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; ++i) {
+        out[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+}
+
+// 每块或每像素的字节数
+size_t blockBytes(mgl::PixelFormat format) {
+    switch (format) {
+        case mgl::PixelFormat::R8:
+            return 1;
+        case mgl::PixelFormat::RG8:
+            return 2;
+        case mgl::PixelFormat::RGB8:
+            return 3;
+        case mgl::PixelFormat::RGBA8:
+            return 4;
+        case mgl::PixelFormat::BC1:
+        case mgl::PixelFormat::BC4:
+            return 8;
+        case mgl::PixelFormat::BC3:
+        case mgl::PixelFormat::BC5:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+// 缩小一半使用的可分离滤波核: 目标像素x取源像素2x + first起的count个
+struct Kernel {
+    int first;
+    int count;
+    float weights[8];
+};
+
+// 第一类零阶修正贝塞尔函数
+double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+// 以目标像素为单位, 截止频率为目标奈奎斯特频率的sinc, 乘以半径为2的
+// Kaiser窗口; 抽头位于源像素中心, 距目标像素中心-1.75到1.75
+Kernel makeKaiser() {
+    Kernel kernel;
+    kernel.first = -3;
+    kernel.count = 8;
+    double weights[8], sum = 0.0;
+    for (int i = 0; i < 8; ++i) {
+        double t = (i - 3.5) / 2.0;
+        double sinc = std::sin(PI * t) / (PI * t);
+        double r = t / 2.0;
+        weights[i] = sinc * besselI0(KAISER_BETA * std::sqrt(1.0 - r * r)) /
+                     besselI0(KAISER_BETA);
+        sum += weights[i];
+    }
+    for (int i = 0; i < 8; ++i) {
+        kernel.weights[i] = static_cast<float>(weights[i] / sum);
+    }
+    return kernel;
+}
+
+const Kernel& kernelFor(mgl::MipFilter filter) {
+    static const Kernel box = {0, 2, {0.5f, 0.5f}};
+    static const Kernel kaiser = makeKaiser();
+    return filter == mgl::MipFilter::Kaiser ? kaiser : box;
+}
+
+// 把一行像素展开为RGBA浮点数
+void loadRow(const unsigned char* src, int width, int channels, float* out) {
+#ifdef MGL_SSE2
+    if (channels == 4) {
+        __m128i zero = _mm_setzero_si128();
+        for (int x = 0; x < width; ++x) {
+            int bits;
+            std::memcpy(&bits, src + x * 4, 4);
+            __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero);
+            v = _mm_unpacklo_epi16(v, zero);
+            _mm_storeu_ps(out + x * 4, _mm_cvtepi32_ps(v));
+        }
+        return;
+    }
+#endif
+    for (int x = 0; x < width; ++x, src += channels, out += 4) {
+        if (channels <= 2) {
+            out[0] = out[1] = out[2] = src[0];
+            out[3] = channels == 2 ? src[1] : 255.0f;
+        } else {
+            out[0] = src[0];
+            out[1] = src[1];
+            out[2] = src[2];
+            out[3] = channels == 4 ? src[3] : 255.0f;
+        }
+    }
+}
+
+// 水平方向滤波并缩小一半
+void filterRow(const float* in, int width, const Kernel& kernel, float* out,
+               int outWidth) {
+    for (int x = 0; x < outWidth; ++x) {
+        int first = 2 * x + kernel.first;
+#ifdef MGL_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (int k = 0; k < kernel.count; ++k) {
+            int sx = std::min(std::max(first + k, 0), width - 1);
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + sx * 4),
+                                             _mm_set1_ps(kernel.weights[k])));
+        }
+        _mm_storeu_ps(out + x * 4, sum);
+#else
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int k = 0; k < kernel.count; ++k) {
+            int sx = std::min(std::max(first + k, 0), width - 1);
+            for (int c = 0; c < 4; ++c) {
+                sum[c] += in[sx * 4 + c] * kernel.weights[k];
+            }
+        }
+        std::memcpy(out + x * 4, sum, sizeof(sum));
+#endif
+    }
+}
+
+// out += in * weight, n为4的倍数
+void accumulate(float* out, const float* in, float weight, size_t n) {
+#ifdef MGL_SSE2
+    __m128 w = _mm_set1_ps(weight);
+    for (size_t i = 0; i < n; i += 4) {
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i),
+                                          _mm_mul_ps(_mm_loadu_ps(in + i), w)));
+    }
+#else
+    for (size_t i = 0; i < n; ++i) out[i] += in[i] * weight;
+#endif
+}
+
+// 把法线重新归一化
+void renormalize(float* px) {
+    float n[3];
+    for (int c = 0; c < 3; ++c) n[c] = px[c] / 127.5f - 1.0f;
+    float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length < 1e-6f) return;
+    for (int c = 0; c < 3; ++c) px[c] = (n[c] / length + 1.0f) * 127.5f;
+}
+
+// 四舍五入并截断到0..255
+void storeRow(float* in, int width, bool normalMap, unsigned char* out) {
+    for (int x = 0; x < width; ++x) {
+        float* px = in + x * 4;
+        if (normalMap) renormalize(px);
+#ifdef MGL_SSE2
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(px), _mm_setzero_ps()),
+                              _mm_set1_ps(255.0f));
+        __m128i i = _mm_cvtps_epi32(v);
+        i = _mm_packs_epi32(i, i);
+        i = _mm_packus_epi16(i, i);
+        int bits = _mm_cvtsi128_si32(i);
+        std::memcpy(out + x * 4, &bits, 4);
+#else
+        for (int c = 0; c < 4; ++c) {
+            float v = std::min(255.0f, std::max(0.0f, px[c]));
+            out[x * 4 + c] = static_cast<unsigned char>(std::nearbyint(v));
+        }
+#endif
+    }
+}
+}  // namespace
+
+_MGL MipLevel _MGL DownsampleHalf(const unsigned char* pixels, int width,
+                                  int height, int channels, MipFilter filter,
+                                  bool normalMap) {
+    const Kernel& kernel = kernelFor(filter);
+    MipLevel dst;
+    dst.width = std::max(1, width / 2);
+    dst.height = std::max(1, height / 2);
+    dst.pixels.resize(size_t(dst.width) * dst.height * 4);
+    size_t rowFloats = size_t(dst.width) * 4;
+    // 水平滤波后的源行, 按行号对抽头数取模循环使用,
+    // 一个目标行需要的连续几行总是落在不同的位置
+    std::vector<float> ring(rowFloats * kernel.count);
+    std::vector<int> ringRow(kernel.count, -1);
+    std::vector<float> line(size_t(width) * 4);
+    std::vector<float> sum(rowFloats);
+    auto filteredRow = [&](int y) -> const float* {
+        y = std::min(std::max(y, 0), height - 1);
+        int slot = y % kernel.count;
+        float* row = &ring[slot * rowFloats];
+        if (ringRow[slot] != y) {
+            loadRow(pixels + size_t(y) * width * channels, width, channels,
+                    line.data());
+            filterRow(line.data(), width, kernel, row, dst.width);
+            ringRow[slot] = y;
+        }
+        return row;
+    };
+    for (int y = 0; y < dst.height; ++y) {
+        std::fill(sum.begin(), sum.end(), 0.0f);
+        for (int k = 0; k < kernel.count; ++k) {
+            accumulate(sum.data(), filteredRow(2 * y + kernel.first + k),
+                       kernel.weights[k], rowFloats);
+        }
+        storeRow(sum.data(), dst.width, normalMap,
+                 &dst.pixels[size_t(y) * dst.width * 4]);
+    }
+    return dst;
+}
+
+std::vector<_MGL MipLevel> _MGL BuildMipChain(const unsigned char* rgba,
+                                              int width, int height,
+                                              MipFilter filter,
+                                              bool normalMap) {
+    std::vector<MipLevel> chain(1);
+    chain[0].width = width;
+    chain[0].height = height;
+    chain[0].pixels.assign(rgba, rgba + size_t(width) * height * 4);
+    while (chain.back().width > 1 || chain.back().height > 1) {
+        const MipLevel& last = chain.back();
+        MipLevel next = DownsampleHalf(last.pixels.data(), last.width,
+                                       last.height, 4, filter, normalMap);
+        chain.push_back(std::move(next));
+    }
+    return chain;
+}
+
+size_t _MGL ImageLevelSize(PixelFormat format, int width, int height) {
+    if (IsCompressed(format)) {
+        return size_t((width + 3) / 4) * ((height + 3) / 4) *
+               blockBytes(format);
+    }
+    return size_t(width) * height * blockBytes(format);
+}
+
+void _MGL EncodeImageLevel(PixelFormat format, const unsigned char* rgba,
+                           int width, int height, unsigned char* out) {
+    if (!IsCompressed(format)) {
+        size_t channels = blockBytes(format);
+        size_t count = size_t(width) * height;
+        for (size_t i = 0; i < count; ++i) {
+            std::memcpy(out + i * channels, rgba + i * 4, channels);
+        }
+        return;
+    }
+    size_t stride = blockBytes(format);
+    Block block;
+    for (int y = 0; y < height; y += 4) {
+        for (int x = 0; x < width; x += 4) {
+            loadBlock(rgba, width, height, x, y, block);
+            switch (format) {
+                case PixelFormat::BC1:
+                    encodeColor(block, out);
+                    break;
+                case PixelFormat::BC3:
+                    encodeChannel(block, 3, out);
+                    encodeColor(block, out + 8);
+                    break;
+                case PixelFormat::BC4:
+                    encodeChannel(block, 0, out);
+                    break;
+                case PixelFormat::BC5:
+                    encodeChannel(block, 0, out);
+                    encodeChannel(block, 1, out + 8);
+                    break;
+                default:
+                    break;
+            }
+            out += stride;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+﻿#include "header/ThreadPool.h"
+#include "header/Config.h"
+
+_MGL ThreadPool::ThreadPool(unsigned int threads) : stopping(false) {
+    if (threads == 0) threads = hardwareThreads();
+    workers.reserve(threads);
+    for (unsigned int i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+_MGL ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void _MGL ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+unsigned int _MGL ThreadPool::hardwareThreads() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+namespace {
+// 按设置的线程数获取(必要时重建)线程池
+_MGL ThreadPool& configuredPool(std::unique_ptr<_MGL ThreadPool>& pool,
+                                std::mutex& poolMutex, unsigned int threads) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (threads == 0) threads = _MGL ThreadPool::hardwareThreads();
+    if (!pool || pool->size() != threads) {
+        pool.reset();
+        pool.reset(new _MGL ThreadPool(threads));
+    }
+    return *pool;
+}
+}  // namespace
+
+_MGL ThreadPool& _MGL texturePool() {
+    static std::unique_ptr<ThreadPool> pool;
+    static std::mutex poolMutex;
+    return configuredPool(pool, poolMutex, loadConfig().decodeThreads);
+}
+
+_MGL ThreadPool& _MGL workerPool() {
+    static std::unique_ptr<ThreadPool> pool;
+    static std::mutex poolMutex;
+    return configuredPool(pool, poolMutex, loadConfig().workerThreads);
+}
+
+_MGL ThreadPool& _MGL importPool() {
+    static std::unique_ptr<ThreadPool> pool;
+    static std::mutex poolMutex;
+    return configuredPool(pool, poolMutex, loadConfig().importThreads);
+}
+
+_MGL ThreadPool& _MGL ioPool() {
+    static std::unique_ptr<ThreadPool> pool;
+    static std::mutex poolMutex;
+    return configuredPool(pool, poolMutex, loadConfig().ioThreads);
+}
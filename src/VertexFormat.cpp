@@ -0,0 +1,215 @@
+﻿#include "header/VertexFormat.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "header/Memory.h"
+#include "header/VertexLayout.h"
+
+namespace {
+static_assert(mgl::PackedLayout::stride == 20,
+              "PackedVertex must be tightly packed");
+static_assert(mgl::PackedSkinnedLayout::stride == 28,
+              "PackedSkinnedVertex must be tightly packed");
+static_assert(mgl::StaticLayout::stride == 56,
+              "StaticVertex must be tightly packed");
+
+inline uint16_t toUnorm16(float value) {
+    value = std::max(0.0f, std::min(1.0f, value));
+    return static_cast<uint16_t>(std::lround(value * 65535.0f));
+}
+
+inline uint8_t toUnorm8(float value) {
+    value = std::max(0.0f, std::min(1.0f, value));
+    return static_cast<uint8_t>(std::lround(value * 255.0f));
+}
+
+inline int16_t toSnorm16(float value) {
+    value = std::max(-1.0f, std::min(1.0f, value));
+    return static_cast<int16_t>(std::lround(value * 32767.0f));
+}
+
+template <typename Packed>
+void packVertex(const mgl::Vertex& v, const glm::vec3& min,
+                const glm::vec3& inverseExtent, Packed& out) {
+    glm::vec3 p = (v.Position - min) * inverseExtent;
+    out.Position[0] = toUnorm16(p.x);
+    out.Position[1] = toUnorm16(p.y);
+    out.Position[2] = toUnorm16(p.z);
+    // 副切线只保存相对 N x T 的方向
+    float sign = glm::dot(glm::cross(v.Normal, v.Tangent), v.Bitangent);
+    out.Position[3] = sign < 0.0f ? 0 : 65535;
+    mgl::EncodeOctahedral(v.Normal, out.Normal);
+    mgl::EncodeOctahedral(v.Tangent, out.Tangent);
+    out.TexCoords[0] = mgl::FloatToHalf(v.TexCoords.x);
+    out.TexCoords[1] = mgl::FloatToHalf(v.TexCoords.y);
+}
+
+void convertVertex(const mgl::Vertex& v, mgl::StaticVertex& out) {
+    out.Position = v.Position;
+    out.Normal = v.Normal;
+    out.TexCoords = v.TexCoords;
+    out.Tangent = v.Tangent;
+    out.Bitangent = v.Bitangent;
+}
+
+void convertVertex(const mgl::Vertex& v, mgl::PositionVertex& out) {
+    out.Position = v.Position;
+}
+
+template <typename Out>
+void convertAll(const mgl::Vertex* vertices, size_t count, void* out) {
+    Out* converted = static_cast<Out*>(out);
+    for (size_t i = 0; i < count; ++i) convertVertex(vertices[i], converted[i]);
+}
+
+// 包围盒各轴长度的倒数, 长度为0的轴所有顶点都落在min上
+inline float inverse(float extent) {
+    return extent > 0.0f ? 1.0f / extent : 0.0f;
+}
+
+inline bool isZero(const glm::vec3& v) {
+    return v.x == 0.0f && v.y == 0.0f && v.z == 0.0f;
+}
+}  // namespace
+
+size_t _MGL VertexFormatSize(VertexFormat format) {
+    switch (format) {
+        case VertexFormat::Static:
+            return StaticLayout::stride;
+        case VertexFormat::Position:
+            return PositionLayout::stride;
+        case VertexFormat::Packed:
+            return PackedLayout::stride;
+        case VertexFormat::PackedSkinned:
+            return PackedSkinnedLayout::stride;
+        default:
+            return SkinnedLayout::stride;
+    }
+}
+
+_MGL VertexFormat _MGL ChooseVertexFormat(const Vertex* vertices,
+                                          size_t count, bool pack) {
+    bool skinned = false;
+    bool shortBones = true;
+    bool positionOnly = true;
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex& v = vertices[i];
+        for (int k = 0; k < MAX_BONE_INFLUENCE; ++k) {
+            if (v.m_Weights[k] == 0.0f) continue;
+            int id = v.m_BoneIDs[k];
+            if (id < 0 || id > 255) shortBones = false;
+            skinned = true;
+        }
+        positionOnly = positionOnly && isZero(v.Normal) &&
+                       v.TexCoords.x == 0.0f && v.TexCoords.y == 0.0f &&
+                       isZero(v.Tangent) && isZero(v.Bitangent);
+    }
+    if (skinned) {
+        return pack && shortBones ? VertexFormat::PackedSkinned
+                                  : VertexFormat::Skinned;
+    }
+    if (positionOnly) return VertexFormat::Position;
+    return pack ? VertexFormat::Packed : VertexFormat::Static;
+}
+
+_MGL PositionDecode _MGL ConvertVertices(const Vertex* vertices, size_t count,
+                                         VertexFormat format, void* out) {
+    PositionDecode decode;
+    switch (format) {
+        case VertexFormat::Skinned:
+            std::memcpy(out, vertices, count * sizeof(Vertex));
+            CountCopy(count * sizeof(Vertex));
+            return decode;
+        case VertexFormat::Static:
+            convertAll<StaticVertex>(vertices, count, out);
+            CountCopy(count * sizeof(StaticVertex));
+            return decode;
+        case VertexFormat::Position:
+            convertAll<PositionVertex>(vertices, count, out);
+            CountCopy(count * sizeof(PositionVertex));
+            return decode;
+        default:
+            break;
+    }
+    glm::vec3 min(0.0f);
+    glm::vec3 max(0.0f);
+    if (count > 0) min = max = vertices[0].Position;
+    for (size_t i = 1; i < count; ++i) {
+        min = glm::min(min, vertices[i].Position);
+        max = glm::max(max, vertices[i].Position);
+    }
+    decode.offset = min;
+    decode.scale = max - min;
+    glm::vec3 inverseExtent(inverse(decode.scale.x), inverse(decode.scale.y),
+                            inverse(decode.scale.z));
+
+    if (format == VertexFormat::Packed) {
+        PackedVertex* packed = static_cast<PackedVertex*>(out);
+        for (size_t i = 0; i < count; ++i) {
+            packVertex(vertices[i], min, inverseExtent, packed[i]);
+        }
+    } else {
+        PackedSkinnedVertex* packed = static_cast<PackedSkinnedVertex*>(out);
+        for (size_t i = 0; i < count; ++i) {
+            const Vertex& v = vertices[i];
+            packVertex(v, min, inverseExtent, packed[i]);
+            for (int k = 0; k < MAX_BONE_INFLUENCE; ++k) {
+                bool used = v.m_Weights[k] != 0.0f;
+                packed[i].BoneIDs[k] =
+                    used ? static_cast<uint8_t>(v.m_BoneIDs[k]) : 0;
+                packed[i].Weights[k] = toUnorm8(v.m_Weights[k]);
+            }
+        }
+    }
+    CountCopy(count * VertexFormatSize(format));
+    return decode;
+}
+
+uint16_t _MGL FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t abs = bits & 0x7FFFFFFF;
+    // 无穷与NaN
+    if (abs >= 0x7F800000) {
+        return sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0);
+    }
+    // 大于等于65520时舍入为无穷
+    if (abs >= 0x477FF000) return sign | 0x7C00;
+    uint32_t half;
+    uint32_t rest;
+    uint32_t halfway;
+    if (abs >= 0x38800000) {
+        // 规格化数: 指数偏移从127改为15, 尾数舍去低13位
+        half = (abs - 0x38000000) >> 13;
+        rest = abs & 0x1FFF;
+        halfway = 0x1000;
+    } else {
+        // 非规格化数, 小于2^-25时为0
+        if (abs < 0x33000000) return sign;
+        uint32_t exponent = abs >> 23;
+        uint32_t mantissa = (abs & 0x7FFFFF) | 0x800000;
+        uint32_t shift = 126 - exponent;
+        half = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    }
+    // 就近舍入, 恰在中间时取偶数
+    if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+    return static_cast<uint16_t>(sign | half);
+}
+
+void _MGL EncodeOctahedral(const glm::vec3& n, int16_t out[2]) {
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    float x = sum > 0.0f ? n.x / sum : 0.0f;
+    float y = sum > 0.0f ? n.y / sum : 0.0f;
+    if (n.z < 0.0f) {
+        // 下半球沿对角线折叠到外侧
+        float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    out[0] = toSnorm16(x);
+    out[1] = toSnorm16(y);
+}
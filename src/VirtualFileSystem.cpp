@@ -0,0 +1,123 @@
+﻿#include "header/VirtualFileSystem.h"
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#include "header/AsyncFile.h"
+#include "header/FileSystem.h"
+#include "header/Hash.h"
+#include "header/MappedFile.h"
+#include "header/ResourcePack.h"
+
+namespace {
+// 已挂载的资源包及其根目录的规范路径
+struct Mount {
+    std::shared_ptr<const mgl::ResourcePack> pack;
+    std::string root;
+};
+
+struct Mounts {
+    std::mutex mutex;
+    std::vector<Mount> packs;
+};
+
+Mounts& mounts() {
+    static Mounts m;
+    return m;
+}
+
+// 在已挂载的包中查找文件, 后挂载的优先
+bool findInPacks(const std::string& path,
+                 std::shared_ptr<const mgl::ResourcePack>& pack,
+                 const mgl::PackEntry*& entry) {
+    Mounts& m = mounts();
+    std::lock_guard<std::mutex> lock(m.mutex);
+    if (m.packs.empty()) return false;
+    std::string key = mgl::CanonicalPath(path);
+    for (auto it = m.packs.rbegin(); it != m.packs.rend(); ++it) {
+        const std::string& root = it->root;
+        if (key.size() <= root.size() || key[root.size()] != '/' ||
+            key.compare(0, root.size(), root) != 0) {
+            continue;
+        }
+        entry = it->pack->find(key.substr(root.size() + 1));
+        if (entry) {
+            pack = it->pack;
+            return true;
+        }
+    }
+    return false;
+}
+}  // namespace
+
+bool _MGL MountPack(const std::string& path, const std::string& root) {
+    auto pack = std::make_shared<ResourcePack>();
+    if (!pack->open(path)) {
+        std::printf("ERROR::PACK::MOUNT %s\n", path.c_str());
+        return false;
+    }
+    std::string directory = root;
+    if (directory.empty()) {
+        size_t slash = path.find_last_of("/\\");
+        directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+    std::printf("RESOURCE::PACK::MOUNT %s (%zu files)\n", path.c_str(),
+                pack->getEntries().size());
+    Mounts& m = mounts();
+    std::lock_guard<std::mutex> lock(m.mutex);
+    m.packs.push_back({pack, CanonicalPath(directory)});
+    return true;
+}
+
+void _MGL UnmountPacks() {
+    Mounts& m = mounts();
+    std::lock_guard<std::mutex> lock(m.mutex);
+    m.packs.clear();
+}
+
+_MGL FileData _MGL ReadFile(const std::string& path) {
+    FileData batched;
+    if (FindBatched(path, batched)) return batched;
+    std::shared_ptr<const ResourcePack> pack;
+    const PackEntry* entry = nullptr;
+    if (findInPacks(path, pack, entry)) {
+        if (const unsigned char* data = pack->view(*entry)) {
+            return FileData(pack, data, static_cast<size_t>(entry->size));
+        }
+        auto buffer = std::make_shared<std::vector<unsigned char>>();
+        if (!pack->read(*entry, *buffer)) {
+            std::printf("ERROR::PACK::CORRUPT %s\n", path.c_str());
+            return FileData();
+        }
+        return FileData(buffer, buffer->data(), buffer->size());
+    }
+    auto file = std::make_shared<MappedFile>(path);
+    if (!file->isOpen()) return FileData();
+    return FileData(file, file->data(), file->size());
+}
+
+bool _MGL InPack(const std::string& path) {
+    std::shared_ptr<const ResourcePack> pack;
+    const PackEntry* entry = nullptr;
+    return findInPacks(path, pack, entry);
+}
+
+bool _MGL FileExists(const std::string& path) {
+    std::shared_ptr<const ResourcePack> pack;
+    const PackEntry* entry = nullptr;
+    if (findInPacks(path, pack, entry)) return true;
+    return std::ifstream(path).good();
+}
+
+bool _MGL FileHash(const std::string& path, uint64_t& hash) {
+    std::shared_ptr<const ResourcePack> pack;
+    const PackEntry* entry = nullptr;
+    if (findInPacks(path, pack, entry)) {
+        hash = entry->contentHash;
+        return true;
+    }
+    FileData file = ReadFile(path);
+    if (!file.isOpen()) return false;
+    hash = HashBytes(file.data(), file.size());
+    return true;
+}
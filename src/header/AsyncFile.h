@@ -0,0 +1,53 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include "VirtualFileSystem.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 一组资源文件的批量异步读取. 构造时一次提交整组读取:
+ * Linux上通过io_uring同时发出所有读请求, 由ioPool的一个线程收取完成;
+ * 其他平台或io_uring不可用时在ioPool上逐个文件并行读取.
+ * 批次存活期间, 任意线程对其中文件调用ReadFile都等待并返回已读入的内容,
+ * 解码器因此无需修改即可从内存解码. 资源包中的文件不参与批量读取
+ * @class
+ */
+class ReadBatch {
+  private:
+    // 本批次登记的文件的规范路径
+    std::vector<std::string> keys;
+
+  public:
+    /**
+     * @brief 提交一组文件的读取, 已由其他存活的批次读取的文件不再重复读取
+     *
+     * @param paths 文件路径
+     */
+    explicit ReadBatch(const std::vector<std::string>& paths);
+    /**
+     * @brief 取消登记, 已经返回的FileData仍然有效, 未完成的读取在后台完成
+     *
+     */
+    ~ReadBatch();
+    ReadBatch(const ReadBatch&) = delete;
+    ReadBatch& operator=(const ReadBatch&) = delete;
+};
+
+/**
+ * @brief 批量读取一组文件并等待全部完成
+ *
+ * @param paths 文件路径
+ * @return std::vector<FileData> 按paths顺序的文件内容,
+ * 无法读取的文件isOpen()为false
+ */
+std::vector<FileData> ReadFiles(const std::vector<std::string>& paths);
+/**
+ * @brief 查找存活的批次中的文件, 必要时等待其读取完成. 由ReadFile调用
+ *
+ * @param path 文件路径
+ * @param data 输出文件内容
+ * @return true 文件属于某个存活的批次
+ * @return false 文件不在任何批次中
+ */
+bool FindBatched(const std::string& path, FileData& data);
+MGL_END
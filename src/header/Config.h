@@ -0,0 +1,83 @@
+﻿#pragma once
+#include <string>
+#include "defined.h"
+MGL_START
+/**
+ * @brief 缩小纹理使用的滤波器
+ * @enum
+ */
+enum class MipFilter {
+    // 2x2平均, 最快, 结果偏模糊
+    Box,
+    // Kaiser窗口的sinc, 8个抽头, 保留更多细节
+    Kaiser,
+};
+
+/**
+ * @brief 资源加载设置
+ * @struct
+ */
+struct LoadConfig {
+    // 纹理解码线程数, 0表示使用硬件线程数
+    unsigned int decodeThreads = 0;
+    // 是否按文件内容哈希合并不同路径下的相同纹理
+    bool dedupeTextureContent = false;
+    // 通用工作线程数, 0表示使用硬件线程数
+    unsigned int workerThreads = 0;
+    // 批量加载(ModelBatch)时同时导入的模型数, 0表示使用硬件线程数
+    unsigned int importThreads = 0;
+    // 文件读取线程数, 0表示使用硬件线程数; 使用io_uring时每批只占一个线程
+    unsigned int ioThreads = 0;
+    // 是否按资源组批量异步读取磁盘上的文件(ReadBatch), 否则由解码线程
+    // 映射文件后按页读取
+    bool asyncFileReads = true;
+    // .obj模型是否使用内置的并行解析器而不是Assimp
+    bool nativeObjLoader = true;
+    // .gltf/.glb模型是否使用内置的映射解析器而不是Assimp
+    bool nativeGltfLoader = true;
+    // 导入后是否合并顶点, 优化三角形与顶点顺序并切分大网格,
+    // 结果随网格缓存保存
+    bool optimizeMeshes = true;
+    // 每个网格在原始网格之外生成的LOD层数, 0表示不生成,
+    // 结果随网格缓存保存
+    unsigned int lodLevels = 4;
+    // LOD允许的最大几何误差, 相对于网格包围球半径
+    float lodMaxError = 0.1f;
+    // 是否以压缩顶点格式(VertexFormat)上传网格, 着色器需要解码
+    bool packVertices = false;
+    // 是否把原始网格切分为簇(Meshlet)以便逐簇剔除, 不保存到网格缓存
+    bool buildMeshlets = false;
+    // init()时挂载的资源包(由mgl-pack生成), 不存在时直接读取磁盘上的文件
+    std::string resourcePack = "./resource.mglpack";
+    // 烘焙过的资源根目录(mgl-cook的输入), 其下的文件优先使用烘焙产物,
+    // 为空时不查找
+    std::string cookedRoot = "./resource";
+    // 烘焙纹理时是否按用途使用BC块压缩, 否则只预先计算mip链
+    bool compressTextures = true;
+    // 纹理的最大边长, 更大的纹理在上传前于CPU上缩小, 0表示不限制
+    unsigned int maxTextureSize = 0;
+    // 纹理的mip偏移: 在最大边长的限制之外再跳过的最精细层数
+    unsigned int textureMipBias = 0;
+    // 缩小纹理与烘焙mip链使用的滤波器, 按用途(TextureRole)依次为
+    // 颜色, 高光, 法线; 法线默认使用更锐利的Kaiser滤波
+    MipFilter textureFilters[3] = {MipFilter::Box, MipFilter::Box,
+                                   MipFilter::Kaiser};
+    // 是否把单通道的高光合并到不透明漫反射的alpha中, 两者共用一张纹理,
+    // 着色器按specularInAlpha从alpha读取高光; 高光与高度图总是存为单通道
+    bool packMaterialTextures = true;
+    // 环境光照预过滤的镜面反射立方体贴图第0层的边长
+    unsigned int iblSpecularSize = 256;
+    // 预过滤镜面反射时每个像素的GGX重要性采样数
+    unsigned int iblSampleCount = 64;
+};
+
+/**
+ * @brief 获取全局资源加载设置
+ *
+ * @return LoadConfig& 加载设置
+ */
+inline LoadConfig& loadConfig() {
+    static LoadConfig config;
+    return config;
+}
+MGL_END
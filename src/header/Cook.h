@@ -0,0 +1,62 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "defined.h"
+MGL_START
+/// @brief 烘焙产物所在的目录名, 位于资源根目录下
+const char* const COOKED_DIRECTORY = ".cooked";
+
+/**
+ * @brief 一次烘焙的统计
+ * @struct
+ */
+struct CookStats {
+    // 重新烘焙的文件数
+    size_t cooked = 0;
+    // 源文件, 依赖文件与设置都未改变, 直接沿用已有产物的文件数
+    size_t upToDate = 0;
+    // 烘焙失败的文件数
+    size_t failed = 0;
+    // 删除的不再被引用的产物数
+    size_t removed = 0;
+};
+
+/**
+ * @brief 烘焙资源目录下的模型, 纹理与着色器, 产物按
+ * (源文件哈希, 烘焙设置, 依赖文件哈希)的哈希命名存放在root/.cooked下,
+ * 清单记录每个源文件对应的产物与模型的依赖文件(.mtl, 外部.bin等).
+ * 已有同名产物的文件不再处理, 因此只有源文件, 依赖文件或设置改变的
+ * 文件会被重新烘焙
+ * @param root 资源根目录
+ * @param stats 输出的统计, 可为空
+ * @return true 全部成功
+ * @return false 有文件烘焙失败或清单写入失败
+ */
+bool CookDirectory(const std::string& root, CookStats* stats = nullptr);
+/**
+ * @brief 查找源文件的烘焙产物, 可在任意线程调用.
+ * 源文件位于loadConfig().cookedRoot下, 清单中有记录, 烘焙设置一致,
+ * 且源文件与清单记录的依赖文件内容都未变(或源文件已不存在)时可用.
+ * 大小与修改时间都与清单记录相同的文件视为未变, 不读取内容
+ * @param source 源文件路径
+ * @param settings 当前的烘焙设置哈希
+ * @param sourceHash 可为空, 找到时输出源文件哈希
+ * @return std::string 产物路径, 没有可用的产物时为空
+ */
+std::string FindCooked(const std::string& source, uint64_t settings,
+                       uint64_t* sourceHash = nullptr);
+/**
+ * @brief 着色器的烘焙设置哈希
+ *
+ * @return uint64_t 设置哈希
+ */
+uint64_t ShaderCookSettings();
+/**
+ * @brief 烘焙着色器源码: 去掉注释与行尾空白, 保留行号不变
+ *
+ * @param source 着色器源码
+ * @return std::string 烘焙后的源码
+ */
+std::string CookShaderSource(const std::string& source);
+MGL_END
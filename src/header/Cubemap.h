@@ -0,0 +1,80 @@
+﻿#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Image.h"
+#include "TextureCompress.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 立方体贴图面上的坐标对应的立方体表面上的点, 与GL的面朝向一致
+ *
+ * @param face 面, 顺序为+X, -X, +Y, -Y, +Z, -Z
+ * @param s 水平坐标, 范围[0, 1]
+ * @param t 竖直坐标, 范围[0, 1], 0为数据的第一行
+ * @return glm::vec3 边长为2的立方体表面上的点, 未归一化
+ */
+glm::vec3 CubemapFacePoint(int face, float s, float t);
+/**
+ * @brief 方向所在的立方体贴图面及面上的坐标, 与GL的选择规则一致
+ *
+ * @param direction 非零方向
+ * @param s 输出水平坐标, 范围[0, 1]
+ * @param t 输出竖直坐标, 范围[0, 1]
+ * @return int 面, 顺序为+X, -X, +Y, -Y, +Z, -Z
+ */
+int CubemapFaceOf(const glm::vec3& direction, float& s, float& t);
+/**
+ * @brief 修正立方体贴图一层的接缝: 相邻两面共享的边上对应的像素
+ * 取平均, 三面共享的角取三者平均, 1x1的层取六面平均.
+ * 使各面独立缩小得到的mip层在面之间连续
+ * @param faces 六个面的同一层, 顺序为+X, -X, +Y, -Y, +Z, -Z,
+ * 须为相同尺寸的正方形RGBA8
+ */
+void FixCubemapSeams(MipLevel faces[6]);
+/**
+ * @brief 并行解码立方体贴图的六个面, 展开为RGBA8. 可在任意线程调用
+ *
+ * @param paths 六个面的文件路径, 顺序为+X, -X, +Y, -Y, +Z, -Z
+ * @param levels 输出的六个面
+ * @return true 成功
+ * @return false 有面无法读取, 或各面不是相同尺寸的正方形
+ */
+bool DecodeCubemapFaces(const std::vector<std::string>& paths,
+                        MipLevel levels[6]);
+/**
+ * @brief 解码六个面并生成修正了接缝的完整mip链, 六个面并行解码,
+ * 每层六个面并行缩小; 开启compressTextures时按BC1/BC3压缩.
+ * 可在任意线程调用
+ * @param paths 六个面的文件路径, 顺序为+X, -X, +Y, -Y, +Z, -Z
+ * @param faces 输出的六个面, 像素由各面的pixels持有
+ * @return true 成功
+ * @return false 有面无法读取, 或各面不是相同尺寸的正方形
+ */
+bool BuildCubemap(const std::vector<std::string>& paths, Image faces[6]);
+/**
+ * @brief 六个面的内容合起来的哈希, 任一面改变时都不同
+ *
+ * @param paths 六个面的文件路径
+ * @param hash 输出哈希值
+ * @return true 计算成功
+ * @return false 不是六个面, 或有面无法读取
+ */
+bool CubemapSourceHash(const std::vector<std::string>& paths, uint64_t& hash);
+/**
+ * @brief 立方体贴图的缓存文件路径, 位于第一个面的旁边
+ *
+ * @param paths 六个面的文件路径
+ * @return std::string 缓存文件路径
+ */
+std::string CubemapCachePath(const std::vector<std::string>& paths);
+/**
+ * @brief 加载立方体贴图: 六个面与设置都未改变时直接映射缓存文件,
+ * 否则由BuildCubemap生成并写入缓存. 结果按LimitTextureSize丢弃
+ * 过大的层后以不可变存储上传. 必须在GL上下文线程调用
+ * @param paths 六个面的文件路径, 顺序为+X, -X, +Y, -Y, +Z, -Z
+ * @return unsigned int 纹理名称, 失败时为空纹理
+ */
+unsigned int LoadCubemap(const std::vector<std::string>& paths);
+MGL_END
@@ -0,0 +1,69 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "defined.h"
+MGL_START
+/**
+ * @brief 文件的大小与修改时间, 两者都未变时认为内容未变
+ * @struct
+ */
+struct FileStamp {
+    uint64_t size = 0;
+    // 最后修改时间, 单位与起点取决于平台, 只用于比较, 0表示未知
+    int64_t mtime = 0;
+};
+
+inline bool operator==(const FileStamp& a, const FileStamp& b) {
+    return a.size == b.size && a.mtime == b.mtime;
+}
+
+/**
+ * @brief 获取路径的规范形式: 绝对路径, 统一分隔符并消去.与..
+ * 仅做字面处理, 不解析符号链接, 路径不存在时同样有效
+ * @param path 路径
+ * @return std::string 规范化路径
+ */
+std::string CanonicalPath(const std::string& path);
+/**
+ * @brief 递归列出目录下的所有普通文件
+ *
+ * @param directory 目录
+ * @return std::vector<std::string> 相对于directory的路径, 分隔符为'/',
+ * 按字典序排列
+ */
+std::vector<std::string> ListFiles(const std::string& directory);
+/**
+ * @brief 创建目录, 上级目录必须已存在
+ *
+ * @param directory 目录
+ * @return true 创建成功或目录已存在
+ * @return false 创建失败
+ */
+bool MakeDirectory(const std::string& directory);
+/**
+ * @brief 读取磁盘上普通文件的大小与修改时间, 不读取内容
+ *
+ * @param path 文件路径
+ * @param stamp 输出
+ * @return true 读取成功
+ * @return false 文件不存在或不是普通文件
+ */
+bool StatFile(const std::string& path, FileStamp& stamp);
+/**
+ * @brief 为path生成同目录下唯一的临时文件名, 以.tmp结尾
+ * 名字包含进程号与进程内序号, 并发的写入者不会写到同一个临时文件
+ * @param path 最终文件路径
+ * @return std::string 临时文件路径
+ */
+std::string TempPath(const std::string& path);
+/**
+ * @brief 用from原子地替换to, to已存在时直接覆盖
+ * 替换过程中其他读取者看到的要么是旧文件要么是新文件, 不会出现文件缺失
+ * @param from 已写完的临时文件, 与to位于同一文件系统
+ * @param to 目标路径
+ * @return true 替换成功, from不再存在
+ * @return false 替换失败, to保持原样, from被删除
+ */
+bool ReplaceFileAtomic(const std::string& from, const std::string& to);
+MGL_END
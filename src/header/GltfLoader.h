@@ -0,0 +1,21 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief glTF 2.0 (.gltf/.glb) 导入
+ * .glb与外部.bin缓冲区通过内存映射读取, 访问器数据由映射内存一次写入交错的顶点,
+ * 32位紧密排列的索引直接整块复制. 各图元在线程池中并行处理.
+ * 网格按场景节点顺序输出, 与Assimp路径一样不应用节点变换;
+ * 缺少法线时生成平滑法线, 缺少切线且有纹理坐标时计算切线空间
+ * @param path 模型路径
+ * @param meshes 输出的网格数据, 每个图元一个
+ * @param dependencies 可为空, 追加读取的外部缓冲区(buffers[].uri)路径
+ * @return true 导入成功
+ * @return false 文件无法读取或格式错误
+ */
+bool LoadGltf(const std::string& path, std::vector<MeshData>& meshes,
+              std::vector<std::string>* dependencies = nullptr);
+MGL_END
@@ -0,0 +1,42 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "defined.h"
+MGL_START
+/// @brief FNV-1a 64位偏移基数
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+/// @brief FNV-1a 64位素数
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+/**
+ * @brief 使用FNV-1a计算一段内存的64位哈希值
+ *
+ * @param data 数据首地址
+ * @param size 数据字节数
+ * @param seed 初始哈希值, 用于将多段数据串联哈希
+ * @return uint64_t 哈希值
+ */
+inline uint64_t HashBytes(const void* data, size_t size,
+                          uint64_t seed = FNV_OFFSET_BASIS) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief 将一个平凡类型的值合并进哈希值
+ *
+ * @tparam T 平凡可复制类型
+ * @param seed 已有的哈希值
+ * @param value 需要合并的值
+ * @return uint64_t 新的哈希值
+ */
+template <typename T>
+inline uint64_t HashCombine(uint64_t seed, const T& value) {
+    return HashBytes(&value, sizeof(T), seed);
+}
+MGL_END
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "Image.h"
+#include "Shader.h"
+#include "defined.h"
+MGL_START
+/// @brief L2球谐的系数个数
+const int SH_COEFFICIENTS = 9;
+
+/**
+ * @brief 在CPU上预计算的环境光照
+ * @struct
+ */
+struct EnvironmentData {
+    // 漫反射辐照度的L2球谐系数, 已与余弦核卷积并除以π,
+    // 按Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21, Y22排列
+    glm::vec3 irradiance[SH_COEFFICIENTS] = {};
+    // GGX预过滤的镜面反射立方体贴图, sRGB编码的RGB8,
+    // 第i层的粗糙度为i / (层数 - 1), 像素由各面的pixels或file持有
+    Image specular[6];
+    // BRDF积分查找表的边长
+    int lutSize = 0;
+    // BRDF积分查找表, 每个像素为F0的缩放与偏移两个float,
+    // 横轴为NdotV, 纵轴为粗糙度
+    std::vector<float> lut;
+};
+
+/**
+ * @brief 上传到GPU的环境光照
+ * @struct
+ */
+struct EnvironmentLighting {
+    // 漫反射辐照度的L2球谐系数, 见EnvironmentData
+    glm::vec3 irradiance[SH_COEFFICIENTS] = {};
+    // 预过滤的镜面反射立方体贴图, GL_SRGB8, 采样结果是线性的
+    unsigned int specular = 0;
+    // specular的层数
+    unsigned int specularLevels = 0;
+    // BRDF积分查找表, RG16F
+    unsigned int brdfLut = 0;
+    /**
+     * @brief 设置着色器的irradianceSH[9], specularLevels,
+     * 并把specularMap, brdfLut绑定到纹理单元unit, unit + 1
+     * @param shader 着色器对象
+     * @param unit 第一个纹理单元
+     */
+    void bind(Shader& shader, unsigned int unit) const;
+};
+
+/**
+ * @brief 由立方体贴图预计算环境光照: 各面按sRGB解码为线性值后,
+ * 辐照度投影到L2球谐, 镜面反射按各层的粗糙度做GGX重要性采样预过滤,
+ * 另积分BRDF查找表.
+ * 逐行在workerPool上并行, 累加使用SIMD. 可在任意线程调用
+ * @param paths 六个面的文件路径, 顺序为+X, -X, +Y, -Y, +Z, -Z
+ * @param data 输出的预计算结果
+ * @return true 成功
+ * @return false 有面无法读取, 或各面不是相同尺寸的正方形
+ */
+bool PrecomputeEnvironment(const std::vector<std::string>& paths,
+                           EnvironmentData& data);
+/**
+ * @brief 加载环境光照: 六个面与设置都未改变时直接映射第一个面旁边的
+ * .mglibl缓存文件, 否则由PrecomputeEnvironment计算并写入缓存.
+ * 必须在GL上下文线程调用
+ * @param paths 六个面的文件路径, 顺序为+X, -X, +Y, -Y, +Z, -Z
+ * @return EnvironmentLighting 环境光照, 失败时纹理为0
+ */
+EnvironmentLighting LoadEnvironmentLighting(
+    const std::vector<std::string>& paths);
+MGL_END
@@ -0,0 +1,190 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "VirtualFileSystem.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 像素格式, BC格式以4x4像素为一块
+ * @enum
+ */
+enum class PixelFormat : uint32_t {
+    None = 0,
+    R8,
+    RG8,
+    RGB8,
+    RGBA8,
+    // RGB, 每块8字节
+    BC1,
+    // RGBA, 每块16字节
+    BC3,
+    // 单通道, 每块8字节
+    BC4,
+    // 双通道, 每块16字节
+    BC5,
+};
+
+/**
+ * @brief 纹理的用途, 决定烘焙时的压缩格式
+ * @enum
+ */
+enum class TextureRole : uint32_t {
+    // 颜色(漫反射等): 不透明时BC1, 有透明度时BC3, 灰度时BC4
+    Color = 0,
+    // 高光: 灰度时BC4, 否则BC1
+    Specular,
+    // 法线: BC5, 不压缩时RG8, 都只保存xy,
+    // 着色器中由z = sqrt(1 - dot(xy, xy))重建
+    Normal,
+};
+
+inline bool IsCompressed(PixelFormat format) {
+    return format >= PixelFormat::BC1;
+}
+
+/**
+ * @brief 烘焙图像中的一层mip, 数据指向文件内容
+ * @struct
+ */
+struct ImageLevel {
+    int width = 0;
+    int height = 0;
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+};
+
+/**
+ * @brief 解码后的图像数据, 只可移动
+ * @struct
+ */
+struct Image {
+    // 宽度
+    int width = 0;
+    // 高度
+    int height = 0;
+    // 通道数, 块压缩格式为采样得到的分量数
+    int channels = 0;
+    // 像素格式
+    PixelFormat format = PixelFormat::None;
+    // 像素数据, 由stb_image分配, 或指向file, pixels
+    unsigned char* data = nullptr;
+    // 来自烘焙文件时持有文件内容, data指向其中, 只读
+    FileData file;
+    // 烘焙文件中预先计算的完整mip链, 第0层即data;
+    // 为空时只有data一层, 上传时由驱动生成mipmap
+    std::vector<ImageLevel> levels;
+    // 在CPU上缩小后的像素, 非空时data指向其中
+    std::vector<unsigned char> pixels;
+
+    Image() = default;
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+    Image(Image&& rval) noexcept;
+    Image& operator=(Image&& rval) noexcept;
+    ~Image() noexcept { reset(); }
+    /**
+     * @brief 释放像素数据
+     *
+     */
+    void reset() noexcept;
+    inline bool valid() const { return data != nullptr; }
+    inline bool compressed() const { return IsCompressed(format); }
+};
+
+/**
+ * @brief 解码图像文件, 有未压缩的烘焙产物时直接使用, 资源包挂载时
+ * 从包中读取, 结果总是未压缩的像素, 可在任意线程调用
+ * @param filename 文件路径
+ * @return Image 图像, 失败时valid()为false
+ */
+Image DecodeImage(const std::string& filename);
+/**
+ * @brief 读取用作纹理的图像: 有烘焙产物时直接映射, 可能是块压缩的
+ * 并带有完整的mip链, 否则解码源文件; 结果已按LimitTextureSize缩小,
+ * 用途由文件名推测. 可在任意线程调用
+ * @param filename 文件路径
+ * @return Image 图像, 失败时valid()为false
+ */
+Image LoadTextureImage(const std::string& filename);
+/**
+ * @brief 按loadConfig()的maxTextureSize与textureMipBias缩小纹理:
+ * 带mip链的图像直接丢弃过大的层, 其余图像在CPU上用该用途的滤波器
+ * 逐次缩小一半, 之后释放原尺寸的像素. 可在任意线程调用
+ * @param image 图像
+ * @param role 用途
+ */
+void LimitTextureSize(Image& image, TextureRole role);
+/**
+ * @brief 从内存(如映射的文件)解码图像, 可在任意线程调用
+ *
+ * @param bytes 编码后的图像数据
+ * @param size 数据字节数
+ * @return Image 图像, 失败时valid()为false
+ */
+Image DecodeImageFromMemory(const unsigned char* bytes, size_t size);
+/**
+ * @brief 把未压缩的图像展开为RGBA8, 单通道为灰度, 双通道为灰度与透明度
+ *
+ * @param image 未压缩的图像
+ * @return std::vector<unsigned char> RGBA8像素
+ */
+std::vector<unsigned char> ExpandRGBA(const Image& image);
+/**
+ * @brief 以不可变存储(glTexStorage2D)把图像上传到当前绑定的2D纹理,
+ * 有mip链时逐层上传, 否则上传第0层后生成mipmap;
+ * 单通道图像采样为灰度. 必须在GL上下文线程调用
+ * @param image 有效的图像
+ */
+void UploadTextureLevels(const Image& image);
+/**
+ * @brief 将图像上传为带mipmap的2D纹理, 必须在GL上下文线程调用
+ *
+ * @param image 图像
+ * @return unsigned int 纹理名称, 图像无效时为空纹理
+ */
+unsigned int UploadTexture2D(const Image& image);
+/**
+ * @brief 以不可变存储上传立方体贴图, 有mip链时逐层上传,
+ * 否则生成mipmap. 必须在GL上下文线程调用
+ * @param faces 六个面, 顺序为+X, -X, +Y, -Y, +Z, -Z;
+ * 须为尺寸, 格式与层数都相同的正方形
+ * @param srgb RGB8与RGBA8是否为sRGB编码, 是时以GL_SRGB8(_ALPHA8)存储,
+ * 采样时由硬件解码为线性值
+ * @return unsigned int 纹理名称, 面不满足条件时为空纹理
+ */
+unsigned int UploadCubemap(const Image faces[6], bool srgb = false);
+/**
+ * @brief 按文件名推测纹理用途: 含normal, nrm, ddn的为法线,
+ * 含spec的为高光, 其余为颜色
+ * @param path 文件路径
+ * @return TextureRole 用途
+ */
+TextureRole GuessTextureRole(const std::string& path);
+/**
+ * @brief 纹理的烘焙设置哈希, 包含由文件名推测的用途
+ *
+ * @param path 源文件路径
+ * @return uint64_t 设置哈希
+ */
+uint64_t CookedImageSettings(const std::string& path);
+/**
+ * @brief 把解码后的图像写为烘焙格式: 文件头与各层的索引之后是
+ * 预先计算的完整mip链, 按用途选择块压缩格式
+ * @param image 图像
+ * @param role 用途
+ * @param path 输出路径
+ * @return true 写入成功
+ * @return false 写入失败
+ */
+bool WriteCookedImage(const Image& image, TextureRole role,
+                      const std::string& path);
+/**
+ * @brief 读取烘焙格式的图像, 各层直接引用文件内容而不复制
+ *
+ * @param file 文件内容
+ * @return Image 图像, 文件损坏时valid()为false
+ */
+Image ReadCookedImage(FileData&& file);
+MGL_END
@@ -0,0 +1,96 @@
+﻿#pragma once
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include "defined.h"
+MGL_START
+/**
+ * @brief 只读JSON值, 用于解析glTF等资源描述文件
+ * 访问不存在的成员或越界元素时返回null值, 便于连续取值
+ * @class
+ */
+class JsonValue {
+  public:
+    /// @brief 值类型
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+  private:
+    Type type;
+    bool boolean;
+    double number;
+    // 字符串值
+    std::string text;
+    // 数组元素
+    std::vector<JsonValue> items;
+    // 对象成员, 保持文件中的顺序
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    friend class JsonParser;
+
+  public:
+    JsonValue() : type(Null), boolean(false), number(0.0) {}
+
+    inline Type getType() const { return type; }
+    inline bool isNull() const { return type == Null; }
+    inline bool isNumber() const { return type == Number; }
+    inline bool isString() const { return type == String; }
+    inline bool isArray() const { return type == Array; }
+    inline bool isObject() const { return type == Object; }
+    /**
+     * @brief 获取数组元素数量, 非数组时为0
+     *
+     * @return size_t 元素数量
+     */
+    inline size_t size() const { return items.size(); }
+    /**
+     * @brief 获取数组元素
+     *
+     * @param index 序号
+     * @return const JsonValue& 元素, 越界时为null
+     */
+    const JsonValue& operator[](size_t index) const;
+    /**
+     * @brief 获取对象成员
+     *
+     * @param key 成员名
+     * @return const JsonValue& 成员, 不存在时为null
+     */
+    const JsonValue& operator[](const char* key) const;
+    /**
+     * @brief 判断对象是否包含成员
+     *
+     * @param key 成员名
+     * @return true 包含
+     */
+    bool has(const char* key) const;
+    inline const std::vector<std::pair<std::string, JsonValue>>& getMembers()
+        const {
+        return members;
+    }
+
+    inline double asNumber(double fallback = 0.0) const {
+        return type == Number ? number : fallback;
+    }
+    inline int asInt(int fallback = 0) const {
+        return type == Number ? static_cast<int>(number) : fallback;
+    }
+    inline bool asBool(bool fallback = false) const {
+        return type == Bool ? boolean : fallback;
+    }
+    inline const std::string& asString() const { return text; }
+};
+
+/**
+ * @brief 解析JSON文本
+ *
+ * @param data 文本首地址
+ * @param size 文本字节数
+ * @param value 输出的根值
+ * @param error 解析失败时的错误描述, 可以为空
+ * @return true 解析成功
+ * @return false 格式错误
+ */
+bool ParseJson(const char* data, size_t size, JsonValue& value,
+               std::string* error = nullptr);
+MGL_END
@@ -0,0 +1,76 @@
+﻿#pragma once
+#include <glm/glm.hpp>
+#include <cmath>
+#include <vector>
+#include "Mesh.h"
+#include "defined.h"
+MGL_START
+template <typename Vector, typename Matrix>
+class Camera;
+
+/**
+ * @brief LOD选择使用的视图参数
+ * @struct
+ */
+struct LodView {
+    // 相机位置
+    glm::vec3 position = glm::vec3(0.0f);
+    // 距离为1处单位长度在屏幕上的像素数: 视口高度 / (2 * tan(fovy / 2))
+    float pixelsPerUnit = 1.0f;
+    // 允许的屏幕空间误差(像素)
+    float pixelError = 1.0f;
+    // 滞后比例: 换到更粗的一层要求其误差低于pixelError * (1 - hysteresis),
+    // 换回更精的一层要求当前误差高于pixelError * (1 + hysteresis)
+    float hysteresis = 0.25f;
+};
+
+/**
+ * @brief 每个模型实例的LOD状态, 记录各网格当前使用的层
+ * @struct
+ */
+struct LodState {
+    std::vector<unsigned char> levels;
+};
+
+/**
+ * @brief 由相机与视口高度构造视图参数
+ *
+ * @tparam Matrix 相机的矩阵类型
+ * @param camera 相机, 缩放值为竖直视场角(度)
+ * @param viewportHeight 视口高度(像素)
+ * @param pixelError 允许的屏幕空间误差(像素)
+ * @return LodView 视图参数
+ */
+template <typename Matrix>
+LodView MakeLodView(const Camera<glm::vec3, Matrix>& camera,
+                    float viewportHeight, float pixelError = 1.0f) {
+    LodView view;
+    view.position = camera.position();
+    view.pixelsPerUnit =
+        viewportHeight / (2.0f * std::tan(glm::radians(camera.zoom()) * 0.5f));
+    view.pixelError = pixelError;
+    return view;
+}
+/**
+ * @brief 把几何误差投影到屏幕上, 按包围球上离相机最近的点估计,
+ * 相机位于包围球内时视为无穷大
+ * @param error 几何误差, 模型空间
+ * @param bounds 包围球, 模型空间
+ * @param transform 模型矩阵
+ * @param view 视图参数
+ * @return float 屏幕空间误差(像素)
+ */
+float ProjectedError(float error, const BoundingSphere& bounds,
+                     const glm::mat4& transform, const LodView& view);
+/**
+ * @brief 选择屏幕空间误差不超过view.pixelError的最粗一层,
+ * 与当前层相差不到滞后范围时保持当前层以避免来回跳变
+ * @param geometry 几何数据
+ * @param transform 模型矩阵
+ * @param view 视图参数
+ * @param current 当前使用的层
+ * @return unsigned int 新的层
+ */
+unsigned int SelectLod(const MeshGeometry& geometry, const glm::mat4& transform,
+                       const LodView& view, unsigned int current);
+MGL_END
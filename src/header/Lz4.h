@@ -0,0 +1,35 @@
+﻿#pragma once
+#include <cstddef>
+#include "defined.h"
+MGL_START
+/**
+ * @brief LZ4块格式压缩后可能的最大字节数
+ *
+ * @param size 原始字节数
+ * @return size_t 输出缓冲区所需的字节数
+ */
+inline size_t Lz4CompressBound(size_t size) { return size + size / 255 + 16; }
+/**
+ * @brief 按LZ4块格式压缩, 输出可由任意LZ4实现的块解压函数解压
+ *
+ * @param src 原始数据
+ * @param size 原始字节数, 不超过4GB
+ * @param dst 输出缓冲区
+ * @param capacity 输出缓冲区字节数
+ * @return size_t 压缩后的字节数, 缓冲区不足时为0
+ */
+size_t Lz4Compress(const unsigned char* src, size_t size, unsigned char* dst,
+                   size_t capacity);
+/**
+ * @brief 解压LZ4块, 所有读写均做边界检查, 可用于不可信的数据
+ *
+ * @param src 压缩数据
+ * @param size 压缩字节数
+ * @param dst 输出缓冲区
+ * @param rawSize 原始字节数, 解压结果必须恰好为这么多
+ * @return true 解压成功
+ * @return false 数据损坏
+ */
+bool Lz4Decompress(const unsigned char* src, size_t size, unsigned char* dst,
+                   size_t rawSize);
+MGL_END
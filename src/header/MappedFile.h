@@ -0,0 +1,54 @@
+﻿#pragma once
+#include <cstddef>
+#include <string>
+#include "defined.h"
+MGL_START
+/**
+ * @brief 只读内存映射文件
+ * @class
+ */
+class MappedFile {
+  private:
+    // 映射首地址
+    const unsigned char* _data;
+    // 文件大小
+    size_t _size;
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    // 文件句柄
+    void* _file;
+    // 映射句柄
+    void* _mapping;
+#endif
+
+  public:
+    MappedFile();
+    /**
+     * @brief 打开并映射文件
+     *
+     * @param path 文件路径
+     */
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& rval) noexcept;
+    MappedFile& operator=(MappedFile&& rval) noexcept;
+    ~MappedFile() noexcept { close(); }
+    /**
+     * @brief 打开并映射文件, 已打开的映射会先被关闭
+     *
+     * @param path 文件路径
+     * @return true 映射成功
+     * @return false 文件不存在或映射失败
+     */
+    bool open(const std::string& path);
+    /**
+     * @brief 解除映射并关闭文件
+     *
+     */
+    void close() noexcept;
+
+    inline bool isOpen() const { return _data != nullptr; }
+    inline const unsigned char* data() const { return _data; }
+    inline size_t size() const { return _size; }
+};
+MGL_END
@@ -0,0 +1,32 @@
+﻿#pragma once
+#include "Image.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 判断图像是否实际上只有一个通道: 单通道格式,
+ * 或各像素RGB相等且不透明
+ * @param image 图像
+ * @return true 只有一个通道的信息
+ */
+bool IsSingleChannel(const Image& image);
+/**
+ * @brief 把实际上只有一个通道的未压缩图像转换为R8,
+ * 上传时采样为灰度, 只占原来1/3到1/4的显存
+ * @param image 图像, 转换后像素由image.pixels持有
+ * @return true 转换后(或本来)是单通道
+ * @return false 图像有多个通道的信息, 未修改
+ */
+bool ReduceToSingleChannel(Image& image);
+/**
+ * @brief 把单通道的高光合并到不透明漫反射的alpha中, 两张纹理合为一张.
+ * 未压缩时RGB + R8得到RGBA8; 烘焙的BC1 + BC4直接交错压缩块得到BC3,
+ * 不需要重新编码. 两者的尺寸与mip层数必须相同
+ * @param diffuse 漫反射图像
+ * @param specular 高光图像
+ * @param packed 输出的合并图像
+ * @return true 合并成功
+ * @return false 格式或尺寸不满足条件, packed未修改
+ */
+bool PackSpecularIntoAlpha(const Image& diffuse, const Image& specular,
+                           Image& packed);
+MGL_END
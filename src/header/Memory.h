@@ -0,0 +1,188 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include "defined.h"
+MGL_START
+/**
+ * @brief 线性分配器, 用于加载过程中的临时数据
+ * 分配只移动指针, 释放通过回退到标记或reset整体完成;
+ * 内存块在回退后保留, 稳定状态下不再向系统申请内存. 非线程安全
+ * @class
+ */
+class Arena {
+  public:
+    /// @brief 回退位置
+    struct Marker {
+        size_t block;
+        size_t used;
+    };
+
+  private:
+    /// @brief 内存块
+    struct Block {
+        unsigned char* data;
+        size_t size;
+        size_t used;
+    };
+    // 已申请的内存块, 按申请顺序排列
+    std::vector<Block> blocks;
+    // 当前分配所在的块
+    size_t current;
+    // 新内存块的最小大小
+    size_t blockSize;
+
+  public:
+    /**
+     * @brief 构造分配器, 首次分配时才申请内存
+     *
+     * @param blockSize 内存块的最小大小
+     */
+    explicit Arena(size_t blockSize = 256 * 1024);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+    /**
+     * @brief 分配内存, 失败时抛出std::bad_alloc
+     *
+     * @param size 字节数
+     * @param alignment 对齐, 必须是2的幂
+     * @return void* 内存首地址
+     */
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    /**
+     * @brief 分配未初始化的数组, 按元素类型对齐
+     *
+     * @tparam T 元素类型, 应当是平凡类型
+     * @param count 元素数量
+     * @return T* 数组首地址
+     */
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+    /**
+     * @brief 获取当前位置
+     *
+     * @return Marker 标记
+     */
+    inline Marker mark() const {
+        return {current, blocks.empty() ? 0 : blocks[current].used};
+    }
+    /**
+     * @brief 回退到标记处, 之后分配的内存全部失效
+     *
+     * @param marker 由mark获取的标记
+     */
+    void rewind(Marker marker);
+    /**
+     * @brief 释放全部分配, 保留内存块
+     *
+     */
+    inline void reset() { rewind({0, 0}); }
+    /**
+     * @brief 获取已向系统申请的字节数
+     *
+     * @return size_t 字节数
+     */
+    size_t capacity() const;
+};
+
+/**
+ * @brief 在作用域结束时回退分配器, 可以嵌套使用
+ * @class
+ */
+class ArenaScope {
+  private:
+    Arena& arena;
+    Arena::Marker marker;
+
+  public:
+    explicit ArenaScope(Arena& arena) : arena(arena), marker(arena.mark()) {}
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+    ~ArenaScope() { arena.rewind(marker); }
+};
+
+/**
+ * @brief 从Arena分配的标准库分配器, deallocate不做任何事
+ * @tparam T 元素类型
+ */
+template <typename T>
+class ArenaAllocator {
+  public:
+    using value_type = T;
+    Arena* arena;
+
+    explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& rhs) const {
+        return arena == rhs.arena;
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& rhs) const {
+        return arena != rhs.arena;
+    }
+};
+
+/// @brief 使用Arena内存的数组
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/**
+ * @brief 获取当前线程的临时分配器
+ * 线程池中的任务应当用ArenaScope包围自己的临时数据
+ * @return Arena& 分配器
+ */
+Arena& threadArena();
+
+/**
+ * @brief 资源加载的内存计数
+ * 统计加载流程中几何数组与临时内存的堆分配, 以及CPU端复制与上传GPU的字节数.
+ * 计数是进程级的, 同时加载多个模型时彼此的计数会混在一起
+ * @struct
+ */
+struct LoadCounters {
+    // 堆分配次数
+    uint64_t allocations = 0;
+    // 堆分配字节数
+    uint64_t allocatedBytes = 0;
+    // 几何数据在CPU端复制的字节数
+    uint64_t bytesCopied = 0;
+    // 上传到GPU的字节数
+    uint64_t bytesUploaded = 0;
+};
+/**
+ * @brief 记录一次堆分配
+ *
+ * @param bytes 字节数
+ */
+void CountAllocation(size_t bytes);
+/**
+ * @brief 记录一次几何数据复制
+ *
+ * @param bytes 字节数
+ */
+void CountCopy(size_t bytes);
+/**
+ * @brief 记录一次GPU上传
+ *
+ * @param bytes 字节数
+ */
+void CountUpload(size_t bytes);
+/**
+ * @brief 读取当前的累计计数, 两次读取之差即为期间的计数
+ *
+ * @return LoadCounters 计数
+ */
+LoadCounters ReadLoadCounters();
+MGL_END
@@ -1,32 +1,16 @@
 ﻿#pragma once
 #include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
+#include "Meshlet.h"
+#include "Hash.h"
 #include "Shader.h"
+#include "Vertex.h"
+#include "VertexFormat.h"
 #include "defined.h"
 MGL_START
-#define MAX_BONE_INFLUENCE 4
-/**
- * @brief 顶点
- * @struct
- */
-struct Vertex {
-    // 顶点坐标
-    glm::vec3 Position;
-    // 法向量
-    glm::vec3 Normal;
-    // 纹理坐标
-    glm::vec2 TexCoords;
-    // 切线
-    glm::vec3 Tangent;
-    // 副切线
-    glm::vec3 Bitangent;
-    // 将影响此顶点的骨骼索引
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    // 每块骨头的重量
-    float m_Weights[MAX_BONE_INFLUENCE];
-};
-
 /**
  * @brief 纹理
  * @struct
@@ -41,50 +25,319 @@ struct Texture {
 };
 
 /**
- * @brief 网格
+ * @brief 一个细节层次(LOD)在索引数组中的范围
+ * 各层共用顶点, 只有索引不同; 顶点按首次被哪一层使用由粗到精排列,
+ * 每层只引用顶点数组的前vertexCount个, 因此可以由粗到精逐层上传
+ * @struct
+ */
+struct MeshLod {
+    // 首个索引的位置
+    uint32_t indexOffset;
+    // 索引数量
+    uint32_t indexCount;
+    // 相对原始网格的几何误差, 与顶点坐标同单位
+    float error;
+    // 此层引用的顶点都在前vertexCount个之中
+    uint32_t vertexCount;
+};
+
+/**
+ * @brief 包围球
+ * @struct
+ */
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+/**
+ * @brief 网格的CPU端数据, 由导入器产生, 上传前在此之上进行各种处理
+ * @struct
+ */
+struct MeshData {
+    // 顶点数据
+    std::vector<Vertex> vertices;
+    // 索引数据, 有LOD时依次存放各层的索引
+    std::vector<unsigned int> indices;
+    // 纹理类型与路径, id尚未加载
+    std::vector<Texture> textures;
+    // 由精到粗的各层LOD, 为空时全部索引属于唯一的一层
+    std::vector<MeshLod> lods;
+};
+
+/**
+ * @brief 网格的GPU几何数据, 创建后不可修改
+ * 内容相同的几何数据在进程内只上传一次, 由所有使用它的Mesh共享
  * @class
  */
-class Mesh {
+class MeshGeometry {
   private:
     // 渲染数据
     unsigned int VAO, VBO, EBO;
+    // 索引数量
+    unsigned int indexCount;
+    // 索引类型, GL_UNSIGNED_SHORT或GL_UNSIGNED_INT
+    unsigned int indexType;
+    // 上传的顶点格式
+    VertexFormat format;
+    // 压缩格式的位置解码参数
+    PositionDecode positionDecode;
+    // 由精到粗的各层LOD, 至少一层
+    std::vector<MeshLod> lods;
+    // 顶点与全部LOD的索引数量
+    size_t vertexCount = 0, totalIndexCount = 0;
+    // 已上传的最精细的一层, 逐步上传时从最粗的一层开始
+    unsigned int residentLod = 0;
+    // 逐步上传时尚未上传的顶点与索引(已转换为上传格式), 上传完成后释放
+    std::vector<unsigned char> stagedVertices, stagedIndices;
+    // 顶点的包围球
+    BoundingSphere bounds;
+    // 原始网格的簇, 未开启LoadConfig::buildMeshlets时为空
+    std::vector<Meshlet> meshlets;
+    // 簇的SoA包围体, 供CPU剔除
+    MeshletBounds meshletBounds;
+    // 簇的着色器存储缓冲区与间接绘制命令缓冲区, 需要OpenGL 4.3
+    unsigned int meshletBuffer = 0, commandBuffer = 0;
+    // 顶点与索引内容的哈希
+    uint64_t contentHash;
+    // 以ContentCheckSeed为种子的第二个内容哈希, 与contentHash合为128位
+    uint64_t contentCheck;
     /**
-     * @brief 初始化所有缓冲区对象/数组
+     * @brief 初始化所有缓冲区对象/数组, 顶点数允许时索引以16位上传.
+     * 顶点按数据选择最小的布局上传(见ChooseVertexFormat),
+     * 开启LoadConfig::packVertices时使用压缩格式
      *
+     * @param vertexData 顶点数据首地址
+     * @param vertexCount 顶点数量
+     * @param indexData 索引数据首地址
+     * @param count 索引数量
+     * @param progressive 是否只上传最粗的一层, 其余暂存等待refine
      */
-    void setupMesh();
-    // 网格数据
-    // 顶点数据
-    std::vector<Vertex> vertices;
-    // 索引数据
-    std::vector<unsigned int> indices;
+    void setupMesh(const Vertex* vertexData, size_t vertexCount,
+                   const unsigned int* indexData, size_t count,
+                   bool progressive = false);
+    /**
+     * @brief 从暂存数据上传一层尚未上传的顶点与该层的索引
+     *
+     * @param level LOD序号, 应当比residentLod精细一层
+     * @return size_t 上传的字节数
+     */
+    size_t uploadLevel(unsigned int level);
+    /**
+     * @brief 切分原始网格的簇并创建剔除所需的缓冲区
+     *
+     * @param vertexData 顶点数据首地址
+     * @param vertexCount 顶点数量
+     * @param indexData 索引数据首地址
+     */
+    void setupMeshlets(const Vertex* vertexData, size_t vertexCount,
+                       const unsigned int* indexData);
+
+  public:
+    /// @brief 顶点数不超过此值时上传16位索引, 0xFFFF留作图元重启索引
+    static const size_t MaxShortIndexVertices = 0xFFFF;
+    /// @brief 第二个内容哈希的种子, 与FNV偏移基数不同
+    static const uint64_t ContentCheckSeed = 0x9E3779B97F4A7C15ULL;
+    /**
+     * @brief 从CPU内存上传, 不保留CPU副本
+     *
+     * @param vertexData 顶点数据首地址
+     * @param vertexCount 顶点数量
+     * @param indexData 索引数据首地址
+     * @param count 索引数量
+     * @param lods 各层LOD在索引中的范围, 为空时只有一层
+     * @param hash 内容哈希
+     * @param check 以ContentCheckSeed计算的内容哈希
+     * @param progressive 是否先只上传最粗的一层, 之后由refine逐层细化.
+     * 此时数据被暂存, 外部内存在构造后即可释放
+     */
+    MeshGeometry(const Vertex* vertexData, size_t vertexCount,
+                 const unsigned int* indexData, size_t count,
+                 std::vector<MeshLod> lods, uint64_t hash, uint64_t check,
+                 bool progressive = false);
+    MeshGeometry(const MeshGeometry&) = delete;
+    MeshGeometry& operator=(const MeshGeometry&) = delete;
+    /**
+     * @brief 删除GL缓冲区对象
+     *
+     */
+    ~MeshGeometry();
+    /**
+     * @brief 上传比当前更精细的一层, 需要在GL上下文线程调用
+     *
+     * @return size_t 上传的字节数, 已全部上传时为0
+     */
+    size_t refine();
+    /**
+     * @brief 绑定VAO并绘制一层LOD
+     *
+     * @param lod LOD序号, 超出时绘制最粗的一层,
+     * 尚未上传时绘制已上传的最精细一层
+     */
+    void Draw(unsigned int lod = 0) const;
+    /**
+     * @brief 绑定VAO并绘制剔除后的簇
+     *
+     * @param list CullMeshlets产生的绘制范围
+     */
+    void Draw(const MeshletDrawList& list) const;
+    /**
+     * @brief 按GpuMeshletCuller写入的命令缓冲区间接绘制所有簇
+     *
+     */
+    void DrawIndirect() const;
+    /**
+     * @brief 设置着色器解码顶点所需的uniform:
+     * packedVertex, positionScale与positionOffset
+     * @param shader 着色器对象
+     */
+    void setDecodeUniforms(Shader& shader) const;
+    /**
+     * @brief 计算顶点与索引内容的哈希
+     *
+     * @param vertexData 顶点数据首地址
+     * @param vertexCount 顶点数量
+     * @param indexData 索引数据首地址
+     * @param count 索引数量
+     * @param seed 初始哈希值
+     * @return uint64_t 哈希值
+     */
+    static uint64_t hashContent(const Vertex* vertexData, size_t vertexCount,
+                                const unsigned int* indexData, size_t count,
+                                uint64_t seed = FNV_OFFSET_BASIS);
+    /**
+     * @brief contentHash相同时排除碰撞: 比较数量, LOD与第二个内容哈希,
+     * 两个哈希合为128位, 碰撞概率可以忽略. 只在CPU上比较, 不读回缓冲区
+     * @param vertexCount 顶点数量
+     * @param count 索引数量
+     * @param lods 各层LOD在索引中的范围, 为空时只有一层
+     * @param check 以ContentCheckSeed计算的内容哈希
+     * @return true 内容相同, 可以共享
+     */
+    bool sameContent(size_t vertexCount, size_t count,
+                     const std::vector<MeshLod>& lods, uint64_t check) const;
+    /**
+     * @brief 获取存活的几何数据数量
+     *
+     * @return size_t 几何数据数量
+     */
+    static size_t liveCount();
+
+    inline unsigned int getIndexCount() const { return indexCount; }
+    inline unsigned int getIndexType() const { return indexType; }
+    inline const std::vector<MeshLod>& getLods() const { return lods; }
+    inline const BoundingSphere& getBounds() const { return bounds; }
+    inline unsigned int getResidentLod() const { return residentLod; }
+    inline const std::vector<Meshlet>& getMeshlets() const { return meshlets; }
+    inline const MeshletBounds& getMeshletBounds() const {
+        return meshletBounds;
+    }
+    inline unsigned int getMeshletBuffer() const { return meshletBuffer; }
+    inline unsigned int getCommandBuffer() const { return commandBuffer; }
+    inline size_t getIndexSize() const {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t)
+                                              : sizeof(unsigned int);
+    }
+    inline VertexFormat getFormat() const { return format; }
+    inline const PositionDecode& getPositionDecode() const {
+        return positionDecode;
+    }
+    inline uint64_t getContentHash() const { return contentHash; }
+    inline unsigned int getVAO() const { return VAO; }
+    inline unsigned int getVBO() const { return VBO; }
+    inline unsigned int getEBO() const { return EBO; }
+};
+
+/**
+ * @brief 网格, 由共享的几何数据与自身的纹理组成, 复制开销很小
+ * @class
+ */
+class Mesh {
+  private:
+    // 几何数据
+    std::shared_ptr<const MeshGeometry> geometry;
     // 纹理数据
     std::vector<Texture> textures;
+    /**
+     * @brief 把纹理绑定到着色器的采样器并设置顶点解码参数.
+     * 高光合并在漫反射的alpha中时设置specularInAlpha,
+     * 有法线贴图时设置normalMapped
+     * @param shader 着色器对象
+     */
+    void bindTextures(Shader& shader) const;
 
     // 提供外部接口访问数据
   public:
-    inline std::vector<Vertex>& getVertices() { return vertices; }
-    inline std::vector<unsigned int>& getIndices() { return indices; }
     inline std::vector<Texture>& getTextures() { return textures; }
-    inline unsigned int getVAO() const { return VAO; }
-    inline unsigned int getVBO() const { return VBO; }
-    inline unsigned int getEBO() const { return EBO; }
+    inline const std::vector<Texture>& getTextures() const { return textures; }
+    inline const std::shared_ptr<const MeshGeometry>& getGeometry() const {
+        return geometry;
+    }
+    inline unsigned int getIndexCount() const {
+        return geometry->getIndexCount();
+    }
+    inline unsigned int getIndexType() const {
+        return geometry->getIndexType();
+    }
+    inline const std::vector<MeshLod>& getLods() const {
+        return geometry->getLods();
+    }
+    inline unsigned int getVAO() const { return geometry->getVAO(); }
+    inline unsigned int getVBO() const { return geometry->getVBO(); }
+    inline unsigned int getEBO() const { return geometry->getEBO(); }
 
   public:
     /**
      * @brief 渲染网格
      *
      * @param shader 着色器对象
+     * @param lod LOD序号, 0为原始网格
+     */
+    void Draw(Shader& shader, unsigned int lod = 0) const;
+    /**
+     * @brief 渲染剔除后的簇
+     *
+     * @param shader 着色器对象
+     * @param list CullMeshlets产生的绘制范围
+     */
+    void Draw(Shader& shader, const MeshletDrawList& list) const;
+    /**
+     * @brief 按GPU剔除写入的命令缓冲区渲染所有簇
+     *
+     * @param shader 着色器对象
      */
-    void Draw(Shader& shader);
+    void DrawIndirect(Shader& shader) const;
     /**
-     * @brief 构造函数
+     * @brief 构造函数, 已存在相同内容的几何数据时直接共享
+     * 数据上传后不保留CPU副本, 传入右值时构造结束即释放
      *
      * @param vertices 顶点数据
      * @param indices 索引数据
      * @param textures 纹理数据
+     * @param lods 各层LOD在索引中的范围, 为空时只有一层
      */
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices,
+         std::vector<Texture> textures, std::vector<MeshLod> lods = {});
+    /**
+     * @brief 直接从外部内存(如映射的缓存文件)构造, 数据上传后不保留CPU副本
+     * 已存在相同内容的几何数据时直接共享
+     * @param vertexData 顶点数据首地址
+     * @param vertexCount 顶点数量
+     * @param indexData 索引数据首地址
+     * @param count 索引数量
+     * @param textures 纹理数据
+     * @param lods 各层LOD在索引中的范围, 为空时只有一层
+     */
+    Mesh(const Vertex* vertexData, size_t vertexCount,
+         const unsigned int* indexData, size_t count,
+         std::vector<Texture> textures, std::vector<MeshLod> lods = {});
+    /**
+     * @brief 使用已有的几何数据构造
+     *
+     * @param geometry 几何数据
+     * @param textures 纹理数据
+     */
+    Mesh(std::shared_ptr<const MeshGeometry> geometry,
          std::vector<Texture> textures);
 };
-MGL_END
\ No newline at end of file
+MGL_END
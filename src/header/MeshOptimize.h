@@ -0,0 +1,105 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Mesh.h"
+#include "defined.h"
+MGL_START
+/// @brief 模拟的顶点后变换缓存大小(FIFO)
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+/**
+ * @brief 顶点后变换缓存的模拟结果
+ * @struct
+ */
+struct VertexCacheStats {
+    // 三角形数量
+    uint64_t triangles = 0;
+    // 被索引引用的顶点数量
+    uint64_t vertices = 0;
+    // 缓存未命中次数, 即顶点着色器的调用次数
+    uint64_t misses = 0;
+
+    /// @brief 每个三角形平均变换的顶点数(ACMR), 越接近0.5越好
+    inline double acmr() const {
+        return triangles ? double(misses) / double(triangles) : 0.0;
+    }
+    /// @brief 每个顶点平均被变换的次数(ATVR), 最优为1
+    inline double atvr() const {
+        return vertices ? double(misses) / double(vertices) : 0.0;
+    }
+    /// @brief 累加另一个网格的结果
+    inline VertexCacheStats& operator+=(const VertexCacheStats& rhs) {
+        triangles += rhs.triangles;
+        vertices += rhs.vertices;
+        misses += rhs.misses;
+        return *this;
+    }
+};
+
+/**
+ * @brief 网格优化前后的缓存统计
+ * @struct
+ */
+struct MeshOptimizeStats {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+/**
+ * @brief 用FIFO缓存模拟三角形列表的顶点变换次数
+ *
+ * @param indices 三角形列表索引
+ * @param count 索引数量
+ * @param vertexCount 顶点数量
+ * @param cacheSize 缓存大小
+ * @return VertexCacheStats 统计结果
+ */
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t count,
+                                    size_t vertexCount,
+                                    unsigned int cacheSize = VERTEX_CACHE_SIZE);
+/**
+ * @brief 按Tipsify算法重排三角形, 提高顶点后变换缓存的命中率
+ *
+ * @param indices 三角形列表索引, 原地修改
+ * @param count 索引数量, 必须是3的倍数
+ * @param vertexCount 顶点数量
+ * @param cacheSize 缓存大小
+ */
+void OptimizeVertexCache(unsigned int* indices, size_t count,
+                         size_t vertexCount,
+                         unsigned int cacheSize = VERTEX_CACHE_SIZE);
+/**
+ * @brief 合并二进制内容完全相同的顶点并改写索引, 保持首次出现的顺序
+ *
+ * @param mesh 网格
+ * @return size_t 移除的顶点数量
+ */
+size_t WeldVertices(MeshData& mesh);
+/**
+ * @brief 按顶点在索引中首次出现的顺序重排顶点并改写索引,
+ * 未被引用的顶点被移除
+ * @param mesh 网格
+ */
+void OptimizeVertexFetch(MeshData& mesh);
+/**
+ * @brief 依次进行顶点合并, 顶点缓存, 过度绘制与顶点读取优化.
+ * 过度绘制优化把Tipsify的输出切分为簇, 簇内保持缓存顺序,
+ * 簇之间按朝外程度排序使遮挡者先绘制; 切分点只选在缓存效率不低于
+ * 原簇threshold倍的位置
+ * @param mesh 三角形网格, 索引数量不是3的倍数时不做修改
+ * @param threshold 允许的ACMR增幅, 1.05表示最多变差5%
+ * @return MeshOptimizeStats 优化前后的统计
+ */
+MeshOptimizeStats OptimizeMesh(MeshData& mesh, float threshold = 1.05f);
+/**
+ * @brief 把顶点数超过16位索引上限的网格按三角形顺序切分为多个部分,
+ * 每个部分都可以使用16位索引. 边界处重复的顶点字节数不少于
+ * 节省的索引字节数时不切分
+ * @param mesh 三角形网格, 应当已经过缓存优化
+ * @param parts 切分成功时追加各部分
+ * @return true 已切分
+ * @return false 不需要或不值得切分, parts不变
+ */
+bool SplitForShortIndices(const MeshData& mesh, std::vector<MeshData>& parts);
+MGL_END
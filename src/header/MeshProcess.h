@@ -0,0 +1,89 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "Mesh.h"
+#include "Memory.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 导入器中按属性分开存放的顶点数据, 每个元素由连续的float组成
+ * 为空的属性在输出中置零
+ * @struct
+ */
+struct VertexStreams {
+    // 位置, 每个元素3个float
+    const float* positions = nullptr;
+    // 法线, 每个元素3个float
+    const float* normals = nullptr;
+    // 纹理坐标, 只使用前两个分量
+    const float* texCoords = nullptr;
+    // 相邻纹理坐标间隔的float数量
+    size_t texCoordStride = 2;
+    // 切线, 每个元素3个float
+    const float* tangents = nullptr;
+    // 副切线, 每个元素3个float
+    const float* bitangents = nullptr;
+};
+/**
+ * @brief 将分开存放的属性交错写入顶点数组, 骨骼数据置零
+ * 支持SSE2时每个属性以一次向量读写完成
+ * @param streams 属性数据
+ * @param first 起始元素序号
+ * @param count 元素数量
+ * @param out 输出的顶点, 对应第first个元素
+ */
+void InterleaveVertices(const VertexStreams& streams, size_t first,
+                        size_t count, Vertex* out);
+/**
+ * @brief 按顶点前keyBytes字节的二进制内容分组, 内容相同的顶点得到相同组号,
+ * 组号按首次出现的顺序分配. 使用开放寻址哈希表, 临时内存来自arena
+ * @param vertices 顶点
+ * @param keyBytes 参与比较的字节数, 不超过sizeof(Vertex)
+ * @param group 输出每个顶点的组号, 长度为顶点数量
+ * @param arena 临时分配器
+ * @return size_t 组数
+ */
+size_t GroupVertices(const std::vector<Vertex>& vertices, size_t keyBytes,
+                     uint32_t* group, Arena& arena);
+/**
+ * @brief 计算顶点的包围球: 球心为包围盒中心, 半径为到最远顶点的距离
+ *
+ * @param vertices 顶点数据
+ * @param count 顶点数量
+ * @return BoundingSphere 包围球, 没有顶点时半径为0
+ */
+BoundingSphere ComputeBounds(const Vertex* vertices, size_t count);
+/**
+ * @brief 判断所有顶点的法线是否为有限的非零向量
+ *
+ * @param mesh 网格
+ * @return true 法线可以直接使用
+ */
+bool HasValidNormals(const MeshData& mesh);
+/**
+ * @brief 判断所有顶点的切线与副切线是否为有限的非零向量
+ *
+ * @param mesh 网格
+ * @return true 切线空间可以直接使用
+ */
+bool HasValidTangents(const MeshData& mesh);
+/**
+ * @brief 生成平滑法线, 代替aiProcess_GenSmoothNormals:
+ * 按面积加权累加面法线, 位置相同的顶点共享结果.
+ * 面法线与每组的累加在线程池中按三角形/顶点范围并行
+ * @param mesh 三角形网格
+ */
+void GenerateSmoothNormals(MeshData& mesh);
+/**
+ * @brief 生成切线与副切线, 代替aiProcess_CalcTangentSpace并复现其结果:
+ * 每个角的面切线空间投影到法线平面后归一化, 再与位置相近, 法线相同且
+ * 方向相差不超过45度的角等权平均. 与Assimp的差别只在其输出NaN的退化处,
+ * 其余顶点的切线与副切线偏差在1度以内. 按三角形与位置分量并行.
+ * 这里没有使用MikkTSpace: 切线在加载时生成而不是随资源保存,
+ * 已有的法线贴图与网格缓存都是按Assimp的切线空间烘焙和校验的,
+ * 改用MikkTSpace会使它们的着色偏移, 所以以与Assimp一致为先.
+ * 两者的差别主要在角的加权方式, 以及接缝与镜像处顶点的拆分
+ * @param mesh 带法线与纹理坐标(已翻转V)的三角形网格
+ */
+void GenerateTangents(MeshData& mesh);
+MGL_END
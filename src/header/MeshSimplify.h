@@ -0,0 +1,44 @@
+﻿#pragma once
+#include <cstddef>
+#include <vector>
+#include "Mesh.h"
+#include "defined.h"
+MGL_START
+/// @brief 相邻两层LOD的目标三角形比例
+const float LOD_REDUCTION = 0.5f;
+/// @brief 新一层的三角形多于上一层的此比例时停止生成
+const float LOD_MIN_GAIN = 0.8f;
+
+/**
+ * @brief 用二次误差度量(QEM)简化三角形网格.
+ * 顶点只折叠到相邻的已有顶点上, 结果仍然索引原顶点数组;
+ * 位置相同而属性不同的顶点(接缝)只沿着两端都有对应顶点的边折叠,
+ * 开放边界与非流形边上的顶点保持不动
+ * @param vertices 顶点
+ * @param indices 三角形列表索引
+ * @param targetCount 目标索引数量
+ * @param maxError 允许的最大几何误差, 与顶点坐标同单位
+ * @param error 输出结果的几何误差, 可为空
+ * @return std::vector<unsigned int> 简化后的索引
+ */
+std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex>& vertices,
+                                       const std::vector<unsigned int>& indices,
+                                       size_t targetCount, float maxError,
+                                       float* error = nullptr);
+/**
+ * @brief 连续简化网格生成LOD链, 每层的三角形约为上一层的LOD_REDUCTION倍,
+ * 每层的索引按顶点缓存重排, 顶点按OrderVerticesByLod重排.
+ * 误差超过上限或简化不再有效时停止
+ * @param mesh 三角形网格, indices改为依次存放各层, lods记录各层的范围
+ * @param maxLevels 除原始网格外最多生成的层数
+ * @param maxError 允许的最大误差, 相对于包围球半径
+ * @return size_t 生成的层数, 不含原始网格
+ */
+size_t GenerateLods(MeshData& mesh, unsigned int maxLevels, float maxError);
+/**
+ * @brief 按顶点首次被哪一层LOD使用由粗到精重排顶点, 并记录每层的vertexCount,
+ * 使每一层只引用顶点数组的一段前缀, 可以先上传最粗的一层再逐层补充
+ * @param mesh 已生成LOD的网格, 顶点与索引原地修改
+ */
+void OrderVerticesByLod(MeshData& mesh);
+MGL_END
@@ -0,0 +1,206 @@
+﻿#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Shader.h"
+#include "Vertex.h"
+#include "defined.h"
+MGL_START
+template <typename Vector, typename Matrix>
+class Camera;
+
+/// @brief 每个簇的最大顶点数
+const size_t MESHLET_MAX_VERTICES = 64;
+/// @brief 每个簇的最大三角形数
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+/**
+ * @brief 簇(meshlet): 索引数组中一段连续的三角形及其包围体.
+ * 布局与计算着色器中的std430结构一致
+ * @struct
+ */
+struct Meshlet {
+    // 包围球
+    glm::vec3 center;
+    float radius;
+    // 法线锥: 视线与轴的夹角余弦不小于cutoff时整簇背向相机,
+    // 法线过于分散时轴为0, 永不剔除
+    glm::vec3 coneAxis;
+    float coneCutoff;
+    // 首个索引的位置与索引数量
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t reserved[2];
+};
+
+/**
+ * @brief 按SIMD宽度补齐的簇包围体, 各分量分开存放(SoA)
+ * 补齐的元素不可见
+ * @struct
+ */
+struct MeshletBounds {
+    // 簇数量
+    size_t count = 0;
+    // 补齐到4的倍数后的数量
+    size_t padded = 0;
+    // 依次为centerX, centerY, centerZ, radius,
+    // axisX, axisY, axisZ, cutoff, 每个分量padded个
+    std::vector<float> data;
+
+    inline const float* stream(size_t k) const { return &data[k * padded]; }
+};
+
+/**
+ * @brief 剔除使用的视图: 视锥的六个平面与相机位置
+ * 平面满足 dot(xyz, p) + w >= 0 时p在内侧, xyz为单位向量
+ * @struct
+ */
+struct CullView {
+    glm::vec4 planes[6];
+    glm::vec3 position = glm::vec3(0.0f);
+    // 是否进行法线锥剔除, 模型矩阵含非均匀缩放时关闭
+    bool coneCulling = true;
+};
+
+/**
+ * @brief 一次绘制的索引范围, 相邻的可见簇合并为一个范围
+ * @struct
+ */
+struct MeshletDrawList {
+    // 每个范围的索引数量
+    std::vector<int> counts;
+    // 每个范围的首个索引在索引缓冲区中的字节偏移
+    std::vector<const void*> offsets;
+    // 可见的簇数量与三角形数量
+    size_t visibleMeshlets = 0;
+    size_t triangles = 0;
+
+    inline void clear() {
+        counts.clear();
+        offsets.clear();
+        visibleMeshlets = 0;
+        triangles = 0;
+    }
+};
+
+/**
+ * @brief 按三角形顺序贪心地把网格切分为簇, 每簇不超过
+ * MESHLET_MAX_VERTICES个顶点与MESHLET_MAX_TRIANGLES个三角形.
+ * 三角形顺序不变, 因此每个簇都是索引数组中连续的一段;
+ * 输入应当已经过顶点缓存优化, 相邻三角形共用的顶点更多
+ * @param vertices 顶点数据
+ * @param vertexCount 顶点数量
+ * @param indices 三角形列表索引
+ * @param count 索引数量
+ * @param meshlets 输出的簇
+ */
+void BuildMeshlets(const Vertex* vertices, size_t vertexCount,
+                   const unsigned int* indices, size_t count,
+                   std::vector<Meshlet>& meshlets);
+/**
+ * @brief 把簇的包围体转换为SoA布局
+ *
+ * @param meshlets 簇
+ * @return MeshletBounds 包围体
+ */
+MeshletBounds MakeMeshletBounds(const std::vector<Meshlet>& meshlets);
+/**
+ * @brief 由视图投影矩阵提取视锥平面
+ *
+ * @param viewProjection 投影矩阵 * 视图矩阵
+ * @param position 相机位置
+ * @return CullView 世界空间的剔除视图
+ */
+CullView MakeCullView(const glm::mat4& viewProjection,
+                      const glm::vec3& position);
+/**
+ * @brief 由相机构造剔除视图
+ *
+ * @tparam Matrix 相机的矩阵类型
+ * @param camera 相机, 缩放值为竖直视场角(度)
+ * @param aspect 视口宽高比
+ * @param zNear 近平面
+ * @param zFar 远平面
+ * @return CullView 世界空间的剔除视图
+ */
+template <typename Matrix>
+CullView MakeCullView(Camera<glm::vec3, Matrix>& camera, float aspect,
+                      float zNear, float zFar) {
+    glm::mat4 projection =
+        glm::perspective(glm::radians(camera.zoom()), aspect, zNear, zFar);
+    return MakeCullView(projection * camera.GetViewMatrix(),
+                        camera.position());
+}
+/**
+ * @brief 把世界空间的剔除视图变换到模型空间, 簇的包围体无需逐个变换
+ *
+ * @param view 世界空间的剔除视图
+ * @param transform 模型矩阵
+ * @return CullView 模型空间的剔除视图
+ */
+CullView ToModelSpace(const CullView& view, const glm::mat4& transform);
+/**
+ * @brief 判断包围球是否与视锥相交
+ *
+ * @param view 与包围球同一空间的剔除视图
+ * @param center 球心
+ * @param radius 半径
+ * @return true 可能可见
+ */
+bool SphereVisible(const CullView& view, const glm::vec3& center,
+                   float radius);
+/**
+ * @brief 剔除视锥外与背向相机的簇, 每次用SIMD处理4个簇,
+ * 可见的相邻簇合并为一个绘制范围追加到out
+ * @param meshlets 簇
+ * @param bounds 簇的SoA包围体
+ * @param view 模型空间的剔除视图
+ * @param indexSize 索引缓冲区中每个索引的字节数
+ * @param out 输出的绘制范围
+ */
+void CullMeshlets(const std::vector<Meshlet>& meshlets,
+                  const MeshletBounds& bounds, const CullView& view,
+                  size_t indexSize, MeshletDrawList& out);
+
+/**
+ * @brief 计算着色器剔除: 每个簇写入一条间接绘制命令,
+ * 不可见的簇索引数量为0, 之后由glMultiDrawElementsIndirect一次绘制
+ * 需要OpenGL 4.3, 不支持时available()为false
+ * @class
+ */
+class GpuMeshletCuller {
+  private:
+    // 剔除程序, 不支持时为空
+    std::unique_ptr<Shader> program;
+
+  public:
+    /**
+     * @brief 检查上下文并编译剔除着色器, 需要在GL上下文线程调用
+     *
+     * @param path 计算着色器路径
+     */
+    explicit GpuMeshletCuller(
+        const std::string& path = "./resource/shader/meshlet_cull.comp");
+    GpuMeshletCuller(const GpuMeshletCuller&) = delete;
+    GpuMeshletCuller& operator=(const GpuMeshletCuller&) = delete;
+    /**
+     * @brief 当前上下文是否支持计算着色器与间接绘制
+     *
+     */
+    inline bool available() const { return program != nullptr; }
+    /**
+     * @brief 剔除一个网格的所有簇, 结果写入命令缓冲区
+     *
+     * @param meshletBuffer 簇的着色器存储缓冲区
+     * @param commandBuffer 间接绘制命令缓冲区
+     * @param meshletCount 簇数量
+     * @param view 模型空间的剔除视图
+     */
+    void dispatch(unsigned int meshletBuffer, unsigned int commandBuffer,
+                  size_t meshletCount, const CullView& view);
+};
+MGL_END
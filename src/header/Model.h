@@ -1,8 +1,15 @@
 ﻿#pragma once
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "Shader.h"
+#include "LodSelect.h"
 #include "Mesh.h"
+#include "Memory.h"
+#include "Meshlet.h"
+#include "MeshOptimize.h"
+#include "ModelCache.h"
 #include "stb_image.h"
 #include "defined.h"
 #include <assimp/Importer.hpp>
@@ -19,86 +26,358 @@ MGL_START
  */
 unsigned int TextureFromFile(const char* path, const std::string& directory,
                              bool gamma = false);
+/**
+ * @brief 模型加载统计
+ * @struct
+ */
+struct LoadStats {
+    // 是否命中网格缓存
+    bool cacheHit = false;
+    // 是否使用内置解析器(OBJ, glTF)导入
+    bool nativeImport = false;
+    // 读取缓存或导入网格数据的耗时(毫秒)
+    double importMs = 0.0;
+    // Assimp场景转换为网格数据的耗时(毫秒), 包含在importMs中
+    double convertMs = 0.0;
+    // 包括纹理与上传在内的总耗时(毫秒)
+    double totalMs = 0.0;
+    // 加载期间的内存分配与复制计数
+    LoadCounters counters;
+    // 网格优化的耗时(毫秒), 包含在importMs中
+    double optimizeMs = 0.0;
+    // 优化前后的顶点缓存统计, 仅在导入时计算
+    VertexCacheStats cacheBefore;
+    VertexCacheStats cacheAfter;
+    // 生成LOD的耗时(毫秒), 包含在importMs中
+    double lodMs = 0.0;
+    // 逐步加载时最粗一层上传完成, 可以开始绘制的耗时(毫秒);
+    // 此时totalMs为全部细化完成的耗时
+    double firstDrawMs = 0.0;
+};
+/**
+ * @brief 模型的加载方式
+ */
+enum class LoadMode {
+    // 构造时载入全部网格与纹理
+    Blocking,
+    // 构造时只上传每个网格最粗的一层LOD, 纹理先用占位纹理并在后台解码,
+    // 之后由Model::update逐帧上传纹理并由粗到精细化网格.
+    // 未命中网格缓存时导入也在后台进行, 完成前模型没有可绘制的网格
+    Progressive
+};
+/**
+ * @brief 逐簇剔除的统计
+ * @struct
+ */
+struct ClusterCullStats {
+    // 参与剔除的簇数量
+    size_t meshlets = 0;
+    // 可见的簇数量, GPU剔除时无法在CPU端得知, 为0
+    size_t visible = 0;
+    // 绘制的三角形数量, GPU剔除时只统计没有簇的网格
+    size_t triangles = 0;
+};
+/**
+ * @brief 每个模型实例的逐簇剔除状态, 在多帧之间保留以复用内存
+ * @struct
+ */
+struct ClusterState {
+    // 每个网格的绘制范围
+    std::vector<MeshletDrawList> lists;
+};
 /**
  * @brief 模型
  * @class
  */
 class Model {
   public:
+    /// @brief Assimp导入参数, 内置解析器产生等价的结果.
+    /// 法线与切线空间不交给Assimp, 由GenerateSmoothNormals/GenerateTangents生成
+    static const unsigned int ImportFlags =
+        aiProcess_Triangulate | aiProcess_FlipUVs;
     /**
      * @brief 构造一个模型对象
      *
      * @param path 模型路径
      * @param gamma 伽玛校正--默认为false
+     * @param mode 加载方式--默认为一次载入全部
      */
-    Model(const std::string& path, bool gamma = false)
-        : gammaCorrection(gamma) {
-        loadModel(path);
-    }
+    Model(const std::string& path, bool gamma = false,
+          LoadMode mode = LoadMode::Blocking);
     /**
      * @brief 构造一个模型对象
      *
      * @param path 模型路径
      * @param gamma 伽玛校正--默认为false
+     * @param mode 加载方式--默认为一次载入全部
+     */
+    Model(const char* path, bool gamma = false,
+          LoadMode mode = LoadMode::Blocking);
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    Model(Model&& rval);
+    Model& operator=(Model&& rval);
+    /**
+     * @brief 释放模型持有的纹理引用
+     *
      */
-    Model(const char* path, bool gamma = false) : gammaCorrection(gamma) {
-        loadModel(path);
-    }
+    ~Model();
     /**
      * @brief 绘制模型及其所有网格
      *
      * @param shader 着色器对象
      */
-    void Draw(Shader& shader);
+    void Draw(Shader& shader) const;
+    /**
+     * @brief 按屏幕空间误差为每个网格选择LOD并绘制
+     *
+     * @param shader 着色器对象
+     * @param transform 模型矩阵, 需与着色器中的model一致
+     * @param view 视图参数
+     * @param state 此实例的LOD状态, 在多帧之间保留
+     * @return size_t 绘制的三角形数量
+     */
+    size_t Draw(Shader& shader, const glm::mat4& transform,
+                const LodView& view, LodState& state) const;
+    /**
+     * @brief 逐簇剔除视锥外与背向相机的部分后绘制原始网格.
+     * 默认在线程池中按网格并行剔除; gpu可用时由计算着色器剔除并间接绘制.
+     * 没有簇的网格(未开启LoadConfig::buildMeshlets)整体绘制
+     * @param shader 着色器对象
+     * @param transform 模型矩阵, 需与着色器中的model一致
+     * @param view 世界空间的剔除视图
+     * @param state 此实例的剔除状态
+     * @param gpu GPU剔除器, 为空或不可用时在CPU剔除
+     * @return ClusterCullStats 剔除统计
+     */
+    ClusterCullStats DrawClusters(Shader& shader, const glm::mat4& transform,
+                                  const CullView& view, ClusterState& state,
+                                  GpuMeshletCuller* gpu = nullptr) const;
+    /**
+     * @brief 推进逐步加载: 后台导入完成后先上传每个网格最粗的一层;
+     * 之后先上传已解码完成的纹理, 再把网格由粗到精细化一层,
+     * 用完时间预算后返回, 每次至少完成一项. 需要在GL上下文线程每帧调用
+     * @param budgetMs 时间预算(毫秒)
+     * @return true 仍在加载
+     * @return false 已全部载入
+     */
+    bool update(double budgetMs = 2.0);
+    /**
+     * @brief 是否仍在逐步加载
+     *
+     */
+    inline bool streaming() const { return stream != nullptr; }
+    /**
+     * @brief 离线烘焙: 导入, 优化并生成LOD后写为网格缓存, 不调用GL
+     *
+     * @param path 模型路径
+     * @param sourceHash 源文件哈希
+     * @param output 输出的缓存文件路径
+     * @param dependencies 可为空, 输出导入时读取的依赖文件表
+     * @return true 烘焙成功
+     * @return false 导入或写入失败
+     */
+    static bool Cook(const std::string& path, uint64_t sourceHash,
+                     const std::string& output,
+                     std::vector<ModelDependency>* dependencies = nullptr);
+    /**
+     * @brief 只导入网格数据, 不读写缓存也不调用GL.
+     * 按loadConfig()选择导入器, 优化并生成LOD, 供工具与基准测试使用
+     * @param path 模型路径
+     * @param data 输出的网格数据
+     * @param stats 可为空, 输出导入与转换耗时
+     * @return true 导入成功
+     * @return false 导入失败
+     */
+    static bool Import(const std::string& path, std::vector<MeshData>& data,
+                       LoadStats* stats = nullptr);
+    /**
+     * @brief 计算影响导入结果的设置的哈希, 作为网格缓存的校验项
+     *
+     * @param path 模型路径
+     * @return uint64_t 设置哈希
+     */
+    static uint64_t importSettings(const std::string& path);
 
     // 提供外部接口访问数据可能非必要
   public:
     inline std::vector<Mesh>& getMesh() { return meshes; }
+    inline const std::vector<Mesh>& getMesh() const { return meshes; }
     inline std::string getDirectory() const { return directory; }
     inline std::vector<Texture>& getTexturesLoaded() { return textures_loaded; }
     inline bool getGamma() const { return gammaCorrection; }
+    inline const LoadStats& getLoadStats() const { return stats; }
 
   private:
     // 网格数组
     std::vector<Mesh> meshes;
     // 模型所在目录
     std::string directory;
-    // 缓存已经载入过的纹理
+    // 缓存已经载入过的纹理, 每一项持有全局纹理注册表的一次引用
     std::vector<Texture> textures_loaded;
+    // 纹理路径 -> textures_loaded中的下标
+    std::unordered_map<std::string, size_t> textureIndex;
     // 伽玛校正
     bool gammaCorrection;
+    // 加载统计
+    LoadStats stats;
+    // 逐步加载的状态, 全部载入后释放
+    struct StreamState;
+    std::unique_ptr<StreamState> stream;
+    // 正在后台解码的纹理
+    struct PendingTexture;
+    // 导入完成, 等待在GL上下文线程上传的数据
+    struct PendingLoad;
+    // 在后台线程导入的网格数据与统计
+    struct ImportResult;
+    std::unique_ptr<PendingLoad> pendingLoad;
+
+    friend class ModelBatch;
+    /// @brief 构造尚未加载的模型, 由ModelBatch分两步加载
+    struct Deferred {};
+    Model(Deferred, bool gamma);
     /**
-     * @brief 加载模型
-     * 
+     * @brief 加载模型: importModel之后立即uploadModel
+     *
      * @param path 模型路径
+     * @param mode 加载方式
      */
-    void loadModel(const std::string& path);
+    void loadModel(const std::string& path, LoadMode mode);
+    /**
+     * @brief 加载的CPU部分, 不调用GL, 可在任意线程执行:
+     * 优先映射烘焙产物或网格缓存, 未命中时导入并写入缓存,
+     * 然后提交纹理解码. 逐步加载未命中时把导入提交到importPool后立即返回
+     * @param path 模型路径
+     * @param mode 加载方式
+     */
+    void importModel(const std::string& path, LoadMode mode);
+    /**
+     * @brief 加载的GL部分, 必须在GL上下文线程执行:
+     * 上传importModel的结果, 逐步加载时只上传最粗的一层
+     */
+    void uploadModel();
+    /**
+     * @brief 开始逐步加载: 上传每个网格最粗的一层, 纹理先使用占位纹理.
+     * stream应当已创建. 网格数据在返回前被暂存, 之后不再访问source
+     * @param source 网格视图
+     * @param decoding 已提交解码的纹理, 在update中上传
+     */
+    void streamMeshes(const std::vector<CachedMesh>& source,
+                      std::vector<PendingTexture>&& decoding);
+    /**
+     * @brief 后台导入完成后提交纹理解码并开始逐步加载,
+     * 网格缓存在ioPool中写入. 导入失败时结束逐步加载
+     */
+    void finishImport();
+    /**
+     * @brief 把已载入的纹理替换到所有引用同一路径的网格上
+     *
+     * @param texture 纹理
+     */
+    void applyTexture(const Texture& texture);
+    /**
+     * @brief 导入网格数据, 按设置优化并生成LOD.
+     * .obj与.gltf/.glb在loadConfig()启用时使用内置解析器, 其余使用Assimp
+     * @param path 模型路径
+     * @param data 输出的网格数据
+     * @param dependencies 可为空, 追加导入时读取的其他文件
+     * @return true 导入成功
+     * @return false 导入失败
+     */
+    bool importMeshes(const std::string& path, std::vector<MeshData>& data,
+                      std::vector<std::string>* dependencies = nullptr);
+    /**
+     * @brief 通过Assimp导入网格数据
+     *
+     * @param path 模型路径
+     * @param data 输出的网格数据
+     * @param dependencies 可为空, 追加Assimp打开的其他文件
+     * @return true 导入成功
+     * @return false 导入失败
+     */
+    bool importAssimp(const std::string& path, std::vector<MeshData>& data,
+                      std::vector<std::string>* dependencies);
+    /**
+     * @brief 并行合并重复顶点, 优化每个网格的三角形与顶点顺序,
+     * 并把顶点过多的网格切分为可用16位索引的部分, 统计写入stats
+     *
+     * @param path 模型路径, 用于输出
+     * @param data 网格数据, 原地修改
+     */
+    void optimizeMeshes(const std::string& path, std::vector<MeshData>& data);
+    /**
+     * @brief 并行为每个网格生成LOD链, 耗时写入stats
+     *
+     * @param path 模型路径, 用于输出
+     * @param data 网格数据, 原地修改
+     */
+    void generateLods(const std::string& path, std::vector<MeshData>& data);
+    /**
+     * @brief 上传网格, 引用的纹理应当已经载入
+     *
+     * @param data 网格数据, 调用后被移走
+     */
+    void buildMeshes(std::vector<MeshData>&& data);
     /**
      * @brief 以递归方式处理节点。
-     * 处理位于节点上的每个网格，并在其子节点（如果有）上重复此过程。
+     * 收集位于节点上的每个网格，并在其子节点（如果有）上重复此过程。
      * @param node aiNode指针
      * @param scene aiScene指针
+     * @param found 按遍历顺序输出的网格
      */
-    void processNode(aiNode* node, const aiScene* scene);
+    void processNode(aiNode* node, const aiScene* scene,
+                     std::vector<aiMesh*>& found);
     /**
-     * @brief 处理每一个节点的网格，封装为Mesh对象
-     * 
+     * @brief 处理每一个节点的网格，转换为网格数据
+     * 可在多个线程中同时调用
      * @param mesh aiMesh指针
      * @param scene aiScene指针
-     * @return Mesh 网格对象
+     * @return MeshData 网格数据
      */
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    MeshData processMesh(aiMesh* mesh, const aiScene* scene);
     /**
-     * @brief 检查给定类型的所有材质纹理，如果尚未加载纹理，则加载纹理。
-     * 所需信息作为纹理结构返回。
+     * @brief 获取材质中给定类型的所有纹理
+     * 所需信息作为纹理结构追加到textures, 此时尚未加载
      * @param mat aiMaterial的指针
      * @param type aiTextureType对象
      * @param typeName 类型名称
-     * @return std::vector<Texture> 纹理数组
+     * @param textures 输出的纹理数组
+     */
+    void loadMaterialTextures(aiMaterial* mat, aiTextureType type,
+                              const char* typeName,
+                              std::vector<Texture>& textures);
+    /**
+     * @brief 查找已载入的纹理, 尚未载入时从文件加载
+     *
+     * @param path 纹理相对模型目录的路径
+     * @param typeName 类型名称
+     * @return Texture 纹理
+     */
+    Texture findOrLoadTexture(const std::string& path,
+                              const std::string& typeName);
+    /**
+     * @brief 释放持有的所有纹理引用
+     *
+     */
+    void releaseTextures();
+    /**
+     * @brief 查询全局纹理注册表, 已注册的直接记入textures_loaded,
+     * 其余提交到线程池解码. 已载入或重复的路径会被跳过
+     * @param wanted 需要的纹理, 只使用type与path
+     * @param pending 输出的解码任务
+     * @param pairs 可以合并为一张纹理的漫反射与高光路径
+     */
+    void requestTextures(
+        const std::vector<Texture>& wanted,
+        std::vector<PendingTexture>& pending,
+        const std::unordered_map<std::string, std::string>& pairs = {});
+    /**
+     * @brief 等待解码完成, 上传并记入textures_loaded.
+     * 成对解码的漫反射与高光两者都会记入
+     * @param pending 解码任务
+     * @return Texture 载入的纹理, 成对时为漫反射
      */
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat,
-                                              aiTextureType type,
-                                              std::string typeName);
+    Texture finishTexture(PendingTexture& pending);
 };
 
 MGL_END
@@ -0,0 +1,114 @@
+﻿#pragma once
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Model.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 并发加载一组模型: 导入(解析, 优化, 生成LOD, 读写缓存, 纹理解码)
+ * 在importPool中并行进行, GL对象的创建全部留在GL上下文线程,
+ * 由poll, take或wait按导入完成的顺序逐个上传.
+ * 相同路径的模型只导入一次并共享; 一次载入(LoadMode::Blocking)的模型
+ * 上传后登记到ModelRegistry, 之后按路径加载时直接共享
+ * @class
+ */
+class ModelBatch {
+  private:
+    // 一个路径的导入任务及共享其结果的模型
+    struct Group {
+        std::string path;
+        // 正在导入的模型, 上传后交给members
+        std::shared_ptr<Model> model;
+        std::future<void> imported;
+        std::vector<size_t> members;
+        // 已上传, 或导入与上传已失败
+        bool uploaded = false;
+        // 导入或上传抛出的异常, 失败时组内的模型为空
+        std::exception_ptr error;
+    };
+    // 按路径顺序的模型, 上传之前与被take之后为空, 相同路径为同一个
+    std::vector<std::shared_ptr<Model>> models;
+    // 每个模型所在的组
+    std::vector<size_t> groupOf;
+    std::vector<Group> groups;
+    bool gamma;
+    LoadMode mode;
+    // 尚未上传的组数
+    size_t remaining;
+    std::chrono::steady_clock::time_point start;
+    /**
+     * @brief 等待组导入完成并上传其中的模型, 不抛出异常,
+     * 失败时记录在组中
+     * @param group 组
+     */
+    void upload(Group& group);
+
+  public:
+    /**
+     * @brief 提交所有模型的导入, 立即返回
+     *
+     * @param paths 模型路径
+     * @param gamma 伽玛校正--默认为false
+     * @param mode 加载方式, 逐步加载时上传后仍需调用Model::update
+     */
+    explicit ModelBatch(const std::vector<std::string>& paths,
+                        bool gamma = false,
+                        LoadMode mode = LoadMode::Blocking);
+    ModelBatch(const ModelBatch&) = delete;
+    ModelBatch& operator=(const ModelBatch&) = delete;
+    /**
+     * @brief 等待仍在进行的导入结束, 未取走的模型随之释放
+     *
+     */
+    ~ModelBatch();
+    /**
+     * @brief 获取模型数量
+     *
+     * @return size_t 模型数量
+     */
+    inline size_t size() const { return models.size(); }
+    /**
+     * @brief 上传已导入完成的模型, 不等待, 必须在GL上下文线程调用
+     *
+     * @return size_t 已上传或已失败的模型数量
+     */
+    size_t poll();
+    /**
+     * @brief 第index个模型是否已上传, 可以无等待地take
+     *
+     * @param index 路径序号
+     */
+    bool ready(size_t index) const;
+    /**
+     * @brief 取走第index个模型, 尚未导入完成时等待,
+     * 所在组的导入或上传失败时重新抛出其异常. 必须在GL上下文线程调用
+     * @param index 路径序号
+     * @return std::shared_ptr<Model> 模型, 已被取走时为空
+     */
+    std::shared_ptr<Model> take(size_t index);
+    /**
+     * @brief 按导入完成的顺序上传全部模型后取走, 有组失败时
+     * 在全部组结束后重新抛出第一个失败组的异常. 必须在GL上下文线程调用
+     * @return std::vector<std::shared_ptr<Model>> 按路径顺序的模型,
+     * 相同路径为同一个模型
+     */
+    std::vector<std::shared_ptr<Model>> wait();
+};
+
+/**
+ * @brief 并发加载一组模型, 总耗时接近其中最慢的一个而不是各自之和,
+ * 有模型失败时抛出其异常(见ModelBatch::wait). 必须在GL上下文线程调用
+ * @param paths 模型路径
+ * @param gamma 伽玛校正--默认为false
+ * @param mode 加载方式
+ * @return std::vector<std::shared_ptr<Model>> 按路径顺序的模型,
+ * 相同路径为同一个模型
+ */
+std::vector<std::shared_ptr<Model>> LoadModels(
+    const std::vector<std::string>& paths, bool gamma = false,
+    LoadMode mode = LoadMode::Blocking);
+MGL_END
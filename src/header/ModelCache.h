@@ -0,0 +1,147 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "VirtualFileSystem.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 缓存文件中一个网格的只读视图, 顶点与索引直接指向映射内存
+ * @struct
+ */
+struct CachedMesh {
+    // 顶点数据
+    const Vertex* vertices;
+    // 顶点数量
+    uint32_t vertexCount;
+    // 索引数据
+    const unsigned int* indices;
+    // 索引数量
+    uint32_t indexCount;
+    // 各层LOD在索引中的范围
+    const MeshLod* lods;
+    // LOD数量, 0表示只有原始网格
+    uint32_t lodCount;
+    // 纹理类型与路径, id尚未加载
+    std::vector<Texture> textures;
+};
+
+/**
+ * @brief 导入时读取的其他文件(.mtl, 外部.bin等)及其内容哈希
+ * @struct
+ */
+struct ModelDependency {
+    // 相对于模型所在目录的路径, 不在该目录下时为原路径
+    std::string path;
+    // 文件内容的哈希, 文件不存在时为0
+    uint64_t hash;
+};
+
+/**
+ * @brief 模型网格的二进制缓存
+ * 文件布局: 文件头 | 网格记录表 | 每个网格的顶点, 索引, LOD表与纹理表 |
+ * 依赖文件表. 源文件哈希, 导入设置或任一依赖文件的内容变化时缓存失效
+ * @class
+ */
+class ModelCache {
+  public:
+    /// @brief 缓存格式版本, 修改布局时递增
+    static const uint32_t Version = 5;
+    /**
+     * @brief 获取模型对应的缓存文件路径
+     *
+     * @param source 模型路径
+     * @return std::string 缓存文件路径
+     */
+    static std::string cachePath(const std::string& source);
+    /**
+     * @brief 计算模型源文件的哈希值
+     *
+     * @param source 模型路径
+     * @param hash 输出哈希值
+     * @return true 计算成功
+     * @return false 源文件无法读取
+     */
+    static bool hashSource(const std::string& source, uint64_t& hash);
+    /**
+     * @brief 计算导入器报告的依赖文件的哈希, 去掉重复与模型本身
+     *
+     * @param source 模型路径
+     * @param files 导入时读取的其他文件
+     * @return std::vector<ModelDependency> 依赖文件表
+     */
+    static std::vector<ModelDependency> hashDependencies(
+        const std::string& source, const std::vector<std::string>& files);
+    /**
+     * @brief 重新计算依赖文件表中各文件当前的哈希
+     *
+     * @param source 模型路径, 依赖文件相对于其所在目录
+     * @param dependencies 依赖文件表, hash就地更新为文件当前的哈希
+     */
+    static void rehashDependencies(const std::string& source,
+                                   std::vector<ModelDependency>& dependencies);
+    /**
+     * @brief 获取依赖文件可读取的路径
+     *
+     * @param source 模型路径, 依赖文件相对于其所在目录
+     * @param dependency 依赖文件
+     * @return std::string 文件路径
+     */
+    static std::string dependencyPath(const std::string& source,
+                                      const ModelDependency& dependency);
+    /**
+     * @brief 将网格写入缓存文件
+     *
+     * @param path 缓存文件路径
+     * @param sourceHash 源文件哈希
+     * @param settings 导入设置的哈希
+     * @param meshes 导入得到的网格数据
+     * @param dependencies 由hashDependencies得到的依赖文件表
+     * @return true 写入成功
+     * @return false 写入失败
+     */
+    static bool write(const std::string& path, uint64_t sourceHash,
+                      uint64_t settings, const std::vector<MeshData>& meshes,
+                      const std::vector<ModelDependency>& dependencies);
+    /**
+     * @brief 映射并校验缓存文件, 并重新计算各依赖文件的哈希与记录比较
+     *
+     * @param path 缓存文件路径
+     * @param source 模型路径, 依赖文件相对于其所在目录
+     * @param sourceHash 期望的源文件哈希
+     * @param settings 期望的导入设置哈希
+     * @return true 缓存有效
+     * @return false 缓存不存在, 已损坏或已失效
+     */
+    bool open(const std::string& path, const std::string& source,
+              uint64_t sourceHash, uint64_t settings);
+    /**
+     * @brief 获取网格数量
+     *
+     * @return size_t 网格数量
+     */
+    size_t meshCount() const;
+    /**
+     * @brief 获取第index个网格的视图, 仅在缓存保持打开时有效
+     *
+     * @param index 网格序号
+     * @return CachedMesh 网格视图
+     */
+    CachedMesh mesh(size_t index) const;
+    /**
+     * @brief 获取缓存记录的依赖文件表
+     *
+     * @return const std::vector<ModelDependency>& 依赖文件表
+     */
+    inline const std::vector<ModelDependency>& getDependencies() const {
+        return dependencies;
+    }
+
+  private:
+    // 映射的缓存文件, 可能位于资源包中
+    FileData file;
+    // 打开时读出的依赖文件表
+    std::vector<ModelDependency> dependencies;
+};
+MGL_END
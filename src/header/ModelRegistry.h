@@ -0,0 +1,101 @@
+﻿#pragma once
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Model.h"
+#include "Shader.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 进程级模型注册表
+ * 同一路径的模型只导入一次, 返回共享且不可修改的模型数据;
+ * 最后一个引用释放时模型随之释放
+ * @class
+ */
+class ModelRegistry {
+  private:
+    // 注册键 -> 模型, 只保存弱引用
+    std::unordered_map<std::string, std::weak_ptr<const Model>> models;
+    std::mutex mutex;
+
+    ModelRegistry() = default;
+
+  public:
+    ModelRegistry(const ModelRegistry&) = delete;
+    ModelRegistry& operator=(const ModelRegistry&) = delete;
+    /**
+     * @brief 获取全局注册表
+     *
+     * @return ModelRegistry& 注册表
+     */
+    static ModelRegistry& instance();
+    /**
+     * @brief 获取模型, 尚未载入或已被释放时导入
+     * 必须在GL上下文线程调用
+     * @param path 模型路径
+     * @param gamma 伽玛校正
+     * @return std::shared_ptr<const Model> 共享的模型
+     */
+    std::shared_ptr<const Model> load(const std::string& path,
+                                      bool gamma = false);
+    /**
+     * @brief 登记在别处载入完成的模型(如ModelBatch), 之后按路径加载时
+     * 直接共享; 同一路径已有存活的模型时不替换
+     * @param path 模型路径
+     * @param gamma 伽玛校正
+     * @param model 已载入的模型
+     */
+    void insert(const std::string& path, bool gamma,
+                std::shared_ptr<const Model> model);
+    /**
+     * @brief 获取存活的模型数量
+     *
+     * @return size_t 模型数量
+     */
+    size_t size();
+};
+
+/**
+ * @brief 模型实例, 共享模型数据, 只持有自身的变换等状态
+ * @class
+ */
+class ModelInstance {
+  private:
+    // 共享的模型数据
+    std::shared_ptr<const Model> model;
+    // 模型矩阵
+    glm::mat4 transform;
+
+  public:
+    /**
+     * @brief 通过模型注册表构造实例
+     *
+     * @param path 模型路径
+     * @param gamma 伽玛校正--默认为false
+     */
+    explicit ModelInstance(const std::string& path, bool gamma = false);
+    /**
+     * @brief 使用已载入的模型构造实例
+     *
+     * @param model 共享的模型
+     * @param transform 模型矩阵
+     */
+    explicit ModelInstance(std::shared_ptr<const Model> model,
+                           const glm::mat4& transform = glm::mat4(1.0f));
+    /**
+     * @brief 设置着色器的model矩阵后绘制模型
+     *
+     * @param shader 着色器对象
+     */
+    void Draw(Shader& shader) const;
+
+    inline const std::shared_ptr<const Model>& getModel() const {
+        return model;
+    }
+    inline glm::mat4& getTransform() { return transform; }
+    inline const glm::mat4& getTransform() const { return transform; }
+    inline void setTransform(const glm::mat4& m) { transform = m; }
+};
+MGL_END
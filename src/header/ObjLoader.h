@@ -0,0 +1,20 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief Wavefront OBJ/MTL快速导入
+ * 映射文件后按行边界切块, 在线程池中并行解析, 再按对象/材质并行组装网格.
+ * 输出与Assimp路径一致: 三角化, 翻转V坐标, 缺失时生成平滑法线, 计算切线空间;
+ * 顶点按 (v, vt, vn) 组合去重
+ * @param path OBJ文件路径
+ * @param meshes 输出的网格数据, 按对象与材质切分
+ * @param dependencies 可为空, 追加引用的各mtllib文件路径
+ * @return true 导入成功
+ * @return false 文件无法读取或格式错误
+ */
+bool LoadObj(const std::string& path, std::vector<MeshData>& meshes,
+             std::vector<std::string>* dependencies = nullptr);
+MGL_END
@@ -0,0 +1,109 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 资源包中的一个文件
+ * @struct
+ */
+struct PackEntry {
+    // 相对于包根目录的路径, 分隔符为'/'
+    std::string path;
+    // 数据在包中的偏移量与字节数
+    uint64_t offset;
+    uint64_t size;
+    // 解压后的字节数
+    uint64_t rawSize;
+    // 原始内容的HashBytes哈希
+    uint64_t contentHash;
+    // 压缩方式
+    uint32_t compression;
+};
+
+/**
+ * @brief 单文件资源包, 整个文件只映射一次
+ * 文件布局: 文件头 | 按Alignment对齐的各文件数据 | 目录表(TOC)
+ * 未压缩的条目在映射内存中按Alignment对齐, 可以直接上传
+ * @class
+ */
+class ResourcePack {
+  public:
+    /// @brief 包格式版本, 修改布局时递增
+    static const uint32_t Version = 1;
+    /// @brief 每个条目数据的对齐字节数
+    static const uint64_t Alignment = 64;
+    /// @brief 压缩方式
+    enum Compression : uint32_t { Stored = 0, Lz4 = 1 };
+    /**
+     * @brief 映射资源包并读取目录表
+     *
+     * @param path 资源包路径
+     * @return true 打开成功
+     * @return false 文件不存在或已损坏
+     */
+    bool open(const std::string& path);
+    /**
+     * @brief 按路径查找条目, Windows下不区分大小写
+     *
+     * @param path 相对于包根目录的路径
+     * @return const PackEntry* 条目, 不存在时为空
+     */
+    const PackEntry* find(const std::string& path) const;
+    /**
+     * @brief 未压缩条目在映射内存中的数据
+     *
+     * @param entry 条目
+     * @return const unsigned char* 数据首地址, 压缩的条目为空
+     */
+    const unsigned char* view(const PackEntry& entry) const;
+    /**
+     * @brief 读取并解压条目
+     *
+     * @param entry 条目
+     * @param out 输出的原始内容
+     * @return true 读取成功
+     * @return false 数据损坏
+     */
+    bool read(const PackEntry& entry, std::vector<unsigned char>& out) const;
+
+    inline const std::vector<PackEntry>& getEntries() const { return entries; }
+
+  private:
+    // 映射的包文件
+    MappedFile file;
+    std::vector<PackEntry> entries;
+    // 查找用的路径 -> 条目序号
+    std::unordered_map<std::string, size_t> index;
+};
+
+/**
+ * @brief 资源包的构建统计
+ * @struct
+ */
+struct PackBuildStats {
+    size_t files = 0;
+    // 压缩存放的文件数
+    size_t compressed = 0;
+    uint64_t rawBytes = 0;
+    uint64_t packedBytes = 0;
+};
+
+/**
+ * @brief 把目录下的所有文件写入资源包.
+ * 压缩后仍超过原大小7/8的文件(如png, jpg)与可直接映射使用的文件
+ * (网格缓存, 烘焙的纹理)不压缩, 其余使用LZ4
+ * @param directory 资源目录
+ * @param prefix 包内路径前缀, 如"resource", 为空时不加前缀
+ * @param output 输出的资源包路径
+ * @param stats 输出的统计, 可为空
+ * @return true 构建成功
+ * @return false 写入失败
+ */
+bool BuildResourcePack(const std::string& directory, const std::string& prefix,
+                       const std::string& output,
+                       PackBuildStats* stats = nullptr);
+MGL_END
@@ -51,6 +51,13 @@ class Shader {
      * @param path 路径
      */
     void readShader(const std::string& path);
+    /**
+     * @brief 从source读取path对应的shader, source为烘焙产物或path本身
+     *
+     * @param path 源文件路径, 用于判断类型
+     * @param source 实际读取的文件
+     */
+    void readShader(const std::string& path, const std::string& source);
     /**
      * @brief 获取着色器类型对应的OpenGL值
      *
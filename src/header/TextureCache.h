@@ -0,0 +1,108 @@
+﻿#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "defined.h"
+MGL_START
+/**
+ * @brief 进程级纹理注册表
+ * 以规范化路径(CanonicalPath)为键, 可选按内容哈希去重
+ * 引用计数归零时删除GL纹理
+ * 查询接口线程安全, GL纹理的删除发生在调用release的线程
+ * @class
+ */
+class TextureCache {
+  private:
+    /// @brief 注册表条目
+    struct Entry {
+        // 纹理名称
+        unsigned int id;
+        // 引用计数
+        unsigned int refs;
+        // 内容哈希
+        uint64_t contentHash;
+        // 是否记录了内容哈希
+        bool hashed;
+        // 指向该纹理的所有路径
+        std::vector<std::string> keys;
+    };
+    // 纹理名称 -> 条目
+    std::unordered_map<unsigned int, Entry> entries;
+    // 规范化路径 -> 纹理名称
+    std::unordered_map<std::string, unsigned int> byPath;
+    // 内容哈希 -> 纹理名称
+    std::unordered_map<uint64_t, unsigned int> byContent;
+    mutable std::mutex mutex;
+
+    TextureCache() = default;
+
+  public:
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+    /**
+     * @brief 获取全局注册表
+     *
+     * @return TextureCache& 注册表
+     */
+    static TextureCache& instance();
+    /**
+     * @brief 按路径查找纹理, 找到时引用计数加一
+     *
+     * @param key 规范化路径
+     * @param id 输出纹理名称
+     * @return true 找到
+     * @return false 未注册
+     */
+    bool acquire(const std::string& key, unsigned int& id);
+    /**
+     * @brief 按内容哈希查找纹理, 并逐字节比较key与该纹理的源文件以排除
+     * 哈希碰撞. 确认相同时将key登记为其别名并且引用计数加一.
+     * 比较时不持有锁, 不应在持有其他纹理锁的情况下调用
+     * @param key 规范化路径, 即哈希所对应的文件
+     * @param contentHash 文件内容哈希
+     * @param id 输出纹理名称
+     * @return true 找到相同内容的纹理
+     * @return false 未找到, 内容不同或任一文件无法读取
+     */
+    bool acquireContent(const std::string& key, uint64_t contentHash,
+                        unsigned int& id);
+    /**
+     * @brief 判断是否已存在相同哈希的纹理, 只用于提前跳过解码,
+     * 是否真的相同由acquireContent确认
+     * @param contentHash 文件内容哈希
+     * @return true 已存在
+     */
+    bool hasContent(uint64_t contentHash) const;
+    /**
+     * @brief 判断路径是否已注册, 不改变引用计数
+     *
+     * @param key 规范化路径
+     * @return true 已注册
+     */
+    bool contains(const std::string& key) const;
+    /**
+     * @brief 注册新上传的纹理, 引用计数为一
+     *
+     * @param key 规范化路径
+     * @param id 纹理名称
+     * @param contentHash 文件内容哈希
+     * @param hashed contentHash是否有效
+     */
+    void insert(const std::string& key, unsigned int id, uint64_t contentHash,
+                bool hashed);
+    /**
+     * @brief 释放一次引用, 归零时删除GL纹理, 必须在GL上下文线程调用
+     *
+     * @param id 纹理名称
+     */
+    void release(unsigned int id);
+    /**
+     * @brief 获取注册的纹理数量
+     *
+     * @return size_t 纹理数量
+     */
+    size_t size() const;
+};
+MGL_END
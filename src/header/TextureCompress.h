@@ -0,0 +1,64 @@
+﻿#pragma once
+#include <cstddef>
+#include <vector>
+#include "Config.h"
+#include "Image.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief mip链中的一层, 像素为RGBA8
+ * @struct
+ */
+struct MipLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+/**
+ * @brief 用可分离滤波把图像缩小一半, 边缘之外重复边缘像素,
+ * 逐行以SIMD处理, 除输出外只需几行的临时内存
+ * @param pixels 像素, 1至4通道, 1, 2通道为灰度(与透明度)
+ * @param width 宽度
+ * @param height 高度
+ * @param channels 通道数
+ * @param filter 滤波器
+ * @param normalMap 是否为法线贴图, 是时重新归一化法线
+ * @return MipLevel 缩小后的RGBA8图像
+ */
+MipLevel DownsampleHalf(const unsigned char* pixels, int width, int height,
+                        int channels, MipFilter filter, bool normalMap);
+/**
+ * @brief 由RGBA8图像生成完整的mip链(第0层为原图), 每层缩小一半直到1x1
+ *
+ * @param rgba 第0层像素
+ * @param width 宽度
+ * @param height 高度
+ * @param filter 滤波器
+ * @param normalMap 是否为法线贴图, 是时每层重新归一化法线
+ * @return std::vector<MipLevel> mip链
+ */
+std::vector<MipLevel> BuildMipChain(const unsigned char* rgba, int width,
+                                    int height, MipFilter filter,
+                                    bool normalMap);
+/**
+ * @brief 一层像素按给定格式存储所需的字节数
+ *
+ * @param format 像素格式
+ * @param width 宽度
+ * @param height 高度
+ * @return size_t 字节数, 块压缩格式按4x4块向上取整
+ */
+size_t ImageLevelSize(PixelFormat format, int width, int height);
+/**
+ * @brief 把RGBA8像素转换为给定格式: 未压缩格式取前几个通道,
+ * BC1/BC3压缩RGB(A), BC4压缩R, BC5压缩RG
+ * @param format 目标格式
+ * @param rgba 像素
+ * @param width 宽度
+ * @param height 高度
+ * @param out 输出, ImageLevelSize(format, width, height)字节
+ */
+void EncodeImageLevel(PixelFormat format, const unsigned char* rgba, int width,
+                      int height, unsigned char* out);
+MGL_END
@@ -0,0 +1,171 @@
+﻿#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "defined.h"
+MGL_START
+/**
+ * @brief 固定大小的线程池
+ * @class
+ */
+class ThreadPool {
+  private:
+    // 工作线程
+    std::vector<std::thread> workers;
+    // 待执行任务
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    // 是否正在停止
+    bool stopping;
+    /**
+     * @brief 工作线程循环
+     *
+     */
+    void workerLoop();
+
+  public:
+    /**
+     * @brief 构造线程池
+     *
+     * @param threads 线程数量, 0表示使用硬件线程数
+     */
+    explicit ThreadPool(unsigned int threads = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    /**
+     * @brief 等待已提交的任务完成后结束所有线程
+     *
+     */
+    ~ThreadPool();
+    /**
+     * @brief 提交任务
+     *
+     * @tparam F 可调用类型
+     * @param f 任务
+     * @return std::future 任务结果
+     */
+    template <typename F>
+    std::future<decltype(std::declval<F&>()())> submit(F&& f) {
+        using R = decltype(std::declval<F&>()());
+        auto task =
+            std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([task]() { (*task)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+    /**
+     * @brief 获取线程数量
+     *
+     * @return unsigned int 线程数量
+     */
+    inline unsigned int size() const {
+        return static_cast<unsigned int>(workers.size());
+    }
+    /**
+     * @brief 获取硬件线程数, 无法获取时返回1
+     *
+     * @return unsigned int 硬件线程数
+     */
+    static unsigned int hardwareThreads();
+};
+
+/**
+ * @brief 获取纹理解码线程池, 线程数由loadConfig().decodeThreads决定
+ * 设置变化后下一次调用会重建线程池, 须在没有解码任务时修改设置
+ * @return ThreadPool& 线程池
+ */
+ThreadPool& texturePool();
+/**
+ * @brief 获取通用工作线程池, 用于网格解析与处理等CPU任务,
+ * 线程数由loadConfig().workerThreads决定, 重建规则同texturePool
+ * @return ThreadPool& 线程池
+ */
+ThreadPool& workerPool();
+/**
+ * @brief 获取模型导入线程池, 每个任务导入一个模型,
+ * 模型内部的并行处理仍然使用workerPool.
+ * 线程数由loadConfig().importThreads决定, 重建规则同texturePool
+ * @return ThreadPool& 线程池
+ */
+ThreadPool& importPool();
+/**
+ * @brief 获取文件读取线程池, 由ReadBatch使用,
+ * 线程数由loadConfig().ioThreads决定, 重建规则同texturePool
+ * @return ThreadPool& 线程池
+ */
+ThreadPool& ioPool();
+
+/**
+ * @brief 将 [0, count) 按grain大小分块并行执行 f(begin, end)
+ * 调用线程也参与执行且只等待已被领取的块, 因此可以在线程池任务中嵌套调用.
+ * f抛出异常时等待已开始的块结束, 再在调用线程重新抛出第一个异常
+ * @tparam F 可调用类型 void(size_t, size_t)
+ * @param count 元素数量
+ * @param grain 每块的元素数量
+ * @param f 处理函数
+ * @param pool 线程池
+ */
+template <typename F>
+void ParallelFor(size_t count, size_t grain, F&& f,
+                 ThreadPool& pool = workerPool()) {
+    if (count == 0) return;
+    if (grain == 0) grain = 1;
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || pool.size() <= 1) {
+        f(size_t(0), count);
+        return;
+    }
+    struct State {
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        size_t done = 0;
+        // 第一个抛出的异常, 等待全部块结束后在调用线程重新抛出
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+    auto state = std::make_shared<State>();
+    auto run = [state, chunks, grain, count, &f]() {
+        for (;;) {
+            size_t chunk = state->next.fetch_add(1);
+            if (chunk >= chunks) return;
+            size_t begin = chunk * grain;
+            std::exception_ptr error;
+            // 出错后剩余的块不再执行, 但仍然计数, 调用线程才能结束等待
+            if (!state->failed) {
+                try {
+                    f(begin, std::min(count, begin + grain));
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (error && !state->error) {
+                state->error = error;
+                state->failed = true;
+            }
+            if (++state->done == chunks) state->condition.notify_all();
+        }
+    };
+    size_t helpers = std::min<size_t>(pool.size(), chunks - 1);
+    for (size_t i = 0; i < helpers; ++i) pool.submit(run);
+    run();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&] { return state->done == chunks; });
+    if (state->error) std::rethrow_exception(state->error);
+}
+MGL_END
@@ -0,0 +1,88 @@
+﻿#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include "defined.h"
+MGL_START
+#define MAX_BONE_INFLUENCE 4
+/**
+ * @brief 顶点
+ * @struct
+ */
+struct Vertex {
+    // 顶点坐标
+    glm::vec3 Position;
+    // 法向量
+    glm::vec3 Normal;
+    // 纹理坐标
+    glm::vec2 TexCoords;
+    // 切线
+    glm::vec3 Tangent;
+    // 副切线
+    glm::vec3 Bitangent;
+    // 将影响此顶点的骨骼索引
+    int m_BoneIDs[MAX_BONE_INFLUENCE];
+    // 每块骨头的重量
+    float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+/**
+ * @brief 不含骨骼数据的静态顶点
+ * @struct
+ */
+struct StaticVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+};
+
+/**
+ * @brief 只有位置的顶点, 用于天空盒等
+ * @struct
+ */
+struct PositionVertex {
+    glm::vec3 Position;
+};
+
+/**
+ * @brief 位置与纹理坐标
+ * @struct
+ */
+struct PositionTexVertex {
+    glm::vec3 Position;
+    glm::vec2 TexCoords;
+};
+
+/**
+ * @brief 压缩的静态顶点
+ * 位置为相对网格包围盒的unorm16, w分量保存副切线方向(0为-1, 65535为+1);
+ * 法线与切线为八面体映射的snorm16; 纹理坐标为半精度浮点.
+ * 着色器中的解码:
+ *   position = aPos * positionScale + positionOffset
+ *   n = vec3(e, 1 - |e.x| - |e.y|); t = max(-n.z, 0);
+ *   n.xy += n.xy >= 0 ? -t : t; normal = normalize(n)
+ *   bitangent = cross(normal, tangent) * (sign * 2 - 1)
+ * @struct
+ */
+struct PackedVertex {
+    uint16_t Position[4];
+    int16_t Normal[2];
+    int16_t Tangent[2];
+    uint16_t TexCoords[2];
+};
+
+/**
+ * @brief 压缩的蒙皮顶点, 前20字节与PackedVertex相同,
+ * 骨骼索引为uint8, 权重为unorm8
+ * @struct
+ */
+struct PackedSkinnedVertex {
+    uint16_t Position[4];
+    int16_t Normal[2];
+    int16_t Tangent[2];
+    uint16_t TexCoords[2];
+    uint8_t BoneIDs[MAX_BONE_INFLUENCE];
+    uint8_t Weights[MAX_BONE_INFLUENCE];
+};
+MGL_END
@@ -0,0 +1,75 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "Vertex.h"
+#include "defined.h"
+MGL_START
+/**
+ * @brief 上传到GPU的顶点格式
+ */
+enum class VertexFormat {
+    // 完整的Vertex, 88字节
+    Skinned,
+    // 不含骨骼的StaticVertex, 56字节
+    Static,
+    // 只有位置的PositionVertex, 12字节
+    Position,
+    // 压缩的静态顶点PackedVertex, 20字节
+    Packed,
+    // 压缩的蒙皮顶点PackedSkinnedVertex, 28字节
+    PackedSkinned
+};
+
+/**
+ * @brief 位置的解码参数: position = 归一化值 * scale + offset
+ * @struct
+ */
+struct PositionDecode {
+    glm::vec3 scale = glm::vec3(1.0f);
+    glm::vec3 offset = glm::vec3(0.0f);
+};
+
+/**
+ * @brief 获取格式的顶点大小
+ *
+ * @param format 顶点格式
+ * @return size_t 字节数
+ */
+size_t VertexFormatSize(VertexFormat format);
+/**
+ * @brief 选择能无损表示顶点数据的最小格式:
+ * 没有骨骼权重时省略骨骼, 法线, 纹理坐标与切线都为0时只保留位置;
+ * 压缩时骨骼索引都在0~255内才使用8位, 否则不压缩
+ * @param vertices 顶点数据
+ * @param count 顶点数量
+ * @param pack 是否使用压缩格式
+ * @return VertexFormat 顶点格式
+ */
+VertexFormat ChooseVertexFormat(const Vertex* vertices, size_t count,
+                                bool pack);
+/**
+ * @brief 按格式转换顶点
+ *
+ * @param vertices 顶点数据
+ * @param count 顶点数量
+ * @param format 顶点格式, 为Skinned时直接复制
+ * @param out 输出, 至少count * VertexFormatSize(format)字节
+ * @return PositionDecode 位置的解码参数, 非压缩格式为单位变换
+ */
+PositionDecode ConvertVertices(const Vertex* vertices, size_t count,
+                               VertexFormat format, void* out);
+/**
+ * @brief 单精度浮点转换为半精度, 就近舍入
+ *
+ * @param value 单精度浮点
+ * @return uint16_t 半精度的位表示
+ */
+uint16_t FloatToHalf(float value);
+/**
+ * @brief 单位向量的八面体映射, 结果为snorm16
+ *
+ * @param n 单位向量
+ * @param out 两个分量
+ */
+void EncodeOctahedral(const glm::vec3& n, int16_t out[2]);
+MGL_END
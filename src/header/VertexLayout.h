@@ -0,0 +1,221 @@
+﻿#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include "Vertex.h"
+#include "defined.h"
+#include "type_traits.hpp"
+MGL_START
+/**
+ * @brief 顶点属性在着色器中的读取方式
+ */
+enum class AttributeKind {
+    // 按原值转换为浮点
+    Float,
+    // 整数归一化到[0, 1]或[-1, 1]
+    Normalized,
+    // 16位半精度浮点, 分量类型为uint16_t
+    Half,
+    // 整数属性, 着色器中为ivec/uvec
+    Integer
+};
+
+/**
+ * @brief 分量类型对应的GL类型
+ * @tparam T 分量类型
+ */
+template <typename T>
+struct gl_component_type;
+template <>
+struct gl_component_type<float> : integral_constant<unsigned int, GL_FLOAT> {};
+template <>
+struct gl_component_type<int32_t> : integral_constant<unsigned int, GL_INT> {};
+template <>
+struct gl_component_type<uint32_t>
+    : integral_constant<unsigned int, GL_UNSIGNED_INT> {};
+template <>
+struct gl_component_type<int16_t> : integral_constant<unsigned int, GL_SHORT> {
+};
+template <>
+struct gl_component_type<uint16_t>
+    : integral_constant<unsigned int, GL_UNSIGNED_SHORT> {};
+template <>
+struct gl_component_type<int8_t> : integral_constant<unsigned int, GL_BYTE> {};
+template <>
+struct gl_component_type<uint8_t>
+    : integral_constant<unsigned int, GL_UNSIGNED_BYTE> {};
+
+/**
+ * @brief 成员类型的分量类型与分量数: glm向量, 定长数组或标量
+ * @tparam T 成员类型
+ */
+template <typename T>
+struct member_components {
+    using type = T;
+    static constexpr unsigned int count = 1;
+};
+template <>
+struct member_components<glm::vec2> {
+    using type = float;
+    static constexpr unsigned int count = 2;
+};
+template <>
+struct member_components<glm::vec3> {
+    using type = float;
+    static constexpr unsigned int count = 3;
+};
+template <>
+struct member_components<glm::vec4> {
+    using type = float;
+    static constexpr unsigned int count = 4;
+};
+template <typename T, size_t N>
+struct member_components<T[N]> {
+    using type = T;
+    static constexpr unsigned int count = static_cast<unsigned int>(N);
+};
+
+/**
+ * @brief 一个顶点属性的编译期描述
+ * @tparam Location 着色器中的location
+ * @tparam Component 分量类型
+ * @tparam Count 分量数, 1~4
+ * @tparam Offset 在顶点中的字节偏移
+ * @tparam Kind 读取方式
+ */
+template <unsigned int Location, typename Component, unsigned int Count,
+          size_t Offset, AttributeKind Kind>
+struct VertexAttribute {
+    static_assert(Count >= 1 && Count <= 4, "attribute needs 1-4 components");
+    static_assert(Kind != AttributeKind::Half || is_same_v<Component, uint16_t>,
+                  "half attributes are stored as uint16_t");
+    static_assert(Kind != AttributeKind::Integer ||
+                      !is_same_v<Component, float>,
+                  "integer attributes need an integer component type");
+
+    using component_type = Component;
+    static constexpr unsigned int location = Location;
+    static constexpr unsigned int count = Count;
+    static constexpr size_t offset = Offset;
+    static constexpr size_t size = sizeof(Component) * Count;
+    static constexpr unsigned int glType =
+        Kind == AttributeKind::Half ? GL_HALF_FLOAT
+                                    : gl_component_type<Component>::value;
+
+    /**
+     * @brief 启用属性并设置当前VBO中的指针
+     *
+     * @param stride 顶点大小
+     */
+    static void setup(size_t stride) {
+        glEnableVertexAttribArray(Location);
+        if constexpr (Kind == AttributeKind::Integer) {
+            glVertexAttribIPointer(Location, Count, glType,
+                                   static_cast<GLsizei>(stride),
+                                   (void*)Offset);
+        } else {
+            glVertexAttribPointer(
+                Location, Count, glType,
+                Kind == AttributeKind::Normalized ? GL_TRUE : GL_FALSE,
+                static_cast<GLsizei>(stride), (void*)Offset);
+        }
+    }
+};
+
+/// @brief 编译期计算置位的位数
+constexpr size_t countBits(unsigned int bits) {
+    return bits ? (bits & 1u) + countBits(bits >> 1) : 0;
+}
+
+/**
+ * @brief 顶点布局: 顶点类型与其全部属性, 属性设置在编译期展开
+ * @tparam VertexT 顶点类型
+ * @tparam Attributes VertexAttribute列表
+ */
+template <typename VertexT, typename... Attributes>
+struct VertexLayout {
+    using vertex_type = VertexT;
+    static constexpr size_t stride = sizeof(VertexT);
+    static constexpr size_t attributeCount = sizeof...(Attributes);
+    // 使用的location位掩码
+    static constexpr unsigned int locations =
+        (0u | ... | (1u << Attributes::location));
+
+    static_assert(((Attributes::offset + Attributes::size <= stride) && ...),
+                  "attribute lies outside the vertex");
+    static_assert(((Attributes::location < 16) && ...),
+                  "attribute location out of range");
+    static_assert(countBits(locations) == attributeCount,
+                  "attribute locations must be unique");
+
+    /**
+     * @brief 设置当前绑定的VAO与VBO的全部属性
+     *
+     */
+    static void setup() { (Attributes::setup(stride), ...); }
+};
+
+/// @brief 由顶点成员声明属性, 分量类型与数量从成员类型推导
+#define MGL_VERTEX_ATTRIBUTE(location, vertex, member, kind)           \
+    _MGL VertexAttribute<                                               \
+        location,                                                       \
+        typename _MGL member_components<decltype(vertex::member)>::type, \
+        _MGL member_components<decltype(vertex::member)>::count,        \
+        offsetof(vertex, member), _MGL AttributeKind::kind>
+
+/// @brief 带骨骼数据的完整顶点
+using SkinnedLayout =
+    VertexLayout<Vertex, MGL_VERTEX_ATTRIBUTE(0, Vertex, Position, Float),
+                 MGL_VERTEX_ATTRIBUTE(1, Vertex, Normal, Float),
+                 MGL_VERTEX_ATTRIBUTE(2, Vertex, TexCoords, Float),
+                 MGL_VERTEX_ATTRIBUTE(3, Vertex, Tangent, Float),
+                 MGL_VERTEX_ATTRIBUTE(4, Vertex, Bitangent, Float),
+                 MGL_VERTEX_ATTRIBUTE(5, Vertex, m_BoneIDs, Integer),
+                 MGL_VERTEX_ATTRIBUTE(6, Vertex, m_Weights, Float)>;
+
+/// @brief 静态顶点, 省略骨骼属性
+using StaticLayout = VertexLayout<
+    StaticVertex, MGL_VERTEX_ATTRIBUTE(0, StaticVertex, Position, Float),
+    MGL_VERTEX_ATTRIBUTE(1, StaticVertex, Normal, Float),
+    MGL_VERTEX_ATTRIBUTE(2, StaticVertex, TexCoords, Float),
+    MGL_VERTEX_ATTRIBUTE(3, StaticVertex, Tangent, Float),
+    MGL_VERTEX_ATTRIBUTE(4, StaticVertex, Bitangent, Float)>;
+
+/// @brief 只有位置
+using PositionLayout =
+    VertexLayout<PositionVertex,
+                 MGL_VERTEX_ATTRIBUTE(0, PositionVertex, Position, Float)>;
+
+/// @brief 位置与纹理坐标
+using PositionTexLayout = VertexLayout<
+    PositionTexVertex,
+    MGL_VERTEX_ATTRIBUTE(0, PositionTexVertex, Position, Float),
+    MGL_VERTEX_ATTRIBUTE(1, PositionTexVertex, TexCoords, Float)>;
+
+/**
+ * @brief 压缩顶点的公共属性: 位置只取前三个分量,
+ * 副切线方向读取位置的w分量
+ * @tparam V PackedVertex或PackedSkinnedVertex
+ * @tparam Extra 额外的属性
+ */
+template <typename V, typename... Extra>
+using PackedLayoutOf = VertexLayout<
+    V, VertexAttribute<0, uint16_t, 3, offsetof(V, Position),
+                       AttributeKind::Normalized>,
+    MGL_VERTEX_ATTRIBUTE(1, V, Normal, Normalized),
+    MGL_VERTEX_ATTRIBUTE(2, V, TexCoords, Half),
+    MGL_VERTEX_ATTRIBUTE(3, V, Tangent, Normalized),
+    VertexAttribute<4, uint16_t, 1,
+                    offsetof(V, Position) + 3 * sizeof(uint16_t),
+                    AttributeKind::Normalized>,
+    Extra...>;
+
+/// @brief 压缩的静态顶点
+using PackedLayout = PackedLayoutOf<PackedVertex>;
+
+/// @brief 压缩的蒙皮顶点
+using PackedSkinnedLayout = PackedLayoutOf<
+    PackedSkinnedVertex,
+    MGL_VERTEX_ATTRIBUTE(5, PackedSkinnedVertex, BoneIDs, Integer),
+    MGL_VERTEX_ATTRIBUTE(6, PackedSkinnedVertex, Weights, Normalized)>;
+MGL_END
@@ -0,0 +1,74 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "defined.h"
+MGL_START
+/**
+ * @brief 只读的文件内容, 来自资源包或磁盘上的文件.
+ * 未压缩的内容直接指向映射内存, 压缩的内容解压到自有的缓冲区,
+ * 两种情况下数据首地址至少按16字节对齐; 内容存活期间其来源保持映射
+ * @class
+ */
+class FileData {
+  private:
+    // 持有数据的对象: 资源包, 映射的文件或解压缓冲区
+    std::shared_ptr<const void> owner;
+    const unsigned char* _data = nullptr;
+    size_t _size = 0;
+
+  public:
+    FileData() = default;
+    FileData(std::shared_ptr<const void> owner, const unsigned char* data,
+             size_t size)
+        : owner(std::move(owner)), _data(data), _size(size) {}
+
+    inline bool isOpen() const { return owner != nullptr; }
+    inline const unsigned char* data() const { return _data; }
+    inline size_t size() const { return _size; }
+};
+
+/**
+ * @brief 挂载资源包, 之后root下的路径优先从包中读取,
+ * 后挂载的包优先. 应在加载资源之前调用
+ * @param path 资源包路径
+ * @param root 包中路径相对的目录, 为空时使用资源包所在目录
+ * @return true 挂载成功
+ * @return false 资源包不存在或已损坏
+ */
+bool MountPack(const std::string& path, const std::string& root = "");
+/**
+ * @brief 卸载所有资源包, 已读取的FileData仍然有效
+ *
+ */
+void UnmountPacks();
+/**
+ * @brief 读取文件: 属于存活的ReadBatch时返回其读入的内容, 否则先查找
+ * 已挂载的资源包, 不在包中时映射磁盘上的文件, 可在任意线程调用
+ * @param path 文件路径
+ * @return FileData 文件内容, 文件不存在, 为空或已损坏时isOpen()为false
+ */
+FileData ReadFile(const std::string& path);
+/**
+ * @brief 判断文件是否位于已挂载的资源包中
+ *
+ * @param path 文件路径
+ */
+bool InPack(const std::string& path);
+/**
+ * @brief 判断文件是否存在于资源包或磁盘上
+ *
+ * @param path 文件路径
+ */
+bool FileExists(const std::string& path);
+/**
+ * @brief 获取文件内容的HashBytes哈希, 包中的文件直接使用构建时记录的值
+ *
+ * @param path 文件路径
+ * @param hash 输出哈希值
+ * @return true 计算成功
+ * @return false 文件无法读取
+ */
+bool FileHash(const std::string& path, uint64_t& hash);
+MGL_END
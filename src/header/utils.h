@@ -66,8 +66,8 @@ GLFWwindow* init();
  */
 void processInput(GLFWwindow* window);
 /**
- * @brief 读取纹理图片
- *
+ * @brief 读取纹理图片并上传到当前绑定的2D纹理,
+ * 有烘焙产物时直接使用其中的mip链
  * @param path 纹理图片路径
  */
 void readImage(const char* path);
@@ -87,7 +87,8 @@ unsigned int loadTexture(const char* path);
  */
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 /**
- * @brief 加载天空盒
+ * @brief 加载天空盒, 六个面并行解码并生成修正了接缝的mip链,
+ * 结果缓存在第一个面旁边的.mglcube文件中
  * 顺序:
  * +X (right)
  * -X (left)
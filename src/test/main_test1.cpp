@@ -1,7 +1,9 @@
 #include "header/tool.h"
 #include "header/utils.h"
 #include "header/Shader.h"
+#include "header/Ibl.h"
 #include "header/Model.h"
+#include "header/VertexLayout.h"
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
 #pragma comment(lib, "glfw3.lib")
 #pragma comment(lib, "assimp-vc143-mtd.lib")
@@ -28,8 +30,9 @@ int main() {
         {"./resource/shader/model_loading.vert",
          "./resource/shader/model_loading.frag"});
     ourShader.Compile();
-    Model ourModel(
-        "./resource/model/nanosuit/nanosuit.obj");
+    // 先显示最粗的一层, 之后在渲染循环中逐帧细化
+    Model ourModel("./resource/model/nanosuit/nanosuit.obj", false,
+                   mgl::LoadMode::Progressive);
     // cube VAO
     unsigned int cubeVAO, cubeVBO;
     glGenVertexArrays(1, &cubeVAO);
@@ -38,12 +41,9 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices,
                  GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-                          (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-                          (void*)(3 * sizeof(float)));
+    static_assert(mgl::PositionTexLayout::stride == 5 * sizeof(float),
+                  "cube vertices are position + texcoords");
+    mgl::PositionTexLayout::setup();
     // skybox VAO
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
@@ -52,9 +52,9 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices,
                  GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float),
-                          (void*)0);
+    static_assert(mgl::PositionLayout::stride == 3 * sizeof(float),
+                  "skybox vertices are positions only");
+    mgl::PositionLayout::setup();
 
     // load textures
     // -------------
@@ -69,22 +69,31 @@ int main() {
         "./resource/texture/skybox/front.jpg",
         "./resource/texture/skybox/back.jpg"};
     unsigned int cubemapTexture = loadCubemap(faces);
+    // 由同一组面预计算的环境光照, 结果缓存在第一个面旁边
+    mgl::EnvironmentLighting environment = mgl::LoadEnvironmentLighting(faces);
 
     // shader configuration
     // --------------------
     shader.use();
     shader.setUniform("skybox", 0);
     shader.setUniform("c", 1.0f);
+    shader.setUniform("useEnvironmentLighting", environment.specular != 0);
+    shader.setUniformV("albedo", glm::vec3(1.0f));
+    shader.setUniform("metallic", 1.0f);
+    shader.setUniform("roughness", 0.3f);
 
     skyboxShader.use();
     skyboxShader.setUniform("skybox", 0);
 
+    // 模型每个网格当前使用的LOD
+    mgl::LodState lodState;
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         processInput(window);
+        ourModel.update();
         /*
         const float value[] = {0.1f, 0.1f, 0.1f, 1.0f};
         glClearBufferfv(GL_COLOR, 0, value);
@@ -103,6 +112,7 @@ int main() {
         shader.setUniformM("view", view);
         shader.setUniformM("projection", projection);
         shader.setUniformM("cameraPos", camera.position());
+        environment.bind(shader, 1);
         // cubes
         glBindVertexArray(cubeVAO);
         glActiveTexture(GL_TEXTURE0);
@@ -127,7 +137,9 @@ int main() {
             glm::vec3(
                 1.0f));  // it's a bit too big for our scene, so scale it down
         ourShader.setUniformM("model", model);
-        ourModel.Draw(ourShader);
+        ourModel.Draw(ourShader, model,
+                      mgl::MakeLodView(camera, static_cast<float>(height)),
+                      lodState);
 
         // draw skybox as last
         glDepthFunc(
@@ -1,4 +1,9 @@
-#include "header/utils.h"
+﻿#include "header/utils.h"
+#include <fstream>
+#include "header/Config.h"
+#include "header/Cubemap.h"
+#include "header/Image.h"
+#include "header/VirtualFileSystem.h"
 const int width = 800;
 const int height = 600;
 float lastX = width / 2.0f, lastY = height / 2.0f;
@@ -31,22 +36,9 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 }
 
 void readImage(const char* path) {
-    int width, height, nrChannels;
     // stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format;
-        if (nrChannels == 1)
-            format = GL_RED;
-        else if (nrChannels == 3)
-            format = GL_RGB;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                     GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    stbi_image_free(data);
+    _MGL Image image = _MGL LoadTextureImage(path);
+    if (image.valid()) _MGL UploadTextureLevels(image);
 }
 
 unsigned int loadTexture(const char* path) {
@@ -57,7 +49,8 @@ unsigned int loadTexture(const char* path) {
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     readImage(path);
     return texture;
@@ -89,6 +82,10 @@ GLFWwindow* init() {
 
     glEnable(GL_DEPTH_TEST);
 
+    // 资源包存在时只需映射这一个文件
+    const std::string& pack = _MGL loadConfig().resourcePack;
+    if (!pack.empty() && std::ifstream(pack)) _MGL MountPack(pack);
+
     return window;
 }
 
@@ -110,30 +107,6 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 }
 
 unsigned int loadCubemap(std::vector<std::string> faces) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char* data =
-            stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width,
-                         height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        } else {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i]
-                      << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return _MGL LoadCubemap(faces);
 }
 
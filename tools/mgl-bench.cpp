@@ -0,0 +1,312 @@
+﻿#include "header/Config.h"
+#include "header/MeshProcess.h"
+#include "header/Model.h"
+#include "header/ObjLoader.h"
+#include "header/ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+#pragma comment(lib, "assimp-vc143-mtd.lib")
+#endif
+
+// 用法: mgl-bench [OBJ模型] [重复次数]
+// 1. 分别用内置解析器(LoadObj)与Assimp路径导入同一个OBJ模型并输出耗时.
+//    两者都不做网格优化也不生成LOD, 只比较解析与转换.
+// 2. 对Assimp场景中的网格比较逐顶点push_back的旧转换循环与按属性交错的
+//    InterleaveVertices(单线程与并行), 逐字节确认结果一致.
+// 3. 比较GenerateTangents与Assimp的aiProcess_CalcTangentSpace,
+//    输出切线空间的角度偏差, 超过1度的顶点视为不一致.
+// 默认模型为 resource/model/nanosuit/nanosuit.obj, 默认重复10次.
+// 转换或切线结果不一致时返回非零值
+namespace {
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// 网格数据的规模, 用于确认两条路径导入了同样的内容
+struct Totals {
+    size_t meshes = 0;
+    size_t vertices = 0;
+    size_t triangles = 0;
+};
+
+Totals totalsOf(const std::vector<mgl::MeshData>& data) {
+    Totals totals;
+    totals.meshes = data.size();
+    for (auto& d : data) {
+        totals.vertices += d.vertices.size();
+        totals.triangles += d.indices.size() / 3;
+    }
+    return totals;
+}
+
+// 重复导入并输出最短与平均耗时, 第一次只用于预热
+template <typename Import>
+bool run(const char* name, int repeats, Import import) {
+    std::vector<mgl::MeshData> data;
+    if (!import(data)) {
+        std::printf("BENCH::%s::FAILED\n", name);
+        return false;
+    }
+    double best = 0.0, total = 0.0;
+    for (int i = 0; i < repeats; ++i) {
+        data.clear();
+        auto start = std::chrono::steady_clock::now();
+        import(data);
+        double ms = elapsedMs(start);
+        best = i == 0 ? ms : std::min(best, ms);
+        total += ms;
+    }
+    Totals totals = totalsOf(data);
+    std::printf(
+        "BENCH::IMPORT %-7s best: %8.2f ms, mean: %8.2f ms "
+        "(meshes: %zu, vertices: %zu, triangles: %zu)\n",
+        name, best, total / repeats, totals.meshes, totals.vertices,
+        totals.triangles);
+    return true;
+}
+
+// 旧的逐顶点转换循环, 作为InterleaveVertices的参照.
+// 顶点先值初始化, 使未写入的字段与填充字节可以逐字节比较
+void convertPerVertex(const aiMesh* mesh, std::vector<mgl::Vertex>& vertices,
+                      std::vector<unsigned int>& indices) {
+    for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+        mgl::Vertex vertex = mgl::Vertex();
+        vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y,
+                                    mesh->mVertices[i].z);
+        if (mesh->HasNormals()) {
+            vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y,
+                                      mesh->mNormals[i].z);
+        }
+        if (mesh->mTextureCoords[0]) {
+            vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x,
+                                         mesh->mTextureCoords[0][i].y);
+            if (mesh->mTangents) {
+                vertex.Tangent =
+                    glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y,
+                              mesh->mTangents[i].z);
+            }
+            if (mesh->mBitangents) {
+                vertex.Bitangent =
+                    glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y,
+                              mesh->mBitangents[i].z);
+            }
+        } else {
+            vertex.TexCoords = glm::vec2(0.0f);
+        }
+        vertices.push_back(vertex);
+    }
+    for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+        const aiFace& face = mesh->mFaces[i];
+        for (unsigned int j = 0; j < face.mNumIndices; ++j) {
+            indices.push_back(face.mIndices[j]);
+        }
+    }
+}
+
+// 与Model::processMesh相同的转换: 属性交错写入一次分配好的数组,
+// 索引按面整块复制. parallel为true时顶点分块在workerPool上并行
+void convertInterleaved(const aiMesh* mesh, bool parallel,
+                        std::vector<mgl::Vertex>& vertices,
+                        std::vector<unsigned int>& indices) {
+    mgl::VertexStreams streams;
+    streams.positions = &mesh->mVertices[0].x;
+    if (mesh->HasNormals()) streams.normals = &mesh->mNormals[0].x;
+    if (mesh->mTextureCoords[0]) {
+        streams.texCoords = &mesh->mTextureCoords[0][0].x;
+        streams.texCoordStride = 3;
+        if (mesh->mTangents) streams.tangents = &mesh->mTangents[0].x;
+        if (mesh->mBitangents) streams.bitangents = &mesh->mBitangents[0].x;
+    }
+    vertices.resize(mesh->mNumVertices);
+    mgl::Vertex* out = vertices.data();
+    if (parallel) {
+        mgl::ParallelFor(vertices.size(), 16 * 1024,
+                         [&](size_t first, size_t last) {
+                             mgl::InterleaveVertices(streams, first,
+                                                     last - first, out + first);
+                         });
+    } else {
+        mgl::InterleaveVertices(streams, 0, vertices.size(), out);
+    }
+    size_t indexCount = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+        indexCount += mesh->mFaces[i].mNumIndices;
+    }
+    indices.resize(indexCount);
+    unsigned int* index = indices.data();
+    for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+        const aiFace& face = mesh->mFaces[i];
+        std::memcpy(index, face.mIndices, face.mNumIndices * sizeof(*index));
+        index += face.mNumIndices;
+    }
+}
+
+// 一次转换整个场景的结果
+struct Converted {
+    std::vector<std::vector<mgl::Vertex>> vertices;
+    std::vector<std::vector<unsigned int>> indices;
+};
+
+template <typename Convert>
+double timeConversion(const aiScene* scene, int repeats, Converted& result,
+                      Convert convert) {
+    double best = 0.0;
+    for (int i = 0; i <= repeats; ++i) {
+        result.vertices.assign(scene->mNumMeshes, {});
+        result.indices.assign(scene->mNumMeshes, {});
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int m = 0; m < scene->mNumMeshes; ++m) {
+            convert(scene->mMeshes[m], result.vertices[m], result.indices[m]);
+        }
+        double ms = elapsedMs(start);
+        // 第0次为预热
+        if (i == 1 || (i > 1 && ms < best)) best = ms;
+    }
+    return best;
+}
+
+bool sameBytes(const Converted& a, const Converted& b) {
+    if (a.vertices.size() != b.vertices.size()) return false;
+    for (size_t m = 0; m < a.vertices.size(); ++m) {
+        auto& va = a.vertices[m];
+        auto& vb = b.vertices[m];
+        auto& ia = a.indices[m];
+        auto& ib = b.indices[m];
+        if (va.size() != vb.size() || ia.size() != ib.size()) return false;
+        if (!va.empty() &&
+            std::memcmp(va.data(), vb.data(), va.size() * sizeof(va[0])) != 0) {
+            return false;
+        }
+        if (!ia.empty() &&
+            std::memcmp(ia.data(), ib.data(), ia.size() * sizeof(ia[0])) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 切线与副切线中偏差较大者的角度
+double tangentDeviation(const mgl::Vertex& vertex, const aiVector3D& tangent,
+                        const aiVector3D& bitangent) {
+    float t = glm::dot(vertex.Tangent,
+                       glm::vec3(tangent.x, tangent.y, tangent.z));
+    float b = glm::dot(vertex.Bitangent,
+                       glm::vec3(bitangent.x, bitangent.y, bitangent.z));
+    float c = std::max(-1.0f, std::min(1.0f, std::min(t, b)));
+    return std::acos(c) * 180.0 / 3.14159265358979;
+}
+
+inline bool unitVector(const aiVector3D& v) {
+    float len = v.x * v.x + v.y * v.y + v.z * v.z;
+    return len > 0.25f && len < 4.0f;
+}
+
+// 对每个三角形的角比较GenerateTangents与Assimp的结果, 跳过Assimp在退化处
+// 输出的NaN或零向量. 所有角的偏差都不超过1度时返回true
+bool checkTangents(const aiScene* scene) {
+    size_t corners = 0, over1 = 0, over18 = 0, skipped = 0;
+    double worst = 0.0;
+    for (unsigned int m = 0; m < scene->mNumMeshes; ++m) {
+        const aiMesh* mesh = scene->mMeshes[m];
+        if (!mesh->HasNormals() || !mesh->mTextureCoords[0] ||
+            !mesh->mTangents || !mesh->mBitangents) {
+            continue;
+        }
+        mgl::MeshData data;
+        convertInterleaved(mesh, false, data.vertices, data.indices);
+        if (data.indices.size() != size_t(mesh->mNumFaces) * 3) continue;
+        mgl::GenerateTangents(data);
+        for (size_t c = 0; c < data.indices.size(); ++c) {
+            unsigned int source = mesh->mFaces[c / 3].mIndices[c % 3];
+            const aiVector3D& tangent = mesh->mTangents[source];
+            const aiVector3D& bitangent = mesh->mBitangents[source];
+            if (!unitVector(tangent) || !unitVector(bitangent)) {
+                ++skipped;
+                continue;
+            }
+            double deviation = tangentDeviation(data.vertices[data.indices[c]],
+                                                tangent, bitangent);
+            ++corners;
+            worst = std::max(worst, deviation);
+            if (deviation > 1.0) ++over1;
+            if (deviation > 18.0) ++over18;
+        }
+    }
+    std::printf(
+        "BENCH::TANGENTS corners: %zu, > 1 deg: %zu, > 18 deg: %zu, "
+        "max: %.3f deg, skipped: %zu\n",
+        corners, over1, over18, worst, skipped);
+    std::printf("BENCH::TANGENTS %s\n",
+                over1 == 0 ? "within 1 deg of Assimp" : "MISMATCH");
+    return over1 == 0;
+}
+
+// 比较Assimp网格到引擎顶点的两种转换与切线空间, 结果一致时返回true
+bool benchConversion(const std::string& path, int repeats) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(
+        path, mgl::Model::ImportFlags | aiProcess_CalcTangentSpace);
+    if (!scene || !scene->mRootNode) {
+        std::printf("BENCH::CONVERT::ASSIMP %s\n", importer.GetErrorString());
+        return false;
+    }
+    Converted reference, single, parallel;
+    double loopMs = timeConversion(
+        scene, repeats, reference,
+        [](const aiMesh* mesh, std::vector<mgl::Vertex>& vertices,
+           std::vector<unsigned int>& indices) {
+            convertPerVertex(mesh, vertices, indices);
+        });
+    double singleMs = timeConversion(
+        scene, repeats, single,
+        [](const aiMesh* mesh, std::vector<mgl::Vertex>& vertices,
+           std::vector<unsigned int>& indices) {
+            convertInterleaved(mesh, false, vertices, indices);
+        });
+    double parallelMs = timeConversion(
+        scene, repeats, parallel,
+        [](const aiMesh* mesh, std::vector<mgl::Vertex>& vertices,
+           std::vector<unsigned int>& indices) {
+            convertInterleaved(mesh, true, vertices, indices);
+        });
+    bool same = sameBytes(reference, single) && sameBytes(reference, parallel);
+    std::printf("BENCH::CONVERT per-vertex loop:      %8.3f ms\n", loopMs);
+    std::printf("BENCH::CONVERT interleaved:          %8.3f ms\n", singleMs);
+    std::printf("BENCH::CONVERT interleaved parallel: %8.3f ms\n", parallelMs);
+    std::printf("BENCH::CONVERT output %s\n", same ? "identical" : "MISMATCH");
+    bool tangents = checkTangents(scene);
+    return same && tangents;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string path =
+        argc > 1 ? argv[1] : "resource/model/nanosuit/nanosuit.obj";
+    int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+    mgl::LoadConfig& config = mgl::loadConfig();
+    config.optimizeMeshes = false;
+    config.lodLevels = 0;
+    std::printf("BENCH %s (%d runs, %u worker threads)\n", path.c_str(),
+                repeats, mgl::workerPool().size());
+
+    bool ok = run("native", repeats, [&](std::vector<mgl::MeshData>& data) {
+        return mgl::LoadObj(path, data);
+    });
+    config.nativeObjLoader = false;
+    ok = run("assimp", repeats,
+             [&](std::vector<mgl::MeshData>& data) {
+                 return mgl::Model::Import(path, data);
+             }) &&
+         ok;
+    ok = benchConversion(path, repeats) && ok;
+    return ok ? 0 : 1;
+}
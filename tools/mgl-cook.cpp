@@ -0,0 +1,29 @@
+﻿#include "header/Cook.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+#pragma comment(lib, "assimp-vc143-mtd.lib")
+#endif
+
+// 用法: mgl-cook [资源目录]
+// 把资源目录下的模型, 纹理与着色器烘焙到 <资源目录>/.cooked,
+// 只处理内容或烘焙设置改变的文件, 默认目录为 ./resource
+int main(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./resource";
+    while (root.size() > 1 && (root.back() == '/' || root.back() == '\\')) {
+        root.pop_back();
+    }
+    auto start = std::chrono::steady_clock::now();
+    mgl::CookStats stats;
+    bool ok = mgl::CookDirectory(root, &stats);
+    std::printf(
+        "COOK %s (cooked: %zu, up to date: %zu, failed: %zu, removed: %zu, "
+        "%.1f ms)\n",
+        root.c_str(), stats.cooked, stats.upToDate, stats.failed,
+        stats.removed,
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    return ok ? 0 : 1;
+}
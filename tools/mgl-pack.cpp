@@ -0,0 +1,39 @@
+﻿#include "header/ResourcePack.h"
+#include <cstdio>
+#include <string>
+
+// 用法: mgl-pack <资源目录> <输出文件> [包内前缀]
+// 前缀默认为资源目录名, 例如 mgl-pack ./resource ./resource.mglpack
+// 生成的包中路径为 resource/shader/..., 挂载到包所在目录后
+// ./resource/... 的读取都会命中资源包
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::printf("usage: %s <directory> <output> [prefix]\n", argv[0]);
+        return 1;
+    }
+    std::string directory = argv[1];
+    while (directory.size() > 1 &&
+           (directory.back() == '/' || directory.back() == '\\')) {
+        directory.pop_back();
+    }
+    std::string prefix;
+    if (argc > 3) {
+        prefix = argv[3];
+    } else {
+        size_t slash = directory.find_last_of("/\\");
+        prefix = slash == std::string::npos ? directory
+                                            : directory.substr(slash + 1);
+        if (prefix == "." || prefix == "..") prefix.clear();
+    }
+
+    mgl::PackBuildStats stats;
+    if (!mgl::BuildResourcePack(directory, prefix, argv[2], &stats)) {
+        std::printf("ERROR::PACK::BUILD_FAILED %s\n", argv[2]);
+        return 1;
+    }
+    std::printf("PACK %s (files: %zu, compressed: %zu, %llu KB -> %llu KB)\n",
+                argv[2], stats.files, stats.compressed,
+                (unsigned long long)stats.rawBytes / 1024,
+                (unsigned long long)stats.packedBytes / 1024);
+    return 0;
+}
@@ -0,0 +1,781 @@
+﻿#include "header/Cook.h"
+#include "header/FileSystem.h"
+#include "header/GltfLoader.h"
+#include "header/Json.h"
+#include "header/Lz4.h"
+#include "header/MaterialPacker.h"
+#include "header/MeshOptimize.h"
+#include "header/ResourcePack.h"
+#include "header/TextureCompress.h"
+#include "header/VertexFormat.h"
+#include "header/VirtualFileSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// 用法: mgl-test
+// 不依赖OpenGL与模型资源的自检: LZ4压缩与解压的往返, 资源包的打包,
+// 挂载与读取, LZ4/资源包/JSON/glTF对截断或损坏输入的处理,
+// 网格的顶点合并, 缓存优化与16位索引切分, 顶点压缩的半精度与
+// 八面体编码, 高光合并到漫反射alpha, 以及着色器源码的烘焙.
+// 临时文件写在当前目录的 mgl-test.tmp 下, 结束时删除.
+// 有检查失败时返回非零值
+namespace {
+int failures = 0;
+int checks = 0;
+
+#define CHECK(expr)                                                    \
+    do {                                                               \
+        ++checks;                                                      \
+        if (!(expr)) {                                                 \
+            ++failures;                                                \
+            std::printf("TEST::FAILED %s:%d %s\n", __FILE__, __LINE__, \
+                        #expr);                                        \
+        }                                                              \
+    } while (0)
+
+typedef std::vector<unsigned char> Bytes;
+
+const std::string TEMP_DIRECTORY = "mgl-test.tmp";
+
+Bytes randomBytes(size_t size, uint32_t seed) {
+    std::mt19937 random(seed);
+    Bytes data(size);
+    for (auto& byte : data) byte = static_cast<unsigned char>(random());
+    return data;
+}
+
+// 以period为周期重复的数据, 匹配距离小于匹配长度, 解压时与输出重叠
+Bytes periodicBytes(size_t size, size_t period) {
+    Bytes data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<unsigned char>('a' + i % period);
+    }
+    return data;
+}
+
+Bytes textBytes(const std::string& text) {
+    return Bytes(text.begin(), text.end());
+}
+
+bool writeBytes(const std::string& path, const Bytes& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return bool(out);
+}
+
+Bytes readBytes(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return Bytes((std::istreambuf_iterator<char>(in)),
+                 std::istreambuf_iterator<char>());
+}
+
+Bytes compress(const Bytes& raw) {
+    Bytes packed(mgl::Lz4CompressBound(raw.size()));
+    size_t n = mgl::Lz4Compress(raw.data(), raw.size(), packed.data(),
+                                packed.size());
+    packed.resize(n);
+    return packed;
+}
+
+bool decompress(const Bytes& packed, size_t rawSize, Bytes& out) {
+    out.assign(rawSize, 0);
+    return mgl::Lz4Decompress(packed.data(), packed.size(), out.data(),
+                              rawSize);
+}
+
+// 压缩后解压应得到原数据, 声明的原始长度不符时解压失败
+void roundTrip(const Bytes& raw) {
+    Bytes packed = compress(raw);
+    CHECK(!packed.empty());
+    CHECK(packed.size() <= mgl::Lz4CompressBound(raw.size()));
+    Bytes out;
+    CHECK(decompress(packed, raw.size(), out) && out == raw);
+    if (!raw.empty()) CHECK(!decompress(packed, raw.size() - 1, out));
+    CHECK(!decompress(packed, raw.size() + 1, out));
+    // 输出缓冲区不足时压缩失败而不是越界
+    if (packed.size() > 1) {
+        Bytes small(packed.size() - 1);
+        CHECK(mgl::Lz4Compress(raw.data(), raw.size(), small.data(),
+                               small.size()) == 0);
+    }
+}
+
+void testLz4RoundTrip() {
+    roundTrip(Bytes());
+    // 不超过MF_LIMIT(12)字节的输入只输出字面量
+    for (size_t size = 1; size <= 16; ++size) {
+        roundTrip(randomBytes(size, static_cast<uint32_t>(size)));
+        roundTrip(Bytes(size, 'x'));
+    }
+    // 距离为1到7的重叠匹配, 以及超过15 + 255的长匹配
+    for (size_t period = 1; period <= 7; ++period) {
+        roundTrip(periodicBytes(5000, period));
+        roundTrip(periodicBytes(13 + period, period));
+    }
+    // 超过15 + 255的长字面量
+    roundTrip(randomBytes(1000, 1));
+    roundTrip(randomBytes(300000, 2));
+    // 相同内容相隔超过最大匹配距离(65535)
+    Bytes block = randomBytes(4096, 3);
+    Bytes far = block;
+    Bytes gap = randomBytes(70000, 4);
+    far.insert(far.end(), gap.begin(), gap.end());
+    far.insert(far.end(), block.begin(), block.end());
+    roundTrip(far);
+    // 字面量与匹配交替
+    std::string text;
+    for (int i = 0; i < 2000; ++i) {
+        text += "vertex " + std::to_string(i % 97) + " normal " +
+                std::to_string(i * 31 % 13) + "\n";
+    }
+    Bytes raw = textBytes(text);
+    Bytes packed = compress(raw);
+    CHECK(packed.size() < raw.size() / 2);
+    roundTrip(raw);
+}
+
+void testLz4Corrupt() {
+    std::string text;
+    for (int i = 0; i < 200; ++i) text += "v 1.0 2.0 " + std::to_string(i);
+    Bytes raw = textBytes(text);
+    Bytes packed = compress(raw);
+    Bytes out;
+    // 任何截断都丢失了数据
+    for (size_t size = 0; size < packed.size(); ++size) {
+        Bytes truncated(packed.begin(), packed.begin() + size);
+        CHECK(!decompress(truncated, raw.size(), out));
+    }
+    // 逐字节损坏: 结果可以错误, 但不能越界读写(配合AddressSanitizer)
+    for (size_t i = 0; i < packed.size(); ++i) {
+        Bytes broken = packed;
+        broken[i] ^= 0xA5;
+        decompress(broken, raw.size(), out);
+        broken[i] = 0xFF;
+        decompress(broken, raw.size(), out);
+    }
+    // 匹配距离为0或指向输出开始之前
+    const unsigned char zeroDistance[] = {0x10, 'a', 0x00, 0x00, 0x00};
+    CHECK(!mgl::Lz4Decompress(zeroDistance, sizeof(zeroDistance), out.data(),
+                              5));
+    const unsigned char beforeStart[] = {0x10, 'a', 0x02, 0x00, 0x00};
+    CHECK(!mgl::Lz4Decompress(beforeStart, sizeof(beforeStart), out.data(),
+                              5));
+    // 长度的扩展部分被截断
+    const unsigned char openLength[] = {0xF0, 0xFF, 0xFF};
+    CHECK(!mgl::Lz4Decompress(openLength, sizeof(openLength), out.data(),
+                              out.size()));
+    // 输出缓冲区放不下匹配
+    const unsigned char overflow[] = {0x1F, 'a', 0x01, 0x00, 0xFF, 0x10};
+    CHECK(!mgl::Lz4Decompress(overflow, sizeof(overflow), out.data(), 100));
+}
+
+void testResourcePack() {
+    const std::string data = TEMP_DIRECTORY + "/data";
+    const std::string packPath = TEMP_DIRECTORY + "/test.mglpack";
+    CHECK(mgl::MakeDirectory(data) && mgl::MakeDirectory(data + "/sub"));
+
+    std::string text;
+    for (int i = 0; i < 500; ++i) text += "line " + std::to_string(i) + "\n";
+    struct {
+        const char* name;
+        Bytes content;
+    } files[] = {
+        {"a.txt", textBytes(text)},
+        {"sub/b.bin", randomBytes(10000, 5)},
+        {"sub/c.mglcache", periodicBytes(4096, 3)},
+        {"tiny.txt", textBytes("hi")},
+    };
+    for (auto& file : files) {
+        CHECK(writeBytes(data + '/' + file.name, file.content));
+    }
+
+    mgl::PackBuildStats stats;
+    CHECK(mgl::BuildResourcePack(data, "data", packPath, &stats));
+    CHECK(stats.files == 4);
+    // 只有文本可压缩: 随机数据压缩无收益, .mglcache需要原样映射
+    CHECK(stats.compressed == 1);
+    {
+        mgl::ResourcePack pack;
+        CHECK(pack.open(packPath));
+        CHECK(pack.getEntries().size() == 4);
+        CHECK(pack.find("data/missing.txt") == nullptr);
+        for (auto& file : files) {
+            const mgl::PackEntry* entry =
+                pack.find(std::string("data/") + file.name);
+            CHECK(entry != nullptr);
+            if (!entry) continue;
+            CHECK(entry->offset % mgl::ResourcePack::Alignment == 0);
+            Bytes content;
+            CHECK(pack.read(*entry, content) && content == file.content);
+        }
+        const mgl::PackEntry* cache = pack.find("data/sub/c.mglcache");
+        CHECK(cache && cache->compression == mgl::ResourcePack::Stored &&
+              pack.view(*cache) != nullptr);
+        const mgl::PackEntry* compressed = pack.find("data/a.txt");
+        CHECK(compressed &&
+              compressed->compression == mgl::ResourcePack::Lz4 &&
+              compressed->size < compressed->rawSize);
+    }
+
+    // 删除原文件后仍能经由挂载的包读取
+    for (auto& file : files) std::remove((data + '/' + file.name).c_str());
+    CHECK(mgl::MountPack(packPath));
+    for (auto& file : files) {
+        std::string path = data + '/' + file.name;
+        CHECK(mgl::InPack(path));
+        mgl::FileData content = mgl::ReadFile(path);
+        CHECK(content.isOpen() && content.size() == file.content.size() &&
+              std::memcmp(content.data(), file.content.data(),
+                          content.size()) == 0);
+    }
+    CHECK(!mgl::InPack(data + "/missing.txt"));
+    CHECK(!mgl::ReadFile(data + "/missing.txt").isOpen());
+    mgl::UnmountPacks();
+    CHECK(!mgl::InPack(data + "/a.txt"));
+
+    // 截断的包无法打开
+    Bytes bytes = readBytes(packPath);
+    const std::string brokenPath = TEMP_DIRECTORY + "/broken.mglpack";
+    for (size_t size = 0; size < bytes.size(); size += 7) {
+        CHECK(writeBytes(brokenPath,
+                         Bytes(bytes.begin(), bytes.begin() + size)));
+        mgl::ResourcePack pack;
+        CHECK(!pack.open(brokenPath));
+    }
+}
+
+void testJson() {
+    const char* document =
+        "\xEF\xBB\xBF{\"asset\": {\"version\": \"2.0\"},\n"
+        " \"numbers\": [0, -1.5, 2e3, 1E-2],\n"
+        " \"flags\": [true, false, null],\n"
+        " \"text\": \"a\\\"b\\\\c\\/\\n\\u00e9\\ud83d\\ude00\",\n"
+        " \"empty\": {}, \"list\": []}";
+    mgl::JsonValue json;
+    std::string error;
+    CHECK(mgl::ParseJson(document, std::strlen(document), json, &error));
+    CHECK(json.isObject() && json.has("asset") && !json.has("missing"));
+    CHECK(json["asset"]["version"].asString() == "2.0");
+    CHECK(json["numbers"].size() == 4);
+    CHECK(json["numbers"][1].asNumber() == -1.5);
+    CHECK(json["numbers"][2].asNumber() == 2000.0);
+    CHECK(json["numbers"][3].asNumber() == 0.01);
+    CHECK(json["flags"][size_t(0)].asBool() && !json["flags"][1].asBool(true));
+    CHECK(json["flags"][2].isNull());
+    CHECK(json["text"].asString() ==
+          "a\"b\\c/\n\xC3\xA9\xF0\x9F\x98\x80");
+    CHECK(json["empty"].isObject() && json["list"].isArray());
+    // 越界访问返回空值
+    CHECK(json["numbers"][10].isNull() && json["missing"]["x"].isNull());
+
+    // 输入未必以'\0'结尾: 只解析前size个字节
+    const char* prefix = "[1,2]garbage";
+    CHECK(mgl::ParseJson(prefix, 5, json) && json.size() == 2);
+
+    // 截断的文档都应解析失败
+    size_t length = std::strlen(document);
+    for (size_t size = 0; size + 1 < length; ++size) {
+        std::string truncated(document, size);
+        CHECK(!mgl::ParseJson(truncated.data(), truncated.size(), json));
+    }
+
+    const char* broken[] = {
+        "",
+        "{",
+        "[1,]",
+        "{\"a\" 1}",
+        "{\"a\": 1,}",
+        "{1: 2}",
+        "[1 2]",
+        "\"unterminated",
+        "\"bad escape \\q\"",
+        "\"\\u12\"",
+        "\"\\u 12a\"",
+        "\"\\uD800\\u0041\"",
+        "tru",
+        "nul",
+        "-",
+        "inf",
+        "[1] x",
+        "1e",
+    };
+    for (const char* text : broken) {
+        error.clear();
+        CHECK(!mgl::ParseJson(text, std::strlen(text), json, &error));
+        CHECK(!error.empty());
+    }
+
+    // 超过最大嵌套深度时失败而不是耗尽栈空间
+    std::string deep(100000, '[');
+    CHECK(!mgl::ParseJson(deep.data(), deep.size(), json));
+    std::string nested = std::string(200, '[') + std::string(200, ']');
+    CHECK(mgl::ParseJson(nested.data(), nested.size(), json));
+}
+
+std::string base64(const Bytes& data) {
+    static const char table[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < data.size()) n |= uint32_t(data[i + 1]) << 8;
+        if (i + 2 < data.size()) n |= data[i + 2];
+        out += table[n >> 18 & 63];
+        out += table[n >> 12 & 63];
+        out += i + 1 < data.size() ? table[n >> 6 & 63] : '=';
+        out += i + 2 < data.size() ? table[n & 63] : '=';
+    }
+    return out;
+}
+
+void appendU32(Bytes& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+// 一个三角形的glTF文档: 位置与16位索引, 法线由导入时生成
+std::string triangleJson(const std::string& uri, size_t indexCount) {
+    std::string buffer = "{\"byteLength\": 44";
+    if (!uri.empty()) buffer += ", \"uri\": \"" + uri + "\"";
+    return "{\"asset\": {\"version\": \"2.0\"},"
+           " \"scene\": 0, \"scenes\": [{\"nodes\": [0]}],"
+           " \"nodes\": [{\"mesh\": 0}],"
+           " \"meshes\": [{\"primitives\": [{\"attributes\":"
+           " {\"POSITION\": 0}, \"indices\": 1}]}],"
+           " \"buffers\": [" + buffer + "}],"
+           " \"bufferViews\": [{\"buffer\": 0, \"byteLength\": 36},"
+           " {\"buffer\": 0, \"byteOffset\": 36, \"byteLength\": 6}],"
+           " \"accessors\": [{\"bufferView\": 0, \"componentType\": 5126,"
+           " \"count\": 3, \"type\": \"VEC3\","
+           " \"min\": [0, 0, 0], \"max\": [1, 1, 0]},"
+           " {\"bufferView\": 1, \"componentType\": 5123, \"count\": " +
+           std::to_string(indexCount) + ", \"type\": \"SCALAR\"}]}";
+}
+
+Bytes triangleBuffer() {
+    const float positions[] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+    const uint16_t indices[] = {0, 1, 2, 0};
+    Bytes data(44);
+    std::memcpy(data.data(), positions, sizeof(positions));
+    std::memcpy(data.data() + 36, indices, sizeof(indices));
+    return data;
+}
+
+void checkTriangle(const std::vector<mgl::MeshData>& meshes) {
+    CHECK(meshes.size() == 1);
+    if (meshes.size() != 1) return;
+    const mgl::MeshData& mesh = meshes[0];
+    CHECK(mesh.vertices.size() == 3 && mesh.indices.size() == 3);
+    if (mesh.vertices.size() != 3 || mesh.indices.size() != 3) return;
+    CHECK(mesh.vertices[1].Position == glm::vec3(1, 0, 0));
+    CHECK(mesh.vertices[2].Position == glm::vec3(0, 1, 0));
+    CHECK(mesh.indices[0] == 0 && mesh.indices[1] == 1 &&
+          mesh.indices[2] == 2);
+    CHECK(mesh.vertices[0].Normal == glm::vec3(0, 0, 1));
+}
+
+void testGltf() {
+    const std::string& dir = TEMP_DIRECTORY;
+    Bytes buffer = triangleBuffer();
+    CHECK(writeBytes(dir + "/triangle.bin", buffer));
+
+    // 外部缓冲区, 路径记入依赖
+    std::string json = triangleJson("triangle.bin", 3);
+    CHECK(writeBytes(dir + "/triangle.gltf", textBytes(json)));
+    std::vector<mgl::MeshData> meshes;
+    std::vector<std::string> dependencies;
+    CHECK(mgl::LoadGltf(dir + "/triangle.gltf", meshes, &dependencies));
+    checkTriangle(meshes);
+    CHECK(dependencies.size() == 1 &&
+          dependencies[0] == dir + "/triangle.bin");
+
+    // data: URI内嵌的缓冲区
+    json = triangleJson(
+        "data:application/octet-stream;base64," + base64(buffer), 3);
+    CHECK(writeBytes(dir + "/embedded.gltf", textBytes(json)));
+    meshes.clear();
+    dependencies.clear();
+    CHECK(mgl::LoadGltf(dir + "/embedded.gltf", meshes, &dependencies));
+    checkTriangle(meshes);
+    CHECK(dependencies.empty());
+
+    // 索引超出缓冲区视图的图元被跳过
+    json = triangleJson("triangle.bin", 1000);
+    CHECK(writeBytes(dir + "/overrun.gltf", textBytes(json)));
+    meshes.clear();
+    CHECK(mgl::LoadGltf(dir + "/overrun.gltf", meshes));
+    CHECK(meshes.empty());
+
+    // GLB: 文件头 | JSON块 | BIN块, 块长度按4字节对齐
+    json = triangleJson("", 3);
+    while (json.size() % 4) json += ' ';
+    Bytes glb;
+    appendU32(glb, 0x46546C67);
+    appendU32(glb, 2);
+    appendU32(glb, static_cast<uint32_t>(12 + 8 + json.size() + 8 + 44));
+    appendU32(glb, static_cast<uint32_t>(json.size()));
+    appendU32(glb, 0x4E4F534A);
+    glb.insert(glb.end(), json.begin(), json.end());
+    appendU32(glb, 44);
+    appendU32(glb, 0x004E4942);
+    glb.insert(glb.end(), buffer.begin(), buffer.end());
+    CHECK(writeBytes(dir + "/triangle.glb", glb));
+    meshes.clear();
+    CHECK(mgl::LoadGltf(dir + "/triangle.glb", meshes));
+    checkTriangle(meshes);
+
+    // 截断的GLB缺少JSON块或BIN块, 导入失败
+    for (size_t size = 0; size < glb.size(); ++size) {
+        CHECK(writeBytes(dir + "/truncated.glb",
+                         Bytes(glb.begin(), glb.begin() + size)));
+        meshes.clear();
+        CHECK(!mgl::LoadGltf(dir + "/truncated.glb", meshes));
+    }
+}
+
+// side*side个顶点的平面网格, 每个四边形单独使用4个顶点, 三角形顺序打乱
+mgl::MeshData quadGrid(int side, uint32_t seed) {
+    mgl::MeshData mesh;
+    for (int y = 0; y + 1 < side; ++y) {
+        for (int x = 0; x + 1 < side; ++x) {
+            unsigned int base = static_cast<unsigned int>(mesh.vertices.size());
+            for (int k = 0; k < 4; ++k) {
+                mgl::Vertex v;
+                std::memset(&v, 0, sizeof(v));
+                v.Position = glm::vec3(float(x + k % 2), float(y + k / 2), 0);
+                v.Normal = glm::vec3(0, 0, 1);
+                v.TexCoords = glm::vec2(float(x + k % 2) / float(side - 1),
+                                        float(y + k / 2) / float(side - 1));
+                mesh.vertices.push_back(v);
+            }
+            const unsigned int quad[] = {0, 1, 2, 2, 1, 3};
+            for (unsigned int i : quad) mesh.indices.push_back(base + i);
+        }
+    }
+    std::vector<size_t> order(mesh.indices.size() / 3);
+    for (size_t t = 0; t < order.size(); ++t) order[t] = t;
+    std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+    std::vector<unsigned int> shuffled;
+    for (size_t t : order) {
+        shuffled.insert(shuffled.end(), mesh.indices.begin() + 3 * t,
+                        mesh.indices.begin() + 3 * t + 3);
+    }
+    mesh.indices.swap(shuffled);
+    return mesh;
+}
+
+void testMeshOptimize() {
+    // FIFO缓存模拟: 共享一条边的两个三角形只变换4个顶点
+    const unsigned int pair[] = {0, 1, 2, 2, 1, 3};
+    mgl::VertexCacheStats stats = mgl::AnalyzeVertexCache(pair, 6, 4);
+    CHECK(stats.triangles == 2 && stats.vertices == 4 && stats.misses == 4);
+    CHECK(stats.acmr() == 2.0 && stats.atvr() == 1.0);
+    // 缓存只有3项时, 重复使用最早进入的顶点会未命中
+    const unsigned int evict[] = {0, 1, 2, 3, 4, 5, 0, 1, 2};
+    CHECK(mgl::AnalyzeVertexCache(evict, 9, 6, 3).misses == 9);
+
+    // 400*400的网格合并后只剩格点, 缓存优化后ACMR明显下降
+    const int side = 400;
+    mgl::MeshData mesh = quadGrid(side, 7);
+    const size_t unwelded = size_t(side - 1) * (side - 1) * 4;
+    CHECK(mesh.vertices.size() == unwelded);
+    std::vector<glm::vec3> triangles;
+    for (unsigned int i : mesh.indices) {
+        triangles.push_back(mesh.vertices[i].Position);
+    }
+    CHECK(mgl::WeldVertices(mesh) == unwelded - size_t(side) * side);
+    CHECK(mesh.vertices.size() == size_t(side) * side);
+    mgl::MeshOptimizeStats optimized = mgl::OptimizeMesh(mesh);
+    CHECK(mesh.vertices.size() == size_t(side) * side);
+    CHECK(optimized.before.acmr() > 2.0);
+    CHECK(optimized.after.acmr() < 0.7);
+    CHECK(optimized.after.atvr() < 1.3);
+    mgl::VertexCacheStats after = mgl::AnalyzeVertexCache(
+        mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    CHECK(after.misses == optimized.after.misses);
+
+    // 160000个顶点切分为3个可使用16位索引的部分, 三角形的集合不变
+    std::vector<mgl::MeshData> parts;
+    CHECK(mgl::SplitForShortIndices(mesh, parts));
+    CHECK(parts.size() == 3);
+    std::vector<glm::vec3> split;
+    size_t outOfRange = 0;
+    for (auto& part : parts) {
+        CHECK(part.vertices.size() <= 0xFFFF);
+        CHECK(part.indices.size() % 3 == 0);
+        for (unsigned int i : part.indices) {
+            if (i >= part.vertices.size()) {
+                ++outOfRange;
+                continue;
+            }
+            split.push_back(part.vertices[i].Position);
+        }
+    }
+    CHECK(outOfRange == 0);
+    auto less = [](const glm::vec3& a, const glm::vec3& b) {
+        return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    };
+    std::vector<glm::vec3> expected;
+    for (unsigned int i : mesh.indices) {
+        expected.push_back(mesh.vertices[i].Position);
+    }
+    CHECK(split == expected);
+    std::sort(triangles.begin(), triangles.end(), less);
+    std::sort(expected.begin(), expected.end(), less);
+    CHECK(triangles == expected);
+
+    // 顶点数在16位范围内时不切分
+    mgl::MeshData small = quadGrid(8, 1);
+    parts.clear();
+    CHECK(!mgl::SplitForShortIndices(small, parts) && parts.empty());
+}
+
+// 用双精度计算的半精度参考值, 就近舍入且恰在中间时取偶数
+uint16_t referenceHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    if (std::isnan(value)) return sign | 0x7E00;
+    double abs = std::fabs(double(value));
+    if (std::isinf(value)) return sign | 0x7C00;
+    // 所在区间的最小间隔, 非规格化数的间隔固定为2^-24
+    int exponent = abs > 0.0 ? std::max(std::ilogb(abs), -14) : -14;
+    double quantum = std::ldexp(1.0, exponent - 10);
+    double rounded = std::nearbyint(abs / quantum) * quantum;
+    if (rounded >= 65536.0) return sign | 0x7C00;
+    if (rounded < std::ldexp(1.0, -14)) {
+        return sign | static_cast<uint16_t>(rounded / std::ldexp(1.0, -24));
+    }
+    int e = std::ilogb(rounded);
+    uint32_t mantissa =
+        static_cast<uint32_t>((rounded / std::ldexp(1.0, e) - 1.0) * 1024.0);
+    return sign | static_cast<uint16_t>((e + 15) << 10 | mantissa);
+}
+
+// 与着色器中decodeOctahedral相同的解码
+glm::vec3 decodeOctahedral(const int16_t e[2]) {
+    float x = std::max(e[0] / 32767.0f, -1.0f);
+    float y = std::max(e[1] / 32767.0f, -1.0f);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float length = std::sqrt(x * x + y * y + z * z);
+    return glm::vec3(x / length, y / length, z / length);
+}
+
+void testVertexPacking() {
+    // 特殊值: 零, 舍入边界, 最大有限值, 非规格化数与无穷
+    const float specials[] = {0.0f,      -0.0f,     1.0f,        -2.0f,
+                              65504.0f,  65519.99f, 65520.0f,    1e-8f,
+                              2.98e-8f,  5.96e-8f,  6.1035e-5f,  1e30f,
+                              -1e-30f,   INFINITY,  -INFINITY};
+    for (float value : specials) {
+        CHECK(mgl::FloatToHalf(value) == referenceHalf(value));
+    }
+    CHECK(mgl::FloatToHalf(65504.0f) == 0x7BFF);
+    CHECK(mgl::FloatToHalf(65520.0f) == 0x7C00);
+    uint16_t nan = mgl::FloatToHalf(NAN);
+    CHECK((nan & 0x7C00) == 0x7C00 && (nan & 0x3FF) != 0);
+
+    // 200万个随机输入逐位比较: 一半为任意位模式, 一半在半精度范围附近
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> mantissa(1.0f, 2.0f);
+    std::uniform_int_distribution<int> exponent(-27, 16);
+    size_t mismatches = 0;
+    for (int i = 0; i < 2000000; ++i) {
+        float value;
+        if (i % 2) {
+            uint32_t bits = static_cast<uint32_t>(random());
+            std::memcpy(&value, &bits, sizeof(value));
+            if (std::isnan(value)) continue;
+        } else {
+            value = std::ldexp(mantissa(random), exponent(random));
+            if (random() & 1) value = -value;
+        }
+        mismatches += mgl::FloatToHalf(value) != referenceHalf(value);
+    }
+    CHECK(mismatches == 0);
+
+    // 八面体编码往返: 坐标轴与随机单位向量的角度误差小于0.04度
+    std::normal_distribution<float> gaussian;
+    std::vector<glm::vec3> normals = {
+        glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+        glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)};
+    for (int i = 0; i < 1000000; ++i) {
+        float x = gaussian(random), y = gaussian(random), z = gaussian(random);
+        float length = std::sqrt(x * x + y * y + z * z);
+        if (length < 1e-6f) continue;
+        normals.push_back(glm::vec3(x / length, y / length, z / length));
+    }
+    double worst = 0.0;
+    for (const glm::vec3& n : normals) {
+        int16_t encoded[2];
+        mgl::EncodeOctahedral(n, encoded);
+        glm::vec3 d = decodeOctahedral(encoded);
+        // 用叉积与点积求夹角, 接近0度时acos的精度不足
+        double cx = double(n.y) * d.z - double(n.z) * d.y;
+        double cy = double(n.z) * d.x - double(n.x) * d.z;
+        double cz = double(n.x) * d.y - double(n.y) * d.x;
+        double dot = double(n.x) * d.x + double(n.y) * d.y + double(n.z) * d.z;
+        double angle = std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot);
+        worst = std::max(worst, angle * 180.0 / 3.14159265358979);
+    }
+    CHECK(worst < 0.04);
+}
+
+// 把各层RGBA像素编码为format, 与烘焙图像一样带完整的mip链
+mgl::Image encodedImage(mgl::PixelFormat format,
+                        const std::vector<mgl::MipLevel>& chain,
+                        int channels) {
+    mgl::Image image;
+    image.width = chain[0].width;
+    image.height = chain[0].height;
+    image.channels = channels;
+    image.format = format;
+    size_t total = 0;
+    for (auto& level : chain) {
+        total += mgl::ImageLevelSize(format, level.width, level.height);
+    }
+    image.pixels.resize(total);
+    size_t offset = 0;
+    for (auto& level : chain) {
+        mgl::ImageLevel out;
+        out.width = level.width;
+        out.height = level.height;
+        out.data = image.pixels.data() + offset;
+        out.size = mgl::ImageLevelSize(format, level.width, level.height);
+        mgl::EncodeImageLevel(format, level.pixels.data(), level.width,
+                              level.height, image.pixels.data() + offset);
+        offset += out.size;
+        image.levels.push_back(out);
+    }
+    image.data = image.pixels.data();
+    return image;
+}
+
+void testMaterialPacker() {
+    // 不透明的漫反射与灰度高光, 以及alpha为高光的参考图像
+    const int width = 32, height = 16;
+    std::mt19937 random(5);
+    Bytes color(size_t(width) * height * 4), gloss(color.size());
+    Bytes combined(color.size());
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            size_t i = (size_t(y) * width + x) * 4;
+            unsigned char s = static_cast<unsigned char>(x * 8 ^ y * 16);
+            color[i] = static_cast<unsigned char>(x * 8);
+            color[i + 1] = static_cast<unsigned char>(y * 16);
+            color[i + 2] = static_cast<unsigned char>(random() & 0x3F);
+            color[i + 3] = 255;
+            gloss[i] = gloss[i + 1] = gloss[i + 2] = s;
+            gloss[i + 3] = 255;
+            std::memcpy(&combined[i], &color[i], 3);
+            combined[i + 3] = s;
+        }
+    }
+    auto chain = [&](const Bytes& rgba) {
+        return mgl::BuildMipChain(rgba.data(), width, height,
+                                  mgl::MipFilter::Box, false);
+    };
+    auto colorChain = chain(color), glossChain = chain(gloss);
+    auto combinedChain = chain(combined);
+    CHECK(colorChain.size() == 6);
+
+    // BC1 + BC4交错为BC3, 与直接编码alpha为高光的图像逐字节相同
+    mgl::Image diffuse = encodedImage(mgl::PixelFormat::BC1, colorChain, 3);
+    mgl::Image specular = encodedImage(mgl::PixelFormat::BC4, glossChain, 1);
+    mgl::Image expected = encodedImage(mgl::PixelFormat::BC3, combinedChain, 4);
+    mgl::Image packed;
+    CHECK(mgl::PackSpecularIntoAlpha(diffuse, specular, packed));
+    CHECK(packed.format == mgl::PixelFormat::BC3 && packed.channels == 4);
+    CHECK(packed.width == width && packed.height == height);
+    CHECK(packed.levels.size() == expected.levels.size());
+    CHECK(packed.pixels == expected.pixels);
+    for (size_t l = 0; l < packed.levels.size(); ++l) {
+        const mgl::ImageLevel& level = packed.levels[l];
+        CHECK(level.size == expected.levels[l].size);
+        CHECK(level.data == packed.pixels.data() +
+                                (expected.levels[l].data - expected.data));
+    }
+    CHECK(packed.data == packed.pixels.data());
+
+    // 未压缩: RGB8 + R8得到RGBA8
+    mgl::Image rgb = encodedImage(mgl::PixelFormat::RGB8, colorChain, 3);
+    mgl::Image r8 = encodedImage(mgl::PixelFormat::R8, glossChain, 1);
+    mgl::Image rgba = encodedImage(mgl::PixelFormat::RGBA8, combinedChain, 4);
+    mgl::Image merged;
+    CHECK(mgl::PackSpecularIntoAlpha(rgb, r8, merged));
+    CHECK(merged.format == mgl::PixelFormat::RGBA8);
+    CHECK(merged.pixels == rgba.pixels);
+
+    // 格式不匹配或尺寸不同时不合并, 输出不变
+    mgl::Image untouched;
+    CHECK(!mgl::PackSpecularIntoAlpha(diffuse, r8, untouched));
+    CHECK(!mgl::PackSpecularIntoAlpha(rgb, specular, untouched));
+    auto half = mgl::BuildMipChain(glossChain[1].pixels.data(), width / 2,
+                                   height / 2, mgl::MipFilter::Box, false);
+    mgl::Image small = encodedImage(mgl::PixelFormat::BC4, half, 1);
+    CHECK(!mgl::PackSpecularIntoAlpha(diffuse, small, untouched));
+    CHECK(!untouched.valid());
+}
+
+void testShaderCook() {
+    // 注释与行尾空白被去掉, CRLF变为LF, 行数不变以保持编译错误的行号
+    const std::string source =
+        "#version 330 core\t\r\n"
+        "// header\r\n"
+        "uniform vec3 a; // trailing\n"
+        "float b = 1.0 / 2.0;   \n"
+        "/* block\n"
+        "   spans */ int c;\n"
+        "int/**/d;\n"
+        "/* unterminated";
+    const std::string expected =
+        "#version 330 core\n"
+        "\n"
+        "uniform vec3 a;\n"
+        "float b = 1.0 / 2.0;\n"
+        "\n"
+        "  int c;\n"
+        "int d;\n";
+    std::string cooked = mgl::CookShaderSource(source);
+    CHECK(cooked == expected);
+    CHECK(std::count(cooked.begin(), cooked.end(), '\n') ==
+          std::count(source.begin(), source.end(), '\n'));
+    // 已烘焙的源码再次烘焙不变
+    CHECK(mgl::CookShaderSource(cooked) == cooked);
+    CHECK(mgl::CookShaderSource("").empty());
+}
+}  // namespace
+
+int main() {
+    std::filesystem::remove_all(TEMP_DIRECTORY);
+    if (!mgl::MakeDirectory(TEMP_DIRECTORY)) {
+        std::printf("ERROR::TEST::MKDIR %s\n", TEMP_DIRECTORY.c_str());
+        return 1;
+    }
+    testLz4RoundTrip();
+    testLz4Corrupt();
+    testResourcePack();
+    testJson();
+    testGltf();
+    testMeshOptimize();
+    testVertexPacking();
+    testMaterialPacker();
+    testShaderCook();
+    std::filesystem::remove_all(TEMP_DIRECTORY);
+
+    std::printf("TEST %d checks, %d failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}